@@ -0,0 +1,768 @@
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+// {{{ headers
+#include <list>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <iterator>
+#include <algorithm>
+
+#include <blitz/array.h>
+#include <blitz/tinyvec.h>
+#include <blitz/tinyvec-et.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <lear/cmdline.h>
+#include <lear/exception.h>
+#include <lear/util/customoption.h>
+#include <lear/image/imageio.h>
+#include <lear/image/imageutil.h>
+#include <lear/image/rescale.h>
+#include <lear/numericutil/gauss.h>
+#include <lear/blitz/ext/convolve.h>
+#include <lear/blitz/ext/sepconvolve.h>
+#include <lear/image/colorconversion.h>
+#include <lear/cvision/iprocessor.h>
+#include <lear/cvision/blockmap.h>
+#include <lear/cvision/imageslider.h>
+#include <lear/cvision/scalepyramid.h>
+#include <lear/classifier/ms_processresult.h>
+#include <lear/classifier/ss_processresult.h>
+#include <lear/classifier/greedy_processresult.h>
+#include <lear/interface/windetect.h>
+// }}}
+
+// {{{  command line parameters
+using namespace std;
+using namespace lear;
+
+typedef float                               RealType;
+typedef blitz::TinyVector<RealType,3>       RGBType;
+typedef blitz::Array<RealType,2>            GrayImage;
+typedef blitz::Array<RGBType,2>             RGBImage;
+typedef blitz::TinyVector<int,2>            IndexType;
+
+static string imagefile;
+static int verbose, repeat, width, height;
+static RealType gscale, tolerance;
+
+enum Bench {Convolve, Remap, NonMax, Classify, Hog};
+static Bench bench = Convolve;
+// }}}
+
+// {{{ timing and comparison helpers
+typedef boost::posix_time::ptime            TimeType;
+
+static inline TimeType now() {
+    return boost::posix_time::microsec_clock::local_time();
+}
+/// milliseconds per repetition since start
+static inline double elapsed(const TimeType start) {
+    return (now() - start).total_microseconds()/(1000.0*repeat);
+}
+
+static void report(const string& name, const double ms, const double diff) {
+    cout << setw(28) << left << name << right
+         << setw(10) << fixed << setprecision(3) << ms << " ms"
+         << "   max|diff| " << scientific << setprecision(2) << diff
+         << endl;
+    cout.unsetf(ios_base::floatfield);
+}
+
+template<class T>
+static RealType maxdiff(const blitz::Array<T,2>& a, const blitz::Array<T,2>& b)
+{
+    const RealType* pa = reinterpret_cast<const RealType*>(a.data());
+    const RealType* pb = reinterpret_cast<const RealType*>(b.data());
+    const int n = a.numElements()*sizeof(T)/sizeof(RealType);
+    RealType r = 0;
+    for (int i= 0; i< n; ++i)
+        r = std::max(r, std::abs(pa[i]-pb[i]));
+    return r;
+}
+// }}}
+
+// {{{ input image
+/// Reads imagefile, or synthesizes a width x height image if none given.
+static RGBImage inputimage() {
+    RGBImage image;
+    if (!imagefile.empty()) {
+        ImageIO::read(imagefile, image);
+        return image;
+    }
+    image.resize(width, height);
+    srand(0);
+    for (int x= 0; x< width; ++x)
+    for (int y= 0; y< height; ++y)
+        for (int c= 0; c< 3; ++c)
+            image(x,y)[c] = rand() % 256;
+    return image;
+}
+// }}}
+
+// {{{ convolve
+template<class Conv, class T>
+static double smooth(
+        const blitz::Array<T,2>& in, const blitz::Array<RealType,1>& kernel,
+        blitz::Array<T,2>& tmp, blitz::Array<T,2>& out)
+{
+    Conv conv;
+    TimeType start = now();
+    for (int r= 0; r< repeat; ++r) {
+        conv.dim1(in, kernel, tmp);
+        conv.dim2(tmp, kernel, out);
+    }
+    return elapsed(start);
+}
+
+static void benchconvolve() {
+    using namespace blitz;
+    typedef ConvolveExact<CPolicy_Chop>     Exact;
+    typedef ConvolveSeparable<CPolicy_Chop> Separable;
+
+    const RGBImage rgb (inputimage());
+    const Array<RealType,1> kernel (Gauss::discrete(gscale,3));
+    const int n0 = rgb.extent(0), n1 = rgb.extent(1);
+
+    cout << "image " << n0 << "x" << n1 << ", kernel " << kernel.extent(0)
+         << " taps, " << repeat << " repetitions" << endl;
+
+    {// interleaved rgb
+        RGBImage tmp(rgb.shape()), exact(rgb.shape()), sep(rgb.shape());
+        report("rgb exact", smooth<Exact>(rgb,kernel,tmp,exact), 0);
+        double ms = smooth<Separable>(rgb,kernel,tmp,sep);
+        report("rgb separable", ms, maxdiff(exact,sep));
+    }
+    GrayImage gray(rgb.shape());
+    for (int x= 0; x< n0; ++x)
+    for (int y= 0; y< n1; ++y)
+        gray(x,y) = (rgb(x,y)[0] + rgb(x,y)[1] + rgb(x,y)[2])/3;
+    {// gray
+        GrayImage tmp(gray.shape()), exact(gray.shape()), sep(gray.shape());
+        report("gray exact", smooth<Exact>(gray,kernel,tmp,exact), 0);
+        double ms = smooth<Separable>(gray,kernel,tmp,sep);
+        report("gray separable", ms, maxdiff(exact,sep));
+
+        // planar rgb: three gray planes back to back
+        const int plane = n0*n1;
+        vector<RealType> in(3*plane), out(3*plane), buf(plane);
+        for (int x= 0; x< n0; ++x)
+        for (int y= 0; y< n1; ++y)
+            for (int c= 0; c< 3; ++c)
+                in[c*plane + x*n1 + y] = rgb(x,y)[c];
+
+        const vector<RealType> c (kernel.begin(), kernel.end());
+        TimeType start = now();
+        for (int r= 0; r< repeat; ++r)
+            for (int p= 0; p< 3; ++p)
+                Separable::convolve(&in[p*plane], &out[p*plane], &buf[0],
+                        n0, n1, 1, &c[0], kernel.lbound(0), kernel.ubound(0));
+        ms = elapsed(start);
+
+        RGBImage rtmp(rgb.shape()), rexact(rgb.shape());
+        Exact conv;
+        conv.dim1(rgb, kernel, rtmp);
+        conv.dim2(rtmp, kernel, rexact);
+        RealType diff = 0;
+        for (int x= 0; x< n0; ++x)
+        for (int y= 0; y< n1; ++y)
+            for (int p= 0; p< 3; ++p)
+                diff = std::max(diff,
+                        std::abs(out[p*plane + x*n1 + y] - rexact(x,y)[p]));
+        report("planar rgb separable", ms, diff);
+    }
+}
+// }}}
+
+// {{{ remap
+/// Reference Lab remap: per pixel conversion, as done before tables
+static RGBImage labreference(const RGBImage& img, const bool dosqrt) {
+    RGB2LabFunctor toLab;
+    RGBImage lab (img.lbound(), img.extent());
+    std::transform(img.begin(), img.end(), lab.begin(), toLab);
+
+    lab[0] *= 255.0/100;
+    lab[1] = (lab[1] +  87)*(255.0/( 99+ 87));
+    lab[2] = (lab[2] + 108)*(255.0/( 95+108));
+    if (dosqrt)
+        lab = blitz::sqrt(lab);
+    return lab;
+}
+
+/// Times reference, table lookup on float input and fused 8-bit input
+template<class Reference>
+static void benchremap(const string& name, const ImageNoRemap& remap,
+        const Reference& reference,
+        const RGBImage& rgb, const ImageNoRemap::RGB8Image& rgb8)
+{
+    RGBImage ref, lut, fused;
+
+    TimeType start = now();
+    for (int r= 0; r< repeat; ++r)
+        ref.reference(reference(rgb));
+    report(name + " reference", elapsed(start), 0);
+
+    start = now();
+    for (int r= 0; r< repeat; ++r)
+        lut.reference(remap(rgb));
+    report(name + " table", elapsed(start), maxdiff(ref,lut));
+
+    start = now();
+    for (int r= 0; r< repeat; ++r)
+        fused.reference(remap(rgb8));
+    report(name + " table 8-bit", elapsed(start), maxdiff(ref,fused));
+}
+
+struct SqrtReference {
+    RGBImage operator()(const RGBImage& img) const 
+    { RGBImage t(blitz::sqrt(img)); return t; }
+};
+struct LogReference {
+    RGBImage operator()(const RGBImage& img) const 
+    { RGBImage t(blitz::log(img+1)); return t; }
+};
+struct LabReference {
+    bool dosqrt;
+    LabReference(const bool dosqrt) : dosqrt(dosqrt) {}
+    RGBImage operator()(const RGBImage& img) const 
+    { return labreference(img, dosqrt); }
+};
+
+static void benchremap() {
+    const RGBImage rgb (inputimage());
+    ImageNoRemap::RGB8Image rgb8 (rgb.shape());
+    for (int x= 0; x< rgb.extent(0); ++x)
+    for (int y= 0; y< rgb.extent(1); ++y)
+        for (int c= 0; c< 3; ++c)
+            rgb8(x,y)[c] = static_cast<unsigned char>(rgb(x,y)[c]);
+
+    cout << "image " << rgb.extent(0) << "x" << rgb.extent(1) << ", "
+         << repeat << " repetitions" << endl;
+
+    benchremap("sqrt", ImageSqrtRemap(), SqrtReference(), rgb, rgb8);
+    benchremap("log", ImageLogRemap(), LogReference(), rgb, rgb8);
+    benchremap("lab table", ImageLabRemap(ImageLabRemap::TableNodes), 
+            LabReference(false), rgb, rgb8);
+    benchremap("lab sqrt table", ImageLabSqrtRemap(ImageLabRemap::TableNodes),
+            LabReference(true), rgb, rgb8);
+
+    TimeType start = now();
+    ImageLabRemap exact(ImageLabRemap::ExactNodes);
+    cout << "exact lab table built in " << fixed << setprecision(1)
+         << (now() - start).total_milliseconds() << " ms" << endl;
+    cout.unsetf(ios_base::floatfield);
+    benchremap("lab exact", exact, LabReference(false), rgb, rgb8);
+}
+// }}}
+
+// {{{ nonmax
+/// One candidate window per lattice position of every pyramid level
+struct Candidates {
+    typedef blitz::TinyVector<int,2>            IndexType;
+    struct Level {
+        IndexType topleft, extent;
+        RealType scale;
+    };
+    vector<Level>               level;
+    vector<DetectInfo>          window;
+};
+
+/**
+ * Scores the windows of a width x height image pyramid against a synthetic
+ * scale space holding a few objects, plus uniform noise.
+ */
+static Candidates candidates(const IndexType winsize, const IndexType winstride) {
+    typedef lear::ImageSlider<2>                SliderType;
+    typedef lear::ScalePyramid<2>               PyramidType;
+
+    srand(0);
+    const int numobj = 8;
+    vector<blitz::TinyVector<RealType,3> > obj(numobj);
+    for (int i= 0; i< numobj; ++i) {
+        const RealType s = std::exp((rand() % 1000)/1000.0 *
+                std::log(std::min(width/RealType(winsize[0]),
+                        height/RealType(winsize[1]))));
+        obj[i] = (rand() % 1000)/1000.0*(width - s*winsize[0]) + s*winsize[0]/2,
+                 (rand() % 1000)/1000.0*(height - s*winsize[1]) + s*winsize[1]/2,
+                 std::log(s);
+    }
+
+    Candidates c;
+    const PyramidType pyramid(IndexType(width,height), winsize, 1.05, 0, 1);
+    for (PyramidType::iterator piter = pyramid.begin(); 
+            piter != pyramid.end(); ++piter) 
+    {
+        SliderType slider(*piter, winsize, winstride);
+        Candidates::Level l = {slider.lbound(), slider.elem_extent(), piter.scale()};
+        c.level.push_back(l);
+
+        for (SliderType::iterator siter = slider.begin(); 
+                siter != slider.end(); ++siter) 
+        {
+            const IndexType tl = *siter;
+            const RealType scale = piter.scale();
+            blitz::TinyVector<RealType,2> cen (scale*(tl + winsize/2.0));
+            blitz::TinyVector<RealType,2> sz (winsize*scale);
+
+            RealType score = (rand() % 1000)/1000.0 - 1.5;
+            for (int i= 0; i< numobj; ++i) {
+                const RealType dx = (cen[0] - obj[i][0])/(8*scale);
+                const RealType dy = (cen[1] - obj[i][1])/(16*scale);
+                const RealType ds = (std::log(scale) - obj[i][2])/std::log(1.3);
+                score += 3*std::exp(-(dx*dx + dy*dy + ds*ds)/2);
+            }
+            c.window.push_back(DetectInfo(score, scale,
+                    blitz::ceil(cen - sz/2), blitz::floor(sz), tl));
+        }
+    }
+    return c;
+}
+
+/// Feeds all candidates to p level by level and runs the suppression
+static double suppress(ProcessResult& p, const Candidates& c) {
+    TimeType start = now();
+    for (int r= 0; r< repeat; ++r) {
+        p.clear();
+        unsigned w = 0;
+        for (unsigned l= 0; l< c.level.size(); ++l) {
+            const Candidates::Level& lv = c.level[l];
+            p.newpyramid(lv.topleft, lv.extent, lv.scale, IndexType(0));
+            const unsigned n = blitz::product(lv.extent);
+            for (unsigned k= 0; k< n; ++k, ++w)
+                p(c.window[w]);
+        }
+        p.doit();
+    }
+    return elapsed(start);
+}
+
+/// Detections of b whose center is within a quarter window of one in a
+static int agree(const ProcessResult& a, const ProcessResult& b) {
+    int n = 0;
+    for (ProcessResult::const_iterator j = b.begin(); j != b.end(); ++j) 
+    for (ProcessResult::const_iterator i = a.begin(); i != a.end(); ++i) {
+        blitz::TinyVector<RealType,2> d = 
+            (i->lbound + i->extent/2.0) - (j->lbound + j->extent/2.0);
+        if (std::abs(d[0]) < i->extent[0]/4.0 && 
+            std::abs(d[1]) < i->extent[1]/4.0 && 
+            std::abs(std::log(i->scale/j->scale)) < std::log(1.3)) 
+        {
+            ++n;
+            break;
+        }
+    }
+    return n;
+}
+
+static void benchnonmax() {
+    const IndexType winsize(64,128), winstride(8,8);
+    const Candidates c (candidates(winsize, winstride));
+
+    vector<RealType> sorted;
+    for (unsigned i= 0; i< c.window.size(); ++i)
+        sorted.push_back(c.window[i].score);
+    std::sort(sorted.begin(), sorted.end());
+
+    cout << "image " << width << "x" << height << ", " << c.level.size() 
+         << " levels, " << c.window.size() << " windows, " 
+         << repeat << " repetitions" << endl;
+
+    const blitz::TinyVector<RealType,2> score2prob(1,0);
+    const blitz::TinyVector<RealType,3> sigma(8,16,1.3);
+    const RealType fraction[] = {0.002, 0.01, 0.05};
+    for (unsigned f= 0; f< sizeof(fraction)/sizeof(fraction[0]); ++f) {
+        const int k = static_cast<int>((1-fraction[f])*sorted.size());
+        const RealType light = sorted[std::min<int>(k, sorted.size()-1)];
+        const int numcand = sorted.end() - 
+            std::upper_bound(sorted.begin(), sorted.end(), light);
+
+        MS_ProcessResult ms(winsize, light, 0.1, score2prob, sigma, 0);
+        SS_ProcessResult ss(winsize, light, 0.1, score2prob, sigma, 0, winstride);
+        Greedy_ProcessResult greedy(light, 0.1, 0.5);
+
+        cout << numcand << " windows above lightthreshold " 
+             << setprecision(3) << light << endl;
+        const double msms = suppress(ms, c);
+        const double ssms = suppress(ss, c);
+        const double grms = suppress(greedy, c);
+        cout << setw(28) << left << "  mean shift" << right 
+             << setw(10) << fixed << setprecision(3) << msms << " ms   "
+             << std::distance(ms.begin(), ms.end()) << " detections" << endl;
+        cout << setw(28) << left << "  scale space" << right 
+             << setw(10) << fixed << setprecision(3) << ssms << " ms   "
+             << std::distance(ss.begin(), ss.end()) << " detections, "
+             << agree(ms, ss) << " near a mean shift one" << endl;
+        cout << setw(28) << left << "  greedy overlap" << right 
+             << setw(10) << fixed << setprecision(3) << grms << " ms   "
+             << std::distance(greedy.begin(), greedy.end()) << " detections, "
+             << agree(ms, greedy) << " near a mean shift one" << endl;
+        cout.unsetf(ios_base::floatfield);
+    }
+
+    // greedy alone on large candidate sets: random windows of all scales
+    const int numcand[] = {10000, 30000, 100000};
+    for (unsigned f= 0; f< sizeof(numcand)/sizeof(numcand[0]); ++f) {
+        Candidates r;
+        for (int i= 0; i< numcand[f]; ++i) {
+            const RealType scale = 1 + (rand() % 1000)/1000.0*2;
+            const IndexType sz (blitz::floor(winsize*scale));
+            r.window.push_back(DetectInfo((rand() % 1000)/1000.0, scale,
+                IndexType(rand() % width - sz[0]/2, rand() % height - sz[1]/2), sz));
+        }
+        Candidates::Level l = {IndexType(0), IndexType(numcand[f],1), 1};
+        r.level.push_back(l);
+
+        Greedy_ProcessResult greedy(0, 0, 0.5);
+        const double ms = suppress(greedy, r);
+        cout << setw(28) << left << "  greedy, random windows" << right 
+             << setw(10) << fixed << setprecision(3) << ms << " ms   "
+             << numcand[f] << " candidates, "
+             << std::distance(greedy.begin(), greedy.end()) << " detections" << endl;
+        cout.unsetf(ios_base::floatfield);
+    }
+}
+// }}}
+
+// {{{ classify
+/// largest absolute difference of the n scores a and b
+static RealType maxdiff(const vector<float>& a, const vector<float>& b) {
+    RealType r = 0;
+    for (unsigned i= 0; i< a.size(); ++i)
+        r = std::max(r, std::abs(a[i]-b[i]));
+    return r;
+}
+
+/// Times count windows scored by c in batches of batch windows
+static double classify(const WindowClassifier& c, const vector<float>& desc, 
+        const int count, const int batch, vector<float>& score) 
+{
+    const int n = c.length();
+    score.resize(count);
+    TimeType start = now();
+    for (int r= 0; r< repeat; ++r)
+        for (int k= 0; k< count; k+= batch) 
+            c(&desc[k*n], std::min(batch, count - k), &score[k]);
+    return elapsed(start);
+}
+
+static void benchclassify() {
+    const LinearClassify linear;
+    const int n = linear.length(), count = 2048, batch = 32;
+
+    // normalized block values, clipped at 0.2
+    srand(0);
+    vector<float> desc(count*n);
+    for (unsigned i= 0; i< desc.size(); ++i)
+        desc[i] = (rand() % 1000)/1000.0*0.2;
+
+    cout << count << " windows of " << n << " values, batches of " << batch 
+         << ", " << repeat << " repetitions" << endl;
+
+    vector<float> ref, score;
+    TimeType start = now();
+    for (int r= 0; r< repeat; ++r) {
+        ref.resize(count);
+        for (int k= 0; k< count; ++k)
+            ref[k] = linear(&desc[k*n]);
+    }
+    report("linear one by one", elapsed(start), 0);
+    const double ms = classify(linear, desc, count, batch, score);
+    report("linear batch", ms, maxdiff(ref, score));
+    const FloatClassify simd(linear);
+    report("float sse batch", classify(simd, desc, count, batch, score), 
+            maxdiff(ref, score));
+
+    // additive kernel models of synthetic support vectors, against the
+    // exact kernel sum on the first windows
+    const int numsv = 256, exact = 64;
+    vector<float> sv(numsv*n);
+    vector<double> alpha(numsv);
+    for (unsigned i= 0; i< sv.size(); ++i)
+        sv[i] = (rand() % 1000)/1000.0*0.2;
+    for (int j= 0; j< numsv; ++j)
+        alpha[j] = (rand() % 1000)/1000.0 - 0.5;
+    for (int kernel= 0; kernel< 2; ++kernel) {
+        const bool chi2 = kernel == AdditiveClassify::ChiSquare;
+        start = now();
+        const AdditiveClassify additive(n, sv, alpha, 0, 64,
+                static_cast<AdditiveClassify::Kernel>(kernel));
+        const double build = (now() - start).total_milliseconds();
+        const double ams = classify(additive, desc, count, batch, score);
+        RealType diff = 0;
+        for (int k= 0; k< exact; ++k) {
+            double s = 0;
+            for (int j= 0; j< numsv; ++j)
+                for (int i= 0; i< n; ++i) {
+                    const double v = desc[k*n + i], w = sv[j*n + i];
+                    s += alpha[j]*(chi2 ? (v + w > 0 ? 2*v*w/(v + w) : 0) 
+                            : std::min(v, w));
+                }
+            diff = std::max(diff, static_cast<RealType>(std::abs(s - score[k])));
+        }
+        report(chi2 ? "chi2 table batch" : "intersection table batch", ams, diff);
+        cout << "  " << numsv << " support vectors, tables built in " 
+             << fixed << setprecision(1) << build << " ms, "
+             << setprecision(2) << ams/ms << "x the linear batch time" << endl;
+        cout.unsetf(ios_base::floatfield);
+    }
+}
+// }}}
+
+// {{{ hog
+/// Differences between the values of two block maps
+struct BlockDiff {
+    BlockDiff() : count(0), above(0), sum(0), max(0) {}
+
+    void operator()(const BlockMap& a, const BlockMap& b) {
+        std::vector<float> va(a.featsize()), vb(b.featsize());
+        const IndexType extent (a.extent());
+        for (int i= 0; i< extent[0]; ++i) 
+        for (int j= 0; j< extent[1]; ++j) {
+            const IndexType loc (a.origin() + IndexType(i,j)*a.stride());
+            a.read(loc, &va[0]);
+            b.read(loc, &vb[0]);
+            for (unsigned k= 0; k< va.size(); ++k) {
+                const double d = std::abs(va[k] - vb[k]);
+                sum += d;
+                max = std::max(max, d);
+                above += d > tolerance;
+            }
+            count += va.size();
+        }
+    }
+
+    /// prints the differences and the speed relative to the blocks of
+    /// ref, which took refms, returns false if check and more than 0.1% of
+    /// the values are above tolerance
+    bool report(const char* name, const double ms, const char* ref,
+            const double refms, const bool check = true) const {
+        ::report(name, ms, max);
+        const double percent = count ? 100.0*above/count : 0;
+        cout << "  mean|diff| " << scientific << setprecision(2) 
+             << (count ? sum/count : 0) << ", " << fixed
+             << setprecision(3) << percent << "% of " << count 
+             << " values above " << tolerance << ", " << setprecision(2) 
+             << refms/ms << "x the speed of " << ref << endl;
+        cout.unsetf(ios_base::floatfield);
+
+        const bool ok = !check || percent <= 0.1;
+        if (!ok)
+            cout << name << " exceed the tolerance" << endl;
+        return ok;
+    }
+
+    long count, above;
+    double sum, max;
+};
+
+/**
+ * Computes the normalized blocks of every pyramid level of each image with
+ * the float, the fixed-point and the half-precision path of the default
+ * R-HOG descriptor, and compares them. Returns false if more than 0.1% of
+ * the block values of either differ by more than tolerance. Also compares
+ * voted and cell grid blocks at half-cell stride, without tolerance.
+ */
+static bool benchhog() {
+    typedef lear::ScalePyramid<2>               PyramidType;
+
+    std::list<std::string> images;
+    if (!imagefile.empty())
+        lear::imagelist(images, imagefile);
+    else
+        images.push_back("");
+
+    // RHOGDenseParam defaults: sqrt RGB, 2x2 cells of 8x8, 9 bins 0-180
+    const RHOGDense desc(IndexType(8), IndexType(2), IndexType(8), 9, 2, true,
+            new GradProcessor_NoSmooth(true, NULL, new ImageSqrtRemap()),
+            new L2HysNormalizer<RealType>(1, 0.2));
+    const IndexType winsize(64,128);
+
+    BlockMap floatblocks, fixedblocks, halfblocks;
+    halfblocks.halfprecision(true);
+    // half-cell stride: blocks voted one by one, and assembled from the
+    // cell grids of the 4 phase offsets
+    const IndexType halfcell (desc.cellsize()/2);
+    BlockMap voteblocks, cellblocks;
+    cellblocks.cellgrid(true);
+    BlockDiff fixeddiff, halfdiff, celldiff;
+    double floatms = 0, fixedms = 0, halfms = 0, votems = 0, cellms = 0;
+    // bytes of preprocessed levels and of blocks in float
+    double pixelbytes = 0, blockbytes = 0;
+    int levels = 0;
+    for (std::list<std::string>::const_iterator f = images.begin(); 
+            f != images.end(); ++f) 
+    {
+        RGBImage image;
+        if (f->empty())
+            image.reference(inputimage());
+        else
+            ImageIO::read(*f, image);
+
+        const PyramidType pyramid(image.extent(), winsize);
+        for (PyramidType::iterator piter = pyramid.begin(); 
+                piter != pyramid.end(); ++piter, ++levels) 
+        {
+            const RGBImage level (lear::rescale(image, *piter));
+
+            TimeType start = now();
+            for (int r= 0; r< repeat; ++r)
+                floatblocks.compute(desc, desc.preprocess(level), 
+                        IndexType(0), desc.stride());
+            floatms += elapsed(start);
+
+            start = now();
+            for (int r= 0; r< repeat; ++r)
+                fixedblocks.compute(desc, desc.preprocessfixed(level), 
+                        IndexType(0), desc.stride());
+            fixedms += elapsed(start);
+
+            start = now();
+            for (int r= 0; r< repeat; ++r)
+                halfblocks.compute(desc, desc.preprocesshalf(level), 
+                        IndexType(0), desc.stride());
+            halfms += elapsed(start);
+
+            const RHOGDense::Preprocessor pre (desc.preprocess(level));
+            start = now();
+            for (int r= 0; r< repeat; ++r)
+                voteblocks.compute(desc, pre, IndexType(0), halfcell);
+            votems += elapsed(start);
+
+            start = now();
+            for (int r= 0; r< repeat; ++r)
+                cellblocks.compute(desc, pre, IndexType(0), halfcell);
+            cellms += elapsed(start);
+
+            fixeddiff(floatblocks, fixedblocks);
+            halfdiff(floatblocks, halfblocks);
+            celldiff(voteblocks, cellblocks);
+            pixelbytes += level.numElements()*(sizeof(float) + sizeof(int));
+            blockbytes += blitz::product(floatblocks.extent())
+                *floatblocks.featsize()*sizeof(float);
+        }
+    }
+
+    cout << images.size() << " images, " << levels << " levels, " 
+         << repeat << " repetitions" << endl;
+    report("float blocks", floatms, 0);
+    bool ok = fixeddiff.report("fixed-point blocks", fixedms, 
+            "float blocks", floatms);
+    ok = halfdiff.report("half-precision blocks", halfms, 
+            "float blocks", floatms) && ok;
+
+    // float: 8 bytes per pixel, 4 per block value. fixed point: 4 per
+    // pixel. half precision: 4 per pixel, 2 per block value.
+    const double mb = 1.0/(1 << 20);
+    cout << "  working set  float " << fixed << setprecision(1) 
+         << (pixelbytes + blockbytes)*mb << " MB, fixed-point " 
+         << (pixelbytes/2 + blockbytes)*mb << " MB, half-precision " 
+         << (pixelbytes + blockbytes)/2*mb << " MB" << endl;
+    cout.unsetf(ios_base::floatfield);
+
+    report("voted blocks, half-cell stride", votems, 0);
+    // not Gaussian weighted, so no tolerance
+    celldiff.report("cell grid blocks", cellms, 
+            "voted blocks", votems, false);
+    return ok;
+}
+// }}}
+
+// {{{ main
+int main(int argc, char** argv) {
+    lear::Cmdline cmdline;
+
+    lear::CustomOption benchopt("benchmark options ", Convolve);
+    benchopt
+        .add("convolve", Convolve,
+                "Gaussian smoothing: ConvolveExact vs ConvolveSeparable")
+        .add("remap", Remap,
+                "Sqrt, Log and Lab image remaps: per pixel vs lookup tables")
+        .add("nonmax", NonMax,
+                "non-maximum suppression: mean shift vs scale space vs greedy")
+        .add("classify", Classify,
+                "window scoring: LinearClassify vs FloatClassify vs "
+                "AdditiveClassify, in batches")
+        .add("hog", Hog,
+                "normalized blocks of all pyramid levels: float vs "
+                "fixed-point vs half-precision storage, and voted vs "
+                "cell grid blocks at half-cell stride")
+        ;
+
+    { // {{{ cmdline
+        cmdline.commandName("bench_rhog");
+        cmdline.version("0.0.1", "");
+        cmdline.brief("Micro benchmarks for the R-HOG detector pipeline");
+
+        cmdline.description(
+            "Times parts of the R-HOG detector pipeline on one image, or on a "
+            "synthetic random image if no image is given, and compares the "
+            "result of each fast path with the reference implementation.");
+        cmdline.appendUsageIssues(benchopt.usage());
+
+        cmdline.addOption()
+            ("verbose,v",option<int>(&verbose)
+                ->defaultValue(0)->minValue(0)->maxValue(9),
+                "verbose level")
+            ("bench,b",option<std::string>(&(benchopt.option))
+                ->defaultValue(benchopt.defaultOption()),
+                "benchmark to run")
+            ("repeat,r",option<int>(&repeat)
+                ->defaultValue(10)->minValue(1),
+                "number of repetitions")
+            ("image,i",option<std::string>(&imagefile),
+                "input image, or (hog only) directory or image list "
+                "(default synthetic image)")
+            ("width,W",option<int>(&width)
+                ->defaultValue(640)->minValue(16),
+                "width of synthetic image")
+            ("height,H",option<int>(&height)
+                ->defaultValue(480)->minValue(16),
+                "height of synthetic image")
+            ("gscale,g",option<RealType>(&gscale)
+                ->defaultValue(1)->minValue(0.1),
+                "Gaussian smoothing scale")
+            ("tolerance,t",option<RealType>(&tolerance)
+                ->defaultValue(0.05)->minValue(0),
+                "largest difference of a block value (hog only)")
+            ;
+    } // }}}
+
+    int status = cmdline.parse(argc, argv);
+    if (status != cmdline.ok)
+        return status;
+
+    bench = static_cast<Bench>(benchopt.check());
+    bool ok = true;
+    try {
+        switch (bench) {
+            case Convolve:
+                benchconvolve();
+                break;
+            case Remap:
+                benchremap();
+                break;
+            case NonMax:
+                benchnonmax();
+                break;
+            case Classify:
+                benchclassify();
+                break;
+            case Hog:
+                ok = benchhog();
+                break;
+        }
+    } catch(std::exception& e) {
+        cerr << "Caught "<< e.what() << endl;
+        return 1;
+    } catch(...) {
+        cerr << "Caught unknown exception" << endl;
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
+// }}}
@@ -0,0 +1,131 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  classify_cascade.cpp
+ *
+ *    Description:  Detects objects in images with a StumpCascade written by
+ *    train_cascade, through the same scale pyramid, sliding window and
+ *    non-maximum suppression as the linear detector.
+ *
+ * =====================================================================================
+ */
+
+#include <fstream>
+#include <iomanip>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "windetectmain.h"
+#include <lear/image/imageio.h>
+#include <lear/image/imageutil.h>
+#include <lear/cvision/stumpcascade.h>
+
+typedef boost::posix_time::ptime            TimeType;
+
+static inline TimeType now() {
+    return boost::posix_time::microsec_clock::local_time();
+}
+
+int main(int argc, char** argv) {
+    using namespace std;
+    using namespace lear;
+    lear::Cmdline cmdline;
+
+    WinDetectClassifyMain windetectmain;
+    WinDetectClassify windetect;
+    {  // cmdline
+        cmdline.commandName("classify_cascade");
+        cmdline.version("0.0.1", "");
+        cmdline.brief(
+"Detect objects with a boosted stump cascade over integral channel features");
+
+        cmdline.description(
+"The model given with 'model' is a StumpCascade written by train_cascade, its window size replaces 'size'. Detections are written to outfile (Format: imagename X Y Width Height Score), and windows accepted, the fraction rejected early by the cascade and time per image are reported.");
+
+        windetectmain.setCommonMainParam(cmdline, &windetect) ;
+        windetectmain.setClassifyParam(cmdline,&windetect);
+    }
+
+    int status = cmdline.parse(argc, argv);
+    if (status != cmdline.ok)
+        return status;
+
+    if (!windetectmain.imageext.empty() && windetectmain.imageext[0] != '.')
+        windetectmain.imageext = '.' + windetectmain.imageext;
+
+    windetectmain.fill(&windetect);
+
+    try {
+        const StumpCascade cascade(windetectmain.modelfile);
+        windetect.init(cascade);
+        if (windetect.verbose)
+            cout << cascade;
+
+        std::list<std::string> inlist;
+        lear::imagelist(inlist, windetectmain.infile, windetectmain.imageext);
+
+        std::ofstream out;
+        if (!windetectmain.outfile.empty()) {
+            out.open(windetectmain.outfile.c_str());
+            if (!out)
+                throw Exception("classify_cascade",
+                        "Unable to open output file " + windetectmain.outfile);
+        }
+
+        typedef blitz::Array<blitz::TinyVector<int,3>,2>    ImageType;
+        std::vector<unsigned char> buffer;
+        std::list<DetectedRegion> detections;
+        const PixelFormat format(PixelFormat::RGB);
+
+        int images = 0;
+        double time = 0, windows = 0, rejected = 0;
+        for (std::list<std::string>::const_iterator f = inlist.begin();
+                f != inlist.end(); ++f)
+        {// {{{
+            ImageType image;
+            ImageIO::read(*f, image);
+            const int width = image.extent(0), height = image.extent(1);
+            buffer.resize(width*height*3);
+            for (int y= 0; y< height; ++y)
+            for (int x= 0; x< width; ++x)
+                for (int c= 0; c< 3; ++c)
+                    buffer[(y*width + x)*3 + c] = image(x,y)[c];
+
+            DetectStats stats;
+            const TimeType start = now();
+            windetect.test(cascade, detections, &buffer[0], width, height,
+                    format, &stats);
+            time += (now() - start).total_microseconds()/1000.0;
+            windows += stats.windows;
+            rejected += stats.rejected;
+            ++images;
+
+            if (out.is_open())
+                for (std::list<DetectedRegion>::const_iterator d = detections.begin();
+                        d != detections.end(); ++d)
+                    out << *f << ' ' << d->x << ' ' << d->y << ' '
+                        << d->width << ' ' << d->height << ' '
+                        << d->score << '\n';
+            if (windetect.verbose > 1)
+                cout << *f << "  detections " << setw(3) << detections.size() << endl;
+        }// }}}
+
+        if (images) {
+            cout << "Images " << images << endl;
+            cout << fixed << setprecision(2)
+                 << setw(10) << time/images << " ms/image"
+                 << setw(12) << windows/images << " windows/image";
+            if (windows + rejected > 0)
+                cout << setw(8) << 100*rejected/(windows + rejected)
+                     << "% rejected early";
+            cout << endl;
+        }
+    } catch(std::exception& e) {
+        cerr << "Caught "<< e.what() << endl;
+        return 1;
+    } catch(...) {
+        cerr << "Caught unknown exception" << endl;
+        return 1;
+    }
+    return 0;
+}
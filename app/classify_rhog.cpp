@@ -13,6 +13,7 @@
 
 #include "windetectmain.h"
 #include <lear/image/imageutil.h>
+#include <lear/interface/detectorbundle.h>
 
 int main(int argc, char** argv) {
     using namespace std;
@@ -23,6 +24,8 @@ int main(int argc, char** argv) {
     RHOGDenseMain rhogdensemain;
 
     WinDetectClassify windetect;
+    bool floatscore;
+    std::string additive;
     {  // cmdline
         cmdline.commandName("classify_rhog");
         cmdline.version("0.0.1", "Author: Navneet Dalal "
@@ -37,6 +40,14 @@ int main(int argc, char** argv) {
         windetectmain.setCommonMainParam(cmdline, &windetect) ;
         windetectmain.setClassifyParam(cmdline,&windetect);
         rhogdensemain.setRHOGDenseParam(cmdline) ;
+        cmdline.addOption()
+            ("floatscore",lear::bool_option(&floatscore),
+                "score windows with FloatClassify (float weights, SSE, "
+                "four windows per weight load)")
+            ("additive",lear::option<std::string>(&additive),
+                "score windows with the additive kernel SVM tables in this "
+                "file (see compile_additive) instead of the linear model")
+            ;
     }
 
     int status = cmdline.parse(argc, argv);
@@ -49,30 +60,53 @@ int main(int argc, char** argv) {
     // now set options read from command line 
     windetectmain.fill(&windetect);
 
-    std::vector<const RHOGDenseParam*> desc = rhogdensemain.fill();
-    windetect.init(desc); 
-    for (unsigned i= 0; i< desc.size(); ++i) 
-        delete desc[i];
-
     try {
+        // a compiled bundle overrides descriptor, window and non-max options
+        DetectorBundle* bundle = NULL;
+        if (windetectmain.modelfile != "defaultperson" 
+                && DetectorBundle::check(windetectmain.modelfile)) 
+        {
+            bundle = new DetectorBundle(windetectmain.modelfile);
+            windetect.init(*bundle);
+        } else {
+            std::vector<const RHOGDenseParam*> desc = rhogdensemain.fill();
+            windetect.init(desc); 
+            for (unsigned i= 0; i< desc.size(); ++i) 
+                delete desc[i];
+        }
+
         LinearClassify* classifier = NULL;
-        if (windetectmain.modelfile == "defaultperson")
+        if (bundle)
+            classifier = new LinearClassify(bundle->classifier());
+        else if (windetectmain.modelfile == "defaultperson")
             classifier = new LinearClassify();
         else 
             classifier = new LinearClassify(windetectmain.modelfile, windetect.verbose);
+        windetect.addposes(*classifier);
 
+        WindowClassifier* scorer = NULL;
         try {
+            if (!additive.empty())
+                scorer = new AdditiveClassify(additive);
+            else if (floatscore)
+                scorer = new FloatClassify(*classifier);
+
             WinDetectDump::PathVector inlist;
             lear::imagelist(inlist, windetectmain.infile, windetectmain.imageext);
-            windetect.runImageSlider(*classifier, inlist, windetectmain.outfile,
+            windetect.runImageSlider(scorer ? *scorer : *classifier, inlist, 
+                    windetectmain.outfile,
                     windetectmain.outimage, windetectmain.outhist,
                     windetectmain.falsetxt, windetectmain.testlocs
                     );
         }catch (std::exception& e) {
+            delete scorer;
             delete classifier;
+            delete bundle;
             throw e;
         }
+        delete scorer;
         delete classifier;
+        delete bundle;
     } catch(std::exception& e) {
         cerr << "Caught "<< e.what() << endl;
         return 1;
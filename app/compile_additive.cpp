@@ -0,0 +1,192 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  compile_additive.cpp
+ *
+ *    Description:  Compiles an additive kernel (intersection, chi-square)
+ *    SVM model learned with svm_learn into the per-dimension lookup
+ *    tables of AdditiveClassify, and optionally compares table scores
+ *    with the exact kernel scores on dump_rhog descriptors.
+ *
+ * =====================================================================================
+ */
+
+#include <cmath>
+#include <vector>
+#include <string>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <lear/cmdline.h>
+
+#include <lear/interface/windetect.h>
+
+#include "rawdescio.h"
+
+using std::cout; using std::cerr; using std::endl;
+typedef std::vector<std::string>    FileListVector;
+typedef boost::posix_time::ptime    TimeType;
+
+static inline TimeType now() {
+    return boost::posix_time::microsec_clock::local_time();
+}
+
+/// Exact scores of a kernel SVM, compared with the table scores
+struct Compare {// {{{
+    Compare(const AdditiveClassify& tables, const int length,
+            const std::vector<float>& sv, const std::vector<double>& alpha,
+            const double bias) :
+        tables(tables), length(length), sv(sv), alpha(alpha), bias(bias),
+        count(0), sumdiff(0), maxdiff(0), disagree(0), exactms(0), tablems(0)
+    {}
+
+    double exact(const float* x) const {
+        const bool chi2 = tables.kernel() == AdditiveClassify::ChiSquare;
+        double sum = 0;
+        for (unsigned j= 0; j< alpha.size(); ++j) {
+            const float* s = &sv[j*length];
+            double k = 0;
+            for (int i= 0; i< length; ++i) {
+                const double v = std::max(x[i], 0.0f);
+                if (chi2)
+                    k += v + s[i] > 0 ? 2*v*s[i]/(v + s[i]) : 0;
+                else
+                    k += std::min(v, static_cast<double>(s[i]));
+            }
+            sum += alpha[j]*k;
+        }
+        return sum - bias;
+    }
+
+    void operator()(const Array1DType& f) {
+        if (f.size() != length)
+            throw lear::Exception("Compare()",
+                    "Descriptor length does not match the model length");
+        TimeType start = now();
+        const double s = exact(f.data());
+        exactms += (now() - start).total_microseconds()/1000.0;
+        start = now();
+        const double t = tables(f.data());
+        tablems += (now() - start).total_microseconds()/1000.0;
+
+        const double d = std::abs(s - t);
+        sumdiff += d;
+        maxdiff = std::max(maxdiff, d);
+        disagree += (s > 0) != (t > 0);
+        ++count;
+    }
+
+    const AdditiveClassify& tables;
+    const int length;
+    const std::vector<float>& sv;
+    const std::vector<double>& alpha;
+    const double bias;
+
+    int count;
+    double sumdiff, maxdiff;
+    int disagree;
+    double exactms, tablems;
+};// }}}
+
+// {{{ main
+int main(int argc, char** argv) {
+    lear::Cmdline cmdline;
+    using namespace lear;
+
+    std::string modelfile, tablefile, kernel;
+    FileListVector testfile;
+    int bins, maxvec, verbose;
+    { // {{{ cmdline
+        cmdline.commandName("compile_additive");
+        cmdline.version("0.0.1", "");
+        cmdline.brief(
+"Compile an additive kernel SVM model into lookup tables");
+
+        cmdline.description(
+"Reads a kernel model written by svm_learn with a custom additive kernel (-t 4, -u intersection or -u chi2), samples the contribution of each dimension at 'bins' points and writes the tables for AdditiveClassify (classify_rhog --additive). With 'testfile' the exact kernel scores and the table scores of the descriptors are compared: score difference, decisions at 0 that change, and time per window.");
+
+        cmdline.usageIssues(
+    "  'testfile'       descriptor file, directory, or a list file.\n"
+                    );
+
+        cmdline.addOption()
+            ("verbose,v",option<int>(&verbose)
+                ->defaultValue(0)->minValue(0)->maxValue(9),
+                "verbose level")
+            ("bins,b",option<int>(&bins)
+                ->defaultValue(64)->minValue(2),
+                "samples per dimension")
+            ("kernel,k",option<std::string>(&kernel)
+                ->defaultValue(""),
+                "intersection or chi2 (Default: kernel parameter -u of the model)")
+            ("testfile,t",option< FileListVector >(&testfile),
+                    "descriptor file to compare exact and table scores on")
+            ("maxvec,N",option<int>(&maxvec)
+                ->defaultValue(1000)->minValue(-1),
+                "maximum vectors read from each test file, -1 implies no limit")
+            ;
+        cmdline.addArgument()
+            ("model",option<std::string>(&modelfile),"svm_learn model file")
+            ("tables",option<std::string>(&tablefile),"output table file")
+            ;
+    } // }}}
+
+    int status = cmdline.parse(argc, argv);
+    if (status != cmdline.ok)
+        return status;
+
+    try {
+        int length;
+        std::vector<float> sv;
+        std::vector<double> alpha;
+        double bias;
+        std::string modelkernel;
+        AdditiveClassify::readsvm(modelfile, length, sv, alpha, bias,
+                modelkernel, verbose);
+        if (kernel.empty())
+            kernel = modelkernel;
+
+        const AdditiveClassify tables(length, sv, alpha, bias, bins,
+                AdditiveClassify::kernelname(kernel));
+        tables.save(tablefile);
+        cout << "Support vectors " << alpha.size() << ", length " << length
+             << ", kernel " << kernel << ", tables of " << bins
+             << " samples (" << 2*length*bins*sizeof(float)/1024 << " KB)" << endl;
+
+        Compare compare(tables, length, sv, alpha, bias);
+        Array1DType feature;
+        for (FileListVector::const_iterator f=testfile.begin(); f!= testfile.end(); ++f) {
+            RawDescIn desc(*f, verbose);
+            feature.resize(desc.featureLength());
+            int size = desc.featureCount();
+            if (maxvec > 0)
+                size = std::min(maxvec, size);
+            for (int m= 0; m< size && desc; ++m) {
+                desc.next(feature);
+                compare(feature);
+            }
+        }
+        if (compare.count) {
+            using std::setprecision;
+            cout << "Test descriptors " << compare.count << endl
+                 << "  score difference  mean " << setprecision(4)
+                 << compare.sumdiff/compare.count
+                 << "  max " << compare.maxdiff << endl
+                 << "  decisions changed " << compare.disagree << " ("
+                 << 100.0*compare.disagree/compare.count << "%)" << endl
+                 << "  ms/window  exact " << compare.exactms/compare.count
+                 << "  tables " << compare.tablems/compare.count << endl;
+        }
+    } catch(std::exception& e) {
+        cerr << "Caught "<< e.what() << endl;
+        return 1;
+    } catch(...) {
+        cerr << "Caught unknown exception" << endl;
+        return 1;
+    }
+    return 0;
+}
+// }}}
@@ -0,0 +1,102 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  compile_bundle.cpp
+ *
+ *    Description:  Compiles a learned linear SVM model and the detector
+ *    options it was trained with into a single detector bundle, which
+ *    classify_rhog and the library load with one memory map.
+ *
+ * =====================================================================================
+ */
+
+#include "windetectmain.h"
+#include <lear/interface/detectorbundle.h>
+
+int main(int argc, char** argv) {
+    using namespace std;
+    using namespace lear;
+    lear::Cmdline cmdline;
+
+    WinDetectClassifyMain windetectmain;
+    RHOGDenseMain rhogdensemain;
+
+    WinDetectClassify windetect;
+    std::string bundlefile;
+    {  // cmdline
+        cmdline.commandName("compile_bundle");
+        cmdline.version("0.0.1", "");
+        cmdline.brief(
+"Compile a learned detector into a memory mapped detector bundle");
+
+        cmdline.description(
+"Writes descriptor parameters, window geometry, pyramid, cell grid and non-maximum suppression settings and the SVM weights to one binary file. Use the same descriptor and window options as for classify_rhog.");
+
+        cmdline.addOption()
+            ("window,W",option<IndexOpt>(&(windetectmain.size))
+                ->defaultValue(IndexOpt(64,128))->minValue(3),
+                "window width,height")
+            ("winstride",option<IndexOpt>(&(windetectmain.winstride))
+                ->defaultValue(8),
+                "window stride along x-y")
+            ("scaleratio",option<RealType>(&(windetect.scaleratio))
+                ->defaultValue(1.05)->minValue(1),
+                "scale ratio")
+            ("endscale",option<RealType>(&(windetect.endscale)),
+                "scale-space pyramid end scale\n"
+                "  (Default: till image size >= window size)")
+            ("startscale",option<RealType>(&(windetect.startscale))
+                ->defaultValue(1)->minValue(1),
+                "start scale")
+            ("cellgrid",bool_option(&(windetect.cellgrid)),
+                "blocks assembled from cell grids, as the model was "
+                "trained with")
+            ("verbose,v",option<int>(&(windetect.verbose))
+                ->defaultValue(0)->minValue(0)->maxValue(9),
+                "verbose level")
+            ;
+        windetectmain.setClassifyParam(cmdline,&windetect);
+        rhogdensemain.setRHOGDenseParam(cmdline) ;
+        cmdline.addArgument()
+            ("bundle",option<std::string>(&bundlefile),"output bundle file")
+            ;
+    }
+
+    int status = cmdline.parse(argc, argv);
+    if (status != cmdline.ok)
+        return status;
+
+    windetectmain.fill(&windetect);
+    std::vector<const RHOGDenseParam*> desc = rhogdensemain.fill();
+
+    try {
+        LinearClassify* classifier = NULL;
+        if (windetectmain.modelfile == "defaultperson")
+            classifier = new LinearClassify();
+        else
+            classifier = new LinearClassify(windetectmain.modelfile, windetect.verbose);
+
+        try {
+            DetectorBundle::write(bundlefile, windetect, desc, *classifier);
+        }catch (std::exception& e) {
+            delete classifier;
+            throw e;
+        }
+        delete classifier;
+        if (windetect.verbose) {
+            DetectorBundle bundle(bundlefile);
+            cout << "Wrote " << bundlefile << ": " << bundle.numdesc()
+                 << " descriptor(s), " << bundle.length() << " weights" << endl;
+        }
+    } catch(std::exception& e) {
+        cerr << "Caught "<< e.what() << endl;
+        return 1;
+    } catch(...) {
+        cerr << "Caught unknown exception" << endl;
+        return 1;
+    }
+    for (unsigned i= 0; i< desc.size(); ++i)
+        delete desc[i];
+    return 0;
+}
+
@@ -0,0 +1,142 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  energy_threshold.cpp
+ *
+ *    Description:  Picks the energy threshold of the flat region prefilter
+ *    (WinDetectClassify::energythreshold) from positive windows: the
+ *    largest threshold that keeps the requested fraction of them.
+ *
+ * =====================================================================================
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include "windetectmain.h"
+#include <lear/image/imageio.h>
+#include <lear/interface/detectorbundle.h>
+
+int main(int argc, char** argv) {
+    using namespace std;
+    using namespace lear;
+    lear::Cmdline cmdline;
+
+    WinDetectClassifyMain windetectmain;
+    RHOGDenseMain rhogdensemain;
+
+    WinDetectClassify windetect;
+    float recall;
+    {  // cmdline
+        cmdline.commandName("energy_threshold");
+        cmdline.version("0.0.1", "");
+        cmdline.brief(
+"Choose the flat region prefilter threshold from positive windows");
+
+        cmdline.description(
+"Computes the mean gradient magnitude of the window in every positive image, at the image center unless 'topleft' is given, and prints the energy threshold that keeps 'recall' of them. Pass it to the detector with --energythreshold. If outfile is given the energy of each window is written to it (Format: imagename Energy).");
+
+        windetectmain.setCommonMainParam(cmdline, &windetect) ;
+        rhogdensemain.setRHOGDenseParam(cmdline) ;
+        cmdline.addOption()
+            ("recall",option<float>(&recall)
+                ->defaultValue(0.99)->minValue(0)->maxValue(1),
+                "fraction of positive windows kept by the threshold")
+            ;
+    }
+
+    int status = cmdline.parse(argc, argv);
+    if (status != cmdline.ok)
+        return status;
+
+    if (!windetectmain.imageext.empty() && windetectmain.imageext[0] != '.')
+        windetectmain.imageext = '.' + windetectmain.imageext;
+
+    windetectmain.fill(&windetect);
+
+    try {
+        if (windetectmain.modelfile != "defaultperson"
+                && DetectorBundle::check(windetectmain.modelfile))
+        {
+            DetectorBundle bundle (windetectmain.modelfile);
+            windetect.init(bundle);
+        } else {
+            std::vector<const RHOGDenseParam*> desc = rhogdensemain.fill();
+            windetect.init(desc);
+            for (unsigned i= 0; i< desc.size(); ++i)
+                delete desc[i];
+        }
+
+        std::list<std::string> inlist;
+        lear::imagelist(inlist, windetectmain.infile, windetectmain.imageext);
+
+        std::ofstream out;
+        if (!windetectmain.outfile.empty()) {
+            out.open(windetectmain.outfile.c_str());
+            if (!out)
+                throw Exception("energy_threshold",
+                        "Unable to open output file " + windetectmain.outfile);
+        }
+
+        typedef blitz::Array<blitz::TinyVector<int,3>,2>    ImageType;
+        std::vector<unsigned char> buffer;
+        std::vector<float> energy;
+        const PixelFormat format(PixelFormat::RGB);
+        int outside = 0;
+        for (std::list<std::string>::const_iterator f = inlist.begin();
+                f != inlist.end(); ++f)
+        {// {{{
+            ImageType image;
+            ImageIO::read(*f, image);
+            const int width = image.extent(0), height = image.extent(1);
+            buffer.resize(width*height*3);
+            for (int y= 0; y< height; ++y)
+            for (int x= 0; x< width; ++x)
+                for (int c= 0; c< 3; ++c)
+                    buffer[(y*width + x)*3 + c] = image(x,y)[c];
+
+            int x = windetect.topleft_x, y = windetect.topleft_y;
+            if (x < 0 || y < 0) {
+                x = (width - windetect.size_x)/2;
+                y = (height - windetect.size_y)/2;
+            }
+            const float e = windetect.windowenergy(x, y, &buffer[0],
+                    width, height, format);
+            if (e < 0) {
+                ++outside;
+                if (windetect.verbose > 1)
+                    cerr << "Window outside of image " << *f << endl;
+                continue;
+            }
+            energy.push_back(e);
+            if (out.is_open())
+                out << *f << ' ' << e << '\n';
+        }// }}}
+
+        if (outside)
+            cout << "Skipped " << outside << " images smaller than the window"
+                 << endl;
+        if (energy.empty())
+            throw Exception("energy_threshold", "No positive window found");
+
+        std::sort(energy.begin(), energy.end());
+        // windows below index k are rejected
+        const int k = std::min<int>(energy.size()-1,
+                static_cast<int>((1-recall)*energy.size()));
+        cout << "Positive windows " << energy.size()
+             << ", energy min " << energy.front()
+             << " median " << energy[energy.size()/2]
+             << " max " << energy.back() << endl;
+        cout << "Energy threshold at recall " << setprecision(4)
+             << 1 - static_cast<float>(k)/energy.size() << ": "
+             << energy[k] << endl;
+    } catch(std::exception& e) {
+        cerr << "Caught "<< e.what() << endl;
+        return 1;
+    } catch(...) {
+        cerr << "Caught unknown exception" << endl;
+        return 1;
+    }
+    return 0;
+}
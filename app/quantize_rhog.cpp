@@ -0,0 +1,253 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  quantize_rhog.cpp
+ *
+ *    Description:  Calibrates the 8-bit descriptor quantization of integer
+ *    scoring (WinDetectClassify::descscale) on dump_rhog descriptors, and
+ *    compares the integer scores of QuantizedClassify with the float scores
+ *    of LinearClassify on them.
+ *
+ * =====================================================================================
+ */
+
+#include <cmath>
+#include <vector>
+#include <string>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+#include <lear/cmdline.h>
+
+#include <lear/interface/windetect.h>
+
+#include "rawdescio.h"
+
+using std::cout; using std::cerr; using std::endl;
+typedef std::vector<std::string>    FileListVector;
+
+// ==========================================================================
+// -------- Command line parameters -----------------------------------------
+// ==========================================================================
+static FileListVector posfile, negfile;
+static std::string modelfile;
+
+static int maxvec;
+static int verbose;
+static float percentile, descscale, threshold;
+
+/// values in [0,HistRange] are counted in HistBins bins for calibration
+static const int HistBins = 1<<16;
+static const float HistRange = 1;
+
+/// calls op on up to maxvec descriptors of each file in list
+template<class Op>
+static void scan(const FileListVector& list, Op& op)
+{// {{{
+    Array1DType feature;
+    for (FileListVector::const_iterator f=list.begin(); f!= list.end(); ++f) {
+        RawDescIn desc(*f, verbose);
+        feature.resize(desc.featureLength());
+        int size = desc.featureCount();
+        if (maxvec > 0)
+            size = std::min(maxvec, size);
+        for (int m= 0; m< size && desc; ++m) {
+            desc.next(feature);
+            op(feature);
+        }
+        if (verbose > 2)
+            cout << "Processed descriptors " << std::setw(7) << size
+                 << " from file " << *f << endl;
+    }
+}// }}}
+
+/// histogram of descriptor values
+struct Calibrate {// {{{
+    Calibrate() : count(HistBins+1, 0), total(0), maxvalue(0) {}
+
+    void operator()(const Array1DType& f) {
+        for (int i= 0; i< f.size(); ++i) {
+            const float v = f(i);
+            maxvalue = std::max(maxvalue, v);
+            const int b = v < 0 ? 0 : std::min(HistBins,
+                    static_cast<int>(v/HistRange*HistBins));
+            ++count[b];
+        }
+        total += f.size();
+    }
+
+    /// smallest value at or above fraction p of the values
+    float value(const double p) const {
+        double sum = 0;
+        for (int b= 0; b< HistBins; ++b) {
+            sum += count[b];
+            if (sum >= p*total)
+                return (b+1)*HistRange/HistBins;
+        }
+        return maxvalue;
+    }
+
+    // last bin counts values above HistRange
+    std::vector<double> count;
+    double total;
+    float maxvalue;
+};// }}}
+
+/// float and integer scores of the descriptors
+struct Compare {// {{{
+    Compare(const LinearClassify& classifier, const QuantizedClassify& quantized,
+            const int target) :
+        classifier(classifier), quantized(quantized), target(target),
+        q(quantized.length()), count(0), saturated(0),
+        sumdiff(0), sumsqdiff(0), maxdiff(0), disagree(0),
+        floaterror(0), interror(0)
+    {}
+
+    void operator()(const Array1DType& f) {
+        if (f.size() != classifier.length())
+            throw lear::Exception("Compare()",
+                    "Descriptor length does not match the model length");
+
+        const float s = classifier(f.data());
+        quantized.quantize(f.data(), &q[0]);
+        const float t = quantized(&q[0]);
+        for (int i= 0; i< f.size(); ++i)
+            saturated += q[i] == 255;
+
+        const double d = std::abs(s - t);
+        sumdiff += d;
+        sumsqdiff += d*d;
+        maxdiff = std::max(maxdiff, d);
+        disagree += (s > threshold) != (t > threshold);
+        floaterror += (s > threshold) != (target > 0);
+        interror += (t > threshold) != (target > 0);
+        ++count;
+    }
+
+    const LinearClassify& classifier;
+    const QuantizedClassify& quantized;
+    /// 1 for positive, -1 for negative descriptors
+    const int target;
+    std::vector<unsigned char> q;
+
+    int count;
+    double saturated;
+    double sumdiff, sumsqdiff, maxdiff;
+    int disagree, floaterror, interror;
+};// }}}
+
+static void report(const std::string& name, const Compare& c, const int length)
+{// {{{
+    using std::setw; using std::setprecision;
+    if (!c.count)
+        return;
+    cout << name << " descriptors " << c.count << endl
+         << "  score difference  mean " << setprecision(4) << c.sumdiff/c.count
+         << "  rms " << std::sqrt(c.sumsqdiff/c.count)
+         << "  max " << c.maxdiff << endl
+         << "  saturated values  " << 100*c.saturated/(double(c.count)*length)
+         << "%" << endl
+         << "  decisions changed " << c.disagree << " ("
+         << 100.0*c.disagree/c.count << "%)" << endl
+         << "  errors float " << c.floaterror << "  integer " << c.interror
+         << endl;
+}// }}}
+
+// {{{ main
+int main(int argc, char** argv) {
+    lear::Cmdline cmdline;
+    using namespace lear;
+
+    { // {{{ cmdline
+        cmdline.commandName("quantize_rhog");
+        cmdline.version("0.0.1", "");
+        cmdline.brief(
+"Calibrate and check 8-bit integer scoring on dump_rhog descriptors");
+
+        cmdline.description(
+"Unless descscale is given, picks the descriptor scale of integer scoring so that 'percentile' of the descriptor values are below 255 after quantization. Then scores every descriptor with the model in float (LinearClassify) and with 8-bit descriptors and weights (QuantizedClassify), and reports the score differences, the decisions at 'threshold' that change and, per label, the errors of both. Pass the scale to the detector with --descscale.");
+
+        cmdline.usageIssues(
+    "  'posfile'        positive descriptor file, directory, or a list file.\n"
+    "  'negfile'        negative descriptor file, directory, or a list file.\n"
+                    );
+
+        cmdline.addOption()
+            ("verbose,v",option<int>(&verbose)
+                ->defaultValue(0)->minValue(0)->maxValue(9),
+                "verbose level")
+            ("posfile,p",option< FileListVector >(&posfile),
+                    "positive descriptor input file")
+            ("negfile,n",option< FileListVector >(&negfile),
+                    "negative descriptor input file")
+            ("maxvec,N",option<int>(&maxvec)
+                ->defaultValue(-1)->minValue(-1),
+                "maximum vectors read from each file, -1 implies no limit")
+            ("percentile",option<float>(&percentile)
+                ->defaultValue(0.9999)->minValue(0)->maxValue(1),
+                "fraction of descriptor values not saturated")
+            ("descscale",option<float>(&descscale)
+                ->defaultValue(0)->minValue(0),
+                "check this scale instead of calibrating one")
+            ("threshold,t",option<float>(&threshold)
+                ->defaultValue(0),
+                "decision threshold on scores")
+            ("model,m",option<std::string>(&modelfile)
+                ->defaultValue("defaultperson"),
+                "linear SVM model file, or 'defaultperson'")
+            ;
+    } // }}}
+
+    int status = cmdline.parse(argc, argv);
+    if (status != cmdline.ok)
+        return status;
+
+    try {
+        if (posfile.empty() && negfile.empty())
+            throw Exception("quantize_rhog", "No descriptor file given");
+
+        if (!(descscale > 0)) {
+            Calibrate calibrate;
+            scan(posfile, calibrate);
+            scan(negfile, calibrate);
+            const float v = calibrate.value(percentile);
+            if (!(v > 0))
+                throw Exception("quantize_rhog", "All descriptor values are zero");
+            descscale = 255/v;
+            cout << "Descriptor values max " << calibrate.maxvalue
+                 << ", at percentile " << percentile << " " << v << endl;
+        }
+
+        LinearClassify* classifier = NULL;
+        if (modelfile == "defaultperson")
+            classifier = new LinearClassify();
+        else
+            classifier = new LinearClassify(modelfile, verbose);
+
+        try {
+            const QuantizedClassify quantized(*classifier, descscale);
+            cout << "Descriptor scale " << descscale
+                 << ", weight scale " << quantized.weightscale() << endl;
+
+            Compare pos(*classifier, quantized, 1);
+            Compare neg(*classifier, quantized, -1);
+            scan(posfile, pos);
+            scan(negfile, neg);
+            report("Positive", pos, classifier->length());
+            report("Negative", neg, classifier->length());
+        }catch (std::exception& e) {
+            delete classifier;
+            throw e;
+        }
+        delete classifier;
+    } catch(std::exception& e) {
+        cerr << "Caught "<< e.what() << endl;
+        return 1;
+    } catch(...) {
+        cerr << "Caught unknown exception" << endl;
+        return 1;
+    }
+    return 0;
+}
+// }}}
@@ -53,6 +53,8 @@ RawDescIn::RawDescIn(const string& filename_, const int verbose):
 
     descLength_.resize(descNum_);
     descExtent_.resize(descNum_);
+    descOrientbin_.resize(descNum_);
+    descJointCirc_.resize(descNum_);
     
     for (int i= 0; i< descNum_; ++i) {
         FileHeader desc_header;
@@ -64,6 +66,16 @@ RawDescIn::RawDescIn(const string& filename_, const int verbose):
         from >> descLength_(i);
         from >> descExtent_(i);
 
+        IndexType cellsize, numcell, stride;
+        bool semicirc, jointcirc = false;
+        RealType wtscale;
+        from >> cellsize >> numcell >> stride >> descOrientbin_(i) 
+            >> semicirc >> wtscale;
+        // RHOGDense version 97 adds joint orientation bins
+        if (desc_header.version() >= 97)
+            from >> jointcirc;
+        descJointCirc_(i) = jointcirc;
+
         len -= from.tellg() - descLen;
         for (int j= 0; j< len ; ++j) 
             from >> dummy;// read descriptor
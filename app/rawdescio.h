@@ -50,6 +50,17 @@ class RawDescIn {
         IndexType descExtent(const int index) const 
         { return descExtent_(index); }
 
+        /// returns the number of orientation bins of each descriptor used
+        int descOrientbin(const int index) const 
+        { return descOrientbin_(index); }
+
+        /**
+         * true if descriptor index has both 0-360 and 0-180 bins, i.e.
+         * 3*descOrientbin values per cell (see RHOGDense)
+         */
+        bool descJointCirc(const int index) const 
+        { return descJointCirc_(index); }
+
         /// returns the xy grid for each descriptor used
         const GridType& grid(const int index) const { return grid_[index]; }
 
@@ -158,6 +169,10 @@ class RawDescIn {
         blitz::Array<int,1>        descLength_;
         /// extent of each descriptor
         blitz::Array<IndexType,1>  descExtent_;
+        /// orientation bins of each descriptor
+        blitz::Array<int,1>        descOrientbin_;
+        /// joint orientation bins of each descriptor
+        blitz::Array<bool,1>       descJointCirc_;
         /// Grid Vector for each descriptor
         std::vector< GridType>     grid_;
 
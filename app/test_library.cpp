@@ -47,25 +47,20 @@ int main(int argc, char** argv) {
     int width  = imlib_image_get_width(), 
         height = imlib_image_get_height();
 
-    typedef unsigned char uchar;
-    DATA32* data = imlib_image_get_data_for_reading_only();
-    uchar* imagedata = new uchar[3*width*height*sizeof(uchar)];
-    for (int j= 0; j< height; ++j) 
-    for (int i= 0; i< width; ++i) {
-        uchar* pixel = imagedata+(i+j*width)*3; 
-        int argb = data[i+j*width];
-        pixel[0] = static_cast<uchar>((argb & 0x00FF0000)>>16);
-        pixel[1] = static_cast<uchar>((argb & 0x0000FF00)>> 8);
-        pixel[2] = static_cast<uchar>((argb & 0x000000FF)    );
-    }
-    imlib_free_image();
+    // Imlib2 stores pixels as 32 bit 0xAARRGGBB words in host byte order,
+    // so the buffer can be handed over in place.
+    const DATA32 probe = 1;
+    const bool littleendian = *reinterpret_cast<const unsigned char*>(&probe);
+    PixelFormat format(littleendian ? PixelFormat::BGRA : PixelFormat::ARGB);
 
+    DATA32* data = imlib_image_get_data_for_reading_only();
+    const unsigned char* imagedata = reinterpret_cast<const unsigned char*>(data);
 
     // now get detections
     std::list<DetectedRegion> detections;
-    windetect.test(classifier, detections, imagedata, width, height);
+    windetect.test(classifier, detections, imagedata, width, height, format);
 
-    delete[] imagedata;
+    imlib_free_image();
 
     //print detections
     std::copy(detections.begin(), detections.end(), std::ostream_iterator<DetectedRegion>(std::cout, "\n"));
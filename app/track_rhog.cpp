@@ -0,0 +1,273 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  track_rhog.cpp
+ *
+ *    Description:  Runs the temporal detection modes (WinDetectTrack or
+ *    WinDetectSession) on a recorded frame sequence, and compares them
+ *    with a full scan of every frame: time, windows scored and recall of
+ *    the full scan detections.
+ *
+ * =====================================================================================
+ */
+
+#include <fstream>
+#include <iomanip>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "windetectmain.h"
+#include <lear/image/imageio.h>
+#include <lear/image/imageutil.h>
+#include <lear/interface/wintrack.h>
+#include <lear/interface/detectorbundle.h>
+
+typedef boost::posix_time::ptime            TimeType;
+
+static inline TimeType now() {
+    return boost::posix_time::microsec_clock::local_time();
+}
+/// milliseconds since start
+static inline double elapsed(const TimeType start) {
+    return (now() - start).total_microseconds()/1000.0;
+}
+
+/// overlap (intersection over union) of two detections
+static float overlap(const DetectedRegion& a, const DetectedRegion& b) {
+    const int x0 = std::max(a.x, b.x), y0 = std::max(a.y, b.y);
+    const int x1 = std::min(a.x+a.width, b.x+b.width);
+    const int y1 = std::min(a.y+a.height, b.y+b.height);
+    if (x1 <= x0 || y1 <= y0)
+        return 0;
+    const float inter = static_cast<float>(x1-x0)*(y1-y0);
+    return inter/(static_cast<float>(a.width)*a.height
+            + static_cast<float>(b.width)*b.height - inter);
+}
+
+/// number of detections in ref overlapping one of test by at least 0.5
+static int recalled(const std::list<DetectedRegion>& ref,
+        const std::list<DetectedRegion>& test)
+{
+    int n = 0;
+    for (std::list<DetectedRegion>::const_iterator r = ref.begin();
+            r != ref.end(); ++r)
+        for (std::list<DetectedRegion>::const_iterator t = test.begin();
+                t != test.end(); ++t)
+            if (overlap(*r,*t) >= 0.5) {
+                ++n;
+                break;
+            }
+    return n;
+}
+
+int main(int argc, char** argv) {
+    using namespace std;
+    using namespace lear;
+    lear::Cmdline cmdline;
+
+    WinDetectClassifyMain windetectmain;
+    RHOGDenseMain rhogdensemain;
+
+    WinDetectClassify windetect;
+    // options of WinDetectTrack, copied once the detector is set up
+    int fullscan, maxmissed;
+    float motionthreshold, searchradius, searchscale;
+    // options of WinDetectSession
+    bool incremental;
+    int refresh, difference, tilesize;
+    bool nocompare;
+    {  // cmdline
+        cmdline.commandName("track_rhog");
+        cmdline.version("0.0.1", "");
+        cmdline.brief(
+"Detect objects in a frame sequence with tracked rescoring and periodic full scans");
+
+        cmdline.description(
+"Frames are processed in file name order. With 'incremental' only windows whose pixels changed since the previous frame are rescored (WinDetectSession), otherwise detections are tracked with a constant velocity model and only their neighborhood is rescored, the whole scale space is scanned every 'fullscan' frames or when the motion energy is above 'motionthreshold'. Unless 'nocompare' is given every frame is also scanned fully, and time, windows scored and the fraction of full scan detections found by the temporal mode are reported. Detections of the temporal mode are written to outfile (Format: imagename X Y Width Height Score).");
+
+        windetectmain.setCommonMainParam(cmdline, &windetect) ;
+        windetectmain.setClassifyParam(cmdline,&windetect);
+        rhogdensemain.setRHOGDenseParam(cmdline) ;
+        cmdline.addOption()
+            ("fullscan",option<int>(&fullscan)
+                ->defaultValue(10)->minValue(0),
+                "scan the whole scale space every n frames "
+                "(0=first frame and motion only)")
+            ("motionthreshold",option<float>(&motionthreshold)
+                ->defaultValue(0)->minValue(0),
+                "scan the whole scale space if the mean absolute frame "
+                "difference is above this, in gray levels (0=never)")
+            ("searchradius",option<float>(&searchradius)
+                ->defaultValue(0.25)->minValue(0),
+                "rescore window centers this fraction of the window size "
+                "around the predicted track position")
+            ("searchscale",option<float>(&searchscale)
+                ->defaultValue(1.2)->minValue(1),
+                "rescore scales within this factor of the track scale")
+            ("maxmissed",option<int>(&maxmissed)
+                ->defaultValue(2)->minValue(0),
+                "drop a track after n frames without detection")
+            ("incremental",bool_option(&incremental),
+                "instead of tracking, rescore only windows touched by "
+                "changed tiles (fixed camera)")
+            ("refresh",option<int>(&refresh)
+                ->defaultValue(30)->minValue(0),
+                "incremental: recompute all scores every n frames (0=never)")
+            ("difference",option<int>(&difference)
+                ->defaultValue(8)->minValue(0),
+                "incremental: largest channel difference of an unchanged pixel")
+            ("tilesize",option<int>(&tilesize)
+                ->defaultValue(16)->minValue(1),
+                "incremental: size of tiles frames are compared in")
+            ("nocompare",bool_option(&nocompare),
+                "do not run the full scan on every frame for comparison")
+            ;
+    }
+
+    int status = cmdline.parse(argc, argv);
+    if (status != cmdline.ok)
+        return status;
+
+    if (!windetectmain.imageext.empty() && windetectmain.imageext[0] != '.')
+        windetectmain.imageext = '.' + windetectmain.imageext;
+
+    windetectmain.fill(&windetect);
+
+    try {
+        DetectorBundle* bundle = NULL;
+        if (windetectmain.modelfile != "defaultperson"
+                && DetectorBundle::check(windetectmain.modelfile))
+        {
+            bundle = new DetectorBundle(windetectmain.modelfile);
+            windetect.init(*bundle);
+        } else {
+            std::vector<const RHOGDenseParam*> desc = rhogdensemain.fill();
+            windetect.init(desc);
+            for (unsigned i= 0; i< desc.size(); ++i)
+                delete desc[i];
+        }
+
+        LinearClassify* classifier = NULL;
+        if (bundle)
+            classifier = new LinearClassify(bundle->classifier());
+        else if (windetectmain.modelfile == "defaultperson")
+            classifier = new LinearClassify();
+        else
+            classifier = new LinearClassify(windetectmain.modelfile, windetect.verbose);
+        windetect.addposes(*classifier);
+
+        WinDetectTrack track(windetect, *classifier);
+        track.fullscan = fullscan;
+        track.motionthreshold = motionthreshold;
+        track.searchradius = searchradius;
+        track.searchscale = searchscale;
+        track.maxmissed = maxmissed;
+        WinDetectSession session(windetect, *classifier);
+        session.refresh = refresh;
+        session.difference = difference;
+        session.tilesize = tilesize;
+        if (windetect.verbose && !incremental)
+            cout << track;
+
+        try {
+            std::list<std::string> inlist;
+            lear::imagelist(inlist, windetectmain.infile, windetectmain.imageext);
+            // directory listings are unordered
+            inlist.sort();
+
+            std::ofstream out;
+            if (!windetectmain.outfile.empty()) {
+                out.open(windetectmain.outfile.c_str());
+                if (!out)
+                    throw Exception("track_rhog",
+                            "Unable to open output file " + windetectmain.outfile);
+            }
+
+            typedef blitz::Array<blitz::TinyVector<int,3>,2>    ImageType;
+            std::vector<unsigned char> buffer;
+            std::list<DetectedRegion> full, temporal;
+            const PixelFormat format(PixelFormat::RGB);
+
+            int frames = 0, fullscans = 0, numfull = 0, numfound = 0;
+            double fulltime = 0, tracktime = 0;
+            double fullwindows = 0, trackwindows = 0;
+            for (std::list<std::string>::const_iterator f = inlist.begin();
+                    f != inlist.end(); ++f)
+            {// {{{
+                ImageType image;
+                ImageIO::read(*f, image);
+                const int width = image.extent(0), height = image.extent(1);
+                buffer.resize(width*height*3);
+                for (int y= 0; y< height; ++y)
+                for (int x= 0; x< width; ++x)
+                    for (int c= 0; c< 3; ++c)
+                        buffer[(y*width + x)*3 + c] = image(x,y)[c];
+
+                DetectStats stats;
+                TimeType start = now();
+                if (incremental)
+                    session.test(temporal, &buffer[0], width, height, format, &stats);
+                else
+                    track.test(temporal, &buffer[0], width, height, format, &stats);
+                tracktime += elapsed(start);
+                trackwindows += stats.windows;
+                fullscans += !incremental && track.lastfull();
+
+                if (!nocompare) {
+                    start = now();
+                    windetect.test(*classifier, full, &buffer[0], width, height,
+                            format, &stats);
+                    fulltime += elapsed(start);
+                    fullwindows += stats.windows;
+                    numfull += full.size();
+                    numfound += recalled(full, temporal);
+                }
+                ++frames;
+
+                if (out.is_open())
+                    for (std::list<DetectedRegion>::const_iterator d = temporal.begin();
+                            d != temporal.end(); ++d)
+                        out << *f << ' ' << d->x << ' ' << d->y << ' '
+                            << d->width << ' ' << d->height << ' '
+                            << d->score << '\n';
+                if (windetect.verbose > 1 && !incremental)
+                    cout << *f << (track.lastfull() ? "  full " : "  track")
+                        << "  motion " << setw(6) << track.motion()
+                        << "  tracks " << setw(3) << track.tracks().size()
+                        << "  detections " << setw(3) << temporal.size() << endl;
+            }// }}}
+
+            if (frames) {
+                cout << "Frames " << frames;
+                if (!incremental)
+                    cout << ", full scans " << fullscans;
+                cout << endl;
+                cout << fixed << setprecision(2)
+                     << (incremental ? "Incremental " : "Temporal    ") << setw(10) << tracktime/frames << " ms/frame"
+                     << setw(12) << trackwindows/frames << " windows/frame" << endl;
+                if (!nocompare) {
+                    cout << "Full scan   " << setw(10) << fulltime/frames << " ms/frame"
+                         << setw(12) << fullwindows/frames << " windows/frame" << endl;
+                    cout << "Recall of full scan detections "
+                         << numfound << "/" << numfull;
+                    if (numfull)
+                        cout << " (" << 100.0*numfound/numfull << "%)";
+                    cout << endl;
+                }
+            }
+        }catch (std::exception& e) {
+            delete classifier;
+            delete bundle;
+            throw e;
+        }
+        delete classifier;
+        delete bundle;
+    } catch(std::exception& e) {
+        cerr << "Caught "<< e.what() << endl;
+        return 1;
+    } catch(...) {
+        cerr << "Caught unknown exception" << endl;
+        return 1;
+    }
+    return 0;
+}
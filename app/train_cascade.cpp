@@ -0,0 +1,460 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  train_cascade.cpp
+ *
+ *    Description:  Trains a StumpCascade over integral channel features
+ *    from positive and negative image lists: real AdaBoost of decision
+ *    stumps over random candidate rectangles, with rounds of hard negative
+ *    mining, and soft cascade reject values from the positive windows.
+ *
+ * =====================================================================================
+ */
+
+#include <cmath>
+#include <ctime>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+
+#include <boost/random.hpp>
+
+#include "windetectmain.h"
+#include <lear/image/imageio.h>
+#include <lear/image/imageutil.h>
+#include <lear/image/rescale.h>
+#include <lear/cvision/scalepyramid.h>
+#include <lear/cvision/imageslider.h>
+#include <lear/cvision/stumpcascade.h>
+
+using std::cout; using std::cerr; using std::endl;
+
+typedef lear::ChannelFeatures                       FeatType;
+typedef FeatType::RGBImage                          ImageType;
+typedef FeatType::IndexType                         IndexType;
+typedef lear::StumpCascade::Stump                   Stump;
+typedef std::list<std::string>                      PathVector;
+
+typedef boost::variate_generator<boost::mt19937&, boost::uniform_int<> > RandEng;
+
+/// feature values are binned in this many bins per candidate
+static const int NumBins = 256;
+
+/// candidate rectangle of a stump
+struct Candidate {
+    int channel;
+    IndexType tl, extent;
+};
+
+/// Training windows, one row of candidate means per window
+struct Samples {// {{{
+    explicit Samples(const std::vector<Candidate>& cand) : cand(cand) {}
+
+    int size() const { return label.size(); }
+    int positives() const { return std::count(label.begin(), label.end(), 1); }
+
+    /// candidate means of the window at tl of the image f was computed on
+    void values(const FeatType& f, const IndexType tl, float* v) const {
+        for (unsigned k= 0; k< cand.size(); ++k)
+            v[k] = f.mean(cand[k].channel, tl + cand[k].tl, cand[k].extent);
+    }
+
+    void push_back(const float* v, const int y) {
+        value.insert(value.end(), v, v + cand.size());
+        label.push_back(y);
+    }
+
+    /// appends the window at tl of the image f was computed on
+    void push_back(const FeatType& f, const IndexType tl, const int y) {
+        value.resize(value.size() + cand.size());
+        values(f, tl, &value[value.size() - cand.size()]);
+        label.push_back(y);
+    }
+
+    const std::vector<Candidate>& cand;
+    /// size() x cand.size(), window outer
+    std::vector<float> value;
+    /// 1 positive, -1 negative
+    std::vector<int> label;
+};// }}}
+
+static ImageType readimage(const std::string& file)
+{
+    ImageType image;
+    lear::ImageIO::read(file, image);
+    return image;
+}
+
+/// image mirrored left to right
+static ImageType mirrored(const ImageType& image)
+{
+    ImageType m(image.extent());
+    const int w = image.extent(0);
+    for (int x= 0; x< w; ++x)
+    for (int y= 0; y< image.extent(1); ++y)
+        m(x,y) = image(image.lbound(0) + w-1-x, image.lbound(1) + y);
+    return m;
+}
+
+/**
+ * Learns rounds stumps on samples with real AdaBoost and sets cascade to
+ * them, chosen holds the candidate index of each stump. Candidate means are binned in NumBins bins between their smallest
+ * and largest value; each round picks the candidate and split minimizing
+ * Z = sqrt(W+l W-l) + sqrt(W+r W-r) over the weights left and right of the
+ * split. Reject values are the smallest partial scores of the positives
+ * the final classifier accepts (direct backward pruning).
+ */
+static void trainstumps(const Samples& samples, const int rounds,
+        lear::StumpCascade& cascade, std::vector<int>& chosen, const int verbose)
+{// {{{
+    const std::vector<Candidate>& cand = samples.cand;
+    const int n = samples.size(), numcand = cand.size();
+
+    std::vector<float> lo(numcand), step(numcand);
+    std::vector<unsigned char> bin(numcand*n);
+    for (int k= 0; k< numcand; ++k) {
+        float vmin = samples.value[k], vmax = vmin;
+        for (int i= 1; i< n; ++i) {
+            const float v = samples.value[i*numcand + k];
+            vmin = std::min(vmin, v); vmax = std::max(vmax, v);
+        }
+        lo[k] = vmin;
+        step[k] = vmax > vmin ? (vmax - vmin)/NumBins : 1;
+        for (int i= 0; i< n; ++i) {
+            const int b = static_cast<int>(
+                    (samples.value[i*numcand + k] - lo[k])/step[k]);
+            bin[k*n + i] = std::max(0, std::min(NumBins-1, b));
+        }
+    }
+
+    const int numpos = samples.positives(), numneg = n - numpos;
+    if (!numpos || !numneg)
+        throw lear::Exception("trainstumps()", "Positive and negative windows are required");
+    std::vector<double> weight(n), score(n, 0);
+    for (int i= 0; i< n; ++i)
+        weight[i] = samples.label[i] > 0 ? 0.5/numpos : 0.5/numneg;
+    // partial scores of the positives after each stump
+    std::vector<float> partial;
+
+    cascade.stumps().clear();
+    chosen.clear();
+    const double eps = 1e-6;
+    std::vector<double> pos(NumBins), neg(NumBins);
+    for (int t= 0; t< rounds; ++t) {
+        double wp = 0, wn = 0;
+        for (int i= 0; i< n; ++i)
+            (samples.label[i] > 0 ? wp : wn) += weight[i];
+
+        double bestz = 2; int bestk = -1, bests = 0;
+        double bestlp = 0, bestln = 0;
+        for (int k= 0; k< numcand; ++k) {
+            std::fill(pos.begin(), pos.end(), 0);
+            std::fill(neg.begin(), neg.end(), 0);
+            const unsigned char* b = &bin[k*n];
+            for (int i= 0; i< n; ++i)
+                (samples.label[i] > 0 ? pos : neg)[b[i]] += weight[i];
+
+            double lp = 0, ln = 0;
+            for (int s= 0; s< NumBins-1; ++s) {
+                lp += pos[s]; ln += neg[s];
+                const double z = std::sqrt(lp*ln)
+                    + std::sqrt(std::max(wp-lp, 0.0)*std::max(wn-ln, 0.0));
+                if (z < bestz) {
+                    bestz = z; bestk = k; bests = s;
+                    bestlp = lp; bestln = ln;
+                }
+            }
+        }
+        if (bestk < 0)
+            break;
+
+        Stump s;
+        s.channel = cand[bestk].channel;
+        s.tl = cand[bestk].tl;
+        s.extent = cand[bestk].extent;
+        s.threshold = lo[bestk] + (bests+1)*step[bestk];
+        s.left = 0.5*std::log((bestlp + eps)/(bestln + eps));
+        s.right = 0.5*std::log((wp - bestlp + eps)/(wn - bestln + eps));
+        cascade.push_back(s);
+        chosen.push_back(bestk);
+
+        const unsigned char* b = &bin[bestk*n];
+        double sum = 0;
+        for (int i= 0; i< n; ++i) {
+            const double h = b[i] <= bests ? s.left : s.right;
+            score[i] += h;
+            weight[i] *= std::exp(-samples.label[i]*h);
+            sum += weight[i];
+            if (samples.label[i] > 0)
+                partial.push_back(score[i]);
+        }
+        for (int i= 0; i< n; ++i)
+            weight[i] /= sum;
+
+        if (verbose > 2)
+            cout << "Stump " << std::setw(4) << t << "  channel " << std::setw(2) << s.channel
+                 << "  Z " << std::setprecision(4) << bestz << endl;
+    }
+
+    // reject below the smallest partial score of accepted positives
+    const int numstump = cascade.size();
+    std::vector<Stump>& stumps = cascade.stumps();
+    std::vector<int> posindex;
+    for (int i= 0, p= 0; i< n; ++i)
+        if (samples.label[i] > 0) {
+            if (score[i] > 0)
+                posindex.push_back(p);
+            ++p;
+        }
+    if (posindex.empty())
+        return;
+    for (int t= 0; t< numstump; ++t) {
+        float r = partial[t*numpos + posindex[0]];
+        for (unsigned p= 1; p< posindex.size(); ++p)
+            r = std::min(r, partial[t*numpos + posindex[p]]);
+        stumps[t].reject = r;
+    }
+}// }}}
+
+/// fraction of windows of samples the cascade classifies correctly, chosen
+/// as set by trainstumps
+static float accuracy(const Samples& samples, const lear::StumpCascade& cascade,
+        const std::vector<int>& chosen)
+{// {{{
+    const int numcand = samples.cand.size();
+    int correct = 0;
+    for (int i= 0; i< samples.size(); ++i) {
+        float score = 0;
+        bool accepted = true;
+        const float* v = &samples.value[i*numcand];
+        for (int t= 0; t< cascade.size() && accepted; ++t) {
+            const Stump& s = cascade.stumps()[t];
+            score += v[chosen[t]] < s.threshold ? s.left : s.right;
+            accepted = !(score < s.reject);
+        }
+        correct += (accepted && score > 0) == (samples.label[i] > 0);
+    }
+    return static_cast<float>(correct)/samples.size();
+}// }}}
+
+int main(int argc, char** argv) {
+    using namespace lear;
+    lear::Cmdline cmdline;
+
+    std::string posfile, negfile, imageext, outfile;
+    IndexOpt window, topleft, winstride;
+    int orientbin, numstump, numcand, minrect, samples, bootstrap, maxneg, verbose;
+    bool noluv, mirror, randomseed;
+    RealType gscale, scaleratio;
+    {  // cmdline
+        cmdline.commandName("train_cascade");
+        cmdline.version("0.0.1", "");
+        cmdline.brief(
+"Train a boosted stump cascade over integral channel features");
+
+        cmdline.description(
+"Channel features (gradient magnitude, orientation channels and optionally LUV) are computed for each positive image, whose window is at the image center unless 'topleft' is given, and for 'samples' random windows of each negative image. Stumps over the means of 'candidates' random rectangles of the window are learned with real AdaBoost. After each of 'bootstrap' rounds the negative images are scanned with the cascade and up to 'samples' false positives per image are added. The model is written to outfile; detect with classify_cascade or WinDetectClassify::test.");
+
+        cmdline.addOption()
+            ("posfile,p",option<std::string>(&posfile),
+                "positive image file, directory, or list file")
+            ("negfile,n",option<std::string>(&negfile),
+                "negative image file, directory, or list file")
+            ("imageext,x",option<std::string>(&imageext)
+                ->defaultValue(""),
+                "image extension (valid only if posfile or negfile is a dir or list)")
+            ("window,W",option<IndexOpt>(&window)
+                ->defaultValue(IndexOpt(64,128))->minValue(3),
+                "window width,height")
+            ("topleft",option<IndexOpt>(&topleft)
+                ->defaultValue(IndexOpt(-1,-1)),
+                "top-left X,Y-coordinate of the window in positive images\n"
+                "  (Default window is at image center )")
+            ("orientbin",option<int>(&orientbin)
+                ->defaultValue(6)->minValue(1),
+                "orientation channels over 0-180 degrees")
+            ("noluv",bool_option(&noluv),
+                "do not use the LUV color channels")
+            ("gscale",option<RealType>(&gscale)
+                ->defaultValue(0)->minValue(0),
+                "gradient smoothing scale (0=no smoothing)")
+            ("stumps,T",option<int>(&numstump)
+                ->defaultValue(256)->minValue(1),
+                "number of boosted stumps")
+            ("candidates,C",option<int>(&numcand)
+                ->defaultValue(2000)->minValue(1),
+                "number of random candidate rectangles")
+            ("minrect",option<int>(&minrect)
+                ->defaultValue(4)->minValue(1),
+                "smallest candidate rectangle side in pixels")
+            ("samples,s",option<int>(&samples)
+                ->defaultValue(10)->minValue(1),
+                "negative windows per negative image and round")
+            ("bootstrap,b",option<int>(&bootstrap)
+                ->defaultValue(2)->minValue(0),
+                "rounds of hard negative mining")
+            ("maxneg,N",option<int>(&maxneg)
+                ->defaultValue(50000)->minValue(1),
+                "largest number of negative windows")
+            ("winstride",option<IndexOpt>(&winstride)
+                ->defaultValue(8),
+                "window stride along x-y when mining hard negatives")
+            ("scaleratio",option<RealType>(&scaleratio)
+                ->defaultValue(1.2)->minValue(1),
+                "scale ratio when mining hard negatives")
+            ("mirror",bool_option(&mirror),
+                "also use positive images mirrored left to right")
+            ("random,r",bool_option(&randomseed),
+                "seed the random generator with the time")
+            ("verbose,v",option<int>(&verbose)
+                ->defaultValue(0)->minValue(0)->maxValue(9),
+                "verbose level")
+            ;
+        cmdline.addArgument()
+            ("outfile",option<std::string>(&outfile),"output model file")
+            ;
+    }
+
+    int status = cmdline.parse(argc, argv);
+    if (status != cmdline.ok)
+        return status;
+
+    if (!imageext.empty() && imageext[0] != '.')
+        imageext = '.' + imageext;
+
+    try {
+        const IndexType win (window[0], window[1]);
+        boost::mt19937 rng(randomseed ? static_cast<unsigned long> (std::time(0)) : 0 );
+        if (minrect > std::min(win[0], win[1]))
+            throw Exception("train_cascade", "minrect is larger than the window");
+
+        StumpCascade cascade(win, orientbin, !noluv, gscale);
+        FeatType features(orientbin, !noluv, gscale);
+
+        std::vector<Candidate> cand(numcand);
+        {// {{{ random rectangles
+            RandEng channel(rng, boost::uniform_int<>(0, features.channels()-1));
+            RandEng width(rng, boost::uniform_int<>(minrect, win[0]));
+            RandEng height(rng, boost::uniform_int<>(minrect, win[1]));
+            for (int k= 0; k< numcand; ++k) {
+                Candidate& c = cand[k];
+                c.channel = channel();
+                c.extent = IndexType(width(), height());
+                RandEng x(rng, boost::uniform_int<>(0, win[0] - c.extent[0]));
+                RandEng y(rng, boost::uniform_int<>(0, win[1] - c.extent[1]));
+                c.tl = IndexType(x(), y());
+            }
+        }// }}}
+
+        PathVector poslist, neglist;
+        lear::imagelist(poslist, posfile, imageext);
+        lear::imagelist(neglist, negfile, imageext);
+
+        Samples train(cand);
+        for (PathVector::const_iterator f = poslist.begin(); f != poslist.end(); ++f)
+        {// {{{
+            const ImageType image (readimage(*f));
+            const IndexType ext (image.extent());
+            IndexType tl (topleft[0], topleft[1]);
+            if (tl[0] < 0 || tl[1] < 0)
+                tl = (ext - win)/2;
+            if (tl[0] < 0 || tl[1] < 0
+                    || tl[0] + win[0] > ext[0] || tl[1] + win[1] > ext[1])
+            {
+                cerr << "Window outside of image " << *f << ". Ignoring ..." << endl;
+                continue;
+            }
+            features.compute(image);
+            train.push_back(features, tl, 1);
+            if (mirror) {
+                features.compute(mirrored(image));
+                train.push_back(features,
+                        IndexType(ext[0] - tl[0] - win[0], tl[1]), 1);
+            }
+        }// }}}
+
+        int numneg = 0;
+        for (PathVector::const_iterator f = neglist.begin();
+                f != neglist.end() && numneg < maxneg; ++f)
+        {// {{{
+            const ImageType image (readimage(*f));
+            const IndexType ext (image.extent());
+            if (ext[0] < win[0] || ext[1] < win[1])
+                continue;
+            features.compute(image);
+            RandEng x(rng, boost::uniform_int<>(0, ext[0] - win[0]));
+            RandEng y(rng, boost::uniform_int<>(0, ext[1] - win[1]));
+            for (int i= 0; i< samples && numneg < maxneg; ++i, ++numneg)
+                train.push_back(features, IndexType(x(), y()), -1);
+        }// }}}
+
+        if (verbose)
+            cout << "Positive windows " << train.positives()
+                 << ", negative windows " << numneg << endl;
+
+        typedef lear::ScalePyramid<2>                PyramidType;
+        typedef lear::ImageSlider<2>                 SliderType;
+        const IndexType stride (winstride[0], winstride[1]);
+        std::vector<int> chosen;
+        for (int round= 0; ; ++round) {
+            trainstumps(train, numstump, cascade, chosen, verbose);
+            if (verbose)
+                cout << "Round " << round << ": " << cascade.size()
+                     << " stumps, training accuracy " << std::setprecision(4)
+                     << accuracy(train, cascade, chosen) << endl;
+            if (round >= bootstrap || numneg >= maxneg)
+                break;
+
+            int added = 0;
+            for (PathVector::const_iterator f = neglist.begin();
+                    f != neglist.end() && numneg < maxneg; ++f)
+            {// {{{ hard negatives
+                const ImageType image (readimage(*f));
+                if (image.extent(0) < win[0] || image.extent(1) < win[1])
+                    continue;
+                // reservoir of samples windows among those accepted
+                const int numcand = cand.size();
+                std::vector<float> hard;
+                int seen = 0;
+                const PyramidType pyramid(image.extent(), win, scaleratio);
+                for (PyramidType::iterator piter = pyramid.begin();
+                        piter != pyramid.end(); ++piter)
+                {
+                    features.compute(ImageType(lear::rescale(image, *piter)));
+                    const SliderType slider(*piter, win, stride);
+                    for (SliderType::iterator s = slider.begin(); s != slider.end(); ++s) {
+                        lear::StumpCascade::RealType score;
+                        if (!cascade(features, *s, score) || !(score > 0))
+                            continue;
+                        int slot = seen++;
+                        if (slot >= samples) {
+                            RandEng pick(rng, boost::uniform_int<>(0, slot));
+                            if ((slot = pick()) >= samples)
+                                continue;
+                        } else
+                            hard.resize(hard.size() + numcand);
+                        train.values(features, *s, &hard[slot*numcand]);
+                    }
+                }
+                for (unsigned i= 0; i< hard.size() && numneg < maxneg;
+                        i+= numcand, ++numneg, ++added)
+                    train.push_back(&hard[i], -1);
+            }// }}}
+            if (verbose)
+                cout << "Added " << added << " hard negative windows" << endl;
+            if (!added)
+                break;
+        }
+
+        cascade.save(outfile);
+        if (verbose)
+            cout << cascade;
+    } catch(std::exception& e) {
+        cerr << "Caught "<< e.what() << endl;
+        return 1;
+    } catch(...) {
+        cerr << "Caught unknown exception" << endl;
+        return 1;
+    }
+    return 0;
+}
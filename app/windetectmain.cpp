@@ -8,6 +8,8 @@
  * =====================================================================================
  */
 
+#include <fstream>
+#include <sstream>
 #include <blitz/array.h>
 #include <blitz/tinyvec.h> 
 
@@ -75,6 +77,33 @@ void WinDetectClassifyMain::fill(WinDetectClassify* param) const
     param->score2prob_a = score2prob[0];
     param->score2prob_b = score2prob[1];
 
+    param->nonmaxmethod = 
+        (WinDetectClassify::NonMaxMethod)nonmaxopt_.check();
+
+    param->groundplane_a = groundplane[0];
+    param->groundplane_b = groundplane[1];
+    if (!groundfrom.empty()) {
+        // detection list written by List_PPResult, one image starts with
+        // an all zero line
+        std::ifstream in(groundfrom.c_str());
+        if (!in)
+            throw lear::Exception("WinDetectClassifyMain::fill()",
+                    "Unable to open detection list " + groundfrom);
+        std::list<DetectedRegion> detections;
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream l(line);
+            DetectedRegion r;
+            l >> r.x >> r.y >> r.width >> r.height >> r.scale >> r.score;
+            if (l && r.width > 0 && r.height > 0)
+                detections.push_back(r);
+        }
+        if (!param->fitGroundPlane(detections))
+            throw lear::Exception("WinDetectClassifyMain::fill()",
+                    "Too few detections in " + groundfrom + 
+                    " to fit the ground plane");
+    }
+
 }
 
 // Cmdline parsing 
@@ -131,6 +160,13 @@ void WinDetectMain::setCommonMainParam(lear::Cmdline& cmdline, WinDetect* param)
             ->defaultValue(128)->minValue(4),
             "descriptor cache size (im MB) to use\n"
             "  NOTE: small cache size can drastically reduce speed")
+        ("sharedlevels",option<int>(&(param->sharedlevels))
+            ->defaultValue(0)->minValue(0),
+            "keep the gradients of n pyramid levels for later scans of "
+            "the same frame (0=off)")
+        ("cellgrid",bool_option(&(param->cellgrid)),
+            "assemble blocks from one cell grid per phase of the window "
+            "stride, without Gaussian weights, see bench_rhog -b hog")
         ("verbose,v",option<int>(&(param->verbose))
             ->defaultValue(0)->minValue(0)->maxValue(9),
             "verbose level")
@@ -206,6 +242,7 @@ void WinDetectDumpMain::setDumpParam( lear::Cmdline& cmdline, WinDetectDump* par
 
 void WinDetectClassifyMain::setClassifyParam( lear::Cmdline& cmdline, WinDetectClassify* param) {
     using namespace lear;
+    cmdline.appendUsageIssues( nonmaxopt_.usage());
     cmdline.addOption()
         ("svmthreshold,m",option<RealType>(&(param->lightthreshold))
             ->defaultValue(0),
@@ -246,6 +283,62 @@ void WinDetectClassifyMain::setClassifyParam( lear::Cmdline& cmdline, WinDetectC
             ->defaultValue(NonmaxOptType(8,16,1.3))
             ->minValue(NonmaxOptType(0,0,0)),
             "smooth sigma for non-max suppression (x,y, scale)")
+        ("nonmax",option<std::string>(&(nonmaxopt_.option))
+            ->defaultValue(nonmaxopt_.defaultOption()),
+            "non-maximum suppression method")
+        ("nonmaxoverlap",option<float>(&(param->nonmaxoverlap))
+            ->defaultValue(0.5)->minValue(0)->maxValue(1),
+            "largest overlap with a kept window (Greedy non-max only)")
+        ("coarsestride",option<int>(&(param->coarsestride))
+            ->defaultValue(1)->minValue(1),
+            "score every n-th window first, then refine around scores "
+            "above refinethreshold (1=dense scan)")
+        ("refinethreshold",option<RealType>(&(param->refinethreshold))
+            ->defaultValue(-0.5),
+            "coarse score above which neighbouring windows are scored")
+        ("groundplane",option<SigmaOptType>(&groundplane)
+            ->defaultValue(SigmaOptType(0,0)),
+            "(A,B): window with bottom at image row r is A*r+B pixels high "
+            "(used iff groundtolerance > 0)")
+        ("groundfrom",option<std::string>(&groundfrom),
+            "fit groundplane to detections in this list (as written to outfile)")
+        ("groundtolerance",option<float>(&(param->groundtolerance))
+            ->defaultValue(0)->minValue(0),
+            "relative height tolerance around groundplane, 0=scan all rows")
+        ("timebudget",option<RealType>(&(param->timebudget))
+            ->defaultValue(0)->minValue(0),
+            "time budget per image in ms, levels that do not fit are "
+            "coarsened or skipped (0=none, not used by classify_rhog)")
+        ("priorityscale",option<RealType>(&(param->priorityscale))
+            ->defaultValue(0)->minValue(0),
+            "with timebudget, process levels closest to this scale first "
+            "(0=smallest scale first)")
+        ("energythreshold",option<RealType>(&(param->energythreshold))
+            ->defaultValue(0)->minValue(0),
+            "do not score windows whose mean gradient magnitude is below "
+            "this, see energy_threshold (0=off)")
+        ("posemirror",bool_option(&(param->posemirror)),
+            "also score the model mirrored left to right")
+        ("poseangle",option<RealType>(&(param->poseangle))
+            ->defaultValue(0),
+            "also score the model rotated by multiples of this angle "
+            "(degrees, see posesteps)")
+        ("posesteps",option<int>(&(param->posesteps))
+            ->defaultValue(0)->minValue(0),
+            "number of rotations by poseangle on each side")
+        ("descscale",option<RealType>(&(param->descscale))
+            ->defaultValue(0)->minValue(0),
+            "score with 8-bit descriptors quantized with this scale and "
+            "8-bit weights, see quantize_rhog (0=float)")
+        ("fixedpoint",bool_option(&(param->fixedpoint)),
+            "compute descriptors with integer gradients and cell votes "
+            "(gscale 0 only), see bench_rhog -b hog")
+        ("halfprecision",bool_option(&(param->halfprecision)),
+            "keep gradient magnitudes and blocks as float16 and "
+            "orientations as 8.8 bins, see bench_rhog -b hog")
+        ("writers",option<int>(&(param->writers))
+            ->defaultValue(0)->minValue(0),
+            "background threads writing results and images (0=none)")
 
         ("outimage,i",option<std::string>(&outimage),
             "align input image to max of classifier\n"
@@ -285,9 +378,11 @@ unsigned RHOGDenseMain::size() const
     svec.push_back(orientbin.size());
     svec.push_back(wtscale.size());
     svec.push_back(fullcirc.size());
+    svec.push_back(jointcirc.size());
     svec.push_back(gscale.size());
     svec.push_back(epsilon.size());
     svec.push_back(maxvalue.size());
+    svec.push_back(labnodes.size());
 
     return *std::max_element(svec.begin(),svec.end());
 }
@@ -324,6 +419,8 @@ void RHOGDenseMain::setRHOGDenseParam(lear::Cmdline& cmdline)
             "magnitude weighting scale")
         ("fullcirc,O",option<MultBoolOpt>(&(fullcirc)),
             "take orientations in range (0-360)")
+        ("jointcirc",option<MultBoolOpt>(&(jointcirc)),
+            "both (0-360) and (0-180) orientation bins, from one vote")
         ("gscale,S",option<MultRealOpt>(&(gscale))
             ->defaultValue(0)->minValue(0),
             "gradient computation scale")
@@ -334,6 +431,11 @@ void RHOGDenseMain::setRHOGDenseParam(lear::Cmdline& cmdline)
             ->defaultValue(0.2)->minValue(0)->maxValue(1),
             "chop feature vector values > maxvalue after normalizing\n"
     "  Used iff normalizing method == NormL2Hys")
+        ("labnodes",option<MultIntOpt>(&(labnodes))
+            ->defaultValue(0)->minValue(0)->maxValue(256),
+            "Lab preprocessing from a lookup table with this many nodes "
+            "per axis, e.g. 65 (1.6 MB) or 256 (exact, 96 MB)\n"
+    "  0 converts each pixel exactly")
         ;
 }
 
@@ -372,6 +474,9 @@ std::vector<const RHOGDenseParam*> RHOGDenseMain::fill() const
         if (fullcirc.size()) 
             desc->semicirc = !fullcirc.at(i);
 
+        if (jointcirc.size()) 
+            desc->jointcirc = jointcirc.at(i);
+
         if (wtscale.size()) 
         desc->wtscale = wtscale.at(i);
 
@@ -382,6 +487,8 @@ std::vector<const RHOGDenseParam*> RHOGDenseMain::fill() const
             desc->epsilon = epsilon.at(i);
         if (maxvalue.size()) 
             desc->maxvalue = maxvalue.at(i);
+        if (labnodes.size()) 
+            desc->labnodes = labnodes.at(i);
 
         desclist[i] = desc;
     }
@@ -87,7 +87,7 @@ struct WinDetectDumpMain : public WinDetectMain {
 };
 struct WinDetectClassifyMain: public WinDetectMain {
     // --- Variable declarations
-    std::string modelfile, outimage, outhist, falsetxt;
+    std::string modelfile, outimage, outhist, falsetxt, groundfrom;
 
     // WinDetectClassify parameters
     IndexOpt        margin;
@@ -96,14 +96,23 @@ struct WinDetectClassifyMain: public WinDetectMain {
     IndexOpt        fullstride;
     NonmaxOptType   nonmaxsigma; 
     SigmaOptType    score2prob;
+    SigmaOptType    groundplane;
      
+    lear::CustomOption nonmaxopt_;
 
     WinDetectClassifyMain(): 
         WinDetectMain(),
         margin(0), avsize(0), 
         alignmargin(0), fullstride(-1),
-        nonmaxsigma(12,24,1.2), score2prob(1,0)
-    { }
+        nonmaxsigma(12,24,1.2), score2prob(1,0), groundplane(0,0),
+        nonmaxopt_("non-maximum suppression",WinDetectClassify::MeanShift)
+    { 
+        nonmaxopt_
+            .add("MeanShift", WinDetectClassify::MeanShift)
+            .add("ScaleSpace", WinDetectClassify::ScaleSpace)
+            .add("Greedy", WinDetectClassify::Greedy)
+            ;
+    }
 
 
     // Some parameters of windetect are set basic types. We 
@@ -122,8 +131,8 @@ struct RHOGDenseMain {
 
     MultStrOpt  iprocessor, normalizer;
     MultIndexOpt cellsize, numcell, descstride;
-    MultIntOpt  orientbin; 
-    MultBoolOpt fullcirc;
+    MultIntOpt  orientbin, labnodes; 
+    MultBoolOpt fullcirc, jointcirc;
     MultRealOpt wtscale;
     MultRealOpt gscale, epsilon, maxvalue;  
 
@@ -0,0 +1,253 @@
+// {{{ file documentation
+/**
+ * @file
+ * @brief Separable convolution of contiguous 2D blitz arrays.
+ *
+ * ConvolveExact walks blitz 1D slices and applies the boundary policy to
+ * every tap of every pixel. ConvolveSeparable works on the raw row-major
+ * memory instead. Pixels whose kernel support lies inside the array use a
+ * branch free loop over contiguous data, and the boundary policy is applied
+ * only to the kernel radius at either end. The pass across the first index
+ * is cache blocked: it walks the image in column chunks so that the input
+ * rows used by a chunk stay in cache.
+ *
+ * Pixels of type TinyVector<T,N> (e.g. interleaved RGB) are handled as N
+ * interleaved planes. Planar images are convolved one plane at a time with
+ * the raw convolve() routine.
+ *
+ * Arrays which are not stored contiguously in row-major order are passed
+ * on to ConvolveExact, so results are always the same as ConvolveExact
+ * with the same policy (up to float rounding).
+ */
+// }}}
+
+#ifndef _LEAR_SEP_CONVOLVE_H_
+#define _LEAR_SEP_CONVOLVE_H_
+
+// {{{ headers
+#include <vector>
+#include <algorithm>
+
+#include <blitz/array.h>
+#include <blitz/tinyvec.h>
+
+#include <lear/blitz/ext/convolve.h>
+// }}}
+
+BZ_NAMESPACE(blitz)
+
+namespace detail {
+// {{{ SepChannels
+/// Number of scalar channels in a pixel type
+template<class T>
+struct SepChannels {
+    enum {N = 1};
+    typedef T                                   ElemType;
+};
+template<class T, int M>
+struct SepChannels< blitz::TinyVector<T,M> > {
+    enum {N = M};
+    typedef T                                   ElemType;
+};
+// }}}
+
+// {{{ SepBorder
+/**
+ * Maps sample index j of a line of n pixels inside the line as the
+ * corresponding ConvolveExact policy does. Returns -1 if the sample does
+ * not contribute.
+ */
+template<class Policy> struct SepBorder;
+
+template<> struct SepBorder<CPolicy_Chop> {
+    static int index(const int j, const int n)
+    { return (j < 0 || j >= n) ? -1 : j; }
+};
+template<> struct SepBorder<CPolicy_Stretch> {
+    static int index(const int j, const int n)
+    { return j < 0 ? 0 : (j >= n ? n-1 : j); }
+};
+template<> struct SepBorder<CPolicy_Mirror> {
+    static int index(const int j, const int n)
+    { return j < 0 ? -j : (j >= n ? 2*(n-1) - j : j); }
+};
+// }}}
+
+template<class A, class B> struct SepSame       { enum {value = 0}; };
+template<class A>          struct SepSame<A,A>  { enum {value = 1}; };
+}
+
+template<class Policy>
+struct ConvolveSeparable {
+    /// Column chunk (in scalars) processed at a time by the pass across lines
+    enum {ChunkSize = 1024};
+
+    // {{{ raw routines
+    /**
+     * Convolves along each line of nline lines of n pixels with nch
+     * interleaved channels each:
+     *      out[i] = sum_{k=lo}^{hi} c[k-lo]*in[i-k]
+     * for every channel. Lines are stored back to back.
+     */
+    template<class T>
+    static void alongline(
+            const T* in, T* out, const int nline, const int n, const int nch,
+            const T* c, const int lo, const int hi)
+    {// {{{
+        // interior pixels have all taps inside the line
+        int ib = std::max(hi,0), ie = std::min(n-1+lo, n-1);
+        if (ib > ie) {
+            ib = n; ie = n-1;
+        }
+        const int len = (ie-ib+1)*nch;
+        const int linesize = n*nch;
+
+        for (int l= 0; l< nline; ++l, in+=linesize, out+=linesize) {
+            if (len > 0) {
+                T* o = out + ib*nch;
+                std::fill(o, o+len, T(0));
+                for (int k= hi; k>= lo; --k) {
+                    const T w = c[k-lo];
+                    const T* s = in + (ib-k)*nch;
+                    for (int e= 0; e< len; ++e)
+                        o[e] += w*s[e];
+                }
+            }
+            for (int i= 0; i< n; ++i) {
+                if (i == ib) {
+                    i = ie;
+                    continue;
+                }
+                for (int ch= 0; ch< nch; ++ch) {
+                    T r = 0;
+                    for (int k= hi; k>= lo; --k) {
+                        const int j = detail::SepBorder<Policy>::index(i-k,n);
+                        if (j >= 0)
+                            r += c[k-lo]*in[j*nch+ch];
+                    }
+                    out[i*nch+ch] = r;
+                }
+            }
+        }
+    }// }}}
+
+    /**
+     * Convolves across n lines of linesize scalars each, i.e.
+     *      out[i] = sum_{k=lo}^{hi} c[k-lo]*in[i-k]
+     * where out[i] and in[i] are whole lines.
+     */
+    template<class T>
+    static void acrossline(
+            const T* in, T* out, const int n, const int linesize,
+            const T* c, const int lo, const int hi)
+    {// {{{
+        for (int e0= 0; e0< linesize; e0+=ChunkSize) {
+            const int len = std::min(static_cast<int>(ChunkSize), linesize-e0);
+            for (int i= 0; i< n; ++i) {
+                T* o = out + i*linesize + e0;
+                std::fill(o, o+len, T(0));
+                const bool interior = i-hi >= 0 && i-lo < n;
+                for (int k= hi; k>= lo; --k) {
+                    const int j = interior ?
+                        i-k : detail::SepBorder<Policy>::index(i-k,n);
+                    if (j < 0)
+                        continue;
+                    const T w = c[k-lo];
+                    const T* s = in + j*linesize + e0;
+                    for (int e= 0; e< len; ++e)
+                        o[e] += w*s[e];
+                }
+            }
+        }
+    }// }}}
+
+    /**
+     * Separable 2D convolution of a row-major array of extent n0 x n1 with
+     * nch interleaved channels: first across the first index, then along
+     * the second. tmp must hold n0*n1*nch scalars; in and out may alias.
+     * For planar images call it once per plane with nch=1.
+     */
+    template<class T>
+    static void convolve(
+            const T* in, T* out, T* tmp,
+            const int n0, const int n1, const int nch,
+            const T* c, const int lo, const int hi)
+    {// {{{
+        acrossline(in, tmp, n0, n1*nch, c, lo, hi);
+        alongline(tmp, out, n0, n1, nch, c, lo, hi);
+    }// }}}
+    // }}}
+
+    /**
+    * @brief Convolve 2D array with 1D array along X-axis (first index).
+    */
+    template<class TB, class TC> inline
+    blitz::Array<typename blitz::promote_trait<TB,TC>::T_promote, 2>&
+        dim1(
+            const blitz::Array<TB,2>& B,
+            const blitz::Array<TC,1>& C,
+            blitz::Array<typename blitz::promote_trait<TB,TC>::T_promote, 2>& A)
+        const
+    {// {{{
+        typedef typename blitz::promote_trait<TB,TC>::T_promote TA;
+        typedef typename detail::SepChannels<TA>::ElemType      T;
+
+        if (!detail::SepSame<TB,TA>::value || !israw(B) || !israw(A)) {
+            ConvolveExact<Policy> op;
+            return op.dim1(B,C,A);
+        }
+        std::vector<T> c;
+        kernel(C,c);
+        acrossline(reinterpret_cast<const T*>(B.data()),
+                reinterpret_cast<T*>(A.data()),
+                B.extent(0), B.extent(1)*detail::SepChannels<TA>::N,
+                &c[0], C.lbound(0), C.ubound(0));
+        return A;
+    }// }}}
+
+    /**
+    * @brief Convolve 2D array with 1D array along Y-axis (second index).
+    */
+    template<class TB, class TC> inline
+    blitz::Array<typename blitz::promote_trait<TB,TC>::T_promote, 2>&
+        dim2(
+            const blitz::Array<TB,2>& B,
+            const blitz::Array<TC,1>& C,
+            blitz::Array<typename blitz::promote_trait<TB,TC>::T_promote, 2>& A)
+        const
+    {// {{{
+        typedef typename blitz::promote_trait<TB,TC>::T_promote TA;
+        typedef typename detail::SepChannels<TA>::ElemType      T;
+
+        if (!detail::SepSame<TB,TA>::value || !israw(B) || !israw(A)) {
+            ConvolveExact<Policy> op;
+            return op.dim2(B,C,A);
+        }
+        std::vector<T> c;
+        kernel(C,c);
+        alongline(reinterpret_cast<const T*>(B.data()),
+                reinterpret_cast<T*>(A.data()),
+                B.extent(0), B.extent(1), detail::SepChannels<TA>::N,
+                &c[0], C.lbound(0), C.ubound(0));
+        return A;
+    }// }}}
+
+    protected:
+    /// true if array is stored contiguously in row-major order
+    template<class T>
+    static bool israw(const blitz::Array<T,2>& A) {
+        return A.isStorageContiguous() &&
+            A.isRankStoredAscending(0) && A.isRankStoredAscending(1) &&
+            A.stride(1) == 1 && A.stride(0) == A.extent(1);
+    }
+    template<class T, class TC>
+    static void kernel(const blitz::Array<TC,1>& C, std::vector<T>& c) {
+        c.resize(C.extent(0));
+        for (int k= C.lbound(0); k<= C.ubound(0); ++k)
+            c[k-C.lbound(0)] = static_cast<T>(C(k));
+    }
+};
+
+BZ_NAMESPACE_END
+
+#endif // _LEAR_SEP_CONVOLVE_H_
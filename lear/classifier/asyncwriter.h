@@ -0,0 +1,71 @@
+#ifndef _LEAR_ASYNC_WRITER_H_
+#define _LEAR_ASYNC_WRITER_H_
+
+#include <set>
+#include <deque>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <lear/util/thread.h>
+#include <lear/classifier/ppresult.h>
+
+namespace lear {
+
+/**
+ * Runs PostProcessResult::write on a pool of background threads.
+ *
+ * push() copies the detections, so the caller may reuse its buffers at
+ * once, and blocks while maxpending writes are waiting (back-pressure).
+ * Writes to the same PostProcessResult run one at a time in push order,
+ * so every output file is the same as with synchronous writes; different
+ * post-processors write concurrently.
+ *
+ * An exception thrown by a write is kept and rethrown by the next push()
+ * or flush() on the calling thread.
+ */
+class AsyncWriter {
+    public:
+        typedef PostProcessResult::DetectionWin     DetectionWin;
+        typedef PostProcessResult::const_iterator   const_iterator;
+
+        /// numthread must be positive, maxpending 0 means 4*numthread
+        AsyncWriter(const int numthread, const int maxpending=0);
+        /// waits for pending writes, errors are reported on std::cerr
+        ~AsyncWriter();
+
+        void push(PostProcessResult* pp,
+                const_iterator s, const_iterator e, const std::string& filename);
+        /// wait until all pushed writes are done
+        void flush();
+
+        int numthread() const { return thread_.size(); }
+
+    private:
+        AsyncWriter(const AsyncWriter&);
+        AsyncWriter& operator=(const AsyncWriter&);
+
+        struct Job {
+            PostProcessResult* pp;
+            DetectionWin detect;
+            std::string filename;
+        };
+
+        static void* run(void* self);
+        void work();
+        /// throws the first error of a write, must hold mutex_
+        void rethrow();
+
+        const int maxpending_;
+        std::vector<pthread_t> thread_;
+
+        Mutex mutex_;
+        Condition haswork_, hasroom_;
+        std::deque<Job*> queue_;
+        /// post-processors with a write running
+        std::set<PostProcessResult*> busy_;
+        int running_;
+        bool stop_;
+        std::string error_;
+};
+}
+#endif // _LEAR_ASYNC_WRITER_H_
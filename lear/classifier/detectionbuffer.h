@@ -0,0 +1,206 @@
+#ifndef _LEAR_DETECTION_BUFFER_H_
+#define _LEAR_DETECTION_BUFFER_H_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstddef>
+#include <lear/classifier/detectinfo.h>
+
+namespace lear {
+
+    /**
+     * Contiguous scores of a row or a level of windows, as passed to
+     * ProcessResult in one call. score[i] is the classifier score of the
+     * window with top-left corner (x[i],y[i]) in level coordinates. All
+     * windows have the same scale and extent (in level pixels), and
+     * detections are moved by -shift in image coordinates.
+     */
+    struct ScoreBatch {
+        typedef DetectInfo::IndexType               IndexType;
+
+        ScoreBatch(
+                const float* score, const int* x, const int* y, const int size,
+                const float scale, const IndexType extent, const IndexType shift)
+            :
+            score(score), x(x), y(y), size(size),
+            scale(scale), extent(extent), shift(shift)
+        {}
+
+        /// image window of i'th score, same as the window by window path
+        DetectInfo operator[](const int i) const {
+            typedef blitz::TinyVector<float,2> Real2DType;
+            const IndexType lb(x[i],y[i]);
+            Real2DType s (extent*scale);
+            Real2DType c (scale*(lb+extent/2));
+
+            DetectInfo r(score[i], scale,
+                    blitz::ceil(c - s/2), blitz::floor(s), lb);
+            r.lbound -= shift;
+            return r;
+        }
+
+        const float *score;
+        const int *x, *y;
+        const int size;
+        const float scale;
+        const IndexType extent, shift;
+    };
+
+    /**
+     * Detection windows stored as structure of arrays. clear() keeps the
+     * allocated storage, so once the buffer has grown to the largest number
+     * of candidates in an image no further allocation takes place.
+     *
+     * Iterators return DetectInfo by value, so code written for a container
+     * of DetectInfo (s->score, *s) reads the buffer unchanged.
+     */
+    class DetectionBuffer {
+        public:
+        typedef DetectInfo                          value_type;
+        typedef DetectInfo::IndexType               IndexType;
+
+        class const_iterator {// {{{
+            public:
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef DetectInfo                      value_type;
+            typedef std::ptrdiff_t                  difference_type;
+            typedef const DetectInfo*               pointer;
+            typedef DetectInfo                      reference;
+
+            /// holds the value for operator->
+            struct Arrow {
+                Arrow(const DetectInfo& d) : d(d) {}
+                const DetectInfo* operator->() const { return &d; }
+                const DetectInfo d;
+            };
+
+            const_iterator() : b(NULL), i(0) {}
+            const_iterator(const DetectionBuffer* b, const int i) : b(b), i(i) {}
+
+            DetectInfo operator*() const { return (*b)[i]; }
+            Arrow operator->() const { return Arrow((*b)[i]); }
+            DetectInfo operator[](const difference_type n) const
+            { return (*b)[i+n]; }
+
+            const_iterator& operator++() { ++i; return *this; }
+            const_iterator& operator--() { --i; return *this; }
+            const_iterator operator++(int) { const_iterator t(*this); ++i; return t; }
+            const_iterator operator--(int) { const_iterator t(*this); --i; return t; }
+            const_iterator& operator+=(const difference_type n) { i+=n; return *this; }
+            const_iterator& operator-=(const difference_type n) { i-=n; return *this; }
+            const_iterator operator+(const difference_type n) const
+            { return const_iterator(b,i+n); }
+            const_iterator operator-(const difference_type n) const
+            { return const_iterator(b,i-n); }
+            difference_type operator-(const const_iterator& o) const { return i-o.i; }
+
+            bool operator==(const const_iterator& o) const { return i==o.i; }
+            bool operator!=(const const_iterator& o) const { return i!=o.i; }
+            bool operator< (const const_iterator& o) const { return i< o.i; }
+            bool operator> (const const_iterator& o) const { return i> o.i; }
+            bool operator<=(const const_iterator& o) const { return i<=o.i; }
+            bool operator>=(const const_iterator& o) const { return i>=o.i; }
+
+            private:
+            const DetectionBuffer* b;
+            int i;
+        };// }}}
+
+        DetectionBuffer() : size_(0) {}
+
+        int size() const { return size_; }
+        bool empty() const { return !size_; }
+        /// forget content, keep storage
+        void clear() { size_ = 0; }
+        void reserve(const int n) { if (n > capacity()) grow(n); }
+
+        void push_back(const DetectInfo& r) {
+            const int i = append(1);
+            score_[i] = r.score; scale_[i] = r.scale;
+            for (int d= 0; d< 2; ++d) {
+                lbound_[d][i] = r.lbound[d];
+                extent_[d][i] = r.extent[d];
+                orig_[d][i] = r.orig_lbound[d];
+            }
+        }
+
+        /// append windows index[0..n) of b
+        void push_back(const ScoreBatch& b, const int* index, const int n)
+        {// {{{
+            if (!n) return;
+            const int o = append(n);
+            for (int k= 0; k< n; ++k) {
+                score_[o+k] = b.score[index[k]];
+                scale_[o+k] = b.scale;
+            }
+            // window size is shared by the whole batch, see ScoreBatch
+            for (int d= 0; d< 2; ++d) {
+                const int* at = d ? b.y : b.x;
+                const float s = b.extent[d]*b.scale;
+                const int half = b.extent[d]/2;
+                const int ext = static_cast<int>(std::floor(s));
+                for (int k= 0; k< n; ++k) {
+                    const int p = at[index[k]];
+                    lbound_[d][o+k] = static_cast<int>(
+                            std::ceil(b.scale*(p+half) - s/2)) - b.shift[d];
+                    extent_[d][o+k] = ext;
+                    orig_[d][o+k] = p;
+                }
+            }
+        }// }}}
+
+        DetectInfo operator[](const int i) const {
+            DetectInfo r(score_[i], scale_[i],
+                IndexType(lbound_[0][i], lbound_[1][i]),
+                IndexType(extent_[0][i], extent_[1][i]),
+                IndexType(orig_[0][i], orig_[1][i]));
+            return r;
+        }
+
+        const_iterator begin() const { return const_iterator(this,0); }
+        const_iterator end() const { return const_iterator(this,size_); }
+
+        /// raw arrays, valid for [0,size())
+        const float* score() const { return size_ ? &score_[0] : NULL; }
+        const float* scale() const { return size_ ? &scale_[0] : NULL; }
+        const int* lbound(const int d) const
+        { return size_ ? &lbound_[d][0] : NULL; }
+        const int* extent(const int d) const
+        { return size_ ? &extent_[d][0] : NULL; }
+
+        void swap(DetectionBuffer& o) {
+            score_.swap(o.score_); scale_.swap(o.scale_);
+            for (int d= 0; d< 2; ++d) {
+                lbound_[d].swap(o.lbound_[d]);
+                extent_[d].swap(o.extent_[d]);
+                orig_[d].swap(o.orig_[d]);
+            }
+            std::swap(size_, o.size_);
+        }
+
+        private:
+        int capacity() const { return score_.size(); }
+
+        void grow(const int n) {
+            score_.resize(n); scale_.resize(n);
+            for (int d= 0; d< 2; ++d) {
+                lbound_[d].resize(n); extent_[d].resize(n); orig_[d].resize(n);
+            }
+        }
+        /// make room for n more windows, returns index of the first one
+        int append(const int n) {
+            if (size_+n > capacity())
+                grow(std::max(size_+n, 2*capacity()));
+            const int i = size_;
+            size_ += n;
+            return i;
+        }
+
+        std::vector<float> score_, scale_;
+        std::vector<int> lbound_[2], extent_[2], orig_[2];
+        int size_;
+    };
+}
+#endif // _LEAR_DETECTION_BUFFER_H_
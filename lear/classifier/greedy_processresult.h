@@ -0,0 +1,49 @@
+#ifndef _LEAR_GREEDY_PROCESS_RESULT_H_
+#define _LEAR_GREEDY_PROCESS_RESULT_H_
+
+#include <list>
+#include <vector>
+#include <string>
+#include <blitz/tinyvec.h>
+#include <lear/classifier/th_processresult.h>
+
+namespace lear {
+
+/**
+ * Greedy overlap non-maximum suppression.
+ *
+ * Windows above threshold_ are visited by decreasing score, and a window
+ * is kept unless its overlap (intersection over union) with an already
+ * kept window exceeds overlap_. Kept windows are indexed in a uniform grid
+ * whose cells are as large as the smallest window, so each window is only
+ * compared with kept windows sharing a cell. Total cost is O(N log N) in
+ * the number of windows above threshold_.
+ *
+ * Kept windows with score above finalthreshold_ are the detections. Their
+ * score is the classifier score.
+ */
+struct Greedy_ProcessResult : public Th_ProcessResult {
+    typedef Th_ProcessResult                    Parent;
+
+    typedef Parent::RealType                    RealType;
+    typedef Parent::DetectionWin                DetectionWin;
+    typedef DetectionWin::const_iterator        const_iterator;
+
+    Greedy_ProcessResult(
+        const RealType threshold_,
+        const RealType finalthreshold_,
+        const RealType overlap_ = 0.5);
+
+    /** Do non-maximum suppression on the detection results */
+    virtual void doit();
+    virtual std::string toString();
+
+    /// intersection over union of the windows of a and b
+    static RealType overlap(const DetectInfo& a, const DetectInfo& b);
+
+    protected:
+        const RealType finalthreshold_;
+        const RealType overlap_;
+};
+}
+#endif // _LEAR_GREEDY_PROCESS_RESULT_H_
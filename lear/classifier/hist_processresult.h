@@ -24,6 +24,10 @@ struct Hist_ProcessResult : public Th_ProcessResult, public HistProcessor {
             HistProcessor::operator()(r.score);
             return Parent::operator()(r);
         }
+        virtual void operator()(const ScoreBatch& b) {
+            HistProcessor::operator()(b.score, b.size);
+            Parent::operator()(b);
+        }
         virtual std::string toString() { 
             return "Histogram Process Result";
         }
@@ -16,6 +16,8 @@ struct HistProcessor {
             return histall_.data();
         }
         virtual void operator()(const RealType r);
+        /// n scores at once
+        virtual void operator()(const RealType* r, const int n);
         virtual std::string toString() { 
             return "Histogram Processor";
         }
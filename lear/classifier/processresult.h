@@ -1,25 +1,48 @@
 #ifndef _LEAR_PROCESS_RESULT_H_
 #define _LEAR_PROCESS_RESULT_H_
 
-#include <list>
+#include <string>
 #include <lear/classifier/detectinfo.h>
+#include <lear/classifier/detectionbuffer.h>
 
 namespace lear {
 
     struct ProcessResult {
         typedef float                               RealType;
-        typedef std::list<DetectInfo>               DetectionWin;
+        typedef DetectionBuffer                     DetectionWin;
         typedef DetectionWin::const_iterator        const_iterator;
 
         ProcessResult(): numdetection_(0){}
         virtual ~ProcessResult() {}
 
+        /**
+         * Called before the windows of each scale level are passed in. The
+         * level has extent windows with top-left corners on a regular
+         * lattice starting at topleft (level coordinates), and detections
+         * are moved by -shift in image coordinates (e.g. an added margin).
+         * Only processors working on the window lattice need it.
+         */
+        virtual void newpyramid(
+                const DetectInfo::IndexType /*topleft*/,
+                const DetectInfo::IndexType /*extent*/,
+                const RealType /*scale*/,
+                const DetectInfo::IndexType /*shift*/) {}
+
         virtual void doit(){}
         virtual void clear(){ numdetection_ = 0; detect_.clear(); }
         virtual bool operator()(const DetectInfo& r){
             ++numdetection_; detect_.push_back(r);
             return true;
         }
+        /**
+         * Windows of a row or a level in one call. The default passes them
+         * one by one to operator()(DetectInfo); processors override it to
+         * work on the score array directly.
+         */
+        virtual void operator()(const ScoreBatch& b){
+            for (int i= 0; i< b.size; ++i)
+                (*this)(b[i]);
+        }
 
         DetectionWin::const_iterator begin() const {
             return detect_.begin();
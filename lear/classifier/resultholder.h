@@ -5,6 +5,7 @@
 #include <lear/classifier/detectinfo.h>
 #include <lear/classifier/processresult.h>
 #include <lear/classifier/ppresult.h>
+#include <lear/classifier/asyncwriter.h>
 
 namespace lear {
 class ResultHolder {
@@ -13,7 +14,7 @@ class ResultHolder {
         typedef std::list<PostProcessResult*>       PostProcessCont;
         typedef std::list<PostProcessCont>          ContCont;
 
-        ResultHolder(){}
+        ResultHolder() : writer_(NULL) {}
         ~ResultHolder();
 
         void push_back(ProcessResult* toadd) {
@@ -37,12 +38,30 @@ class ResultHolder {
          * write detection results.
          */
         void clear();
+        /// Passed on to each ProcessResult, see ProcessResult::newpyramid
+        void newpyramid(
+                const DetectInfo::IndexType topleft,
+                const DetectInfo::IndexType extent,
+                const ProcessResult::RealType scale,
+                const DetectInfo::IndexType shift);
         bool operator()(const DetectInfo& r);
+        /// Passes a row or a level of windows to each ProcessResult
+        void operator()(const ScoreBatch& b);
         void write(const std::string filename="");
 
+        /**
+         * Run post-processors on numthread background threads, at most
+         * maxpending writes waiting (see AsyncWriter). 0 threads writes on
+         * the calling thread, which is the default.
+         */
+        void async(const int numthread, const int maxpending=0);
+        /// Wait for background writes, rethrows their first error
+        void flush();
+
     protected:
         ProcessCont     processcont_;
         ContCont        postcont_;
+        AsyncWriter*    writer_;
 };
 }
 #endif // _LEAR_RESULT_HOLDER_H_
@@ -23,6 +23,12 @@ struct ScoreList_ProcessResult : public Th_ProcessResult {
             to << r.score << std::endl;
             return Parent::operator()(r);
         }
+        virtual void operator()(const ScoreBatch& b){
+            for (int i= 0; i< b.size; ++i)
+                to << b.score[i] << '\n';
+            to.flush();
+            Parent::operator()(b);
+        }
         virtual std::string toString() { 
             return "Score List Process Result";
         }
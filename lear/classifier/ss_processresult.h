@@ -1,13 +1,36 @@
-#ifndef _LEAR_MS_PROCESS_RESULT_H_
-#define _LEAR_MS_PROCESS_RESULT_H_
+#ifndef _LEAR_SS_PROCESS_RESULT_H_
+#define _LEAR_SS_PROCESS_RESULT_H_
 
 #include <list>
+#include <vector>
+#include <string>
+#include <blitz/array.h>
 #include <blitz/tinyvec.h>
 #include <lear/classifier/processresult.h>
 #include <lear/cvision/transfunc.h>
 
 namespace lear {
 
+    /**
+     * Non-maximum suppression on dense score maps in scale space.
+     *
+     * Windows of each pyramid level lie on a regular lattice, so their
+     * weights (scores above threshold passed through the transfer
+     * function) are stored in one ScoreImage per level, announced with
+     * newpyramid(). doit() smooths the maps with the same Gaussian as
+     * MS_ProcessResult: separably along x and y within each level (sigma is
+     * constant in lattice cells at every scale) and then along scale, by
+     * sampling the other levels at the same image position, weighted by
+     * the distance of their log scales (levels need not be evenly spaced,
+     * some may be missing). Local maxima
+     * of the smoothed scale space, refined to sub-cell precision with
+     * InterpolatePosition, are the detections.
+     *
+     * The cost is linear in the number of windows, whatever the number of
+     * windows above threshold. Scores are normalized as the mean shift
+     * density so that finalthreshold_ has the same meaning for both.
+     * Windows passed before newpyramid() is called are ignored.
+     */
     struct SS_ProcessResult : public ProcessResult {
         typedef ProcessResult                       Parent;
         typedef Parent::RealType                    RealType;
@@ -29,6 +52,12 @@ namespace lear {
         typedef std::vector<RealType>               ScaleSpaceRealType;
 
 
+        /**
+         * extent_ is the window size, stride_ the window stride and
+         * winsize_ the radius (in lattice cells) of the neighbourhood in
+         * which a detection must be the maximum. Other arguments are as
+         * for MS_ProcessResult.
+         */
         SS_ProcessResult(
             const IndexType extent_,
             const RealType threshold_,
@@ -36,40 +65,54 @@ namespace lear {
             const SigmoidType score2prob_,
             const Real3DType sigma_,
             const int transfunc,
-            const IndexType stride_, 
+            const IndexType stride_,
             const int winsize_=1);
 
         ~SS_ProcessResult();
 
-        void newpyramid(
+        virtual void newpyramid(
                 const IndexType topleft,
                 const IndexType extent,
-                const RealType scale) ;
+                const RealType scale,
+                const IndexType shift) ;
 
         /** Do non-maximum suppression on the detection results */
         virtual void clear();
         virtual void doit();
         virtual bool operator()(const DetectInfo& r);
+        virtual void operator()(const ScoreBatch& b);
 
-
-        virtual std::string toString() { 
+        virtual std::string toString() {
             return std::string("Scale-Space NonMax Process Result\n    ")
                 + sigmoid->toString();
         }
 
         protected:
+            /// store score of window at level position (x,y)
+            bool put(const RealType score, const int x, const int y);
+
+            /// bilinear sample of level scaleindex at image position xy
             RealType toscore(
                     const ScaleSpaceType& pyimage,
                     const Real2DType xy, const unsigned scaleindex) const ;
             RealType toscore(
-                    const Real2DType xy, const unsigned scaleindex) const 
+                    const Real2DType xy, const unsigned scaleindex) const
             {
                 return toscore(pyimage,xy,scaleindex);
             }
 
-            // get image x-y coordinates
+            /**
+             * bilinear sample at image position xy and log scale t, linear
+             * in log scale between the two levels around t, 0 outside the
+             * levels. Needs the level order of doit().
+             */
+            RealType atlogscale(
+                    const ScaleSpaceType& pyimage,
+                    const Real2DType xy, const RealType t) const ;
+
+            /// image x-y coordinates of window center at lattice position lb
             Real2DType toxy(
-                    const IndexType lb,
+                    const Real2DType lb,
                     const unsigned scaleindex) const ;
 
             const IndexType extent_;
@@ -78,7 +121,7 @@ namespace lear {
             const IndexType stride_;
             const int winsize_;
 
-            const Array1DType smoothkernelX, smoothkernelY, smoothkernelS;
+            const Array1DType smoothkernelX, smoothkernelY;
 
             IndexType topleft;
             ScoreImage* image;
@@ -86,7 +129,11 @@ namespace lear {
 
             ScaleSpaceType pyimage;
             ScaleSpaceRealType pyscale;
-            ScaleSpaceIndexType pytopleft, pyextent;
+            ScaleSpaceIndexType pytopleft, pyextent, pyshift;
+            /// log of pyscale, levels in order of scale and the rank of
+            /// each level in that order, set in doit()
+            ScaleSpaceRealType pylogscale;
+            std::vector<int> pyorder, pyrank;
     };
 }
-#endif // _LEAR_MS_PROCESS_RESULT_H_
+#endif // _LEAR_SS_PROCESS_RESULT_H_
@@ -1,7 +1,7 @@
 #ifndef _LEAR_TH_PROCESS_RESULT_H_
 #define _LEAR_TH_PROCESS_RESULT_H_
 
-#include <list>
+#include <vector>
 #include <blitz/tinyvec.h>
 #include <lear/classifier/processresult.h>
 
@@ -34,6 +34,26 @@ namespace lear {
             }
             return false;
         }
+        /// select windows on the score array, then store them in one go
+        virtual void operator()(const ScoreBatch& b){
+            totwindow_ += b.size;
+            if (static_cast<int>(selected_.size()) < b.size)
+                selected_.resize(b.size);
+
+            int* sel = b.size ? &selected_[0] : NULL;
+            int n = 0;
+            if (label_) {
+                for (int i= 0; i< b.size; ++i) {
+                    sel[n] = i; n += b.score[i] > threshold_;
+                }
+            } else {
+                for (int i= 0; i< b.size; ++i) {
+                    sel[n] = i; n += b.score[i] < threshold_;
+                }
+            }
+            numdetection_ += n;
+            detect_.push_back(b, sel, n);
+        }
         virtual std::string toString() { 
             return "Threshold Process Result";
         }
@@ -43,6 +63,9 @@ namespace lear {
             const RealType threshold_;
 
             const int label_;
+
+            /// indices of selected windows of the current batch
+            std::vector<int> selected_;
     };
 }
 #endif // _LEAR_TH_PROCESS_RESULT_H_
@@ -0,0 +1,287 @@
+#ifndef _LEAR_BLOCK_MAP_H_
+#define _LEAR_BLOCK_MAP_H_
+
+#include <vector>
+#include <algorithm>
+
+#include <blitz/tinyvec.h>
+
+#include <lear/cvision/rhogdense.h>
+#include <lear/cvision/halffloat.h>
+
+namespace lear {
+
+/// v*scale rounded to the nearest integer in [0,255]
+inline unsigned char quantize8(const double v, const double scale) {
+    const double q = v*scale + 0.5;
+    return q <= 0 ? 0 : (q >= 255 ? 255 : static_cast<unsigned char>(q));
+}
+
+/**
+ * Dense buffer of normalized RHOGDense blocks over one pyramid level.
+ *
+ * Blocks are computed at every point origin + k*stride that fits inside the
+ * preprocessed image. They are stored x-major, like pixels in the image
+ * arrays, so the blocks along one image column are adjacent in memory. All
+ * blocks of a level are normalized with a single batch call of the
+ * descriptor normalizer.
+ *
+ * The buffer keeps its memory between levels, so after the first (largest)
+ * level no further allocation takes place.
+ *
+ * After quantize(scale) each compute also keeps the blocks quantized to 8
+ * bits (quantize8), a quarter of the memory read per window for integer
+ * scoring.
+ *
+ * After halfprecision(true) blocks are kept as float16 (halffloat.h), half
+ * the memory of float blocks. They are computed and normalized one lattice
+ * row at a time in float, and read back to float with read().
+ *
+ * After cellgrid(true) blocks are assembled from shared cells instead of
+ * being voted one by one (see RHOGDense::cells). If the lattice stride
+ * divides the cell size, each of the (cellsize/stride)^2 phase offsets of
+ * the lattice has its own grid of cells, voted once per level: a half-cell
+ * stride costs 4 cell passes however many blocks overlap. Otherwise each
+ * block is assembled from its own cells (RHOGDense::cellblock), which
+ * gives the same values. Blocks are not Gaussian weighted and only
+ * approximate the voted ones.
+ *
+ * prepare() sets the lattice up without computing anything, and fill()
+ * then computes only the blocks of the windows that are actually scored,
+ * normalized in one batch per call. The lattice can also span a whole level
+ * of which each fill only sees a part, so that blocks computed from one
+ * part are kept for the next (see the second prepare).
+ */
+class BlockMap {
+    public:
+        typedef RHOGDense::ElemType                 ElemType;
+        typedef blitz::TinyVector<int,2>            IndexType;
+
+        BlockMap() :
+            featsize_(0), origin_(0), stride_(1), extent_(0), area_(0), 
+            shift_(0), lazy_(false),
+            half_(false), cellgrid_(false), usecells_(false), phases_(1), 
+            qscale_(0)
+        {}
+
+        /// Computes all blocks of desc over preprocessed level p.
+        void compute(
+                const RHOGDense& desc,
+                const RHOGDense::Preprocessor& p,
+                const IndexType origin,
+                const IndexType stride);
+
+        /**
+         * Sets the lattice up as compute() does, without computing any
+         * block. Blocks are then computed on demand by fill().
+         */
+        void prepare(
+                const RHOGDense& desc,
+                const RHOGDense::Preprocessor& p,
+                const IndexType origin,
+                const IndexType stride);
+
+        /**
+         * Same as above for a lattice over an area of the given pixel
+         * extent, of which the preprocessed images given to fill() are the
+         * part at shift. Block positions are area positions. Blocks computed
+         * on the same lattice since it was last set up are kept, unless
+         * dropped or the buffer was cleared.
+         */
+        void prepare(
+                const RHOGDense& desc,
+                const IndexType origin,
+                const IndexType stride,
+                const IndexType area,
+                const IndexType shift);
+
+        /**
+         * Computes and normalizes those of the count blocks with top-left
+         * corners at loc that lie on the lattice and are not computed yet.
+         * Does nothing after compute(), which computes all blocks.
+         */
+        void fill(
+                const RHOGDense& desc,
+                const RHOGDense::Preprocessor& p,
+                const IndexType* loc,
+                const int count);
+
+        /**
+         * Keeps the blocks quantized with scale from now on, including the
+         * current ones. 0 stops it.
+         */
+        void quantize(const ElemType scale);
+
+        /**
+         * Keeps the blocks of the following computes as float16 if on. The
+         * buffer is invalidated when the setting changes.
+         */
+        void halfprecision(const bool on) {
+            if (on != half_)
+                clear();
+            half_ = on;
+        }
+        bool halfprecision() const { return half_; }
+
+        /**
+         * Assembles the blocks of the following computes from phase cell
+         * grids if on, see above. The buffer is invalidated when the
+         * setting changes.
+         */
+        void cellgrid(const bool on) {
+            if (on != cellgrid_)
+                clear();
+            cellgrid_ = on;
+        }
+        bool cellgrid() const { return cellgrid_; }
+
+        /// Invalidates the buffer. Memory is kept for the next level.
+        void clear() { extent_ = 0; filled_.clear(); }
+
+        /// marks the block at index i of the lattice as not computed, so
+        /// that the next fill() computes it again. Only after prepare().
+        void drop(const IndexType i) {
+            if (lazy_ && !filled_.empty())
+                filled_[i[0]*extent_[1] + i[1]] = 0;
+        }
+
+        bool empty() const { return extent_[0] <= 0 || extent_[1] <= 0; }
+
+        /// true if pixel loc is the top-left corner of a lattice block
+        bool onlattice(const IndexType loc) const {
+            const IndexType d (loc - origin_);
+            return d[0] >= 0 && d[1] >= 0 &&
+                d[0] % stride_[0] == 0 && d[1] % stride_[1] == 0 &&
+                d[0]/stride_[0] < extent_[0] && d[1]/stride_[1] < extent_[1];
+        }
+
+        /// true if block with top-left corner at pixel loc is in the buffer
+        bool contains(const IndexType loc) const {
+            return onlattice(loc) && (!lazy_ || filled_[index(loc)]);
+        }
+
+        /**
+         * block with top-left corner at pixel loc. loc must be contained,
+         * and blocks not kept in half precision.
+         */
+        const ElemType* operator()(const IndexType loc) const {
+            return block((loc - origin_)/stride_);
+        }
+
+        /// block at index i of the block lattice, see operator()
+        const ElemType* block(const IndexType i) const {
+            return &data_[0] + offset(i);
+        }
+
+        /**
+         * Copies the block with top-left corner at pixel loc to dest, in
+         * either precision, and returns dest + featsize(). loc must be
+         * contained.
+         */
+        ElemType* read(const IndexType loc, ElemType* dest) const {
+            const int k = offset((loc - origin_)/stride_);
+            if (half_)
+                half2float(&hdata_[0] + k, dest, featsize_);
+            else
+                std::copy(&data_[0] + k, &data_[0] + k + featsize_, dest);
+            return dest + featsize_;
+        }
+
+        /// quantized block with top-left corner at pixel loc, see quantize.
+        /// loc must be contained.
+        const unsigned char* quantized(const IndexType loc) const {
+            return &qdata_[0] + offset((loc - origin_)/stride_);
+        }
+        /// scale of the quantized blocks, 0 if they are not kept
+        ElemType quantization() const { return qscale_; }
+
+        /// number of blocks along each axis
+        IndexType extent() const { return extent_; }
+        IndexType origin() const { return origin_; }
+        IndexType stride() const { return stride_; }
+        int featsize() const { return featsize_; }
+
+    protected:
+        /// length of each block
+        int featsize_;
+
+        /// pixel position of first block and block lattice spacing
+        IndexType origin_, stride_;
+
+        /// number of blocks along each axis
+        IndexType extent_;
+
+        /// pixel extent the lattice was set up over, and position of the
+        /// preprocessed image in it, see prepare()
+        IndexType area_, shift_;
+
+        /// blocks computed on demand, see prepare(), and which of them are
+        std::vector<char> filled_;
+        bool lazy_;
+        /// lattice indices and unnormalized blocks of one fill()
+        std::vector<int> pending_;
+        std::vector<ElemType> scratch_;
+
+        /// float blocks, or one lattice row of them if half_
+        std::vector<ElemType> data_;
+
+        /// float16 blocks if half_, same layout as float blocks
+        bool half_;
+        std::vector<HalfType> hdata_;
+
+        /// cell grid setting, and whether the current blocks used it
+        bool cellgrid_, usecells_;
+        /// number of phase offsets along each axis
+        IndexType phases_;
+        /// cells of all phases; grid k = a*phases_[1] + b of cellcount_[k]
+        /// cells starts at celloffset_[k]
+        std::vector<ElemType> cells_;
+        std::vector<IndexType> cellcount_;
+        std::vector<int> celloffset_;
+
+        /// blocks quantized with qscale_, same layout as float blocks
+        ElemType qscale_;
+        std::vector<unsigned char> qdata_;
+
+        /// offset of the block at index i of the block lattice
+        int offset(const IndexType i) const {
+            return (i[0]*extent_[1] + i[1])*featsize_;
+        }
+        /// lattice index, x outer, of the block with top-left corner loc
+        int index(const IndexType loc) const {
+            const IndexType i ((loc - origin_)/stride_);
+            return i[0]*extent_[1] + i[1];
+        }
+        /// sets featsize_, origin_, stride_, extent_ and area_ for a lattice
+        /// over area, false if no block fits
+        bool lattice(
+                const RHOGDense& desc,
+                const IndexType area,
+                const IndexType origin,
+                const IndexType stride);
+        /// unnormalized block with top-left corner at pixel loc
+        void single(
+                const RHOGDense& desc,
+                const RHOGDense::Preprocessor& p,
+                const IndexType loc,
+                ElemType* dest) const;
+
+        /// fills the phase cell grids, false if the stride does not allow it
+        bool buildcells(
+                const RHOGDense& desc,
+                const RHOGDense::Preprocessor& p);
+        /// unnormalized blocks of lattice row i
+        void fillrow(
+                const RHOGDense& desc,
+                const RHOGDense::Preprocessor& p,
+                const int i,
+                ElemType* dest) const;
+        void computehalf(
+                const RHOGDense& desc,
+                const RHOGDense::Preprocessor& p);
+        void fillquantized();
+};
+
+}
+
+#endif // _LEAR_BLOCK_MAP_H_
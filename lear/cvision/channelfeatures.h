@@ -0,0 +1,96 @@
+#ifndef _LEAR_CHANNEL_FEATURES_H_
+#define _LEAR_CHANNEL_FEATURES_H_
+
+#include <vector>
+#include <iostream>
+
+#include <blitz/array.h>
+#include <blitz/tinyvec.h>
+
+#include <lear/cvision/iprocessor.h>
+
+namespace lear {
+
+/**
+ * Integral images of the feature channels of one image, for detectors that
+ * read rectangle sums instead of histograms (see StumpCascade).
+ *
+ * Channels are, in this order: the gradient magnitude, orientbin channels
+ * holding the magnitude of the pixels whose orientation (0-180 degrees)
+ * falls in each bin, and if luv is set the L, u and v channels of the
+ * image. Gradients come from the same front end as RHOGDense, a
+ * GradProcessor with ChannelMax over the color channels (no smoothing if
+ * gscale is 0). LUV is read from a ColorTable of RGB2LuvFunctor shared by
+ * all objects; gray images are converted as equal R, G and B.
+ *
+ * Integral images are stored x-major, like pixels in the image arrays,
+ * with a zero first row and column, one channel after the other. They keep
+ * their memory between images, so after the first (largest) pyramid level
+ * no further allocation takes place.
+ */
+class ChannelFeatures {
+    public:
+        typedef IProcessor::RealType                RealType;
+        typedef IProcessor::IndexType               IndexType;
+        typedef IProcessor::GrayImage               GrayImage;
+        typedef IProcessor::RGBImage                RGBImage;
+        /// integral image element, double keeps sums of large images exact
+        typedef double                              SumType;
+
+        ChannelFeatures(const int orientbin = 6, const bool luv = true,
+                const RealType gscale = 0);
+        ~ChannelFeatures();
+
+        void compute(const GrayImage& image);
+        void compute(const RGBImage& image);
+
+        int channels() const { return 1 + orientbin_ + (luv_ ? 3 : 0); }
+        int orientbin() const { return orientbin_; }
+        bool luv() const { return luv_; }
+        RealType gscale() const { return gscale_; }
+
+        /// extent of the last image
+        IndexType extent() const { return extent_; }
+
+        /// sum of channel c over the rectangle of extent e with top-left tl,
+        /// which must lie inside extent()
+        SumType sum(const int c, const IndexType tl, const IndexType e) const {
+            const SumType* s = &integral_[0] + c*size_;
+            const int h = extent_[1] + 1;
+            const int x0 = tl[0]*h, x1 = (tl[0] + e[0])*h;
+            const int y0 = tl[1], y1 = tl[1] + e[1];
+            return s[x1 + y1] - s[x0 + y1] - s[x1 + y0] + s[x0 + y0];
+        }
+
+        /// mean of channel c over the rectangle, see sum
+        RealType mean(const int c, const IndexType tl, const IndexType e) const {
+            return sum(c, tl, e)/(e[0]*e[1]);
+        }
+
+        void print(std::ostream& o) const ;
+
+    private:
+        ChannelFeatures(const ChannelFeatures&);
+        ChannelFeatures& operator=(const ChannelFeatures&);
+
+        /// builds the integral images from the gradient of image, and
+        /// color if given
+        void integrate(const IProcessor::InfoType& grad, const RGBImage* color);
+
+        const int           orientbin_;
+        const bool          luv_;
+        const RealType      gscale_;
+
+        IProcessor*         processor_;
+
+        IndexType           extent_;
+        /// elements of one integral image
+        int                 size_;
+        std::vector<SumType> integral_;
+};
+
+std::ostream& operator<<(std::ostream& o, const ChannelFeatures& f);
+
+}
+
+#endif // _LEAR_CHANNEL_FEATURES_H_
@@ -8,6 +8,53 @@
 
 namespace lear {
 
+namespace detail {// {{{
+/**
+ * Kernels used by the batch normalizers. They work on raw contiguous memory
+ * and keep several partial sums so that the loops carry no serial
+ * dependency and can be vectorized by the compiler. Sums are accumulated in
+ * double precision, as blitz::sum does for float arrays.
+ */
+template<class RealType>
+inline double blocksum(const RealType* v, const int n) {
+    double s0=0, s1=0, s2=0, s3=0;
+    int i= 0;
+    for (; i+4<= n; i+=4) {
+        s0 += v[i]; s1 += v[i+1]; s2 += v[i+2]; s3 += v[i+3];
+    }
+    for (; i< n; ++i) 
+        s0 += v[i];
+    return (s0+s1)+(s2+s3);
+}
+template<class RealType>
+inline double blocksumsq(const RealType* v, const int n) {
+    double s0=0, s1=0, s2=0, s3=0;
+    int i= 0;
+    for (; i+4<= n; i+=4) {
+        s0 += v[i]*v[i];     s1 += v[i+1]*v[i+1]; 
+        s2 += v[i+2]*v[i+2]; s3 += v[i+3]*v[i+3];
+    }
+    for (; i< n; ++i) 
+        s0 += v[i]*v[i];
+    return (s0+s1)+(s2+s3);
+}
+template<class RealType>
+inline void blockscale(RealType* v, const int n, const RealType f) {
+    for (int i= 0; i< n; ++i) 
+        v[i] *= f;
+}
+template<class RealType>
+inline void blockclip(RealType* v, const int n, const RealType maxval) {
+    for (int i= 0; i< n; ++i) 
+        v[i] = v[i] > maxval ? maxval : v[i];
+}
+template<class RealType>
+inline void blocksqrt(RealType* v, const int n) {
+    for (int i= 0; i< n; ++i) 
+        v[i] = std::sqrt(v[i]);
+}
+}// }}}
+
 template<class RealType_>
 class DescNormalizer {// {{{
     enum {Method = 0};
@@ -24,6 +71,15 @@ class DescNormalizer {// {{{
         Array1DType t(vec.data(),shape(vec.size()),neverDeleteData);
         doit(t);
     }
+    /**
+     * Normalizes 'count' blocks of 'length' elements each, stored back to
+     * back in 'data'. Gives the same result as calling the operator above
+     * on every block (up to float rounding), but a whole buffer of blocks is
+     * handled in one call with tight loops over contiguous memory.
+     */
+    void operator()(RealType* data, const int count, const int length) const {
+        batch(data, count, length);
+    }
     virtual const char* toString() const {
         return "'NONE'";
     }
@@ -40,6 +96,15 @@ class DescNormalizer {// {{{
     protected:
     // Does nothing
     virtual void doit(Array1DType&) const {}
+
+    /// Default falls back to per block normalization
+    virtual void batch(RealType* data, const int count, const int length) const {
+        using namespace blitz;
+        for (int i= 0; i< count; ++i, data+=length) {
+            Array1DType t(data,shape(length),neverDeleteData);
+            doit(t);
+        }
+    }
 };// }}}
 
 template<class RealType_>
@@ -74,6 +139,13 @@ class L1Normalizer : public DescNormalizer<RealType_> {// {{{
         const RealType norm = blitz::sum(vec) + epsilon*vec.size();
         vec /= norm;
     }
+    virtual void batch(RealType* data, const int count, const int length) const {
+        const double eps = epsilon*length;
+        for (RealType* b = data; b != data + count*length; b+=length) {
+            const RealType norm = detail::blocksum(b,length) + eps;
+            detail::blockscale(b, length, 1/norm);
+        }
+    }
     /// add small epsilon to make normalization process stable
     RealType epsilon;
 };// }}}
@@ -106,6 +178,13 @@ class L2Normalizer : public L1Normalizer<RealType_>{// {{{
             Parent::epsilon*vec.size();
         vec /= norm;
     }
+    virtual void batch(RealType* data, const int count, const int length) const {
+        const double eps = Parent::epsilon*length;
+        for (RealType* b = data; b != data + count*length; b+=length) {
+            const RealType norm = std::sqrt(detail::blocksumsq(b,length)) + eps;
+            detail::blockscale(b, length, 1/norm);
+        }
+    }
 };// }}}
 
 template<class RealType_>
@@ -144,6 +223,14 @@ class L2HysNormalizer : public L2Normalizer<RealType_>{// {{{
         RealType norm = std::sqrt(sum(vec*vec)) + epsilon2;
         vec /= norm;
     }
+    virtual void batch(RealType* data, const int count, const int length) const {
+        L2Normalizer<RealType>::batch(data, count, length);
+        detail::blockclip(data, count*length, maxval);
+        for (RealType* b = data; b != data + count*length; b+=length) {
+            const RealType norm = std::sqrt(detail::blocksumsq(b,length)) + epsilon2;
+            detail::blockscale(b, length, 1/norm);
+        }
+    }
     RealType maxval, epsilon2;
 };// }}}
 
@@ -169,6 +256,10 @@ class L1SqrtNormalizer : public L1Normalizer<RealType_>{// {{{
         L1Normalizer<RealType>::doit(vec);
         vec = blitz::sqrt(vec);
     }
+    virtual void batch(RealType* data, const int count, const int length) const {
+        L1Normalizer<RealType>::batch(data, count, length);
+        detail::blocksqrt(data, count*length);
+    }
 };// }}}
 
 ///// Second set of normalizers.. These one check if norm < epsilon, if yes normalize them to set to 1.
@@ -197,6 +288,14 @@ class L1TradNormalizer : public L1Normalizer<RealType_> {// {{{
         if (norm < Parent::epsilon*vec.size()) norm = 1;
         vec /= norm;
     }
+    virtual void batch(RealType* data, const int count, const int length) const {
+        const RealType eps = Parent::epsilon*length;
+        for (RealType* b = data; b != data + count*length; b+=length) {
+            RealType norm = detail::blocksum(b,length);
+            if (norm < eps) norm = 1;
+            detail::blockscale(b, length, 1/norm);
+        }
+    }
 };// }}}
 
 template<class RealType_>
@@ -221,6 +320,14 @@ class L2TradNormalizer : public L2Normalizer<RealType_>{// {{{
         if (norm < Parent::epsilon*vec.size()) norm = 1;
         vec /= norm;
     }
+    virtual void batch(RealType* data, const int count, const int length) const {
+        const RealType eps = Parent::epsilon*length;
+        for (RealType* b = data; b != data + count*length; b+=length) {
+            RealType norm = std::sqrt(detail::blocksumsq(b,length));
+            if (norm < eps) norm = 1;
+            detail::blockscale(b, length, 1/norm);
+        }
+    }
 };// }}}
 
 template<class RealType_>
@@ -252,6 +359,18 @@ class L2TradHysNormalizer : public L2HysNormalizer<RealType_>{// {{{
         if (norm < Parent::epsilon*vec.size()) norm = 1;
         vec /= norm;
     }
+    virtual void batch(RealType* data, const int count, const int length) const {
+        const RealType eps = Parent::epsilon*length;
+        for (RealType* b = data; b != data + count*length; b+=length) {
+            RealType norm = std::sqrt(detail::blocksumsq(b,length));
+            if (norm < eps) norm = 1;
+            detail::blockscale(b, length, 1/norm);
+            detail::blockclip(b, length, Parent::maxval);
+            norm = std::sqrt(detail::blocksumsq(b,length));
+            if (norm < eps) norm = 1;
+            detail::blockscale(b, length, 1/norm);
+        }
+    }
 };// }}}
 
 template<class RealType_>
@@ -276,6 +395,10 @@ class L1TradSqrtNormalizer : public L1TradNormalizer<RealType_>{// {{{
         L1TradNormalizer<RealType>::doit(vec);
         vec = blitz::sqrt(vec);
     }
+    virtual void batch(RealType* data, const int count, const int length) const {
+        L1TradNormalizer<RealType>::batch(data, count, length);
+        detail::blocksqrt(data, count*length);
+    }
 };// }}}
 
 template<class RealType_> std::ostream& 
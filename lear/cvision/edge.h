@@ -18,6 +18,7 @@
 
 #include <lear/blitz/ext/stdfuncs.h>
 #include <lear/blitz/ext/convolve.h>
+#include <lear/blitz/ext/sepconvolve.h>
 #include <lear/blitz/ext/stencilop.h>
 #include <lear/blitz/ext/numtrait.h>
 #include <lear/blitz/ext/domainiter.h>
@@ -347,7 +348,7 @@ gradientXY(
     const blitz::Array<RealType,1>& smoothKernel)
 {
     using namespace blitz;
-    return gradientXY<ConvolveExact<CPolicy_Stretch> >(signal,smoothKernel);
+    return gradientXY<ConvolveSeparable<CPolicy_Stretch> >(signal,smoothKernel);
 }
 // }}}
 // {{{ gradient
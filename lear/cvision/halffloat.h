@@ -0,0 +1,104 @@
+#ifndef _LEAR_HALF_FLOAT_H_
+#define _LEAR_HALF_FLOAT_H_
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+namespace lear {
+
+/**
+ * IEEE half precision (float16) storage for float values: 11 significant
+ * bits, largest finite value 65504. Values are only stored as halves and
+ * converted back to float for arithmetic.
+ *
+ * Conversions use the F16C instructions if the compiler targets them
+ * (-mf16c or -march), otherwise the same rounding (to nearest even) in
+ * integer code.
+ */
+typedef unsigned short HalfType;
+
+inline HalfType float2half(const float v)
+{// {{{
+#ifdef __F16C__
+    return _cvtss_sh(v, 0);
+#else
+    union { float f; unsigned u; } bits;
+    bits.f = v;
+    const unsigned a = bits.u & 0x7fffffff;
+    const HalfType sign = (bits.u >> 16) & 0x8000;
+
+    if (a > 0x7f800000)             // nan, made quiet
+        return sign | 0x7e00 | ((a >> 13) & 0x3ff);
+    if (a >= 0x477ff000)            // inf, or rounds above 65504
+        return sign | 0x7c00;
+    if (a >= 0x38800000) {          // normal half
+        const unsigned r = a - (112u << 23);
+        return sign | ((r + 0xfff + ((r >> 13) & 1)) >> 13);
+    }
+    if (a < 0x33000000)             // at most half the smallest subnormal
+        return sign;
+
+    // subnormal half: v*2^24 rounded
+    const int shift = 126 - static_cast<int>(a >> 23);
+    const unsigned m = (a & 0x7fffff) | 0x800000;
+    const unsigned rest = m & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+    unsigned h = m >> shift;
+    if (rest > halfway || (rest == halfway && (h & 1)))
+        ++h;
+    return sign | h;
+#endif
+}// }}}
+
+inline float half2float(const HalfType h)
+{// {{{
+#ifdef __F16C__
+    return _cvtsh_ss(h);
+#else
+    union { float f; unsigned u; } bits;
+    const unsigned sign = (h & 0x8000u) << 16;
+    unsigned e = (h >> 10) & 0x1f, m = h & 0x3ff;
+    if (e == 31)                    // inf, and nan made quiet
+        bits.u = sign | 0x7f800000 | (m ? 0x400000 | (m << 13) : 0);
+    else if (e)
+        bits.u = sign | ((e + 112) << 23) | (m << 13);
+    else if (!m)
+        bits.u = sign;
+    else {                          // subnormal half, normal float
+        for (e = 113; !(m & 0x400); --e)
+            m <<= 1;
+        bits.u = sign | (e << 23) | ((m & 0x3ff) << 13);
+    }
+    return bits.f;
+#endif
+}// }}}
+
+/// converts n values of src to dest
+inline void float2half(const float* src, HalfType* dest, const int n)
+{// {{{
+    int i = 0;
+#ifdef __F16C__
+    for (; i+8 <= n; i+=8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                _mm256_cvtps_ph(_mm256_loadu_ps(src + i), 0));
+#endif
+    for (; i< n; ++i)
+        dest[i] = float2half(src[i]);
+}// }}}
+
+/// converts n values of src to dest
+inline void half2float(const HalfType* src, float* dest, const int n)
+{// {{{
+    int i = 0;
+#ifdef __F16C__
+    for (; i+8 <= n; i+=8)
+        _mm256_storeu_ps(dest + i, _mm256_cvtph_ps(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+#endif
+    for (; i< n; ++i)
+        dest[i] = half2float(src[i]);
+}// }}}
+
+}
+
+#endif // _LEAR_HALF_FLOAT_H_
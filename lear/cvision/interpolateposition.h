@@ -9,6 +9,9 @@
  * =====================================================================================
  */
 
+#ifndef _LEAR_INTERPOLATE_POSITION_H_
+#define _LEAR_INTERPOLATE_POSITION_H_
+
 #include <blitz/array.h>
 #include <blitz/tinyvec.h>
 #include <blitz/tinymat.h>
@@ -21,6 +24,10 @@ namespace lear {
     /**
      * Used to compute location of maximums in N-space with floating point
      * precision.
+     *
+     * Fits a quadratic to the (2*WIN+1)^N neighbourhood of index and takes
+     * one Newton step, newpoint = index - H^-1 g. score is increased by the
+     * gain of the fit. Returns false if index is not a maximum of the fit.
      */
     template<class RealType, int N>
     struct InterpolatePosition {
@@ -81,21 +88,23 @@ namespace lear {
             ip = WIN; in = WIN; --ip[1]; ++in[1];
             hessian(2,1) = dervZ(in) - dervZ(ip);
             */
+            // CentralDerv1Order2 gives twice the derivative, so mixed
+            // terms are differences of it over two samples divided by 4
             ip = WIN; in = WIN; --ip[0]; ++in[0];
-            hessian(0,1) = hessian(1,0) = (dervY(in) - dervY(ip));
+            hessian(0,1) = hessian(1,0) = (dervY(in) - dervY(ip))/4;
 
             ip = WIN; in = WIN; --ip[2]; ++in[2];
-            hessian(0,2) = hessian(2,0) = (dervX(in) - dervX(ip));
+            hessian(0,2) = hessian(2,0) = (dervX(in) - dervX(ip))/4;
 
             ip = WIN; in = WIN; --ip[2]; ++in[2];
-            hessian(1,2) = hessian(2,1) = (dervY(in) - dervY(ip));
+            hessian(1,2) = hessian(2,1) = (dervY(in) - dervY(ip))/4;
 
             ip = WIN;// use center element
-            grad[0] = dervX(ip); grad[1] = dervY(ip); 
+            grad[0] = dervX(ip)/2; grad[1] = dervY(ip)/2; 
             ip = WIN; in = WIN; --ip[2]; ++in[2];
-            grad[2] = cropped(in) - cropped(ip);
+            grad[2] = (cropped(in) - cropped(ip))/2;
 
-            newpoint=product(numericutil::invert(hessian),grad);
+            newpoint=-numericutil::multiply(numericutil::invert(hessian),grad);
             RealType s = dot(newpoint,grad)/2;
             score +=s; newpoint+=index;
             if (s<0)
@@ -117,3 +126,4 @@ namespace lear {
     };
 }
 
+#endif // _LEAR_INTERPOLATE_POSITION_H_
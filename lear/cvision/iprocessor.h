@@ -10,6 +10,7 @@
 #include <blitz/array.h>
 #include <blitz/tinyvec.h>
 #include <lear/io/biostream.h>
+#include <lear/image/colortable.h>
 
 namespace lear {
 
@@ -22,6 +23,9 @@ namespace lear {
         typedef blitz::Array<RealType,2>        GrayImage;
         typedef blitz::Array<RGBType,2>         RGBImage;
 
+        typedef blitz::TinyVector<unsigned char,3>  RGB8Type; 
+        typedef blitz::Array<RGB8Type,2>            RGB8Image;
+
         enum {Method = 0};
 
         virtual GrayImage operator() (const GrayImage& img) const 
@@ -30,6 +34,9 @@ namespace lear {
         virtual RGBImage operator() (const RGBImage& img) const 
         { return img; }
 
+        /// Converts 8-bit image to float and remaps it in the same pass
+        virtual RGBImage operator() (const RGB8Image& img) const ;
+
         virtual const char * toString() const 
         { return "NoMap"; }
 
@@ -37,11 +44,16 @@ namespace lear {
 
         virtual ~ImageNoRemap() {}
     };// }}}
+    /**
+     * Sqrt and Log remaps use a shared ChannelTable for integral values
+     * and compute the function for others, so results are exact.
+     */
     struct ImageSqrtRemap : public ImageNoRemap {// {{{
         enum {Method = 1};
 
         virtual GrayImage operator() (const GrayImage& img) const ;
         virtual RGBImage operator() (const RGBImage& img) const ;
+        virtual RGBImage operator() (const RGB8Image& img) const ;
         virtual const char * toString() const 
         { return "Sqrt"; }
 
@@ -52,31 +64,53 @@ namespace lear {
 
         virtual GrayImage operator() (const GrayImage& img) const ;
         virtual RGBImage operator() (const RGBImage& img) const ;
+        virtual RGBImage operator() (const RGB8Image& img) const ;
 
         virtual const char * toString() const 
         { return "Log"; }
 
         virtual unsigned toMethod() const { return Method;}
     };// }}}
+    /**
+     * Lab remaps convert each pixel exactly by default. Given a lattice
+     * size, they look colors up in a ColorTable shared by all remaps with
+     * that size instead: TableNodes (65^3 nodes) takes 1.6 MB and is
+     * interpolated trilinearly, ExactNodes (256) converts every 8-bit color
+     * exactly at the cost of a 96 MB table.
+     */
     struct ImageLabRemap : public ImageNoRemap{// {{{
         enum {Method = 3};
+        enum {NoTable = 0, TableNodes = 65, ExactNodes = 256};
+
+        ImageLabRemap(const int nodes = NoTable) ;
 
         // do nothing for gray scale images
         virtual GrayImage operator() (const GrayImage& img) const 
         { return img; }
 
         virtual RGBImage operator() (const RGBImage& img) const ;
+        virtual RGBImage operator() (const RGB8Image& img) const ;
 
         virtual const char * toString() const 
         { return "Lab"; }
 
         virtual unsigned toMethod() const { return Method;}
+
+        protected:
+        ImageLabRemap(const int nodes, const bool sqrt) ;
+
+        /// shared table, not owned, NULL for the exact conversion
+        const ColorTable* table;
+        bool dosqrt;
     };// }}}
     struct ImageLabSqrtRemap : public ImageLabRemap{// {{{
         enum {Method = 4};
 
+        ImageLabSqrtRemap(const int nodes = NoTable) ;
+
         virtual GrayImage operator() (const GrayImage& img) const ;
         virtual RGBImage operator() (const RGBImage& img) const ;
+        virtual RGBImage operator() (const RGB8Image& img) const ;
 
         virtual const char * toString() const 
         { return "Lab Sqrt"; }
@@ -111,6 +145,7 @@ namespace lear {
 class IProcessor {// {{{
     protected:
         typedef blitz::Array<int,2>             OriAType_;
+        typedef blitz::Array<unsigned short,2>  FixedAType_;
     public:
         typedef float                           RealType;
         typedef blitz::TinyVector<int,2>        IndexType;
@@ -121,6 +156,7 @@ class IProcessor {// {{{
         typedef blitz::Array<RealType,2>        Array2DType;
         typedef blitz::Array<RealType,2>        GrayImage;
         typedef blitz::Array<RGBType,2>         RGBImage;
+        typedef ImageNoRemap::RGB8Image         RGB8Image;
 
 
         enum {Method=0};
@@ -130,13 +166,44 @@ class IProcessor {// {{{
             typedef Array2DType         MagAType;
             typedef RealType            MagElemType;
             typedef int                 OriElemType;
+            typedef FixedAType_         FixedAType;
 
             MagAType                    mag;
             OriAType                    ori;
             IndexType                   extent;
 
+            /**
+             * Fixed-point result of fixedpoint(), empty otherwise (mag and
+             * ori are then empty). fmag is the gradient magnitude times
+             * fscale. fori is the orientation in fbins bins, in 8.8 fixed
+             * point: the high byte is the bin whose center is just below
+             * the orientation, the low byte the weight (out of 256) of the
+             * next bin.
+             */
+            FixedAType                  fmag, fori;
+            RealType                    fscale;
+            int                         fbins;
+            /// fmag holds float16 magnitudes (halffloat.h), see tohalf()
+            bool                        fhalf;
+
             InfoType(MagAType tmag, OriAType tori) 
-                : mag(tmag), ori(tori), extent(tmag.extent()) {}
+                : mag(tmag), ori(tori), extent(tmag.extent()), 
+                fscale(0), fbins(0), fhalf(false) {}
+            InfoType(FixedAType tmag, FixedAType tori, 
+                    const RealType scale, const int bins) 
+                : extent(tmag.extent()), fmag(tmag), fori(tori), 
+                fscale(scale), fbins(bins), fhalf(false) {}
+
+            bool fixed() const { return fbins > 0 && !fhalf; }
+            bool half() const { return fhalf; }
+
+            /**
+             * Half-precision copy of a float result, 4 bytes per pixel
+             * instead of 8: magnitudes as float16 and orientations (over
+             * range degrees) in bins bins, in 8.8 fixed point as for
+             * fixed-point results. fscale is 1.
+             */
+            InfoType tohalf(const int bins, const int range) const ;
         };
 
         IProcessor(){}
@@ -145,9 +212,29 @@ class IProcessor {// {{{
         virtual InfoType operator()( const RGBImage& image) const =0;
         virtual InfoType operator()(const GrayImage& image)const =0;
 
+        /// 8-bit input. Default converts to float and processes that.
+        virtual InfoType operator()(const RGB8Image& image)const ;
+
+        /**
+         * Fixed-point gradients of an 8-bit image with the orientation
+         * range split in bins (at most 255) bins, see InfoType. Default
+         * throws, the processor has no fixed-point path.
+         */
+        virtual InfoType fixedpoint(const RGB8Image& image, const int bins) const ;
+        /// Rounds image to 8 bits and calls the above
+        InfoType fixedpoint(const RGBImage& image, const int bins) const ;
+        /// Gray image, as a color image with three equal channels
+        InfoType fixedpoint(const GrayImage& image, const int bins) const ;
+
         virtual std::string toString() const = 0;
         virtual unsigned toMethod() const = 0;
 
+        /**
+         * Identifies the output: processors with equal keys return the same
+         * InfoType for the same image, so one result can be shared.
+         */
+        virtual std::string key() const { return toString(); }
+
         virtual void print(std::ostream& o) const {
             o << toString();
         }
@@ -216,9 +303,23 @@ class GradProcessor_NoSmooth : public IPrePostProcessor
             Parent(to1d, remapBefore, remapAfter), semicirc(semicirc)
         {}
 
-        virtual InfoType operator()(const RGBImage& image) const;
+        virtual InfoType operator()(const RGBImage& image) const
+        { return remapped((*remapBefore)(image)); }
+        /// converts and remaps the 8-bit image in one pass
+        virtual InfoType operator()(const RGB8Image& image) const
+        { return remapped((*remapBefore)(image)); }
         virtual InfoType operator()(const GrayImage& image) const ;
 
+        /**
+         * int16 derivatives of the image remapped by an 8-bit table
+         * (remapBefore must be NoMap, Sqrt or Log, remapAfter NoMap), the
+         * channel of largest magnitude, and its magnitude and orientation
+         * from tables indexed by the ratio of the smaller to the larger
+         * absolute derivative.
+         */
+        virtual InfoType fixedpoint(const RGB8Image& image, const int bins) const ;
+        using Parent::fixedpoint;
+
         virtual unsigned toMethod() const { return Method; }
         virtual std::string toString() const ;
 
@@ -226,6 +327,8 @@ class GradProcessor_NoSmooth : public IPrePostProcessor
         virtual std::string name() const { 
             return "Grad (no smooth) Order 2";
         }
+        /// gradient of a color image already remapped by remapBefore
+        virtual InfoType remapped(const RGBImage& image) const;
         /// if true, angle range = 0--180
         bool semicirc;
 };// }}}
@@ -243,9 +346,16 @@ class GradProcessor : public GradProcessor_NoSmooth
             const ImageNoRemap* remapBefore=NULL, 
             const ImageNoRemap* remapAfter=NULL ); 
 
-        virtual InfoType operator()( const RGBImage& image) const ;
+        virtual InfoType operator()( const RGBImage& image) const
+        { return remapped((*remapBefore)(image)); }
+        virtual InfoType operator()(const RGB8Image& image) const
+        { return remapped((*remapBefore)(image)); }
         virtual InfoType operator()(const GrayImage& image) const ;
 
+        /// Throws, the fixed-point path does not smooth
+        virtual InfoType fixedpoint(const RGB8Image& image, const int bins) const ;
+        using Parent::fixedpoint;
+
         virtual unsigned toMethod() const {
             return Method;
         }
@@ -255,6 +365,13 @@ class GradProcessor : public GradProcessor_NoSmooth
                 << ", scale " << std::setw(3) << std::setprecision(1) << dscale;
             return s.str();
         } 
+        /// toString() rounds the scale
+        virtual std::string key() const {
+            std::ostringstream s ;
+            s   << Parent::toString() 
+                << ", scale " << std::setprecision(9) << dscale;
+            return s.str();
+        } 
         virtual void print(BiOStream& o)const{
             Parent::print(o);
             o << dscale;
@@ -263,6 +380,7 @@ class GradProcessor : public GradProcessor_NoSmooth
         virtual std::string name() const {
             return "Grad";
         }
+        virtual InfoType remapped(const RGBImage& image) const;
         /// smooth scale
         RealType dscale;
         /// 1D Gaussian kernel of specified scale
@@ -1,6 +1,7 @@
 #ifndef _LEAR_RHOG_DENSE_H_
 #define _LEAR_RHOG_DENSE_H_
 
+#include <vector>
 #include <iostream>
 #include <algorithm>
 
@@ -50,7 +51,15 @@ class RHOGDense {
      * Initializes RHOGDense descriptor.
      *
      * It owns preprocessor and normalizer pointers and ensures that they are
-     * freed.
+     * freed. weight, if given, is a precomputed Gaussian weight table of
+     * product(extent()) elements in x-major order (see weight()); otherwise
+     * the table is computed from wtscale_.
+     *
+     * If jointcirc_ is set semicirc_ is ignored: gradients vote once into
+     * 2*orientbin_ bins over 0-360, and the 0-180 histogram is obtained by
+     * adding bins 180 degree apart. Each cell then has 3*orientbin_ values,
+     * the 0-360 bins followed by the 0-180 ones, and the whole block is
+     * normalized. p must give orientations over 0-360.
      */
     RHOGDense(
             const IndexType cellsize_,
@@ -60,7 +69,9 @@ class RHOGDense {
             const RealType wtscale_,
             const bool semicirc_,
             const IProcessor* p,
-            const DescNormalizer<RealType>* n
+            const DescNormalizer<RealType>* n,
+            const RealType* weight = NULL,
+            const bool jointcirc_ = false
             );
     ~RHOGDense()
     {
@@ -72,13 +83,84 @@ class RHOGDense {
     Preprocessor preprocess(const blitz::Array<PixelType,N>& image) const 
     { return (*processor)(image); }
 
+    /**
+     * Fixed-point preprocessing, see IProcessor::fixedpoint. Blocks of the
+     * result are voted with integer arithmetic and only converted to float
+     * for the normalizer.
+     */
+    template<class PixelType>
+    Preprocessor preprocessfixed(const blitz::Array<PixelType,N>& image) const 
+    { return processor->fixedpoint(image, fixedbins()); }
+
+    /**
+     * Half-precision preprocessing, see IProcessor::InfoType::tohalf.
+     * Gradients are computed in float and stored in 4 bytes per pixel,
+     * votes are summed in float.
+     */
+    template<class PixelType>
+    Preprocessor preprocesshalf(const blitz::Array<PixelType,N>& image) const 
+    { return (*processor)(image).tohalf(fixedbins(), semicirc_ ? 180 : 360); }
+
+    /// orientation bins voted into, 2*orientbin() if jointcirc()
+    int fixedbins() const { return jointcirc_ ? 2*orientbin_ : orientbin_; }
+
     /// Only changes hist_ and tmag_ variables. Rest all remains constant.
     FeatType& operator() (const IndexType point, const Preprocessor& p) const ;
 
+    /**
+     * Computes the histogram at point without normalizing it and copies it
+     * to dest, which must hold at least length() elements. Used to fill
+     * block buffers that are then normalized in one batch.
+     */
+    void histogram(const IndexType point, const Preprocessor& p, ElemType* dest) const ;
+
+    /**
+     * Cell histograms of a grid of count cells with top-left corner at
+     * origin, for blocks assembled from shared cells (see block()). Each
+     * pixel of the image votes its magnitude into the 4 nearest cell
+     * centers and the 2 nearest orientation bins, as in a block, but
+     * without the Gaussian weight, so a cell is the same in every grid
+     * that contains it. Cells hold fixedbins() values each and are stored
+     * x-major in dest, which holds product(count)*fixedbins() elements.
+     */
+    void cells(const IndexType origin, const IndexType count, 
+            const Preprocessor& p, ElemType* dest) const ;
+
+    /**
+     * Unnormalized block whose first cell is cell of a grid of count
+     * cells computed by cells(), written to dest which holds length()
+     * elements. A pixel near the border of the block also votes into its
+     * cells from outside the block, and pixels are not weighted, so blocks
+     * only approximate those of histogram().
+     */
+    void block(const ElemType* cells, const IndexType count, 
+            const IndexType cell, ElemType* dest) const ;
+
+    /**
+     * Same block as block() on any grid of cells containing it, computed
+     * from the cells of the block alone. dest holds length() elements.
+     */
+    void cellblock(const IndexType point, const Preprocessor& p, 
+            ElemType* dest) const ;
+
+    /// normalizer applied by operator()
+    const DescNormalizer<RealType>& blocknormalizer() const { return *normalizer; }
+
+    /// image pre-processor applied by preprocess()
+    const IProcessor& imageprocessor() const { return *processor; }
+
     int size() const { return descsize_; }
     int length() const { return descsize_; }
     IndexType extent() const { return extent_; }
     IndexType stride() const { return stride_; }
+    IndexType cellsize() const { return cellsize_; }
+    IndexType numcell() const { return numcell_; }
+    int orientbin() const { return orientbin_; }
+    bool semicirc() const { return semicirc_; }
+    bool jointcirc() const { return jointcirc_; }
+
+    /// Gaussian weight applied to gradient magnitudes of a block
+    const blitz::Array<RealType,N>& weight() const { return weight_; }
 
     void print(lear::BiOStream& o) const ;
 
@@ -103,6 +185,9 @@ class RHOGDense {
     /// if true, orientation bin range is 0-180 degree range, else 0-360
     bool semicirc_;
 
+    /// if true, both 0-360 and 0-180 bins, see constructor
+    bool jointcirc_;
+
     /// image pre-processor to use
     const IProcessor*  processor;
 
@@ -124,6 +209,41 @@ class RHOGDense {
     mutable Preprocessor::MagAType tmag_;
 
     mutable HistogramType hist_;
+
+    /// jointcirc_ only: 0-360 bins of hist_ and their 0-180 folding
+    mutable FeatType joint_;
+
+    /// unnormalized histogram of the last vote, hist_ or joint_
+    FeatType& votes() const ;
+
+    /// fills hist_ with unnormalized votes of block at point
+    void vote(const IndexType point, const Preprocessor& p) const ;
+
+    /**
+     * Fixed-point votes: block pixel k votes into the 4 cells whose bins
+     * start at facc_[fcell_[4*k+c]], with weight fweight_[4*k+c] (Gaussian
+     * times spatial interpolation, scaled by fnorm_), 0 for cells outside
+     * the block. A vote is magnitude times weight shifted right by
+     * fshift_, split between two orientation bins.
+     */
+    std::vector<int> fcell_;
+    std::vector<unsigned short> fweight_;
+    RealType fnorm_;
+    int fshift_;
+    mutable std::vector<unsigned> facc_;
+
+    void initfixed() ;
+    void fixedvote(const IndexType point, const Preprocessor& p) const ;
+
+    /**
+     * Half-precision votes: as fixed-point votes, with the float weights
+     * hweight_ (Gaussian times spatial interpolation) and sums in hacc_.
+     * hrow_ holds one block row of magnitudes converted to float.
+     */
+    std::vector<RealType> hweight_;
+    mutable std::vector<RealType> hacc_, hrow_;
+
+    void halfvote(const IndexType point, const Preprocessor& p) const ;
     
 };
 
@@ -0,0 +1,113 @@
+#ifndef _LEAR_STUMP_CASCADE_H_
+#define _LEAR_STUMP_CASCADE_H_
+
+#include <limits>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <blitz/tinyvec.h>
+
+#include <lear/cvision/channelfeatures.h>
+
+namespace lear {
+
+/**
+ * Boosted decision stumps over ChannelFeatures, evaluated as a soft
+ * cascade.
+ *
+ * Each stump reads the mean of one channel over a rectangle of the window
+ * (four lookups in its integral image, whatever the size) and adds left
+ * to the score if the mean is below threshold, right otherwise. After each
+ * stump the running score is compared with its reject value and the window
+ * is dropped if it is below, so most background windows are rejected after
+ * a few stumps. train_cascade learns the stumps with real AdaBoost and sets
+ * the reject values from the partial scores of the positive windows.
+ *
+ * The model records the window size and the ChannelFeatures parameters it
+ * was trained with.
+ */
+class StumpCascade {
+    public:
+        typedef ChannelFeatures::RealType           RealType;
+        typedef ChannelFeatures::IndexType          IndexType;
+
+        struct Stump {
+            /// channel and rectangle, relative to the window top-left
+            int channel;
+            IndexType tl, extent;
+            RealType threshold, left, right;
+            /// windows whose score after this stump is below are rejected
+            RealType reject;
+
+            Stump() :
+                channel(0), tl(0), extent(1), threshold(0), left(0), right(0),
+                reject(-std::numeric_limits<RealType>::max())
+            {}
+        };
+
+        StumpCascade(const IndexType window, const int orientbin = 6,
+                const bool luv = true, const RealType gscale = 0);
+
+        /// Loads a model written by save
+        explicit StumpCascade(const std::string& filename);
+
+        void save(const std::string& filename) const ;
+
+        /// true if filename looks like a StumpCascade model
+        static bool check(const std::string& filename);
+
+        IndexType window() const { return window_; }
+        int orientbin() const { return orientbin_; }
+        bool luv() const { return luv_; }
+        RealType gscale() const { return gscale_; }
+
+        const std::vector<Stump>& stumps() const { return stumps_; }
+        std::vector<Stump>& stumps() { return stumps_; }
+        int size() const { return stumps_.size(); }
+
+        void push_back(const Stump& s) { stumps_.push_back(s); }
+
+        /// output of stump s for the window with top-left tl
+        RealType operator()(const Stump& s, const ChannelFeatures& f,
+                const IndexType tl) const
+        {
+            return f.mean(s.channel, tl + s.tl, s.extent) < s.threshold
+                ? s.left : s.right;
+        }
+
+        /**
+         * Scores the window with top-left tl of the image f was computed
+         * on. Returns false if the window is rejected, score then holds
+         * the partial score at rejection.
+         */
+        bool operator()(const ChannelFeatures& f, const IndexType tl,
+                RealType& score) const
+        {
+            score = 0;
+            for (std::vector<Stump>::const_iterator s = stumps_.begin();
+                    s != stumps_.end(); ++s)
+            {
+                score += (*this)(*s, f, tl);
+                if (score < s->reject)
+                    return false;
+            }
+            return true;
+        }
+
+        void print(std::ostream& o) const ;
+
+    protected:
+        IndexType           window_;
+        int                 orientbin_;
+        bool                luv_;
+        RealType            gscale_;
+
+        std::vector<Stump>  stumps_;
+};
+
+std::ostream& operator<<(std::ostream& o, const StumpCascade& c);
+
+}
+
+#endif // _LEAR_STUMP_CASCADE_H_
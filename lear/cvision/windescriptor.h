@@ -2,6 +2,8 @@
 #define _LEAR_WIN_DESCRIPTOR_H_
 
 #include <list>
+#include <string>
+#include <vector>
 
 #include <blitz/tinyvec.h>
 #include <lear/exception.h>
@@ -9,11 +11,72 @@
 #include <lear/io/biostream.h>
 #include <lear/cvision/densegrid.h>
 #include <lear/cvision/cachedesc.h>
+#include <lear/cvision/blockmap.h>
 
 #include <lear/cvision/rhogdense.h>
 #include <lear/cvision/iprocessor.h>
 namespace lear {
+/**
+ * Preprocessed images shared between WinDescriptor objects, e.g. of several
+ * detectors scanning the same frame. A result is reused if the image has
+ * the same pixel type, bounds and pixels, and the processor the same
+ * IProcessor::key(). The last capacity results are kept, with a copy of
+ * their image.
+ */
+class PreprocessCache {
+    public:
+        typedef IProcessor::InfoType                InfoType;
+
+        explicit PreprocessCache(const int capacity = 64) 
+            : capacity_(capacity), hits_(0), misses_(0) {}
+        ~PreprocessCache() { clear(); }
+
+        /// result of processor key on image, NULL if not kept
+        template<class PixelType>
+        const InfoType* find(const std::string& key, 
+                const blitz::Array<PixelType,2>& image) ;
+
+        template<class PixelType>
+        void insert(const std::string& key, 
+                const blitz::Array<PixelType,2>& image, const InfoType& info) ;
+
+        void clear() ;
+
+        int capacity() const { return capacity_; }
+        /// number of find calls that returned a result, and that did not
+        int hits() const { return hits_; }
+        int misses() const { return misses_; }
+
+    private:
+        struct Image {
+            virtual ~Image() {}
+        };
+        template<class PixelType>
+        struct TypedImage : public Image {
+            blitz::Array<PixelType,2> pixels;
+        };
+        struct Entry {
+            std::string key;
+            Image* image;
+            InfoType info;
+
+            Entry(const std::string& key, Image* image, const InfoType& info) 
+                : key(key), image(image), info(info) {}
+        };
+
+        PreprocessCache(const PreprocessCache&);
+        PreprocessCache& operator=(const PreprocessCache&);
+
+        const int capacity_;
+        /// most recently used first
+        std::list<Entry> entries_;
+        int hits_, misses_;
+};
+
 /** WinDescriptor
+ *
+ * Descriptors whose image processors have the same key are preprocessed
+ * once and share the result.
  */
 class WinDescriptor {  
     protected:
@@ -27,6 +90,7 @@ class WinDescriptor {
 
         typedef IProcessor::GrayImage               GrayImage;
         typedef IProcessor::RGBImage                RGBImage;
+        typedef IProcessor::RGB8Image               RGB8Image;
 
         typedef RGBImage                            ImageType;
 
@@ -49,6 +113,9 @@ class WinDescriptor {
         typedef DescType::FeatType         SingFeatType;
 
         typedef std::list<DescType::Preprocessor>    Preprocessor;
+
+        /// block buffers, one per descriptor
+        typedef std::list< BlockMap >               BlockCont;
         
     public:
 
@@ -62,11 +129,114 @@ class WinDescriptor {
 
         Preprocessor& preprocess( const GrayImage& image) ;
         Preprocessor& preprocess( const RGBImage& image) ;
+        /// 8-bit image, converted to float while it is remapped
+        Preprocessor& preprocess( const RGB8Image& image) ;
+
+        /**
+         * Computes, after preprocess, every block that windows with top-left
+         * corners on winorigin + k*winstride can use and normalizes them per
+         * descriptor in one batch. compute() then reads blocks from these
+         * buffers and only falls back to the cache for other windows.
+         */
+        void precompute( const IndexType winorigin, const IndexType winstride) ;
+
+        /**
+         * Same lattice as precompute(), but no block is computed yet: fill()
+         * computes the blocks of the windows about to be computed, so blocks
+         * only used by windows that are never computed cost nothing.
+         */
+        void prepare( const IndexType winorigin, const IndexType winstride) ;
+
+        /**
+         * Same as above for windows over a whole level of extent area, of
+         * which the last preprocessed image is the part at level position
+         * offset. Window positions of fill() and compute() are then level
+         * positions, and blocks computed for an earlier part of the level
+         * are kept (see BlockMap::prepare), so that preprocessing several
+         * parts of a level computes each block once.
+         */
+        void prepare( const IndexType winorigin, const IndexType winstride,
+                const IndexType area, const IndexType offset) ;
+
+        /**
+         * Exchanges the block buffers with blocks, e.g. to keep the blocks
+         * of a level from one image to the next. blocks gets one buffer per
+         * descriptor if it has not, and the buffers take the precision, cell
+         * grid and quantization settings of this object.
+         */
+        void swapblocks( BlockCont& blocks) ;
+
+        /**
+         * Computes the blocks of the count windows at gridTopLeft that lie
+         * on the lattice of prepare() and are not computed yet, normalized
+         * in one batch per descriptor. Does nothing after precompute().
+         */
+        void fill( const IndexType* gridTopLeft, const int count) ;
+
         FeatType compute( const IndexType gridTopLeft) const ;
 
+        /// Same as above, but writes to dest which holds at least length() elements
+        void compute( const IndexType gridTopLeft, ElemType* dest) const ;
+
+        /**
+         * Same as above, quantized to 8 bits with the scale given to
+         * quantize(). Windows outside the precomputed blocks are computed
+         * in float and quantized.
+         */
+        void compute( const IndexType gridTopLeft, unsigned char* dest) const ;
+
+        /**
+         * precompute() also keeps its blocks quantized with scale (see
+         * quantize8) for compute(tl, unsigned char*). 0 stops it.
+         */
+        void quantize( const RealType scale) ;
+        RealType quantization() const { return qscale_; }
+
+        /**
+         * From the next preprocess() on, uses the fixed-point path of each
+         * descriptor (RHOGDense::preprocessfixed) if on: 8-bit input,
+         * integer gradients and votes, float from block normalization on.
+         */
+        void fixedpoint( const bool on) { fixed_ = on; }
+        bool fixedpoint() const { return fixed_; }
+
+        /**
+         * From the next preprocess() on, keeps gradients (unless fixed
+         * point) and the blocks of precompute() in half precision if on:
+         * float16 magnitudes and blocks, 8.8 fixed-point orientations (see
+         * RHOGDense::preprocesshalf). Arithmetic stays in float.
+         */
+        void halfprecision( const bool on) ;
+        bool halfprecision() const { return half_; }
+
+        /**
+         * precompute() assembles blocks from one grid of cells per phase
+         * offset of the block lattice if on (see BlockMap::cellgrid), so
+         * window strides below the cell size share cell votes. Windows
+         * outside the precomputed blocks are assembled from one grid of
+         * cells over the window, so every window gets the same blocks.
+         * Blocks are then not Gaussian weighted.
+         */
+        void cellgrid( const bool on) ;
+        bool cellgrid() const { return cellgrid_; }
+
+        /// result of the last preprocess, one entry per descriptor
+        const Preprocessor& preprocessed() const { return preprocessor; }
+
+        /**
+         * Looks up and stores preprocessing results in cache, which may be
+         * shared with other WinDescriptor objects. NULL stops sharing. Does
+         * not own cache.
+         */
+        void share(PreprocessCache* cache) { shared_ = cache; }
+
         IndexType extent() const { return extent_; }
         int length() const { return length_; }
 
+        /// descriptors, and the block positions of each in the window
+        const DescCont& descriptors() const { return desc_; }
+        const GridCont& grids() const { return grid_; }
+
         void print(std::ostream& o) const ;
         void print(lear::BiOStream& o) const ;
 
@@ -89,9 +259,42 @@ class WinDescriptor {
         IndexArray          indexrange_;
 
         Preprocessor preprocessor;
+
+        /// IProcessor::key() of each descriptor
+        std::vector<std::string> key_;
+        /// index of the first descriptor with the same key
+        std::vector<int>    first_;
+        /// same for fixed-point results, which also depend on the bins
+        std::vector<std::string> fixedkey_;
+        std::vector<int>    fixedfirst_;
+        /// and for half-precision results
+        std::vector<std::string> halfkey_;
+        std::vector<int>    halffirst_;
+
+        /// fixed-point preprocessing, see fixedpoint()
+        bool                fixed_;
+        /// half-precision storage, see halfprecision()
+        bool                half_;
+        /// blocks from phase cell grids, see cellgrid()
+        bool                cellgrid_;
+
+        PreprocessCache*    shared_;
+
+        /// scale of quantized blocks, 0 if not kept
+        RealType            qscale_;
         
         mutable CacheCont   cache_;
 
+        /// dense blocks of current image, filled by precompute
+        BlockCont           blocks_;
+        /// level position of the preprocessed image, see prepare()
+        IndexType           shift_;
+
+        /// cells and float blocks of one window, see cellwindow()
+        mutable std::vector<ElemType> cellbuf_, blockbuf_;
+        /// block positions of one fill()
+        std::vector<IndexType> loc_;
+
         std::string title() const {
             return "Win Descriptor ::       ";
         }
@@ -110,8 +313,25 @@ class WinDescriptor {
             int size() const { return d->size(); }
         };// }}}
 
+        /// precompute() if not lazy, else prepare(), over area if given
+        void setlattice( const IndexType winorigin, const IndexType winstride,
+                const bool lazy, const IndexType* area = NULL) ;
+
+        /**
+         * Normalized blocks of d on g from gridTopLeft written to dest, for
+         * cellgrid(): from one grid of cells over the window if the block
+         * positions lie on its cells, else from the cells of each block.
+         */
+        void cellwindow( const DescType& d, const DescType::Preprocessor& p,
+                const GridType& g, const IndexType gridTopLeft, 
+                ElemType* dest) const ;
+
         template <class PixelType>
         Preprocessor& template_preprocess( const blitz::Array<PixelType,2>& image) ;
+        /// appends the result of each descriptor to preprocessor, computing
+        /// it once per processor key
+        template <class PixelType>
+        void shared_preprocess( const blitz::Array<PixelType,2>& image) ;
 };
 
 }
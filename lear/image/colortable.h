@@ -0,0 +1,115 @@
+// {{{ file documentation
+/**
+ * @file
+ * @brief Lookup tables for per pixel color remapping of 8-bit images.
+ *
+ * Images are read with 8 bits per channel, so any per channel function is
+ * fully described by 256 values and any color conversion by 2^24 values.
+ * ChannelTable holds a scalar function at the integers of [0,255] and
+ * computes it for any other value, so it is exact for any input.
+ * ColorTable samples a color conversion on a regular RGB lattice, exact
+ * for 8-bit input on a 256 node lattice, and interpolates linearly for
+ * the fractional values produced by rescaling.
+ */
+// }}}
+
+#ifndef _LEAR_COLOR_TABLE_H_
+#define _LEAR_COLOR_TABLE_H_
+
+// {{{ headers
+#include <vector>
+#include <algorithm>
+
+#include <blitz/tinyvec.h>
+
+#include <lear/image/colorconversion.h>
+// }}}
+
+namespace lear {
+
+// {{{ ChannelTable
+/**
+ * Scalar function at the integers of [0,255]. Other values (fractional
+ * values of rescaled images, gradient magnitudes) are passed on to the
+ * function itself, so results never differ from calling it.
+ */
+class ChannelTable {
+    public:
+        typedef float                               RealType;
+        typedef double (*Function)(double);
+
+        enum {Max = 255, Size = Max + 1};
+
+        explicit ChannelTable(Function f);
+
+        inline RealType operator()(const RealType v) const {
+            if (v >= 0 && v <= Max) {
+                const int i = static_cast<int>(v);
+                if (i == v)
+                    return table_[i];
+            }
+            return static_cast<RealType>(f_(v));
+        }
+
+        /// value for 8-bit input
+        inline RealType operator[](const unsigned char v) const {
+            return table_[v];
+        }
+
+    protected:
+        Function                f_;
+        std::vector<RealType>   table_;
+};
+// }}}
+
+// {{{ ColorTable
+/**
+ * Color conversion sampled on a regular lattice of nodes^3 RGB values
+ * spanning [0,255]^3, with trilinear interpolation between nodes.
+ *
+ * With 256 nodes the lattice holds every 8-bit color, so 8-bit input is
+ * converted exactly (the table takes 96 MB). Smaller lattices approximate
+ * the conversion. Entries are stored as 16-bit fixed point per channel,
+ * scaled to the range of the channel over the table. Input is clamped to
+ * [0,255].
+ */
+class ColorTable {
+    public:
+        typedef float                               RealType;
+        typedef blitz::TinyVector<RealType,3>       ColorType;
+        typedef blitz::TinyVector<unsigned char,3>  Color8Type;
+
+        enum {Max = 255};
+
+        /// samples f on nodes^3 lattice points, 2 <= nodes <= 256
+        ColorTable(const ConvertColor& f, const int nodes);
+
+        int nodes() const { return nodes_; }
+
+        /// true if lattice holds every 8-bit color
+        bool exact() const { return nodes_ == Max + 1; }
+
+        ColorType operator()(const ColorType& rgb) const ;
+
+        inline ColorType operator()(const Color8Type& rgb) const {
+            if (!exact())
+                return (*this)(ColorType(rgb[0], rgb[1], rgb[2]));
+            const unsigned short* t = &table_[0] +
+                3*((rgb[0]*nodes_ + rgb[1])*nodes_ + rgb[2]);
+            return ColorType(
+                    offset_[0] + t[0]*scale_[0],
+                    offset_[1] + t[1]*scale_[1],
+                    offset_[2] + t[2]*scale_[2]);
+        }
+
+    protected:
+        int                         nodes_;
+        /// value = offset_ + entry*scale_, per channel
+        ColorType                   offset_, scale_;
+        std::vector<unsigned short> table_;
+};
+// }}}
+
+}
+
+#endif // _LEAR_COLOR_TABLE_H_
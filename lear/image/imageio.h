@@ -14,6 +14,7 @@
 #include <blitz/tinyvec.h>
 
 #include <lear/exception.h>
+#include <lear/util/thread.h>
 
 /* standard headers */
 #include <X11/Xlib.h>
@@ -188,6 +189,12 @@ struct ImageIO {
 
     /// Return the size of the image width,height
     static blitz::TinyVector<int,2> size(const std::string& imagename) ;
+
+    /**
+     * Imlib2 works on one global context, so threads using ImageIO or
+     * Painter at the same time must hold this mutex.
+     */
+    static Mutex& mutex();
 protected:
 
     static inline DATA8 red(DATA32 c) {
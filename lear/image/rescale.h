@@ -7,6 +7,7 @@
 #define _LEAR_RESCALE_H_
 
 #include <cmath>
+#include <algorithm>
 
 #include <blitz/array.h>
 #include <blitz/tinyvec.h>
@@ -157,31 +158,34 @@ class BilinearFilter {
     };// }}}
 
     // {{{ horizontal/vertical filtering
-    /// Performs horizontal image filtering
+    /**
+     * Performs horizontal image filtering. dst holds the columns
+     * dst.lbound(0)..dst.ubound(0) of a rescale of srcsize source columns to
+     * dstsize, src and dst rows are indexed alike. src has to hold the source
+     * columns these use (see sourcerange).
+     */
     template<class RealType, class ElementTypeA, class ElementTypeB, class BoundType>
     static void horizontalFilter(
             const BilinearFilter<RealType>& filter,
             const blitz::Array<ElementTypeA, 2>& src,
             blitz::Array<ElementTypeB,2>& dst,
-            const BoundType& bound) 
+            const BoundType& bound,
+            const int srcsize, const int dstsize) 
     { 
         typedef typename blitz::promote_trait<
             ElementTypeA, ElementTypeB>::T_promote    ElementType;
-        typedef blitz::TinyVector<int,2>              IndexType;
 
-        IndexType dst_extent = dst.extent();
-        IndexType src_extent = src.extent();
-
-	if(dst_extent[0] == src_extent[0]) {
-            std::copy(src.begin(),src.end(),dst.begin());
-            //for (blitz::DomainIter<2> i(0, dst_extent-1); i; ++i)
-            //    dst(*i) = static_cast<ElementTypeB> (src(*i)); // no scaling required, just copy
+	if(dstsize == srcsize) {
+            // no scaling required, just copy
+            for (int x = dst.lbound(0); x <= dst.ubound(0); ++x)
+            for (int y = dst.lbound(1); y <= dst.ubound(1); ++y)
+                dst(x,y) = src(x,y);
 	} else {
             // allocate and calculate the contributions
-            WeightTable<RealType> weightTable(filter, dst_extent[0], src_extent[0]); 
+            WeightTable<RealType> weightTable(filter, dstsize, srcsize); 
 
-            for(int y = 0; y < dst_extent[1]; ++y) { // step through rows            
-            for(int x = 0; x < dst_extent[0]; ++x) { // scale each row 
+            for(int y = dst.lbound(1); y <= dst.ubound(1); ++y) { // step through rows            
+            for(int x = dst.lbound(0); x <= dst.ubound(0); ++x) { // scale each row 
                     // loop through row
                     ElementType value; value = 0;
                     RealType sumweight=0; 
@@ -206,32 +210,29 @@ class BilinearFilter {
 	}
     } 
 
-    /// Performs vertical image filtering
+    /// Performs vertical image filtering, see horizontalFilter
     template<class RealType, class ElementTypeA, class ElementTypeB, class BoundType>
     static void verticalFilter(
             const BilinearFilter<RealType>& filter,
             const blitz::Array<ElementTypeA, 2>& src,
             blitz::Array<ElementTypeB,2>& dst,
-            const BoundType& bound) 
+            const BoundType& bound,
+            const int srcsize, const int dstsize) 
     {
         typedef typename blitz::promote_trait<
             ElementTypeA, ElementTypeB>::T_promote    ElementType;
-        typedef blitz::TinyVector<int,2>              IndexType;
-
-        IndexType dst_extent = dst.extent();
-        IndexType src_extent = src.extent();
 
-	if(dst_extent[1] == src_extent[1]) {
-            std::copy(src.begin(),src.end(),dst.begin());
-            //for (blitz::DomainIter<2> i(0, dst_extent-1); i; ++i)
-            //    // no scaling required, just copy
-            //    dst(*i) = static_cast<ElementTypeB> (src(*i)); 
+	if(dstsize == srcsize) {
+            // no scaling required, just copy
+            for (int x = dst.lbound(0); x <= dst.ubound(0); ++x)
+            for (int y = dst.lbound(1); y <= dst.ubound(1); ++y)
+                dst(x,y) = src(x,y);
 	} else {
             // allocate and calculate the contributions
-            WeightTable<RealType> weightTable(filter, dst_extent[1], src_extent[1]); 
+            WeightTable<RealType> weightTable(filter, dstsize, srcsize); 
 
-            for(int x = 0; x < dst_extent[0]; ++x) { // step through columns
-            for(int y = 0; y < dst_extent[1]; ++y) { // scale each column
+            for(int x = dst.lbound(0); x <= dst.ubound(0); ++x) { // step through columns
+            for(int y = dst.lbound(1); y <= dst.ubound(1); ++y) { // scale each column
                     // loop through column
                     ElementType value; value = 0;
                     RealType sumweight=0; 
@@ -257,19 +258,45 @@ class BilinearFilter {
             }
 	}
     } 
+
+    /**
+     * Source pixels [first,last] that destination pixels [lo,hi) of a line
+     * rescaled from srcsize to dstsize pixels use.
+     */
+    template<class RealType>
+    static void sourcerange(
+            const BilinearFilter<RealType>& filter,
+            const int srcsize, const int dstsize, const int lo, const int hi,
+            int& first, int& last)
+    {
+        if (dstsize == srcsize) {
+            first = lo; last = hi-1;
+            return;
+        }
+        WeightTable<RealType> weightTable(filter, dstsize, srcsize); 
+        first = srcsize; last = -1;
+        for (int u = lo; u < hi; ++u) {
+            first = std::min(first, weightTable.getLeftBoundary(u));
+            last = std::max(last, weightTable.getRightBoundary(u));
+        }
+    }
     // }}}
 
     }
 
     /**
-     * Rescale the image to the supplied destination size using the supplied filter
+     * Pixels [lo,hi) of the rescale of the image to size, indexed from 0.
+     * They are the same as those of the whole rescale, but only the source
+     * pixels they use are filtered.
      */
     template<class ElementType, class BoundType>
-    blitz::Array<ElementType,2> rescale(
+    blitz::Array<ElementType,2> rescalepart(
             const blitz::Array<ElementType,2>& src, 
-            const int dst_width, const int dst_height,
+            const blitz::TinyVector<int,2> size,
+            const blitz::TinyVector<int,2> lo,
+            const blitz::TinyVector<int,2> hi,
             const BoundType& bound) 
-    { // {{{ rescale
+    { // {{{ rescalepart
         typedef typename blitz::ExtNumericTraits<ElementType>::T_basictype     BasicType;
         typedef typename blitz::ExtNumericTraits<BasicType  >::T_floattype     RealType;
         typedef typename blitz::ExtNumericTraits<ElementType>::T_floattype     RealElementType;
@@ -278,48 +305,85 @@ class BilinearFilter {
         typedef blitz::Array<ElementType,2>                     ArrayType;
         typedef blitz::Array<RealElementType,2>                 RealArrayType;
 
-        IndexType src_extent = src.extent();
-        if (dst_width == src_extent[0] && dst_height == src_extent[1])
-            return src.copy();
+        for (int d= 0; d< 2; ++d) 
+            if (lo[d] < 0 || hi[d] > size[d] || lo[d] >= hi[d])
+                throw Exception("rescalepart", "Part is empty or outside the destination");
 
-	if ((dst_width <= 0) || (dst_height <= 0)) {
-            throw Exception("rescale", "Destination width or height is <= 0");
-	}
+        IndexType src_extent = src.extent();
 	BilinearFilter<RealType> filter;
 
-
-	// allocate the dst array
-	ArrayType dst(dst_width, dst_height);
+	// allocate the dst array, indexed as the whole destination
+	ArrayType dst(blitz::Range(lo[0], hi[0]-1), blitz::Range(lo[1], hi[1]-1));
 
 	// decide which filtering order (xy or yx) is faster for this mapping by
 	// counting convolution multiplies
-	if (dst_width*src_extent[1] <= dst_height*src_extent[0]) {
+        int first, last;
+	if (size[0]*src_extent[1] <= size[1]*src_extent[0]) {
             // xy filtering
 
-            // allocate a temporary image
-            RealArrayType tmp(dst_width, src_extent[1]);
+            // allocate a temporary image of the source rows dst uses
+            detail::sourcerange(filter, src_extent[1], size[1], lo[1], hi[1], 
+                    first, last);
+            RealArrayType tmp(blitz::Range(lo[0], hi[0]-1), blitz::Range(first, last));
 
             // scale source image horizontally into temporary image
-            detail::horizontalFilter(filter, src, tmp, detail::ValueUnbounded());
+            detail::horizontalFilter(filter, src, tmp, detail::ValueUnbounded(),
+                    src_extent[0], size[0]);
 
             // scale temporary image vertically into result image    
-            detail::verticalFilter(filter, tmp, dst, bound);
+            detail::verticalFilter(filter, tmp, dst, bound, src_extent[1], size[1]);
 
 	} else {
             // yx filtering
 
-            // allocate a temporary image
-            RealArrayType tmp(src_extent[0], dst_height);
+            // allocate a temporary image of the source columns dst uses
+            detail::sourcerange(filter, src_extent[0], size[0], lo[0], hi[0], 
+                    first, last);
+            RealArrayType tmp(blitz::Range(first, last), blitz::Range(lo[1], hi[1]-1));
 
             // scale source image vertically into temporary image
-            detail::verticalFilter(filter, src, tmp, detail::ValueUnbounded());
+            detail::verticalFilter(filter, src, tmp, detail::ValueUnbounded(),
+                    src_extent[1], size[1]);
 
             // scale temporary image horizontally into result image    
-            detail::horizontalFilter(filter, tmp, dst, bound);
+            detail::horizontalFilter(filter, tmp, dst, bound, src_extent[0], size[0]);
 	}
+        dst.reindexSelf(IndexType(0));
         return dst;
     } // }}}
     template<class ElementType>
+    blitz::Array<ElementType,2> rescalepart(
+            const blitz::Array<ElementType,2>& src, 
+            const blitz::TinyVector<int,2> size,
+            const blitz::TinyVector<int,2> lo,
+            const blitz::TinyVector<int,2> hi)
+    {
+        typedef typename blitz::ExtNumericTraits<ElementType>::T_floattype     RealElementType;
+        return rescalepart(src, size, lo, hi, detail::ValueBounded<RealElementType>(0.0,255.0));
+    }
+
+    /**
+     * Rescale the image to the supplied destination size using the supplied filter
+     */
+    template<class ElementType, class BoundType>
+    blitz::Array<ElementType,2> rescale(
+            const blitz::Array<ElementType,2>& src, 
+            const int dst_width, const int dst_height,
+            const BoundType& bound) 
+    { // {{{ rescale
+        typedef blitz::TinyVector<int,2>                        IndexType;
+
+        IndexType src_extent = src.extent();
+        if (dst_width == src_extent[0] && dst_height == src_extent[1])
+            return src.copy();
+
+	if ((dst_width <= 0) || (dst_height <= 0)) {
+            throw Exception("rescale", "Destination width or height is <= 0");
+	}
+        const IndexType size (dst_width, dst_height);
+        return rescalepart(src, size, IndexType(0), size, bound);
+    } // }}}
+    template<class ElementType>
     blitz::Array<ElementType,2> rescale(
             const blitz::Array<ElementType,2>& src, 
             const int dst_width, const int dst_height)
@@ -0,0 +1,114 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  detectorbundle.h
+ *
+ *    Description:  Compiled detector: descriptor parameters, window
+ *    geometry, non-maximum suppression settings and classifier weights in
+ *    one memory-mapped file.
+ *
+ * =====================================================================================
+ */
+
+#ifndef  _LEAR_DETECTOR_BUNDLE_H_
+#define  _LEAR_DETECTOR_BUNDLE_H_
+
+#include <vector>
+#include <string>
+
+#include <lear/interface/windetect.h>
+
+/**
+ * A detector compiled into a single binary file.
+ *
+ * Starting a detector from a svm_learn model means parsing a text file of
+ * several thousand weights and recomputing the Gaussian block weights of
+ * every descriptor. A bundle stores all of it in binary, versioned form and
+ * is mapped read-only and shared, so that any number of worker processes
+ * on a machine use the same pages and start without parsing anything.
+ *
+ * Layout (native byte order, all sections 8-byte aligned):
+ *  - header: magic, version, window geometry, pyramid, cell grid and
+ *    non-maximum suppression settings, classifier bias, number of descriptors
+ *  - one record per descriptor: its RHOGDenseParam, the number of
+ *    blocks per window and the offset of its Gaussian weight table
+ *  - per descriptor Gaussian weight table, float, x-major
+ *  - classifier weights, float, in WinDescriptor block order, i.e. for
+ *    each descriptor, for each block of the window (x outer, y inner), the
+ *    normalized block histogram. This is the order in which dump_rhog
+ *    writes features, so svm_learn weights are stored as they are.
+ *
+ * Files written by a different version are rejected.
+ *
+ * Usage:
+ *  DetectorBundle bundle("person.bundle");
+ *  WinDetectClassify windetect;
+ *  windetect.init(bundle);
+ *  LinearClassify classifier = bundle.classifier();
+ *
+ * The bundle must outlive any classifier returned by classifier().
+ */
+class DetectorBundle {
+    public:
+        /// version 4 adds jointcirc to the descriptor records, 5 cellgrid,
+        /// 6 labnodes
+        enum {Version = 6};
+
+        /// Maps filename. Throws lear::Exception if it is not a valid bundle.
+        explicit DetectorBundle(const std::string& filename);
+
+        ~DetectorBundle();
+
+        /// true if filename starts with the bundle magic
+        static bool check(const std::string& filename);
+
+        /**
+         * Writes a bundle from the settings of detector, the descriptor
+         * parameters it is initialized with, and the classifier. Throws
+         * lear::Exception if classifier length does not match the feature
+         * length of the descriptors.
+         */
+        static void write(const std::string& filename,
+                const WinDetectClassify& detector,
+                const std::vector<const RHOGDenseParam*>& param,
+                const LinearClassify& classifier);
+
+        int numdesc() const;
+
+        /// Descriptor parameters, owned by the bundle
+        const std::vector<const RHOGDenseParam*>& param() const
+        { return paramptr_; }
+
+        /// Number of blocks in a window for descriptor i
+        int numblock(const int i) const;
+
+        /// Gaussian weight table of descriptor i
+        const float* gaussweight(const int i) const;
+
+        /// Classifier length, i.e. feature length of a window
+        int length() const;
+
+        /// Sets window geometry, pyramid settings and cellgrid
+        void fill(WinDetect& detector) const;
+
+        /// Same as above, plus non-maximum suppression method and settings
+        void fill(WinDetectClassify& detector) const;
+
+        /// Linear classifier reading weights in place
+        LinearClassify classifier() const;
+
+    private:
+        DetectorBundle(const DetectorBundle&);
+        DetectorBundle& operator=(const DetectorBundle&);
+
+        /// true if n floats at offset lie inside the mapping
+        bool inside(const int offset, const int n) const ;
+
+        const char*                         data_;
+        unsigned long                       size_;
+
+        std::vector<RHOGDenseParam>         param_;
+        std::vector<const RHOGDenseParam*>  paramptr_;
+};
+
+#endif   // ----- #ifndef _LEAR_DETECTOR_BUNDLE_H_
@@ -19,6 +19,12 @@
 
 #define BUILD_APP
 
+class DetectorBundle;
+class WindowClassifier;
+class LinearClassify;
+namespace lear { class StumpCascade; }
+struct WinDetectSessionCache;
+
 // Set required RHOG Dense parameters in an object of this class.
 struct RHOGDenseParam {
     typedef float        RealType;
@@ -45,10 +51,15 @@ struct RHOGDenseParam {
     int                 descstride_x, descstride_y;
     int                 orientbin;
     bool                semicirc; 
+    /// 0-360 and 0-180 orientation bins from one vote, overrides semicirc
+    bool                jointcirc; 
     RealType            wtscale;
     RealType            gscale;
     RealType            epsilon;
     RealType            maxvalue;
+    /// Lab preprocessing: nodes per axis of the RGB lattice of its lookup
+    /// table (see ImageLabRemap), 0 converts each pixel exactly
+    int                 labnodes;
 
 
     /// Normalization to use
@@ -60,13 +71,84 @@ struct RHOGDenseParam {
         cellsize_x(8), cellsize_y(8),
         numcell_x(2), numcell_y(2),
         descstride_x(8), descstride_y(8),
-        orientbin(9), semicirc(true), wtscale(2), 
-        gscale(0), epsilon(1), maxvalue(0.2),
+        orientbin(9), semicirc(true), jointcirc(false), wtscale(2), 
+        gscale(0), epsilon(1), maxvalue(0.2), labnodes(0),
         preprocessing2use(RGB_Sqrt_Grad), norm2use(NormL2Hys)
     { }
 
 };
 
+/**
+ * Layout of an 8-bit image buffer handed to computefeature and test. The
+ * buffer is row-major: pixels of a row are adjacent, rows follow each other.
+ *
+ * For interleaved buffers channel c of pixel (i,j) is read from
+ *      image + j*step + i*pixelstep + index(c)
+ * and for planar buffers (planestep > 0) from
+ *      image + index(c)*planestep + j*step + i*pixelstep
+ * where c is 0 for red, 1 for green and 2 for blue.
+ *
+ * Gray is a single 8-bit channel. Use it for gray images and for the luma
+ * plane of YUV buffers, e.g. pass the Y plane of an NV12 frame with its row
+ * stride as step. Gray images are processed as gray images, so use it with
+ * a model trained on gray images.
+ */
+struct PixelFormat {
+    enum ChannelOrder {
+        RGB=0,
+        BGR,
+        RGBA,
+        BGRA,
+        ARGB,
+        ABGR,
+        Gray
+    };
+
+    ChannelOrder        order;
+    /// Bytes between rows. 0 implies width*pixelstep.
+    int                 step;
+    /// Bytes between pixels of a row. 0 implies channels(), or 1 if planar.
+    int                 pixelstep;
+    /// Bytes between planes. 0 implies interleaved channels.
+    int                 planestep;
+
+    explicit PixelFormat(const ChannelOrder order = RGB, const int step = 0,
+            const int pixelstep = 0, const int planestep = 0) :
+        order(order), step(step), pixelstep(pixelstep), planestep(planestep)
+    { }
+
+    int channels() const {
+        switch (order) {
+            case Gray:  return 1;
+            case RGB:
+            case BGR:   return 3;
+            default:    return 4;
+        }
+    }
+
+    /// Position of red (c=0), green (1) or blue (2) in a pixel or plane list
+    int index(const int c) const {
+        switch (order) {
+            case BGR:
+            case BGRA:  return 2-c;
+            case ARGB:  return 1+c;
+            case ABGR:  return 3-c;
+            case Gray:  return 0;
+            default:    return c;
+        }
+    }
+
+    bool gray() const { return order == Gray; }
+
+    bool planar() const { return planestep > 0; }
+
+    int pixelbytes() const 
+    { return pixelstep ? pixelstep : (planar() ? 1 : channels()); }
+
+    int rowbytes(const int width) const 
+    { return step ? step : width*pixelbytes(); }
+};
+
 /**
  * This is the main class. It provides the initialization routine which given
  * an pointer to RHOGDenseParam, initializes the RHOG Dense descriptor
@@ -96,7 +178,7 @@ struct WinDetect {
 
         // common options
         label(DefaultLabel),
-        verbose(0), cachesize(16)
+        verbose(0), cachesize(16), sharedlevels(0), cellgrid(false)
     { } 
     
     virtual ~WinDetect() {}
@@ -120,6 +202,13 @@ struct WinDetect {
      */
     virtual void init(const std::vector<const RHOGDenseParam*>& param);
 
+    /**
+     * Initializes from a compiled detector. Window geometry and pyramid
+     * settings are taken from the bundle, and descriptors use its Gaussian
+     * weight tables instead of recomputing them.
+     */
+    virtual void init(const DetectorBundle& bundle);
+
     /**
      * Preprocesses an image and computes the HOG descriptor. The descriptor
      * is set in the 'result' pointer.
@@ -166,6 +255,46 @@ struct WinDetect {
             const std::vector<int>& xloc, const std::vector<int>& yloc,
             const unsigned char* image, int width, int height, int step=0) const;
 
+    /**
+     * Same as above two for image buffers in any PixelFormat. RGB buffers
+     * with 3-byte pixels and rows a whole number of pixels apart are read
+     * in place; other layouts are copied once into an image, converting
+     * the channel order.
+     */
+    bool computefeature(float* result, const int xloc, const int yloc,
+            const unsigned char* image, int width, int height, 
+            const PixelFormat& format) const;
+
+    std::vector<bool> computefeature(std::vector<float*>& result, 
+            const std::vector<int>& xloc, const std::vector<int>& yloc,
+            const unsigned char* image, int width, int height, 
+            const PixelFormat& format) const;
+
+    /**
+     * Derives from classifier the model of objects mirrored left to right
+     * (if mirror) and then rotated in the image plane by angle degrees
+     * (clockwise on screen), by moving its weights: block positions and
+     * cells are mirrored and rotated about the window center, with
+     * bilinear interpolation between blocks, and orientation bins are
+     * reflected and shifted, with linear interpolation between bins. A
+     * mirror is exact for a symmetric block grid and an even number of
+     * 0-360 bins; rotations are approximate and suited to a few degrees.
+     * Weights of blocks rotated out of the window are dropped. Add the
+     * result to classifier with LinearClassify::addvariant.
+     */
+    LinearClassify posevariant(const LinearClassify& classifier,
+            const bool mirror, const RealType angle) const;
+
+    /**
+     * Mean gradient magnitude, of the first descriptor, over the window
+     * with top-left corner (xloc,yloc). This is the energy compared with
+     * WinDetectClassify::energythreshold; an offline tool picks the
+     * threshold from the energies of positive windows. Returns -1 if the
+     * window is out of bounds.
+     */
+    RealType windowenergy(const int xloc, const int yloc,
+            const unsigned char* image, int width, int height, 
+            const PixelFormat& format) const;
     
     int featurelength() const;
 
@@ -202,6 +331,21 @@ struct WinDetect {
     /// its default value. Size in MBs
     int cachesize;
 
+    /// Number of preprocessed images (gradients of a pyramid level) kept,
+    /// so that a later scan of the same frame, e.g. a full scan after a
+    /// tracked one, reuses them. A kept image is compared pixel by pixel
+    /// with the one to preprocess. 0 disables it. Set before init.
+    int sharedlevels;
+
+    /// Blocks from shared cells. Each phase offset of the block lattice
+    /// (e.g. (0,0), (4,0), (0,4), (4,4) for a winstride of 4 with 8 pixel
+    /// cells) gets one grid of cells per level and blocks are assembled
+    /// from the grid of their phase, so strides below the cell size cost
+    /// one cell pass per phase instead of voting every block. Blocks are
+    /// not Gaussian weighted (see RHOGDense::cells), so dump training
+    /// windows with the same setting. Set before init.
+    bool cellgrid;
+
     static const char DefaultLabel;
 };
 
@@ -280,12 +424,34 @@ inline std::ostream& operator<<(std::ostream& o, const WinDetectDump& windet)
 { windet.print(o); return o; }
 
 #endif
+/**
+ * Scores window descriptors. The detector scores the windows of a pyramid
+ * level in batches: count descriptors of length() values stored one after
+ * the other, i.e. a count x length() matrix, row major. Implementations
+ * can then share weight loads or table lookups between windows, and the
+ * virtual call is paid once per batch.
+ */
+class WindowClassifier {
+    public:
+    virtual ~WindowClassifier() {}
+
+    virtual int length() const = 0;
+
+    /// score of one descriptor of length() values
+    virtual float operator()(const float* desc) const = 0;
+
+    /// Scores count descriptors stored one after the other in desc to
+    /// score. The default scores them one at a time.
+    virtual void operator()(const float* desc, const int count, float* score) const ;
+};
+
 /**
  * Read output model file after svm learning and fills in bias and weight
  * vector. Only linear SVM output model file are supported.
  */
-class LinearClassify {
+class LinearClassify : public WindowClassifier {
     public:
+    using WindowClassifier::operator();
 
     // The default person detection parameters are hard coded, i.e. 
     // 8x8 cell, 2x2 no. of cells in each block, 9 orientation bin etc.
@@ -295,6 +461,13 @@ class LinearClassify {
     // Loads the linear SVM model from file 
     LinearClassify(std::string& filename, const int verbose = 0) ;
 
+    // Uses float weights in place, e.g. from a DetectorBundle. The weights
+    // are not copied, so they must outlive this object and its copies.
+    LinearClassify(const float* weight, const int length, const double bias) ;
+
+    // Copies weight.
+    LinearClassify(const std::vector<double>& weight, const double bias) ;
+
     LinearClassify(const LinearClassify& ) ;
 
     LinearClassify& operator=(const LinearClassify& ) ;
@@ -302,18 +475,204 @@ class LinearClassify {
     int length() const 
     { return length_; }
 
+    double bias() const 
+    { return linearbias_; }
+
+    double weight(const int i) const 
+    { return floatwt_ ? floatwt_[i] : linearwt_[i]; }
+
     double operator()(const double* desc) const ;
 
     float operator()(const float* desc) const ;
 
+    /**
+     * Adds a variant of the model with the same length and bias, e.g. a
+     * mirrored or rotated one from WinDetect::posevariant. The score is
+     * then the largest of the model and its variants, i.e. one more dot
+     * product per variant over the same descriptor.
+     */
+    void addvariant(const LinearClassify& variant) ;
+
+    int variants() const 
+    { return variant_.size(); }
+
+    /// weight i of variant v
+    double variantweight(const int v, const int i) const 
+    { return variant_[v][i]; }
+
     ~LinearClassify() {
         delete[] linearwt_;
     }
 
     private:
+        /// largest dot product of desc with the weights and the variants
+        template<class T>
+        double dot(const T* desc) const ;
+
         int length_;
         double* linearwt_;
         double linearbias_;
+        // not owned
+        const float* floatwt_;
+        std::vector< std::vector<double> > variant_;
+};
+
+/**
+ * LinearClassify scored with 8-bit descriptors and weights. A descriptor
+ * value v is stored as round(v*descscale) in [0,255] (normalized blocks are
+ * not negative), a weight w as round(w*weightscale) in [-127,127], with
+ * weightscale = 127/max|w| over the model and its variants. The score is
+ *      dot/(descscale*weightscale) - bias
+ * with dot the integer dot product, the largest over the variants as in
+ * LinearClassify. With SSE2 the dot product takes 16 values per step,
+ * widened to 16 bits and summed pairwise into 32 bits (pmaddwd).
+ *
+ * Pick descscale from descriptors of the training or a validation set,
+ * e.g. with quantize_rhog, so that few values saturate at 255.
+ */
+class QuantizedClassify {
+    public:
+    QuantizedClassify() :
+        length_(0), models_(0), descscale_(0), weightscale_(0), bias_(0)
+    {}
+
+    QuantizedClassify(const LinearClassify& classifier, const double descscale) ;
+
+    int length() const 
+    { return length_; }
+
+    double descscale() const 
+    { return descscale_; }
+
+    double weightscale() const 
+    { return weightscale_; }
+
+    /// Quantizes length() values of desc to dest, as WinDescriptor does.
+    void quantize(const float* desc, unsigned char* dest) const ;
+
+    float operator()(const unsigned char* desc) const ;
+
+    private:
+        int length_, models_;
+        double descscale_, weightscale_, bias_;
+        /// model, then each variant, length_ values each
+        std::vector<signed char> weight_;
+};
+
+/**
+ * LinearClassify with float weights, scored with SSE. A batch is scored
+ * four descriptors at a time, so that each load of four weights is shared
+ * by four windows and the four dot products are summed in parallel.
+ * Variants are copied and scored as in LinearClassify. Scores differ from
+ * those of LinearClassify, which sums in double, by float rounding only.
+ */
+class FloatClassify : public WindowClassifier {
+    public:
+    explicit FloatClassify(const LinearClassify& classifier) ;
+
+    int length() const 
+    { return length_; }
+
+    float operator()(const float* desc) const ;
+
+    void operator()(const float* desc, const int count, float* score) const ;
+
+    private:
+        int length_, models_;
+        float bias_;
+        /// model, then each variant, length_ values each
+        std::vector<float> weight_;
+};
+
+/**
+ * Additive kernel SVM, score(x) = sum_j alpha_j K(x,s_j) - bias with
+ * K(x,s) = sum_i k(x_i,s_i), scored as sum_i h_i(x_i) - bias. Each
+ * h_i(v) = sum_j alpha_j k(v,s_ji) is sampled at bins points from 0 to the
+ * largest s_ji and linearly interpolated, so a window costs length() table
+ * lookups whatever the number of support vectors. Descriptor values below
+ * 0 score as 0, values beyond the largest s_ji as the largest s_ji.
+ *
+ * For the histogram intersection kernel h_i is piecewise linear with a
+ * knot at each s_ji and constant beyond the largest one, so the tables
+ * only add the error of interpolating between the knots. For chi-square
+ * h_i is smooth and the error falls with the square of the bin width.
+ *
+ * Tables hold the value and slope of each sample next to each other. With
+ * SSE2 four dimensions are interpolated at once (eight with AVX2, whose
+ * gather loads the samples); without, one at a time.
+ *
+ * Usage:
+ *  compile_additive svmmodel tables    (once, from an svm_learn model)
+ *  AdditiveClassify classifier(tables);
+ *  windetect.test(classifier, detections, ...);
+ */
+class AdditiveClassify : public WindowClassifier {
+    public:
+    enum Kernel {
+        Intersection=0, // k(v,s) = min(v,s)
+        ChiSquare       // k(v,s) = 2vs/(v+s)
+    };
+
+    /**
+     * Kernel SVM with the support vectors sv, length values each, one
+     * after the other, and the coefficients alpha (label times Lagrange
+     * multiplier) of each.
+     */
+    AdditiveClassify(const int length, const std::vector<float>& sv, 
+            const std::vector<double>& alpha, const double bias, 
+            const int bins = 64, const Kernel kernel = Intersection) ;
+
+    /// Loads tables written by save
+    explicit AdditiveClassify(const std::string& filename) ;
+
+    void save(const std::string& filename) const ;
+
+    /// true if filename looks like tables written by save
+    static bool check(const std::string& filename) ;
+
+    /**
+     * Reads a kernel model written by svm_learn (SVM-light text format,
+     * custom kernel type 4) to length, sv, alpha and bias as taken by the
+     * constructor, and the custom kernel parameter (-u) to kernel.
+     */
+    static void readsvm(const std::string& filename, int& length,
+            std::vector<float>& sv, std::vector<double>& alpha, double& bias,
+            std::string& kernel, const int verbose = 0) ;
+
+    /// Kernel named name: 'intersection' (or 'min') or 'chi2'
+    static Kernel kernelname(const std::string& name) ;
+
+    int length() const 
+    { return length_; }
+
+    int bins() const 
+    { return bins_; }
+
+    Kernel kernel() const 
+    { return kernel_; }
+
+    double bias() const 
+    { return bias_; }
+
+    float operator()(const float* desc) const ;
+
+    void operator()(const float* desc, const int count, float* score) const ;
+
+    private:
+        /// sum of the interpolated h_i(desc[i])
+        float lookup(const float* desc) const ;
+
+        /// slopes from the sample values, and checks the tables
+        void setslopes() ;
+
+        Kernel kernel_;
+        int length_, bins_;
+        double bias_;
+        /// bins per unit of descriptor value, per dimension
+        std::vector<float> scale_;
+        /// value and slope to the next of the bins_ samples of h_i, 
+        /// dimension outer
+        std::vector<float> table_;
 };
 
 struct DetectedRegion {
@@ -334,12 +693,110 @@ struct DetectedRegion {
     void print(std::ostream& o) const;
 };
 std::ostream& operator<<(std::ostream& o, const DetectedRegion& region);
+/// Work done by WinDetectClassify::test on one image
+struct DetectStats {
+    DetectStats() : levels(0), windows(0), lattice(0), coarsened(0), 
+        rejected(0) {}
+
+    // pyramid levels scanned
+    int levels;
+    // windows scored by the classifier
+    int windows;
+    // windows on the winstride lattice, i.e. scored by a dense scan
+    int lattice;
+    // levels scanned with a larger coarse stride to fit the time budget
+    int coarsened;
+    // windows not scored as their gradient energy is below energythreshold,
+    // or rejected early by a StumpCascade
+    int rejected;
+    // scales of the levels skipped as they did not fit the time budget
+    std::vector<float> skipped;
+};
+
+/**
+ * Running estimate of the time WinDetectClassify::test spends on a level,
+ * used to fit the levels of an image into timebudget. Each detector
+ * carries its estimates over from image to image.
+ */
+struct LevelCost {
+    /// largest coarse stride a time budget may impose
+    enum {MaxCoarse = 4};
+
+    LevelCost() : pixelms(0), refine(2), nonmaxms(0) {
+        for (int c= 0; c<= MaxCoarse; ++c) 
+            windowms[c] = 0;
+    }
+
+    // ms to rescale and preprocess a level, per level pixel
+    float pixelms;
+    // ms to compute the new blocks of a window and score it, per coarse
+    // stride: windows of a coarse lattice share fewer blocks
+    float windowms[MaxCoarse+1];
+    // windows scored by a coarse-to-fine scan per coarse lattice point
+    float refine;
+    // ms of the last non-maximum suppression
+    float nonmaxms;
+
+    bool calibrated() const { return window(1) > 0; }
+
+    /// ms per window at coarse stride coarse, or at the closest measured
+    float window(const int coarse) const {
+        for (int d= 0; d<= MaxCoarse; ++d) {
+            if (coarse-d >= 1 && windowms[coarse-d] > 0)
+                return windowms[coarse-d];
+            if (coarse+d <= MaxCoarse && windowms[coarse+d] > 0)
+                return windowms[coarse+d];
+        }
+        return 0;
+    }
+
+    /// estimated ms of a level with pixels pixels and windows lattice
+    /// points, scanned with coarse stride coarse
+    float level(const int pixels, const int windows, const int coarse) const {
+        float scored = windows;
+        if (coarse > 1 && windows*refine/(coarse*coarse) < scored)
+            scored = windows*refine/(coarse*coarse);
+        return pixelms*pixels + window(coarse)*scored;
+    }
+
+    static void update(float& estimate, const float measured) {
+        estimate = estimate > 0 ? (estimate + measured)/2 : measured;
+    }
+};
+
+/**
+ * Part of the scale space searched by WinDetectClassify::test. Windows are
+ * scored if their center lies in [x0,x1]x[y0,y1] (image pixels) and their
+ * scale in [minscale,maxscale].
+ */
+struct SearchRegion {
+    SearchRegion() : 
+        x0(0), y0(0), x1(0), y1(0), minscale(0), maxscale(0)
+    {}
+
+    SearchRegion(
+            const float x0, const float y0, const float x1, const float y1,
+            const float minscale, const float maxscale)
+            :
+        x0(x0), y0(y0), x1(x1), y1(y1), minscale(minscale), maxscale(maxscale)
+    {}
+
+    float x0, y0, x1, y1;
+    float minscale, maxscale;
+};
+
 /**
  * Detect objects in test images.
  */
 struct WinDetectClassify : public WinDetect{
     typedef std::list<std::string>              PathVector;
 
+    enum NonMaxMethod {
+        MeanShift=0, // mean shift over windows above lightthreshold
+        ScaleSpace,  // local maxima of smoothed dense score maps
+        Greedy       // best windows first, drop those overlapping a kept one
+    };
+
     WinDetectClassify() :
         WinDetect(), 
         avsize_x(0), avsize_y(96),
@@ -350,7 +807,13 @@ struct WinDetectClassify : public WinDetect{
         aligninimage(false), showscore(true),
         softmax(0), threshold(0.1), lightthreshold(0),
         nonmaxsigma_x(8), nonmaxsigma_y(16), nonmaxsigma_scale(1.3),
-        score2prob_a(1), score2prob_b(0)
+        score2prob_a(1), score2prob_b(0),
+        nonmaxmethod(MeanShift), nonmaxoverlap(0.5),
+        coarsestride(1), refinethreshold(-0.5),
+        groundplane_a(0), groundplane_b(0), groundtolerance(0),
+        timebudget(0), priorityscale(0), energythreshold(0),
+        posemirror(false), poseangle(0), posesteps(0),
+        descscale(0), fixedpoint(false), halfprecision(false), writers(0)
     {}
 
     inline virtual void init(const RHOGDenseParam* param) 
@@ -362,6 +825,22 @@ struct WinDetectClassify : public WinDetect{
         WinDetect::init(param);
         initclassifier();
     }
+    /// Same as WinDetect::init, and also sets non-maximum suppression settings.
+    virtual void init(const DetectorBundle& bundle);
+
+    /**
+     * Sets the window to the one of cascade and non-maximum suppression
+     * up, for test with a StumpCascade. No RHOGDense descriptor is built;
+     * call it instead of the other init functions.
+     */
+    void init(const lear::StumpCascade& cascade);
+
+    /**
+     * Adds to classifier the pose variants selected by posemirror,
+     * poseangle and posesteps, see WinDetect::posevariant. Call after init
+     * and once per classifier, e.g. when it is loaded.
+     */
+    void addposes(LinearClassify& classifier) const;
 
     /**
      * Run any test only after calling init.
@@ -374,23 +853,64 @@ struct WinDetectClassify : public WinDetect{
      * NOTE 3: nopyramid, no_nonmax, showscore suppression options have no effect. This
      * code always run non-maximum suppression on scale-space.
      *
+     * Any WindowClassifier scores the windows, e.g. LinearClassify or one
+     * of the faster FloatClassify and AdditiveClassify. Integer scoring
+     * (descscale) requires a LinearClassify.
+     *
      * Step of 0 implies use same value as width.
      */
-    void  test(const LinearClassify& classifier, std::list<DetectedRegion>& detections,
+    void  test(const WindowClassifier& classifier, std::list<DetectedRegion>& detections,
             const unsigned char* imagedata, int width, int height, int step=0) const;
 
+    /// Same as above for image buffers in any PixelFormat. If stats is
+    /// given it is set to the work done on this image.
+    void  test(const WindowClassifier& classifier, std::list<DetectedRegion>& detections,
+            const unsigned char* imagedata, int width, int height, 
+            const PixelFormat& format, DetectStats* stats=NULL) const;
+
+    /**
+     * Same as above, but only windows in one of regions are scored. Only
+     * the pyramid levels and the parts of them covered by regions are
+     * processed, so the cost grows with the area of regions rather than
+     * with the image size. All windows in regions are scored, i.e.
+     * coarsestride does not apply. Non-maximum suppression runs as usual.
+     */
+    void  test(const WindowClassifier& classifier, std::list<DetectedRegion>& detections,
+            const unsigned char* imagedata, int width, int height, 
+            const PixelFormat& format, const std::vector<SearchRegion>& regions,
+            DetectStats* stats=NULL) const;
+
+    /**
+     * Same as above with the channel feature engine: the integral channel
+     * features of every pyramid level are scanned with the soft cascade,
+     * over the same pyramid, window lattice (winstride, coarsestride with
+     * refinethreshold), ground plane prior and non-maximum suppression.
+     * Windows the cascade rejects are counted in DetectStats::rejected.
+     * The time budget and the energy prefilter do not apply.
+     */
+    void  test(const lear::StumpCascade& cascade, std::list<DetectedRegion>& detections,
+            const unsigned char* imagedata, int width, int height, 
+            const PixelFormat& format, DetectStats* stats=NULL) const;
+
 #ifdef BUILD_APP
     /** 
      * This is for internal use. Binary application functionality is coded in this.
      */
     void runImageSlider(
-        const LinearClassify& classifier, const PathVector& inlist, 
+        const WindowClassifier& classifier, const PathVector& inlist, 
         const std::string& outfile, const std::string& outimage, 
         const std::string& outhist, const std::string& falsetxt,
         const std::string& testlocs// if specified, dump test locations to this file. 
         )  const;
 #endif
 
+    /**
+     * Sets groundplane_a and groundplane_b to the least squares fit of
+     * detection height against bottom row over detections. Returns false,
+     * leaving them unchanged, if fewer than two distinct rows are given.
+     */
+    bool fitGroundPlane(const std::list<DetectedRegion>& detections);
+
     virtual void print(std::ostream& o) const ;
 
     // ===================================
@@ -439,11 +959,164 @@ struct WinDetectClassify : public WinDetect{
 
     float score2prob_a, score2prob_b;
 
+    // Non-maximum suppression method. MeanShift cost grows with the number
+    // of windows above lightthreshold, ScaleSpace cost with the number of
+    // windows.
+    NonMaxMethod nonmaxmethod;
+
+    // Greedy only: largest overlap (intersection over union) with a kept
+    // window. threshold then applies to the classifier score.
+    float nonmaxoverlap;
+
+    // Coarse-to-fine search. Windows are first scored every coarsestride
+    // lattice points (a coarse stride of coarsestride*winstride pixels),
+    // then the lattice points around coarse windows scoring above
+    // refinethreshold are scored. 1 scores every window (dense scan).
+    // Blocks are only computed for the windows scored, so gradients are
+    // the only per-pixel cost left. Lower refinethreshold trades speed
+    // for recall.
+    int coarsestride;
+    RealType refinethreshold;
+
+    // Scene geometry prior for a fixed camera. A window whose bottom is on
+    // image row r is expected to be groundplane_a*r + groundplane_b pixels
+    // high. Windows whose height differs by more than a factor
+    // 1+groundtolerance are not scored, and only the image rows of the
+    // remaining windows are processed at each level. 0 disables the prior.
+    float groundplane_a, groundplane_b, groundtolerance;
+
+    // test only: time budget in ms for one image, 0 for none. Levels are
+    // processed in order of priority, and each gets a share of the time
+    // left in proportion to its windows. From the time measured on
+    // previous levels the smallest coarse stride (up to 4) whose estimated
+    // time fits the share is used; blocks are only computed for the
+    // windows scored, so the stride bounds the block work too. Estimates
+    // are kept per detector, see levelcost(). Levels that do not fit the time left
+    // are skipped and reported in DetectStats. The time of the previous
+    // non-maximum suppression is kept for the one of this image.
+    RealType timebudget;
+
+    // Levels with scale closest to priorityscale are processed first, 0
+    // processes them from the smallest scale on.
+    RealType priorityscale;
+
+    // Flat region prefilter. Windows whose mean gradient magnitude (see
+    // WinDetect::windowenergy) is below energythreshold are rejected before
+    // their descriptor is computed, using an integral image of the
+    // magnitude of each level built right after its gradients. Blocks are
+    // then only computed for the accepted windows, so a block costs
+    // nothing unless an accepted window uses it. Pick it from positive
+    // windows at a high recall, e.g. with energy_threshold. 0 disables it.
+    // Not applied in a WinDetectSession.
+    RealType energythreshold;
+
+    // Pose variants scored over the same descriptors, see addposes.
+    // Rotations by k*poseangle degrees for k = -posesteps..posesteps, each
+    // also mirrored if posemirror. The model itself is the unrotated,
+    // unmirrored pose.
+    bool posemirror;
+    RealType poseangle;
+    int posesteps;
+
+    // Integer scoring. If positive, normalized blocks are quantized to 8
+    // bits as round(descscale*value) once per level, and windows are
+    // scored with QuantizedClassify. Pick it with quantize_rhog, which also
+    // compares the integer scores with float ones. 0 scores in float.
+    RealType descscale;
+
+    // Fixed-point descriptors. Levels are rounded to 8 bits, and gradients,
+    // magnitude, orientation bins and cell votes are computed with integer
+    // arithmetic, converting to float for block normalization (see
+    // IProcessor::fixedpoint). Requires unsmoothed gradients (gscale 0)
+    // and a NoMap, Sqrt or Log image remap. bench_rhog -b hog compares the
+    // blocks with the float ones.
+    bool fixedpoint;
+
+    // Half-precision storage. Gradient magnitudes and normalized blocks of
+    // each level are kept as float16 and orientations as 8-bit bin and
+    // 8-bit fraction, 4 instead of 8 bytes per pixel and half the block
+    // memory, while votes and normalization run in float. With fixedpoint
+    // only the blocks are affected. bench_rhog -b hog compares the blocks
+    // and the throughput with the float ones.
+    bool halfprecision;
+
+    // runImageSlider only: number of background threads writing result
+    // lists and marked images. 0 writes on the detection thread.
+    int writers;
+
+    /// time estimates of test() for timebudget, updated by every test()
+    LevelCost& levelcost() const { return levelcost_; }
+
     protected:
         void initclassifier() ;
+
+        mutable LevelCost levelcost_;
 };
 inline std::ostream& operator<<(std::ostream& o, const WinDetectClassify& windet) 
 { windet.print(o); return o; }
 
+/**
+ * Detection on consecutive frames of a fixed camera, reusing the work done
+ * on previous frames.
+ *
+ * Each frame is compared with the previous one in tiles of tilesize
+ * pixels. A tile has changed if a pixel channel differs by more than
+ * difference gray levels. The session keeps the window scores and the
+ * normalized blocks of every pyramid level. On a new frame only windows
+ * whose footprint (including interpolation and gradient support) touches
+ * a changed tile are scored again: each separate group of them has its
+ * band of the level rescaled and preprocessed on its own, and only the
+ * blocks a change touched are recomputed. Stored scores are used for all
+ * other windows. Non-maximum suppression then runs over all scores as
+ * usual.
+ *
+ * Small changes below difference are ignored, so stored scores can drift
+ * from those of the current frame. Every refresh frames all scores are
+ * recomputed. The first frame, and any frame whose size or channel
+ * layout differs from the previous one, is processed fully.
+ *
+ * All windows are scored, i.e. coarsestride does not apply. Parameters of
+ * detector other than coarsestride must not change during a session
+ * without a reset().
+ *
+ * Usage:
+ *  WinDetectSession session(windetect, classifier);
+ *  for each frame
+ *      session.test(detections, data, width, height, format);
+ *
+ * detector and classifier must outlive the session.
+ */
+class WinDetectSession {
+    public:
+        WinDetectSession(const WinDetectClassify& detector,
+                const WindowClassifier& classifier);
+        ~WinDetectSession();
+
+        /// Same as WinDetectClassify::test, for the next frame of the sequence
+        void test(std::list<DetectedRegion>& detections,
+                const unsigned char* imagedata, int width, int height,
+                const PixelFormat& format, DetectStats* stats=NULL);
+
+        /// Forget stored scores, the next frame is processed fully
+        void reset();
+
+        // Recompute all scores every refresh frames. 0 never refreshes.
+        int refresh;
+
+        // Largest channel difference (gray levels) of an unchanged pixel.
+        int difference;
+
+        // Size in pixels of the tiles frames are compared in.
+        int tilesize;
+
+    private:
+        WinDetectSession(const WinDetectSession&);
+        WinDetectSession& operator=(const WinDetectSession&);
+
+        const WinDetectClassify& detector_;
+        const WindowClassifier& classifier_;
+        WinDetectSessionCache* cache_;
+};
+
 #endif // 
 
@@ -0,0 +1,127 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  wintrack.h
+ *
+ *    Description:  Temporal detection on video: detections are tracked
+ *    from frame to frame and only their neighborhood is rescored, with a
+ *    full scan of the scale space every few frames.
+ *
+ * =====================================================================================
+ */
+
+#ifndef  _LEAR_WIN_TRACK_H_
+#define  _LEAR_WIN_TRACK_H_
+
+#include <list>
+#include <vector>
+#include <iostream>
+
+#include <lear/interface/windetect.h>
+
+/**
+ * Runs a WinDetectClassify detector on consecutive frames of a video.
+ *
+ * Detections are followed by a constant velocity tracker. On most frames
+ * only the windows around the predicted position of each track, at scales
+ * close to its scale, are scored. The whole scale space is scanned on the
+ * first frame, every fullscan frames, and when the motion energy (mean
+ * absolute difference of the green channel, sampled every 8 pixels, to the
+ * previous frame) exceeds motionthreshold. Objects entering between two
+ * full scans are only found by the next one, which bounds the recall loss
+ * by fullscan frames of latency.
+ *
+ * Usage:
+ *  WinDetectTrack track(windetect, classifier);
+ *  track.fullscan = 10;
+ *  for each frame
+ *      track.test(detections, data, width, height, format);
+ *
+ * detector and classifier must outlive this object. Any change to the
+ * public parameters applies from the next frame on.
+ */
+class WinDetectTrack {
+    public:
+        typedef WinDetect::RealType                 RealType;
+
+        /// Object followed from frame to frame, image coordinates
+        struct Track {
+            // window center when last detected, and velocity per frame
+            RealType x, y, vx, vy;
+            RealType width, height, scale, score;
+            // frames since last detection, and number of detections
+            int missed, hits;
+        };
+
+        WinDetectTrack(const WinDetectClassify& detector,
+                const WindowClassifier& classifier);
+
+        /**
+         * Detects objects in the next frame of the sequence. detections is
+         * cleared and filled as by WinDetectClassify::test. If stats is given
+         * it is set to the work done on this frame.
+         */
+        void test(std::list<DetectedRegion>& detections,
+                const unsigned char* imagedata, int width, int height,
+                const PixelFormat& format, DetectStats* stats=NULL);
+
+        /// Forget all tracks, the next frame is scanned fully
+        void reset();
+
+        /// true if the last frame was a full scan
+        bool lastfull() const { return lastfull_; }
+        /// motion energy of the last frame, 0 for the first frame
+        RealType motion() const { return motion_; }
+
+        const std::vector<Track>& tracks() const { return tracks_; }
+
+        void print(std::ostream& o) const;
+
+        // ===================================
+        // ------- Options
+        // ===================================
+
+        // Full scan every fullscan frames. 1 scans every frame fully, 0 only
+        // the first frame and frames with high motion energy.
+        int fullscan;
+
+        // Full scan if the motion energy of a frame is above this, in
+        // gray levels. 0 disables it.
+        RealType motionthreshold;
+
+        // Window centers up to searchradius times the window size (plus
+        // the velocity of the track) away from the predicted position are
+        // scored, at scales within a factor searchscale of the track scale.
+        RealType searchradius, searchscale;
+
+        // A track is dropped after maxmissed frames without detection.
+        int maxmissed;
+
+        // A detection continues a track if their windows overlap
+        // (intersection over union) by at least matchoverlap.
+        RealType matchoverlap;
+
+    private:
+        /// mean absolute difference of sampled frame to the previous one,
+        /// returns -1 if there is no comparable previous frame
+        RealType motionenergy(const unsigned char* imagedata,
+                int width, int height, const PixelFormat& format);
+        /// search regions around predicted track positions
+        void predict(std::vector<SearchRegion>& regions) const;
+        /// continue tracks with detections, start tracks for the others
+        void update(const std::list<DetectedRegion>& detections);
+
+        const WinDetectClassify& detector_;
+        const WindowClassifier& classifier_;
+
+        std::vector<Track> tracks_;
+        std::vector<unsigned char> samples_;
+        int width_, height_;
+        int sincefull_;
+        bool lastfull_;
+        RealType motion_;
+};
+inline std::ostream& operator<<(std::ostream& o, const WinDetectTrack& track)
+{ track.print(o); return o; }
+
+#endif // _LEAR_WIN_TRACK_H_
@@ -0,0 +1,73 @@
+// {{{ file documentation
+/**
+ * @file
+ * @brief Small fixed size linear algebra on blitz TinyMatrix and TinyVector.
+ */
+// }}}
+
+#ifndef _LEAR_LINALG_H_
+#define _LEAR_LINALG_H_
+
+// {{{ headers
+#include <cmath>
+#include <limits>
+#include <blitz/tinyvec.h>
+#include <blitz/tinymat.h>
+// }}}
+
+namespace lear {
+namespace numericutil {
+
+/// Determinant of a 3x3 matrix
+template<class T>
+inline T determinant(const blitz::TinyMatrix<T,3,3>& m)
+{
+    return m(0,0)*(m(1,1)*m(2,2) - m(1,2)*m(2,1))
+         - m(0,1)*(m(1,0)*m(2,2) - m(1,2)*m(2,0))
+         + m(0,2)*(m(1,0)*m(2,1) - m(1,1)*m(2,0));
+}
+
+/**
+ * Inverse of a 3x3 matrix by cofactors. A singular matrix gives the zero
+ * matrix.
+ */
+template<class T>
+blitz::TinyMatrix<T,3,3> invert(const blitz::TinyMatrix<T,3,3>& m)
+{// {{{
+    blitz::TinyMatrix<T,3,3> r;
+    const T det = determinant(m);
+    if (std::abs(det) <= std::numeric_limits<T>::min()) {
+        r = 0;
+        return r;
+    }
+    const T s = 1/det;
+    r(0,0) = s*(m(1,1)*m(2,2) - m(1,2)*m(2,1));
+    r(0,1) = s*(m(0,2)*m(2,1) - m(0,1)*m(2,2));
+    r(0,2) = s*(m(0,1)*m(1,2) - m(0,2)*m(1,1));
+    r(1,0) = s*(m(1,2)*m(2,0) - m(1,0)*m(2,2));
+    r(1,1) = s*(m(0,0)*m(2,2) - m(0,2)*m(2,0));
+    r(1,2) = s*(m(0,2)*m(1,0) - m(0,0)*m(1,2));
+    r(2,0) = s*(m(1,0)*m(2,1) - m(1,1)*m(2,0));
+    r(2,1) = s*(m(0,1)*m(2,0) - m(0,0)*m(2,1));
+    r(2,2) = s*(m(0,0)*m(1,1) - m(0,1)*m(1,0));
+    return r;
+}// }}}
+
+/// Matrix vector product m*v
+template<class T, int N, int M>
+blitz::TinyVector<T,N> multiply(
+        const blitz::TinyMatrix<T,N,M>& m, const blitz::TinyVector<T,M>& v)
+{
+    blitz::TinyVector<T,N> r;
+    for (int i= 0; i< N; ++i) {
+        r[i] = 0;
+        for (int j= 0; j< M; ++j)
+            r[i] += m(i,j)*v[j];
+    }
+    return r;
+}
+
+}
+}
+
+#endif // _LEAR_LINALG_H_
@@ -0,0 +1,63 @@
+// {{{ file documentation
+/**
+ * @file
+ * @brief Minimal POSIX threads wrappers: mutex, scoped lock, condition.
+ */
+// }}}
+
+#ifndef _LEAR_THREAD_H_
+#define _LEAR_THREAD_H_
+
+#include <pthread.h>
+
+namespace lear {
+
+/// Non-recursive mutex
+class Mutex {
+    public:
+        Mutex() { pthread_mutex_init(&m_, NULL); }
+        ~Mutex() { pthread_mutex_destroy(&m_); }
+
+        void lock() { pthread_mutex_lock(&m_); }
+        void unlock() { pthread_mutex_unlock(&m_); }
+        pthread_mutex_t* native() { return &m_; }
+
+    private:
+        Mutex(const Mutex&);
+        Mutex& operator=(const Mutex&);
+
+        pthread_mutex_t m_;
+};
+
+/// Holds a Mutex for its lifetime
+class ScopedLock {
+    public:
+        explicit ScopedLock(Mutex& m) : m_(m) { m_.lock(); }
+        ~ScopedLock() { m_.unlock(); }
+
+    private:
+        ScopedLock(const ScopedLock&);
+        ScopedLock& operator=(const ScopedLock&);
+
+        Mutex& m_;
+};
+
+/// Condition variable, wait() must be called with m locked
+class Condition {
+    public:
+        Condition() { pthread_cond_init(&c_, NULL); }
+        ~Condition() { pthread_cond_destroy(&c_); }
+
+        void wait(Mutex& m) { pthread_cond_wait(&c_, m.native()); }
+        void signal() { pthread_cond_signal(&c_); }
+        void broadcast() { pthread_cond_broadcast(&c_); }
+
+    private:
+        Condition(const Condition&);
+        Condition& operator=(const Condition&);
+
+        pthread_cond_t c_;
+};
+
+}
+#endif // _LEAR_THREAD_H_
@@ -0,0 +1,260 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  blockmap.cpp
+ *
+ *    Description:  Provides implementation to blockmap.h
+ *
+ * =====================================================================================
+ */
+
+#include <lear/cvision/blockmap.h>
+
+using namespace lear;
+
+static inline bool equal(const BlockMap::IndexType a, const BlockMap::IndexType b)
+{
+    return a[0] == b[0] && a[1] == b[1];
+}
+
+void BlockMap::compute(
+        const RHOGDense& desc,
+        const RHOGDense::Preprocessor& p,
+        const IndexType origin,
+        const IndexType stride)
+{// {{{
+    lazy_ = false;
+    shift_ = 0;
+    if (!lattice(desc, p.extent, origin, stride))
+        return;
+    usecells_ = cellgrid_ && buildcells(desc, p);
+
+    if (half_) {
+        computehalf(desc, p);
+        return;
+    }
+    const int count = blitz::product(extent_);
+    if (static_cast<int>(data_.size()) < count*featsize_)
+        data_.resize(count*featsize_);
+
+    for (int i= 0; i< extent_[0]; ++i)
+        fillrow(desc, p, i, &data_[0] + i*extent_[1]*featsize_);
+
+    desc.blocknormalizer()(&data_[0], count, featsize_);
+    if (qscale_ > 0)
+        fillquantized();
+}// }}}
+
+void BlockMap::prepare(
+        const RHOGDense& desc,
+        const RHOGDense::Preprocessor& p,
+        const IndexType origin,
+        const IndexType stride)
+{// {{{
+    filled_.clear();
+    prepare(desc, origin, stride, p.extent, IndexType(0));
+}// }}}
+
+void BlockMap::prepare(
+        const RHOGDense& desc,
+        const IndexType origin,
+        const IndexType stride,
+        const IndexType area,
+        const IndexType shift)
+{// {{{
+    const bool same = lazy_ && featsize_ == desc.length() && 
+        equal(origin_, origin) && equal(stride_, stride) && equal(area_, area);
+    lazy_ = true;
+    usecells_ = false;
+    shift_ = shift;
+    if (!lattice(desc, area, origin, stride)) {
+        filled_.clear();
+        return;
+    }
+    const int count = blitz::product(extent_);
+    if (!same || static_cast<int>(filled_.size()) != count)
+        filled_.assign(count, 0);
+    const int size = count*featsize_;
+    if (half_ && static_cast<int>(hdata_.size()) < size)
+        hdata_.resize(size);
+    if (!half_ && static_cast<int>(data_.size()) < size)
+        data_.resize(size);
+    if (qscale_ > 0 && static_cast<int>(qdata_.size()) < size)
+        qdata_.resize(size);
+}// }}}
+
+void BlockMap::fill(
+        const RHOGDense& desc,
+        const RHOGDense::Preprocessor& p,
+        const IndexType* loc,
+        const int count)
+{// {{{
+    if (!lazy_ || empty())
+        return;
+    pending_.clear();
+    for (int k= 0; k< count; ++k) {
+        if (!onlattice(loc[k]))
+            continue;
+        const int i = index(loc[k]);
+        if (filled_[i])
+            continue;
+        filled_[i] = 1;
+        pending_.push_back(i);
+    }
+    const int n = pending_.size();
+    if (!n)
+        return;
+    if (static_cast<int>(scratch_.size()) < n*featsize_)
+        scratch_.resize(n*featsize_);
+
+    for (int m= 0; m< n; ++m) {
+        const int i = pending_[m];
+        single(desc, p, 
+                origin_ + IndexType(i/extent_[1], i%extent_[1])*stride_ - shift_,
+                &scratch_[m*featsize_]);
+    }
+    desc.blocknormalizer()(&scratch_[0], n, featsize_);
+
+    for (int m= 0; m< n; ++m) {
+        const ElemType* b = &scratch_[m*featsize_];
+        const int o = pending_[m]*featsize_;
+        if (half_)
+            float2half(b, &hdata_[o], featsize_);
+        else
+            std::copy(b, b + featsize_, &data_[o]);
+        if (qscale_ > 0)
+            for (int k= 0; k< featsize_; ++k) 
+                qdata_[o + k] = quantize8(b[k], qscale_);
+    }
+}// }}}
+
+bool BlockMap::lattice(
+        const RHOGDense& desc,
+        const IndexType area,
+        const IndexType origin,
+        const IndexType stride)
+{// {{{
+    featsize_ = desc.length();
+    origin_ = origin;
+    stride_ = stride;
+    area_ = area;
+
+    const IndexType room (area - desc.extent() - origin_);
+    if (room[0] < 0 || room[1] < 0) {
+        extent_ = 0;
+        return false;
+    }
+    extent_ = room/stride_ + 1;
+    return true;
+}// }}}
+
+void BlockMap::single(
+        const RHOGDense& desc,
+        const RHOGDense::Preprocessor& p,
+        const IndexType loc,
+        ElemType* dest) const
+{// {{{
+    if (cellgrid_)
+        desc.cellblock(loc, p, dest);
+    else
+        desc.histogram(loc, p, dest);
+}// }}}
+
+void BlockMap::computehalf(
+        const RHOGDense& desc,
+        const RHOGDense::Preprocessor& p)
+{// {{{
+    // one lattice row in float at a time, normalized and converted
+    const int row = extent_[1]*featsize_;
+    if (static_cast<int>(data_.size()) < row)
+        data_.resize(row);
+    if (static_cast<int>(hdata_.size()) < extent_[0]*row)
+        hdata_.resize(extent_[0]*row);
+    if (qscale_ > 0 && static_cast<int>(qdata_.size()) < extent_[0]*row)
+        qdata_.resize(extent_[0]*row);
+
+    for (int i= 0; i< extent_[0]; ++i) {
+        fillrow(desc, p, i, &data_[0]);
+        desc.blocknormalizer()(&data_[0], extent_[1], featsize_);
+        float2half(&data_[0], &hdata_[i*row], row);
+        if (qscale_ > 0)
+            for (int k= 0; k< row; ++k) 
+                qdata_[i*row + k] = quantize8(data_[k], qscale_);
+    }
+}// }}}
+
+bool BlockMap::buildcells(
+        const RHOGDense& desc,
+        const RHOGDense::Preprocessor& p)
+{// {{{
+    const IndexType cellsize (desc.cellsize());
+    for (int k= 0; k< 2; ++k) 
+        if (cellsize[k] % stride_[k])
+            return false;
+
+    // blocks at lattice index (a,b) + m*phases_ share the grid of cells
+    // with top-left corner origin_ + (a,b)*stride_
+    phases_ = cellsize/stride_;
+    const int count = blitz::product(phases_), bins = desc.fixedbins();
+    cellcount_.resize(count);
+    celloffset_.resize(count);
+    int size = 0;
+    for (int a= 0; a< phases_[0]; ++a) 
+    for (int b= 0; b< phases_[1]; ++b) {
+        const int k = a*phases_[1] + b;
+        const IndexType blocks ((extent_ - IndexType(a,b) + phases_ - 1)/phases_);
+        cellcount_[k] = blocks[0] > 0 && blocks[1] > 0 
+            ? IndexType(blocks + desc.numcell() - 1) : IndexType(0);
+        celloffset_[k] = size;
+        size += blitz::product(cellcount_[k])*bins;
+    }
+    if (static_cast<int>(cells_.size()) < size)
+        cells_.resize(size);
+
+    for (int a= 0; a< phases_[0]; ++a) 
+    for (int b= 0; b< phases_[1]; ++b) {
+        const int k = a*phases_[1] + b;
+        if (blitz::product(cellcount_[k]) > 0)
+            desc.cells(origin_ + IndexType(a,b)*stride_, cellcount_[k], p,
+                    &cells_[celloffset_[k]]);
+    }
+    return true;
+}// }}}
+
+void BlockMap::fillrow(
+        const RHOGDense& desc,
+        const RHOGDense::Preprocessor& p,
+        const int i,
+        ElemType* dest) const
+{// {{{
+    if (!usecells_) {
+        for (int j= 0; j< extent_[1]; ++j, dest+=featsize_)
+            single(desc, p, origin_ + IndexType(i,j)*stride_, dest);
+        return;
+    }
+    for (int j= 0; j< extent_[1]; ++j, dest+=featsize_) {
+        const int k = (i % phases_[0])*phases_[1] + j % phases_[1];
+        desc.block(&cells_[celloffset_[k]], cellcount_[k], 
+                IndexType(i/phases_[0], j/phases_[1]), dest);
+    }
+}// }}}
+
+void BlockMap::quantize(const ElemType scale)
+{
+    qscale_ = scale;
+    if (qscale_ > 0 && !empty())
+        fillquantized();
+}
+
+void BlockMap::fillquantized()
+{// {{{
+    const int size = blitz::product(extent_)*featsize_;
+    if (static_cast<int>(qdata_.size()) < size)
+        qdata_.resize(size);
+    if (half_)
+        for (int i= 0; i< size; ++i) 
+            qdata_[i] = quantize8(half2float(hdata_[i]), qscale_);
+    else
+        for (int i= 0; i< size; ++i) 
+            qdata_[i] = quantize8(data_[i], qscale_);
+}// }}}
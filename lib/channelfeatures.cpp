@@ -0,0 +1,136 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  channelfeatures.cpp
+ *
+ *    Description:  Provides implementation to channelfeatures.h
+ *
+ * =====================================================================================
+ */
+
+#include <iomanip>
+#include <algorithm>
+
+#include <lear/exception.h>
+#include <lear/image/colortable.h>
+#include <lear/image/colorconversion.h>
+
+#include <lear/cvision/channelfeatures.h>
+
+using namespace lear;
+
+namespace {
+/// LUV is converted through a table, built on first use
+const ColorTable& luvtable() {
+    static const ColorTable table(RGB2LuvFunctor(), 65);
+    return table;
+}
+}
+
+ChannelFeatures::ChannelFeatures(
+        const int orientbin, const bool luv, const RealType gscale) 
+    :
+    orientbin_(orientbin), luv_(luv), gscale_(gscale), processor_(NULL),
+    extent_(0), size_(0)
+{
+    if (orientbin_ < 1)
+        throw Exception("ChannelFeatures::ChannelFeatures",
+                "At least one orientation bin is required");
+    if (gscale_ > 0)
+        processor_ = new GradProcessor(gscale_, true);
+    else
+        processor_ = new GradProcessor_NoSmooth(true);
+}
+
+ChannelFeatures::~ChannelFeatures() 
+{
+    delete processor_;
+}
+
+void ChannelFeatures::compute(const GrayImage& image) 
+{
+    if (!luv_) {
+        integrate((*processor_)(image), NULL);
+        return;
+    }
+    RGBImage color(image.lbound(), image.extent());
+    RGBImage::iterator c = color.begin();
+    for (GrayImage::const_iterator i = image.begin(); i != image.end(); ++i, ++c)
+        *c = *i;
+    integrate((*processor_)(image), &color);
+}
+
+void ChannelFeatures::compute(const RGBImage& image) 
+{
+    integrate((*processor_)(image), luv_ ? &image : NULL);
+}
+
+void ChannelFeatures::integrate(
+        const IProcessor::InfoType& grad, const RGBImage* color) 
+{// {{{
+    const IProcessor::InfoType::MagAType& mag = grad.mag;
+    const IProcessor::InfoType::OriAType& ori = grad.ori;
+    extent_ = mag.extent();
+    const int w = extent_[0], h = extent_[1];
+    if (color && (color->extent(0) != w || color->extent(1) != h))
+        throw Exception("ChannelFeatures::compute",
+                "Gradient and image extents differ");
+
+    const int numch = channels();
+    size_ = (w + 1)*(h + 1);
+    if (static_cast<int>(integral_.size()) < numch*size_)
+        integral_.resize(numch*size_);
+    // first column of each channel
+    for (int c= 0; c< numch; ++c)
+        std::fill(&integral_[c*size_], &integral_[c*size_] + h + 1, 0);
+
+    const IndexType mlb (mag.lbound()), olb (ori.lbound());
+    IndexType clb (0);
+    if (color)
+        clb = color->lbound();
+    const ColorTable& table = luvtable();
+
+    std::vector<SumType> column(numch);
+    std::vector<RealType> value(numch);
+    for (int x= 0; x< w; ++x) {
+        std::fill(column.begin(), column.end(), 0);
+        // integral column x+1, previous column at -(h+1)
+        const int base = (x + 1)*(h + 1);
+        for (int c= 0; c< numch; ++c)
+            integral_[c*size_ + base] = 0;
+
+        for (int y= 0; y< h; ++y) {
+            const RealType m = mag(mlb[0] + x, mlb[1] + y);
+            std::fill(value.begin(), value.end(), 0);
+            value[0] = m;
+            const int bin = std::min(orientbin_ - 1, 
+                    ori(olb[0] + x, olb[1] + y)*orientbin_/180);
+            value[1 + std::max(bin, 0)] = m;
+            if (color) {
+                const ColorTable::ColorType luv (
+                        table((*color)(clb[0] + x, clb[1] + y)));
+                for (int k= 0; k< 3; ++k)
+                    value[1 + orientbin_ + k] = luv[k];
+            }
+            for (int c= 0; c< numch; ++c) {
+                SumType* s = &integral_[c*size_ + base + y + 1];
+                column[c] += value[c];
+                *s = *(s - (h + 1)) + column[c];
+            }
+        }
+    }
+}// }}}
+
+void ChannelFeatures::print(std::ostream& o) const 
+{
+    using namespace std;
+    o << "ChannelFeatures ::\n"
+        "  | Orient  " << setw(4) << left << orientbin_ << "  LUV " << setw(2) << luv_ << "  GScale " << setw(6) << gscale_ << right << "        |\n"
+        "  |----------------------------------------------|\n";
+}
+
+std::ostream& lear::operator<<(std::ostream& o, const ChannelFeatures& f) 
+{
+    f.print(o);
+    return o;
+}
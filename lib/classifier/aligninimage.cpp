@@ -35,8 +35,13 @@ void lear::AlignInImage::write(
     typedef blitz::TinyVector<int,3>    PixelType;
     typedef blitz::Array<PixelType,2>   ImageType;
 
+    // Imlib2 works on one global context, possibly on a writer thread:
+    // lock only while reading and writing, not while cropping
     ImageType inimage;
-    ImageIO::read(filename,inimage);
+    {
+        ScopedLock lock(ImageIO::mutex());
+        ImageIO::read(filename,inimage);
+    }
 
     DetectInfo best;
     bool bestvalid=false;
@@ -99,7 +104,10 @@ void lear::AlignInImage::write(
         for (int i= rub[1]+1; i< oex[1]; ++i)
             outimage(all,i) = outimage(all,rub[1]);
         
-        ImageIO::write(fname,outimage);
+        {
+            ScopedLock lock(ImageIO::mutex());
+            ImageIO::write(fname,outimage);
+        }
 
         std::cout << filename  << best << std::ends;
         std::cout << " Domain " << dlb << ", " << dub << std::ends;
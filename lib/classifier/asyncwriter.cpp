@@ -0,0 +1,134 @@
+#include <iostream>
+#include <exception>
+#include <lear/exception.h>
+
+#include <lear/classifier/asyncwriter.h>
+
+lear::AsyncWriter::AsyncWriter(const int numthread, const int maxpending)
+        :
+    maxpending_(maxpending > 0 ? maxpending : 4*numthread),
+    running_(0),
+    stop_(false)
+{
+    if (numthread < 1)
+        throw Exception("AsyncWriter::AsyncWriter()",
+                "Number of writer threads must be positive");
+
+    thread_.reserve(numthread);
+    for (int i= 0; i< numthread; ++i) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, &AsyncWriter::run, this)) {
+            {
+                ScopedLock lock(mutex_);
+                stop_ = true;
+                haswork_.broadcast();
+            }
+            for (unsigned j= 0; j< thread_.size(); ++j)
+                pthread_join(thread_[j], NULL);
+            throw Exception("AsyncWriter::AsyncWriter()",
+                    "Unable to start writer thread");
+        }
+        thread_.push_back(t);
+    }
+}
+
+lear::AsyncWriter::~AsyncWriter()
+{
+    {
+        ScopedLock lock(mutex_);
+        stop_ = true;
+        haswork_.broadcast();
+    }
+    for (unsigned i= 0; i< thread_.size(); ++i)
+        pthread_join(thread_[i], NULL);
+    if (!error_.empty())
+        std::cerr << "Writer error: " << error_ << std::endl;
+}
+
+void lear::AsyncWriter::push(PostProcessResult* pp,
+        const_iterator s, const_iterator e, const std::string& filename)
+{
+    Job* job = new Job;
+    job->pp = pp;
+    job->filename = filename;
+    job->detect.reserve(e - s);
+    for (; s != e; ++s)
+        job->detect.push_back(*s);
+
+    ScopedLock lock(mutex_);
+    while (error_.empty() &&
+            static_cast<int>(queue_.size()) + running_ >= maxpending_)
+        hasroom_.wait(mutex_);
+    if (!error_.empty()) {
+        delete job;
+        rethrow();
+    }
+    queue_.push_back(job);
+    haswork_.signal();
+}
+
+void lear::AsyncWriter::flush()
+{
+    ScopedLock lock(mutex_);
+    while (error_.empty() && (!queue_.empty() || running_))
+        hasroom_.wait(mutex_);
+    rethrow();
+}
+
+void lear::AsyncWriter::rethrow()
+{
+    if (error_.empty())
+        return;
+    std::string mesg;
+    mesg.swap(error_);
+    throw Exception("AsyncWriter", mesg);
+}
+
+void* lear::AsyncWriter::run(void* self)
+{
+    static_cast<AsyncWriter*>(self)->work();
+    return NULL;
+}
+
+void lear::AsyncWriter::work()
+{// {{{
+    ScopedLock lock(mutex_);
+    for (;;) {
+        // oldest job whose post-processor is idle, this keeps push order
+        // for each post-processor
+        std::deque<Job*>::iterator j = queue_.begin();
+        while (j != queue_.end() && busy_.count((*j)->pp))
+            ++j;
+        if (j == queue_.end()) {
+            if (stop_ && queue_.empty())
+                return;
+            haswork_.wait(mutex_);
+            continue;
+        }
+
+        Job* job = *j;
+        queue_.erase(j);
+        busy_.insert(job->pp);
+        ++running_;
+
+        std::string err;
+        mutex_.unlock();
+        try {
+            job->pp->write(job->detect.begin(), job->detect.end(), job->filename);
+        } catch (std::exception& e) {
+            err = job->filename + ": " + e.what();
+        } catch (...) {
+            err = job->filename + ": unknown exception";
+        }
+        mutex_.lock();
+
+        if (!err.empty() && error_.empty())
+            error_ = err;
+        busy_.erase(job->pp);
+        --running_;
+        delete job;
+        // a job of this post-processor may now be runnable
+        haswork_.broadcast();
+        hasroom_.broadcast();
+    }
+}// }}}
@@ -0,0 +1,115 @@
+#include <cmath>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+
+using namespace std;
+
+#include <lear/classifier/greedy_processresult.h>
+
+namespace {
+/// orders candidate indices by decreasing score
+struct ByScore {
+    const float* s;
+    ByScore(const float* s) : s(s) {}
+    bool operator()(const int a, const int b) const
+    { return s[a] > s[b]; }
+};
+}
+
+lear::Greedy_ProcessResult::Greedy_ProcessResult(
+    const RealType threshold_,
+    const RealType finalthreshold_,
+    const RealType overlap_)
+        :
+    Parent(threshold_),
+    finalthreshold_(finalthreshold_),
+    overlap_(overlap_)
+{}
+
+std::string lear::Greedy_ProcessResult::toString()
+{
+    char s[256];
+    sprintf(s, "Greedy NonMax Process Result\n    overlap <= %2.3f", overlap_);
+    return s;
+}
+
+lear::Greedy_ProcessResult::RealType lear::Greedy_ProcessResult::overlap(
+        const DetectInfo& a, const DetectInfo& b)
+{
+    const int x0 = std::max(a.lbound[0], b.lbound[0]);
+    const int y0 = std::max(a.lbound[1], b.lbound[1]);
+    const int x1 = std::min(a.lbound[0]+a.extent[0], b.lbound[0]+b.extent[0]);
+    const int y1 = std::min(a.lbound[1]+a.extent[1], b.lbound[1]+b.extent[1]);
+    if (x1 <= x0 || y1 <= y0)
+        return 0;
+    const RealType inter = static_cast<RealType>(x1-x0)*(y1-y0);
+    const RealType areaa = static_cast<RealType>(a.extent[0])*a.extent[1];
+    const RealType areab = static_cast<RealType>(b.extent[0])*b.extent[1];
+    return inter/(areaa + areab - inter);
+}
+
+void lear::Greedy_ProcessResult::doit()
+{// {{{
+    if (detect_.empty())
+        return;
+
+    const int n = detect_.size();
+    const float* score = detect_.score();
+    const int* lb[2] = { detect_.lbound(0), detect_.lbound(1) };
+    const int* ext[2] = { detect_.extent(0), detect_.extent(1) };
+
+    // grid over the bounding box of all windows, cells of smallest window size
+    int lo[2], hi[2], cell[2];
+    for (int d= 0; d< 2; ++d) {
+        lo[d] = lb[d][0];
+        hi[d] = lb[d][0] + ext[d][0];
+        cell[d] = std::max(ext[d][0], 1);
+        for (int i= 1; i< n; ++i) {
+            lo[d] = std::min(lo[d], lb[d][i]);
+            hi[d] = std::max(hi[d], lb[d][i] + ext[d][i]);
+            cell[d] = std::min(cell[d], std::max(ext[d][i], 1));
+        }
+    }
+    const int gx = (hi[0]-lo[0])/cell[0] + 1, gy = (hi[1]-lo[1])/cell[1] + 1;
+    vector< vector<int> > grid(gx*gy);
+
+    vector<int> order(n);
+    for (int i= 0; i< n; ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), ByScore(score));
+
+    vector<DetectInfo> kept;
+    for (int k= 0; k< n; ++k) {
+        const DetectInfo c = detect_[order[k]];
+        // cells covered by the window
+        const int cx0 = (c.lbound[0] - lo[0])/cell[0];
+        const int cy0 = (c.lbound[1] - lo[1])/cell[1];
+        const int cx1 = (c.lbound[0] + std::max(c.extent[0],1) - 1 - lo[0])/cell[0];
+        const int cy1 = (c.lbound[1] + std::max(c.extent[1],1) - 1 - lo[1])/cell[1];
+
+        bool suppressed = false;
+        for (int x= cx0; x<= cx1 && !suppressed; ++x)
+        for (int y= cy0; y<= cy1 && !suppressed; ++y) {
+            const vector<int>& g = grid[x*gy + y];
+            for (unsigned j= 0; j< g.size(); ++j)
+                if (overlap(kept[g[j]], c) > overlap_) {
+                    suppressed = true;
+                    break;
+                }
+        }
+        if (suppressed)
+            continue;
+
+        for (int x= cx0; x<= cx1; ++x)
+        for (int y= cy0; y<= cy1; ++y)
+            grid[x*gy + y].push_back(kept.size());
+        kept.push_back(c);
+    }
+
+    detect_.clear();
+    for (unsigned i= 0; i< kept.size(); ++i)
+        if (kept[i].score > finalthreshold_)
+            detect_.push_back(kept[i]);
+}// }}}
+
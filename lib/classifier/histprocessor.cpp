@@ -30,3 +30,12 @@ void lear::HistProcessor::operator()(const RealType score)
     }
 }
 
+void lear::HistProcessor::operator()(const RealType* score, const int n)
+{
+    if (!dohistout_)
+        return;
+    for (int i= 0; i< n; ++i) {
+        RealType d = std::max(score[i],minTh_);
+        histall_(std::min(d,maxTh_));
+    }
+}
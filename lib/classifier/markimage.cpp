@@ -3,6 +3,7 @@
 #include <lear/exception.h>
 #include <lear/util/fileutil.h>
 #include <lear/image/painter.h>
+#include <lear/image/imageio.h>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
@@ -55,46 +56,54 @@ bool lear::MarkImage::verifyImageOut(
 }
 
 namespace somegarbagename {
+    /**
+     * Marks bounding boxes on an image loaded from file and saves it when
+     * destroyed. Imlib2 works on one global context, so each call takes
+     * ImageIO::mutex() only while it uses Imlib2: a writer thread does not
+     * block the detection thread for a whole image.
+     */
     class DrawBoundingBox {// {{{
         public:
             typedef blitz::TinyVector<int,2>        IndexType;
 
-            DrawBoundingBox() {}
             DrawBoundingBox(
                     const std::string& infile, const std::string& outfile) :
-                painter(infile), outfile_(outfile)
-            {}
-
-            void load(const std::string& infile) {
-                painter.load(infile);
-            }
-            void saveto(const std::string& outfile) {
-                outfile_ = outfile;
+                painter(NULL), outfile_(outfile)
+            {
+                lear::ScopedLock lock(lear::ImageIO::mutex());
+                painter = new lear::Painter(infile);
             }
 
             void draw(const IndexType& lbound, const IndexType& extent) {
                 lear::Rectangle<int>  r(
                         lbound[0]+1,lbound[1]+1,extent[0]-2,extent[1]-2);
 
-                painter.setColor(colorR, colorG, colorB);
-                painter.drawRect(r);
-                painter.setColor(colorR, colorB, colorG);
-                painter.drawRect(r - 1);
+                lear::ScopedLock lock(lear::ImageIO::mutex());
+                painter->setColor(colorR, colorG, colorB);
+                painter->drawRect(r);
+                painter->setColor(colorR, colorB, colorG);
+                painter->drawRect(r - 1);
             }
             void draw(const IndexType& xy, const std::string& txt) {
-                painter.setBrush(0, 0, 0);
-                painter.drawRect(xy[0],xy[1],54,15);
-                painter.noBrush();
-                painter.setColor(255, 255, 255);
-                painter.drawText(txt,xy[0]+2,xy[1]+1);
+                lear::ScopedLock lock(lear::ImageIO::mutex());
+                painter->setBrush(0, 0, 0);
+                painter->drawRect(xy[0],xy[1],54,15);
+                painter->noBrush();
+                painter->setColor(255, 255, 255);
+                painter->drawText(txt,xy[0]+2,xy[1]+1);
             }
             ~DrawBoundingBox() {
+                lear::ScopedLock lock(lear::ImageIO::mutex());
                 if (!outfile_.empty())
-                    painter.save(outfile_);
+                    painter->save(outfile_);
+                delete painter;
             }
 
         private:
-            lear::Painter painter;
+            DrawBoundingBox(const DrawBoundingBox&);
+            DrawBoundingBox& operator=(const DrawBoundingBox&);
+
+            lear::Painter* painter;
             std::string outfile_;
 
             static const int colorR  = 255;
@@ -110,6 +119,8 @@ void lear::MarkImage::write(
     if (outfileIsDir_) {
         fname += "/" + lear::basename(filename) +".jpg";
     }
+    // Painter works on the Imlib2 context, possibly on a writer thread:
+    // the marker locks around each Imlib2 call
     somegarbagename::DrawBoundingBox marker(filename,fname);
 
     char scoretxt[24];
@@ -122,4 +133,3 @@ void lear::MarkImage::write(
         ++s;
     }
 }// }}}
-
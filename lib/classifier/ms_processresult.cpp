@@ -115,16 +115,18 @@ void lear::MS_ProcessResult::doit()
 
     if (!detect_.empty()) {
 
-        vector<PointType> at(numdetection_);
-        vector<RealType > wt(numdetection_);
+        const int n = detect_.size();
+        vector<PointType> at(n);
+        vector<RealType > wt(n);
         {
-            unsigned index = 0;
-            for (const_iterator i=detect_.begin(); 
-                    i != detect_.end(); ++i,++index) 
-            {
-                wt[index] = (*sigmoid)(i->score);
-                blitz::TinyVector<RealType,2> cen = i->lbound+i->extent/2.0;
-                at[index] = PointType(cen[0],cen[1],std::log(i->scale));
+            const float* score = detect_.score();
+            const float* scale = detect_.scale();
+            const int *lx = detect_.lbound(0), *ly = detect_.lbound(1);
+            const int *ex = detect_.extent(0), *ey = detect_.extent(1);
+            for (int i= 0; i< n; ++i) {
+                wt[i] = (*sigmoid)(score[i]);
+                at[i] = PointType(lx[i]+ex[i]/2.0, ly[i]+ey[i]/2.0,
+                        std::log(scale[i]));
             }
         }
         PointType nsigma = sigma_;
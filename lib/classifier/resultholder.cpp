@@ -9,6 +9,18 @@ void lear::ResultHolder::clear(){
         (**i).clear();
     }
 }
+void lear::ResultHolder::newpyramid(
+        const DetectInfo::IndexType topleft,
+        const DetectInfo::IndexType extent,
+        const ProcessResult::RealType scale,
+        const DetectInfo::IndexType shift)
+{
+    for (ProcessCont::iterator i=processcont_.begin();
+            i != processcont_.end(); ++i) 
+    {
+        (**i).newpyramid(topleft, extent, scale, shift);
+    }
+}
 bool lear::ResultHolder::operator()(const DetectInfo& r){
     for (ProcessCont::iterator i=processcont_.begin();
             i != processcont_.end(); ++i) 
@@ -17,6 +29,13 @@ bool lear::ResultHolder::operator()(const DetectInfo& r){
     }
     return true;
 }
+void lear::ResultHolder::operator()(const ScoreBatch& b){
+    for (ProcessCont::iterator i=processcont_.begin();
+            i != processcont_.end(); ++i) 
+    {
+        (**i)(b);
+    }
+}
 
 void lear::ResultHolder::print(std::ostream& o) const {
     o << "Operations on results :: " << std::endl;
@@ -45,12 +64,30 @@ void lear::ResultHolder::write(const std::string filename)
                 j != pp->end(); ++j) 
         {
 //std::cout << "post processing " << (*j)->toString() << std::endl;
-            (**j).write((**i).begin(),(**i).end(),filename);
+            if (writer_)
+                writer_->push(*j, (**i).begin(), (**i).end(), filename);
+            else
+                (**j).write((**i).begin(),(**i).end(),filename);
         }
     }
 }
 
+void lear::ResultHolder::async(const int numthread, const int maxpending)
+{
+    delete writer_;
+    writer_ = NULL;
+    if (numthread > 0)
+        writer_ = new AsyncWriter(numthread, maxpending);
+}
+void lear::ResultHolder::flush()
+{
+    if (writer_)
+        writer_->flush();
+}
+
 lear::ResultHolder::~ResultHolder(){
+    // pending writes use the post-processors
+    delete writer_;
     ContCont::iterator pp=postcont_.begin();
     for (ProcessCont::iterator i=processcont_.begin();
             i != processcont_.end(); ++i,++pp) 
@@ -0,0 +1,336 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <lear/exception.h>
+#include <lear/blitz/ext/sepconvolve.h>
+#include <lear/cvision/interpolateposition.h>
+
+using namespace std;
+
+#include <lear/classifier/ss_processresult.h>
+
+namespace {
+typedef lear::SS_ProcessResult::RealType        RealType;
+typedef lear::SS_ProcessResult::Array1DType     Array1DType;
+
+/// Unnormalized Gaussian exp(-k^2/(2 sigma^2)) on [-3 sigma, 3 sigma]
+Array1DType gausskernel(const RealType sigma)
+{
+    const int r = sigma > 0 ? static_cast<int>(std::ceil(3*sigma)) : 0;
+    Array1DType k(blitz::Range(-r,r));
+    for (int i= -r; i<= r; ++i)
+        k(i) = r ? std::exp(-(i*i)/(2*sigma*sigma)) : 1;
+    return k;
+}
+
+/// orders level indices by their log scale
+struct ByLogScale {
+    const std::vector<RealType>& logscale;
+    explicit ByLogScale(const std::vector<RealType>& logscale) 
+        : logscale(logscale) {}
+    bool operator()(const int a, const int b) const {
+        return logscale[a] < logscale[b];
+    }
+};
+}
+
+lear::SS_ProcessResult::SS_ProcessResult(
+    const IndexType extent_,
+    const RealType threshold_,
+    const RealType finalthreshold_,
+    const SigmoidType score2prob_,
+    const Real3DType sigma_,
+    const int transfunc,
+    const IndexType stride_,
+    const int winsize_)
+        :
+    Parent(),
+    extent_(extent_),
+    threshold_(threshold_),
+    finalthreshold_(finalthreshold_),
+    sigma_(sigma_),
+    stride_(stride_),
+    winsize_(winsize_),
+    smoothkernelX(gausskernel(sigma_[0]/stride_[0])),
+    smoothkernelY(gausskernel(sigma_[1]/stride_[1])),
+    topleft(0),
+    image(NULL)
+{
+    switch (transfunc) {
+        case 1:
+        sigmoid=new Sigmoid<RealType>(score2prob_[0],score2prob_[1]);
+        break;
+        case 2:
+        sigmoid=new SoftMax<RealType>(score2prob_[0],score2prob_[1]);
+        break;
+        case 0:
+        default:
+        sigmoid=new HardMax<RealType>(score2prob_[0],threshold_);
+        break;
+    };
+}
+
+lear::SS_ProcessResult::~SS_ProcessResult()
+{
+    delete sigmoid;
+}
+
+void lear::SS_ProcessResult::clear()
+{
+    Parent::clear();
+    pyimage.clear();
+    pyscale.clear();
+    pytopleft.clear();
+    pyextent.clear();
+    pyshift.clear();
+    image = NULL;
+}
+
+void lear::SS_ProcessResult::newpyramid(
+        const IndexType tl,
+        const IndexType extent,
+        const RealType scale,
+        const IndexType shift)
+{
+    pyimage.push_back(ScoreImage(extent));
+    pyimage.back() = 0;
+    pyscale.push_back(scale);
+    pytopleft.push_back(tl);
+    pyextent.push_back(extent);
+    pyshift.push_back(shift);
+
+    topleft = tl;
+    image = &pyimage.back();
+}
+
+bool lear::SS_ProcessResult::put(const RealType score, const int x, const int y)
+{
+    const int at[2] = {x, y};
+    IndexType cell;
+    for (int d= 0; d< 2; ++d) {
+        const int off = at[d] - topleft[d];
+        cell[d] = off/stride_[d];
+        if (off < 0 || off % stride_[d] || cell[d] >= image->extent(d))
+            return false;
+    }
+    (*image)(cell) = (*sigmoid)(score);
+    ++numdetection_;
+    return true;
+}
+
+bool lear::SS_ProcessResult::operator()(const DetectInfo& r)
+{
+    if (!image || !(r.score > threshold_))
+        return false;
+    return put(r.score, r.orig_lbound[0], r.orig_lbound[1]);
+}
+
+void lear::SS_ProcessResult::operator()(const ScoreBatch& b)
+{
+    if (!image)
+        return;
+    for (int i= 0; i< b.size; ++i)
+        if (b.score[i] > threshold_)
+            put(b.score[i], b.x[i], b.y[i]);
+}
+
+lear::SS_ProcessResult::Real2DType lear::SS_ProcessResult::toxy(
+        const Real2DType lb, const unsigned scaleindex) const
+{
+    Real2DType xy;
+    for (int d= 0; d< 2; ++d)
+        xy[d] = pyscale[scaleindex]*(pytopleft[scaleindex][d] +
+                lb[d]*stride_[d] + extent_[d]/2.0) - pyshift[scaleindex][d];
+    return xy;
+}
+
+lear::SS_ProcessResult::RealType lear::SS_ProcessResult::toscore(
+        const ScaleSpaceType& pyimage,
+        const Real2DType xy, const unsigned scaleindex) const
+{// {{{
+    if (scaleindex >= pyimage.size())
+        return 0;
+    const ScoreImage& m = pyimage[scaleindex];
+
+    int i[2]; RealType a[2];
+    for (int d= 0; d< 2; ++d) {
+        const RealType p = ((xy[d] + pyshift[scaleindex][d])/pyscale[scaleindex]
+                - extent_[d]/2.0 - pytopleft[scaleindex][d])/stride_[d];
+        i[d] = static_cast<int>(std::floor(p));
+        a[d] = p - i[d];
+    }
+    RealType r = 0;
+    for (int u= 0; u< 2; ++u)
+    for (int v= 0; v< 2; ++v) {
+        const int x = i[0]+u, y = i[1]+v;
+        if (x < 0 || y < 0 || x >= m.extent(0) || y >= m.extent(1))
+            continue;
+        r += (u ? a[0] : 1-a[0])*(v ? a[1] : 1-a[1])*m(x,y);
+    }
+    return r;
+}// }}}
+
+lear::SS_ProcessResult::RealType lear::SS_ProcessResult::atlogscale(
+        const ScaleSpaceType& pyimage,
+        const Real2DType xy, const RealType t) const
+{// {{{
+    const int L = pyorder.size();
+    if (!L || t < pylogscale[pyorder[0]] || t > pylogscale[pyorder[L-1]])
+        return 0;
+    int r = 0;
+    while (pylogscale[pyorder[r]] < t)
+        ++r;
+    if (!r)
+        return toscore(pyimage, xy, pyorder[0]);
+    const unsigned a = pyorder[r-1], b = pyorder[r];
+    const RealType gap = pylogscale[b] - pylogscale[a];
+    if (!(gap > 0))
+        return toscore(pyimage, xy, b);
+    const RealType w = (t - pylogscale[a])/gap;
+    return (1-w)*toscore(pyimage, xy, a) + w*toscore(pyimage, xy, b);
+}// }}}
+
+void lear::SS_ProcessResult::doit()
+{// {{{
+    using namespace blitz;
+    detect_.clear();
+
+    const int L = pyimage.size();
+    if (!L)
+        return;
+
+    // same normalization as the mean shift density
+    const RealType logsigma = std::max(
+            static_cast<RealType>(std::log(sigma_[2])), RealType(1e-3));
+    const RealType norm = std::sqrt(sigma_[0]*sigma_[1]*logsigma);
+
+    // smooth along x and y within each level
+    ScaleSpaceType xyimage(L);
+    ConvolveSeparable<CPolicy_Chop> conv;
+    for (int l= 0; l< L; ++l) {
+        ScoreImage w(pyimage[l].shape()), tmp(pyimage[l].shape());
+        w = pyimage[l]/(pyscale[l]*norm);
+        xyimage[l].resize(pyimage[l].shape());
+        conv.dim1(w, smoothkernelX, tmp);
+        conv.dim2(tmp, smoothkernelY, xyimage[l]);
+    }
+
+    // levels in order of scale. Levels of the pyramid can be missing
+    // (skipped, outside the ground band), so distances along scale are
+    // those of the actual log scales, not of the level indices
+    pylogscale.resize(L);
+    pyorder.resize(L);
+    pyrank.resize(L);
+    for (int l= 0; l< L; ++l) {
+        pylogscale[l] = std::log(pyscale[l]);
+        pyorder[l] = l;
+    }
+    std::stable_sort(pyorder.begin(), pyorder.end(), ByLogScale(pylogscale));
+    for (int r= 0; r< L; ++r) 
+        pyrank[pyorder[r]] = r;
+
+    // smooth along scale, sampling the other levels within 3 sigma at the
+    // same image position
+    ScaleSpaceType ss(L);
+    std::vector<int> others;
+    std::vector<RealType> weight;
+    for (int l= 0; l< L; ++l) {
+        others.clear(); weight.clear();
+        for (int m= 0; m< L; ++m) {
+            const RealType d = (pylogscale[m] - pylogscale[l])/logsigma;
+            if (m == l || std::abs(d) > 3)
+                continue;
+            others.push_back(m);
+            weight.push_back(std::exp(-d*d/2));
+        }
+        const ScoreImage& xyl = xyimage[l];
+        ss[l].resize(xyl.shape());
+        for (int i= 0; i< xyl.extent(0); ++i)
+        for (int j= 0; j< xyl.extent(1); ++j) {
+            RealType sum = xyl(i,j);
+            const Real2DType p = toxy(Real2DType(i,j), l);
+            for (unsigned k= 0; k< others.size(); ++k) 
+                sum += weight[k]*toscore(xyimage, p, others[k]);
+            ss[l](i,j) = sum;
+        }
+    }
+
+    // local maxima
+    typedef InterpolatePosition<RealType,3>     InterpolateType;
+    blitz::Array<RealType,3> local(5,5,5);
+    for (int l= 0; l< L; ++l) {
+        const ScoreImage& s = ss[l];
+        const int n0 = s.extent(0), n1 = s.extent(1);
+        // neighbouring levels in scale, -1 if none
+        const int rank = pyrank[l];
+        const int below = rank > 0 ? pyorder[rank-1] : -1;
+        const int above = rank+1 < L ? pyorder[rank+1] : -1;
+        // log scale step of the refinement, the mean gap to the neighbours
+        const RealType h = below >= 0 && above >= 0 ? 
+            (pylogscale[above] - pylogscale[below])/2 : 0;
+
+        for (int i= 0; i< n0; ++i)
+        for (int j= 0; j< n1; ++j) {
+            const RealType v = s(i,j);
+            if (!(v > finalthreshold_))
+                continue;
+
+            bool ismax = true;
+            for (int dl= -1; dl<= 1 && ismax; ++dl) {
+                const int nl = dl < 0 ? below : (dl > 0 ? above : l);
+                if (nl < 0)
+                    continue;
+                for (int di= -winsize_; di<= winsize_ && ismax; ++di)
+                for (int dj= -winsize_; dj<= winsize_ && ismax; ++dj) {
+                    const int ii = i+di, jj = j+dj;
+                    if (!dl) {
+                        if ((!di && !dj) || ii < 0 || jj < 0 || ii >= n0 || jj >= n1)
+                            continue;
+                        // of equal neighbours keep the first in scan order
+                        const RealType u = s(ii,jj);
+                        ismax = u < v || (u == v && (di > 0 || (!di && dj > 0)));
+                    } else {
+                        ismax = toscore(ss, toxy(Real2DType(ii,jj),l), nl) <= v;
+                    }
+                }
+            }
+            if (!ismax)
+                continue;
+
+            // sub-cell refinement on a 5x5x5 neighbourhood, sampled at
+            // steps of h in log scale
+            Real3DType off(0); RealType score = v;
+            const RealType t = pylogscale[l];
+            if (h > 0 && t - 2*h >= pylogscale[pyorder[0]] && 
+                    t + 2*h <= pylogscale[pyorder[L-1]] &&
+                    i >= 2 && j >= 2 && i+2 < n0 && j+2 < n1) 
+            {
+                for (int dx= -2; dx<= 2; ++dx)
+                for (int dy= -2; dy<= 2; ++dy)
+                for (int dz= -2; dz<= 2; ++dz)
+                    local(dx+2,dy+2,dz+2) = dz ?
+                        atlogscale(ss, toxy(Real2DType(i+dx,j+dy),l), t + dz*h) :
+                        s(i+dx,j+dy);
+
+                InterpolateType interpolate(local);
+                Real3DType p; RealType sc = v;
+                if (interpolate(InterpolateType::IndexType(2), p, sc)) {
+                    p -= 2;
+                    if (std::abs(p[0]) <= 1 && std::abs(p[1]) <= 1 && std::abs(p[2]) <= 1) {
+                        off = p; score = sc;
+                    }
+                }
+            }
+
+            const RealType scale = std::exp(t + off[2]*h);
+            const Real2DType c = toxy(Real2DType(i+off[0], j+off[1]), l);
+            const Real2DType sz (extent_*scale);
+
+            detect_.push_back(DetectInfo(
+                    static_cast<float>(score),
+                    static_cast<float>(scale),
+                    blitz::ceil(c - sz/2), blitz::floor(sz)));
+        }
+    }
+}// }}}
+
@@ -0,0 +1,94 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  colortable.cpp
+ *
+ *    Description:  Provides implementation to colortable.h
+ *
+ * =====================================================================================
+ */
+
+#include <lear/image/colortable.h>
+#include <lear/exception.h>
+
+using namespace lear;
+
+ChannelTable::ChannelTable(Function f) :
+    f_(f), table_(Size)
+{
+    for (int i= 0; i< Size; ++i)
+        table_[i] = static_cast<RealType>(f_(static_cast<double>(i)));
+}
+
+ColorTable::ColorTable(const ConvertColor& f, const int nodes) :
+    nodes_(nodes)
+{// {{{
+    if (nodes_ < 2 || nodes_ > Max + 1)
+        throw Exception("ColorTable::ColorTable",
+                "Number of lattice nodes must be in [2,256]");
+
+    const double step = static_cast<double>(Max)/(nodes_ - 1);
+    ConvertColor::argument_type rgb;
+
+    // first pass finds the range of each channel
+    ConvertColor::result_type lo(1e30), hi(-1e30);
+    for (int i= 0; i< nodes_; ++i)
+    for (int j= 0; j< nodes_; ++j)
+    for (int k= 0; k< nodes_; ++k) {
+        rgb = i*step, j*step, k*step;
+        const ConvertColor::result_type c = f(rgb);
+        for (int ch= 0; ch< 3; ++ch) {
+            lo[ch] = std::min(lo[ch], c[ch]);
+            hi[ch] = std::max(hi[ch], c[ch]);
+        }
+    }
+    ConvertColor::result_type quant;
+    for (int ch= 0; ch< 3; ++ch) {
+        const double range = hi[ch] > lo[ch] ? hi[ch] - lo[ch] : 1;
+        offset_[ch] = static_cast<RealType>(lo[ch]);
+        scale_[ch] = static_cast<RealType>(range/65535);
+        quant[ch] = 65535/range;
+    }
+
+    // second pass fills the table
+    table_.resize(3*nodes_*nodes_*nodes_);
+    unsigned short* t = &table_[0];
+    for (int i= 0; i< nodes_; ++i)
+    for (int j= 0; j< nodes_; ++j)
+    for (int k= 0; k< nodes_; ++k, t+=3) {
+        rgb = i*step, j*step, k*step;
+        const ConvertColor::result_type c = f(rgb);
+        for (int ch= 0; ch< 3; ++ch)
+            t[ch] = static_cast<unsigned short>(
+                    (c[ch] - lo[ch])*quant[ch] + 0.5);
+    }
+}// }}}
+
+ColorTable::ColorType ColorTable::operator()(const ColorType& rgb) const
+{// {{{
+    const RealType step = static_cast<RealType>(nodes_ - 1)/Max;
+    int i[3];
+    RealType a[3];
+    for (int ch= 0; ch< 3; ++ch) {
+        const RealType v = std::min(std::max(rgb[ch], RealType(0)),
+                RealType(Max));
+        const RealType s = v*step;
+        i[ch] = std::min(static_cast<int>(s), nodes_ - 2);
+        a[ch] = s - i[ch];
+    }
+    const int dj = 3*nodes_, di = 3*nodes_*nodes_;
+    const unsigned short* t = &table_[0] + i[0]*di + i[1]*dj + 3*i[2];
+
+    ColorType r;
+    for (int ch= 0; ch< 3; ++ch, ++t) {
+        // interpolate along k, then j, then i
+        RealType c00 = t[0]       + a[2]*(RealType(t[3])       - t[0]);
+        RealType c01 = t[dj]      + a[2]*(RealType(t[dj+3])    - t[dj]);
+        RealType c10 = t[di]      + a[2]*(RealType(t[di+3])    - t[di]);
+        RealType c11 = t[di+dj]   + a[2]*(RealType(t[di+dj+3]) - t[di+dj]);
+        RealType c0 = c00 + a[1]*(c01 - c00);
+        RealType c1 = c10 + a[1]*(c11 - c10);
+        r[ch] = offset_[ch] + (c0 + a[0]*(c1 - c0))*scale_[ch];
+    }
+    return r;
+}// }}}
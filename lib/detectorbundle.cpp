@@ -0,0 +1,338 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  detectorbundle.cpp
+ *
+ *    Description:  Provides implementation to detectorbundle.h interface.
+ *
+ * =====================================================================================
+ */
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <blitz/array.h>
+#include <blitz/tinyvec.h>
+
+#include <lear/exception.h>
+#include <lear/cvision/rhogdense.h>
+#include <lear/cvision/densegrid.h>
+
+#include <lear/interface/detectorbundle.h>
+
+using namespace lear;
+
+namespace {
+// {{{ file layout
+const char Magic[8] = {'L','E','A','R','D','E','T','\0'};
+
+struct BundleHeader {
+    char        magic[8];
+    int         version;
+    int         headersize;     // sizeof(BundleHeader), guards against ABI changes
+    int         filesize;
+    int         numdesc;
+    int         length;
+    int         weightoffset;
+
+    int         size[2], winstride[2];
+    int         avsize[2], margin[2];
+    float       scaleratio, startscale, endscale;
+
+    float       threshold, lightthreshold;
+    float       nonmaxsigma[3];
+    float       score2prob[2];
+    int         softmax;
+    int         nonmax;
+    float       nonmaxoverlap;
+    int         cellgrid;
+    double      bias;
+};
+
+struct BundleDesc {
+    int         cellsize[2], numcell[2], descstride[2];
+    int         orientbin, semicirc, jointcirc;
+    int         preprocessing, norm;
+    float       wtscale, gscale, epsilon, maxvalue;
+    int         labnodes;
+
+    int         numblock;       // blocks in a window
+    int         featsize;       // numblock * block histogram length
+    int         weightsize;     // elements in Gaussian weight table
+    int         gaussoffset;
+};
+
+inline int align(const int n)
+{ return (n + 7) & ~7; }
+
+inline const BundleHeader& header(const char* data)
+{ return *reinterpret_cast<const BundleHeader*>(data); }
+
+inline const BundleDesc& descrecord(const char* data, const int i)
+{
+    return reinterpret_cast<const BundleDesc*>(
+            data + align(sizeof(BundleHeader)))[i];
+}
+// }}}
+
+/// Descriptor of param without preprocessor or normalizer; gives Gaussian and sizes
+RHOGDense* newdesc(const RHOGDenseParam& p)
+{
+    typedef RHOGDense::IndexType IndexType;
+    return new RHOGDense(
+            IndexType(p.cellsize_x, p.cellsize_y),
+            IndexType(p.numcell_x, p.numcell_y),
+            IndexType(p.descstride_x, p.descstride_y),
+            p.orientbin, p.wtscale, p.semicirc, NULL, NULL, NULL, 
+            p.jointcirc);
+}
+}
+
+DetectorBundle::DetectorBundle(const std::string& filename) :
+    data_(NULL), size_(0)
+{// {{{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw Exception("DetectorBundle::DetectorBundle",
+                "Unable to open " + filename);
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || st.st_size <
+            static_cast<off_t>(align(sizeof(BundleHeader))))
+    {
+        ::close(fd);
+        throw Exception("DetectorBundle::DetectorBundle",
+                filename + " is not a detector bundle");
+    }
+    size_ = st.st_size;
+    void* p = ::mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        throw Exception("DetectorBundle::DetectorBundle",
+                "Unable to map " + filename);
+    data_ = static_cast<const char*>(p);
+
+    const BundleHeader& h = header(data_);
+    std::string error;
+    if (std::memcmp(h.magic, Magic, sizeof(Magic)))
+        error = " is not a detector bundle";
+    else if (h.version != Version || h.headersize != sizeof(BundleHeader))
+        error = " was written by an incompatible version";
+    else if (h.filesize != static_cast<int>(size_) || h.numdesc < 1
+            || align(sizeof(BundleHeader)) + h.numdesc*sizeof(BundleDesc) > size_
+            || h.length < 1 || !inside(h.weightoffset, h.length))
+        error = " is truncated or corrupt";
+    for (int i= 0; error.empty() && i< h.numdesc; ++i) {
+        const BundleDesc& d = descrecord(data_, i);
+        if (d.weightsize != d.cellsize[0]*d.numcell[0]*d.cellsize[1]*d.numcell[1]
+                || !inside(d.gaussoffset, d.weightsize))
+            error = " is truncated or corrupt";
+    }
+    if (!error.empty()) {
+        ::munmap(const_cast<char*>(data_), size_);
+        throw Exception("DetectorBundle::DetectorBundle", filename + error);
+    }
+
+    param_.resize(h.numdesc);
+    for (int i= 0; i< h.numdesc; ++i) {
+        const BundleDesc& d = descrecord(data_, i);
+        RHOGDenseParam& p = param_[i];
+        p.cellsize_x = d.cellsize[0];       p.cellsize_y = d.cellsize[1];
+        p.numcell_x = d.numcell[0];         p.numcell_y = d.numcell[1];
+        p.descstride_x = d.descstride[0];   p.descstride_y = d.descstride[1];
+        p.orientbin = d.orientbin;
+        p.semicirc = d.semicirc;
+        p.jointcirc = d.jointcirc;
+        p.preprocessing2use =
+            static_cast<RHOGDenseParam::PreprocessorFlags>(d.preprocessing);
+        p.norm2use = static_cast<RHOGDenseParam::NormalizerFlags>(d.norm);
+        p.wtscale = d.wtscale;
+        p.gscale = d.gscale;
+        p.epsilon = d.epsilon;
+        p.maxvalue = d.maxvalue;
+        p.labnodes = d.labnodes;
+    }
+    for (int i= 0; i< h.numdesc; ++i)
+        paramptr_.push_back(&param_[i]);
+}// }}}
+
+DetectorBundle::~DetectorBundle()
+{
+    if (data_)
+        ::munmap(const_cast<char*>(data_), size_);
+}
+
+bool DetectorBundle::inside(const int offset, const int n) const
+{
+    return offset >= 0 && n >= 0 &&
+        static_cast<unsigned long>(offset) + n*sizeof(float) <= size_;
+}
+
+bool DetectorBundle::check(const std::string& filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    char magic[sizeof(Magic)];
+    return in.read(magic, sizeof(Magic)) &&
+        !std::memcmp(magic, Magic, sizeof(Magic));
+}
+
+int DetectorBundle::numdesc() const
+{ return header(data_).numdesc; }
+
+int DetectorBundle::numblock(const int i) const
+{ return descrecord(data_,i).numblock; }
+
+const float* DetectorBundle::gaussweight(const int i) const
+{ return reinterpret_cast<const float*>(data_ + descrecord(data_,i).gaussoffset); }
+
+int DetectorBundle::length() const
+{ return header(data_).length; }
+
+void DetectorBundle::fill(WinDetect& detector) const
+{
+    const BundleHeader& h = header(data_);
+    detector.size_x = h.size[0];
+    detector.size_y = h.size[1];
+    detector.winstride_x = h.winstride[0];
+    detector.winstride_y = h.winstride[1];
+    detector.scaleratio = h.scaleratio;
+    detector.startscale = h.startscale;
+    detector.endscale = h.endscale;
+    detector.cellgrid = h.cellgrid != 0;
+}
+
+void DetectorBundle::fill(WinDetectClassify& detector) const
+{
+    fill(static_cast<WinDetect&>(detector));
+
+    const BundleHeader& h = header(data_);
+    detector.avsize_x = h.avsize[0];
+    detector.avsize_y = h.avsize[1];
+    detector.margin_x = h.margin[0];
+    detector.margin_y = h.margin[1];
+    detector.threshold = h.threshold;
+    detector.lightthreshold = h.lightthreshold;
+    detector.nonmaxsigma_x = h.nonmaxsigma[0];
+    detector.nonmaxsigma_y = h.nonmaxsigma[1];
+    detector.nonmaxsigma_scale = h.nonmaxsigma[2];
+    detector.score2prob_a = h.score2prob[0];
+    detector.score2prob_b = h.score2prob[1];
+    detector.softmax = h.softmax;
+    detector.nonmaxmethod = 
+        static_cast<WinDetectClassify::NonMaxMethod>(h.nonmax);
+    detector.nonmaxoverlap = h.nonmaxoverlap;
+}
+
+LinearClassify DetectorBundle::classifier() const
+{
+    const BundleHeader& h = header(data_);
+    return LinearClassify(
+            reinterpret_cast<const float*>(data_ + h.weightoffset),
+            h.length, h.bias);
+}
+
+void DetectorBundle::write(const std::string& filename,
+        const WinDetectClassify& detector,
+        const std::vector<const RHOGDenseParam*>& param,
+        const LinearClassify& classifier)
+{// {{{
+    typedef RHOGDense::IndexType IndexType;
+    if (param.empty())
+        throw Exception("DetectorBundle::write", "No descriptor parameters");
+
+    BundleHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, Magic, sizeof(Magic));
+    h.version = Version;
+    h.headersize = sizeof(BundleHeader);
+    h.numdesc = param.size();
+
+    h.size[0] = detector.size_x;            h.size[1] = detector.size_y;
+    h.winstride[0] = detector.winstride_x;  h.winstride[1] = detector.winstride_y;
+    h.avsize[0] = detector.avsize_x;        h.avsize[1] = detector.avsize_y;
+    h.margin[0] = detector.margin_x;        h.margin[1] = detector.margin_y;
+    h.scaleratio = detector.scaleratio;
+    h.startscale = detector.startscale;
+    h.endscale = detector.endscale;
+    h.cellgrid = detector.cellgrid;
+    h.threshold = detector.threshold;
+    h.lightthreshold = detector.lightthreshold;
+    h.nonmaxsigma[0] = detector.nonmaxsigma_x;
+    h.nonmaxsigma[1] = detector.nonmaxsigma_y;
+    h.nonmaxsigma[2] = detector.nonmaxsigma_scale;
+    h.score2prob[0] = detector.score2prob_a;
+    h.score2prob[1] = detector.score2prob_b;
+    h.softmax = detector.softmax;
+    h.nonmax = detector.nonmaxmethod;
+    h.nonmaxoverlap = detector.nonmaxoverlap;
+    h.bias = classifier.bias();
+
+    // descriptor records and their Gaussian tables
+    std::vector<BundleDesc> desc(param.size());
+    std::vector< std::vector<float> > gauss(param.size());
+
+    const IndexType size(detector.size_x, detector.size_y);
+    int offset = align(sizeof(BundleHeader)) + align(desc.size()*sizeof(BundleDesc));
+    for (unsigned i= 0; i< param.size(); ++i) {
+        const RHOGDenseParam& p = *param[i];
+        BundleDesc& d = desc[i];
+        std::memset(&d, 0, sizeof(d));
+        d.cellsize[0] = p.cellsize_x;       d.cellsize[1] = p.cellsize_y;
+        d.numcell[0] = p.numcell_x;         d.numcell[1] = p.numcell_y;
+        d.descstride[0] = p.descstride_x;   d.descstride[1] = p.descstride_y;
+        d.orientbin = p.orientbin;
+        d.semicirc = p.semicirc;
+        d.jointcirc = p.jointcirc;
+        d.preprocessing = p.preprocessing2use;
+        d.norm = p.norm2use;
+        d.wtscale = p.wtscale;
+        d.gscale = p.gscale;
+        d.epsilon = p.epsilon;
+        d.maxvalue = p.maxvalue;
+        d.labnodes = p.labnodes;
+
+        RHOGDense* rhog = newdesc(p);
+        d.numblock = DenseGrid<2>::get(size, rhog->extent(), rhog->stride()).size();
+        d.featsize = d.numblock*rhog->length();
+        gauss[i].assign(rhog->weight().begin(), rhog->weight().end());
+        delete rhog;
+
+        d.weightsize = gauss[i].size();
+        d.gaussoffset = offset;
+        offset += align(d.weightsize*sizeof(float));
+        h.length += d.featsize;
+    }
+    if (h.length != classifier.length())
+        throw Exception("DetectorBundle::write",
+                "Classifier length does not match descriptor length");
+
+    // weights are in WinDescriptor block order already
+    std::vector<float> weight(h.length);
+    for (int i= 0; i< h.length; ++i)
+        weight[i] = static_cast<float>(classifier.weight(i));
+    h.weightoffset = offset;
+    h.filesize = offset + h.length*sizeof(float);
+
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if (!out)
+        throw Exception("DetectorBundle::write", "Unable to open " + filename);
+
+    const char pad[8] = {0};
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(pad, align(sizeof(h)) - sizeof(h));
+    out.write(reinterpret_cast<const char*>(&desc[0]), desc.size()*sizeof(BundleDesc));
+    out.write(pad, align(desc.size()*sizeof(BundleDesc)) - desc.size()*sizeof(BundleDesc));
+    for (unsigned i= 0; i< gauss.size(); ++i) {
+        const int n = gauss[i].size()*sizeof(float);
+        out.write(reinterpret_cast<const char*>(&gauss[i][0]), n);
+        out.write(pad, align(n) - n);
+    }
+    out.write(reinterpret_cast<const char*>(&weight[0]), weight.size()*sizeof(float));
+    if (!out)
+        throw Exception("DetectorBundle::write", "Unable to write " + filename);
+}// }}}
@@ -5,6 +5,11 @@
 
 using namespace lear;
 
+Mutex& ImageIO::mutex() {
+    static Mutex m;
+    return m;
+}
+
 std::string ImageIO::imageFormat(const std::string& imagename) {
     Imlib_Image image = imlib_load_image(imagename.c_str());
     
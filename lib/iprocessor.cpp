@@ -8,7 +8,12 @@
  * =====================================================================================
  */
 
+#include <map>
+
+#include <lear/exception.h>
+#include <lear/util/thread.h>
 #include <lear/cvision/iprocessor.h>
+#include <lear/cvision/halffloat.h>
 #include <lear/cvision/edge.h>
 #include <lear/cvision/phistogram.h>
 
@@ -26,49 +31,333 @@ lear::BiOStream& operator<<(lear::BiOStream& o, const IProcessor& d)
 
 using namespace lear;
 
+// {{{ remap helpers
+namespace {
+/**
+ * Applies op to every pixel of img in one pass. img may be a strided view,
+ * e.g. of a frame buffer; it is read linearly only if laid out as res.
+ */
+template<class Dst, class Src, class Op>
+blitz::Array<Dst,2> remapeach(const blitz::Array<Src,2>& img, const Op& op)
+{
+    blitz::Array<Dst,2> res(img.lbound(), img.extent());
+    if (img.stride(1) == 1 && img.stride(0) == img.extent(1) &&
+        img.ordering(0) == 1 && img.ordering(1) == 0)
+    {
+        const Src* s = img.data();
+        Dst* d = res.data();
+        for (int i= 0, n = img.numElements(); i< n; ++i)
+            d[i] = op(s[i]);
+    } else {
+        typename blitz::Array<Dst,2>::iterator d = res.begin();
+        for (typename blitz::Array<Src,2>::const_iterator s = img.begin(); 
+                s != img.end(); ++s, ++d)
+            *d = op(*s);
+    }
+    return res;
+}
+
+typedef ImageNoRemap::RGBType       RGBType;
+typedef ImageNoRemap::RGB8Type      RGB8Type;
+typedef ImageNoRemap::RealType      RealType;
+
+double sqrtfunc(double v) { return std::sqrt(v); }
+double logfunc(double v) { return std::log(v+1); }
+
+const ChannelTable& sqrttable() {
+    static const ChannelTable table(sqrtfunc);
+    return table;
+}
+const ChannelTable& logtable() {
+    static const ChannelTable table(logfunc);
+    return table;
+}
+
+struct Convert8 {
+    RGBType operator()(const RGB8Type& v) const 
+    { return RGBType(v[0], v[1], v[2]); }
+};
+/// per channel table lookup
+struct Channel {
+    const ChannelTable& t;
+    Channel(const ChannelTable& t) : t(t) {}
+
+    RealType operator()(const RealType v) const { return t(v); }
+    RGBType operator()(const RGBType& v) const 
+    { return RGBType(t(v[0]), t(v[1]), t(v[2])); }
+    RGBType operator()(const RGB8Type& v) const 
+    { return RGBType(t[v[0]], t[v[1]], t[v[2]]); }
+};
+struct Color {
+    const ColorTable& t;
+    Color(const ColorTable& t) : t(t) {}
+
+    template<class T>
+    RGBType operator()(const T& v) const { return t(v); }
+};
+
+/// Lab (optionally square rooted) scaled to 0--255 range
+struct ScaledLabFunctor : public ConvertColor {
+    bool dosqrt;
+    ScaledLabFunctor(const bool dosqrt) : dosqrt(dosqrt) {}
+
+    result_type operator()(const argument_type& rgb) const {
+        result_type lab (toLab(rgb));
+        lab[0] *= 255.0/100;
+        lab[1] = (lab[1] +  87)*(255.0/( 99+ 87));
+        lab[2] = (lab[2] + 108)*(255.0/( 95+108));
+        if (dosqrt) 
+            for (int i= 0; i< 3; ++i)
+                lab[i] = std::sqrt(std::max(lab[i], 0.0));
+        return lab;
+    }
+    RGB2LabFunctor toLab;
+};
+/// exact Lab conversion of each pixel
+struct Lab {
+    ScaledLabFunctor f;
+    Lab(const bool dosqrt) : f(dosqrt) {}
+
+    template<class T>
+    RGBType operator()(const T& v) const { 
+        const ScaledLabFunctor::result_type lab (
+                f(ScaledLabFunctor::argument_type(v[0], v[1], v[2])));
+        return RGBType(lab[0], lab[1], lab[2]);
+    }
+};
+
+/// Lab tables are large, so they are built once and shared
+struct LabTableCache {
+    typedef std::map<std::pair<int,bool>, ColorTable*> MapType;
+    MapType tables;
+    /// remaps may be created from several threads
+    Mutex mutex;
+
+    const ColorTable* get(const int nodes, const bool dosqrt) {
+        ScopedLock lock(mutex);
+        MapType::iterator i = tables.find(std::make_pair(nodes,dosqrt));
+        if (i != tables.end())
+            return i->second;
+        ColorTable* t = new ColorTable(ScaledLabFunctor(dosqrt), nodes);
+        tables[std::make_pair(nodes,dosqrt)] = t;
+        return t;
+    }
+    ~LabTableCache() {
+        for (MapType::iterator i = tables.begin(); i != tables.end(); ++i)
+            delete i->second;
+    }
+};
+const ColorTable* labtable(const int nodes, const bool dosqrt) {
+    if (nodes <= 0)
+        return NULL;
+    static LabTableCache cache;
+    return cache.get(nodes, dosqrt);
+}
+}
+// }}}
+
+// {{{ fixed-point helpers
+namespace {
+/// v rounded to the nearest integer in [0,255]
+inline unsigned char round8(const RealType v) {
+    return v <= 0 ? 0 : (v >= 255 ? 255 : static_cast<unsigned char>(v + 0.5));
+}
+
+/// fractional bits of the ratio indexing FixedTables, and of the norm
+enum {RatioBits = 10, NormBits = 14};
+/// largest remapped 8-bit value, so that derivatives fit in 16 bits and
+/// magnitudes (at most sqrt(2)*RemapMax) in 15 bits
+enum {RemapMax = 16383};
+
+/**
+ * atan(r) and sqrt(1+r*r) at the 2^RatioBits+1 points r of [0,1] the ratio
+ * of the smaller to the larger absolute derivative is rounded to. atan is
+ * in units of 2^-16 turn, the norm factor in units of 2^-NormBits.
+ */
+struct FixedTables {
+    std::vector<unsigned short> atan, norm;
+
+    FixedTables() : atan((1<<RatioBits)+1), norm((1<<RatioBits)+1) {
+        const double turn = 65536/(2*MathConst<double>::PI_Value);
+        for (int i= 0; i<= 1<<RatioBits; ++i) {
+            const double r = i/double(1<<RatioBits);
+            atan[i] = static_cast<unsigned short>(std::atan(r)*turn + 0.5);
+            norm[i] = static_cast<unsigned short>(
+                    std::sqrt(1 + r*r)*(1<<NormBits) + 0.5);
+        }
+    }
+};
+const FixedTables& fixedtables() {
+    static const FixedTables tables;
+    return tables;
+}
+
+/**
+ * Derivatives d of n lines of len samples of v, step apart (lines follow
+ * each other if step is 1, else they are interleaved), as the central
+ * difference v(k+1)-v(k-1) with the end samples copied from their
+ * neighbours, like nosmoothgradientXY.
+ */
+void derivative(const short* v, short* d, const int n, const int len,
+        const int step)
+{
+    // n lines of len samples
+    const int line = step == 1 ? len : 1;
+    for (int l= 0; l< n; ++l, v+=line, d+=line) {
+        for (int k= 1; k< len-1; ++k)
+            d[k*step] = v[(k+1)*step] - v[(k-1)*step];
+        d[0] = d[step];
+        d[(len-1)*step] = d[(len-2)*step];
+    }
+}
+
+/**
+ * Position of each whole degree of range between the centers of bins
+ * orientation bins, in 8.8 fixed point (see IProcessor::InfoType).
+ */
+std::vector<unsigned short> positions(const int bins, const int range)
+{
+    std::vector<unsigned short> position(range);
+    for (int d= 0; d< range; ++d) {
+        int pos = ((d*bins) << 8)/range - 128;
+        if (pos < 0) 
+            pos += bins << 8;
+        position[d] = static_cast<unsigned short>(pos);
+    }
+    return position;
+}
+}
+// }}}
+
+ImageNoRemap::RGBImage ImageNoRemap::operator() (const RGB8Image& img) const 
+{
+    return remapeach<RGBType>(img, Convert8());
+}
+
+ImageLabRemap::ImageLabRemap(const int nodes) :
+    table(labtable(nodes, false)), dosqrt(false)
+{}
+ImageLabRemap::ImageLabRemap(const int nodes, const bool dosqrt) :
+    table(labtable(nodes, dosqrt)), dosqrt(dosqrt)
+{}
+ImageLabSqrtRemap::ImageLabSqrtRemap(const int nodes) :
+    ImageLabRemap(nodes, true)
+{}
+
 ImageLabSqrtRemap::GrayImage ImageLabSqrtRemap::operator() (const GrayImage& img) const 
 {
-    GrayImage t(blitz::sqrt(img));
-    return t;// do nothing for gray scale images
+    return remapeach<RealType>(img, Channel(sqrttable()));
 }
 ImageLabSqrtRemap::RGBImage ImageLabSqrtRemap::operator() (const RGBImage& img) const 
 {
-    RGBImage t(blitz::sqrt(ImageLabRemap::operator()(img)));
-    return t;
+    if (!table)
+        return remapeach<RGBType>(img, Lab(dosqrt));
+    return remapeach<RGBType>(img, Color(*table));
+}
+ImageLabSqrtRemap::RGBImage ImageLabSqrtRemap::operator() (const RGB8Image& img) const 
+{
+    if (!table)
+        return remapeach<RGBType>(img, Lab(dosqrt));
+    return remapeach<RGBType>(img, Color(*table));
 }
 ImageSqrtRemap::GrayImage ImageSqrtRemap::operator() (const GrayImage& img) const 
 {
-    GrayImage t(blitz::sqrt(img));
-    return t;
+    return remapeach<RealType>(img, Channel(sqrttable()));
 }
 ImageSqrtRemap::RGBImage ImageSqrtRemap::operator() (const RGBImage& img) const 
 {
-    RGBImage t(blitz::sqrt(img));
-    return t;
+    return remapeach<RGBType>(img, Channel(sqrttable()));
+}
+ImageSqrtRemap::RGBImage ImageSqrtRemap::operator() (const RGB8Image& img) const 
+{
+    return remapeach<RGBType>(img, Channel(sqrttable()));
 }
 ImageLogRemap::GrayImage ImageLogRemap::operator() (const GrayImage& img) const 
 {
-    GrayImage t(blitz::log(img+1));
-    return t;
+    return remapeach<RealType>(img, Channel(logtable()));
 }
 ImageLogRemap::RGBImage ImageLogRemap::operator() (const RGBImage& img) const 
 {
-    RGBImage t(blitz::log(img+1));
-    return t;
+    return remapeach<RGBType>(img, Channel(logtable()));
+}
+ImageLogRemap::RGBImage ImageLogRemap::operator() (const RGB8Image& img) const 
+{
+    return remapeach<RGBType>(img, Channel(logtable()));
 }
 ImageLabRemap::RGBImage ImageLabRemap::operator() (const RGBImage& img) const 
 {
-    // convert to Lab space
-    RGB2LabFunctor toLab;
-    RGBImage imageLab (img.lbound(), img.extent());
-    std::transform(img.begin(), img.end(), imageLab.begin(), toLab);
+    if (!table)
+        return remapeach<RGBType>(img, Lab(dosqrt));
+    return remapeach<RGBType>(img, Color(*table));
+}
+ImageLabRemap::RGBImage ImageLabRemap::operator() (const RGB8Image& img) const 
+{
+    if (!table)
+        return remapeach<RGBType>(img, Lab(dosqrt));
+    return remapeach<RGBType>(img, Color(*table));
+}
 
-    imageLab[0] *= 255.0/100;
-    imageLab[1] = (imageLab[1] +  87)*(255.0/( 99+ 87));
-    imageLab[2] = (imageLab[2] + 108)*(255.0/( 95+108));
+IProcessor::InfoType IProcessor::operator()(const RGB8Image& image) const 
+{
+    ImageNoRemap convert;
+    return (*this)(convert(image));
+}
 
-    return imageLab;
+IProcessor::InfoType IProcessor::fixedpoint(const RGB8Image& image, const int bins) const 
+{
+    throw Exception("IProcessor::fixedpoint()",
+            "No fixed-point path for " + toString());
 }
+IProcessor::InfoType IProcessor::fixedpoint(const RGBImage& image, const int bins) const 
+{// {{{
+    RGB8Image image8(image.lbound(), image.extent());
+    RGB8Image::iterator d = image8.begin();
+    for (RGBImage::const_iterator s = image.begin(); s != image.end(); ++s, ++d)
+        for (int c= 0; c< 3; ++c) 
+            (*d)[c] = round8((*s)[c]);
+    return fixedpoint(image8, bins);
+}// }}}
+IProcessor::InfoType IProcessor::fixedpoint(const GrayImage& image, const int bins) const 
+{// {{{
+    RGB8Image image8(image.lbound(), image.extent());
+    RGB8Image::iterator d = image8.begin();
+    for (GrayImage::const_iterator s = image.begin(); s != image.end(); ++s, ++d)
+        *d = round8(*s);
+    return fixedpoint(image8, bins);
+}// }}}
+
+IProcessor::InfoType IProcessor::InfoType::tohalf(const int bins, const int range) const 
+{// {{{
+    if (fixed() || half())
+        throw Exception("IProcessor::InfoType::tohalf()",
+                "Result is already packed");
+    if (bins < 1 || bins > 255)
+        throw Exception("IProcessor::InfoType::tohalf()",
+                "Packed orientation takes 1 to 255 bins");
+
+    FixedAType hmag(mag.lbound(), mag.extent());
+    FixedAType hori(ori.lbound(), ori.extent());
+    MagAType m (mag);
+    if (!mag.isStorageContiguous() || mag.ordering(0) != hmag.ordering(0)) {
+        m.reference(MagAType(mag.lbound(), mag.extent()));
+        m = mag;
+    }
+    float2half(m.data(), hmag.data(), m.numElements());
+
+    // whole degrees of range, range itself (atan2 of exactly pi) as 0
+    const std::vector<unsigned short> position = positions(bins, range);
+    FixedAType::iterator d = hori.begin();
+    for (OriAType::const_iterator o = ori.begin(); o != ori.end(); ++o, ++d) {
+        int deg = *o % range;
+        if (deg < 0)
+            deg += range;
+        *d = position[deg];
+    }
+
+    InfoType h(hmag, hori, 1, bins);
+    h.fhalf = true;
+    return h;
+}// }}}
 
 std::pair<ChannelMax::GrayImage, ChannelMax::GrayImage> ChannelMax::operator() 
     (const GrayImage& dervX, const GrayImage& dervY) const 
@@ -101,11 +390,11 @@ std::pair<ChannelMax::GrayImage, ChannelMax::GrayImage> ChannelMax::operator()
     return std::make_pair(maxMag,maxOri);
 } 
 
-GradProcessor_NoSmooth::InfoType GradProcessor_NoSmooth::operator()( const RGBImage& image) const 
+GradProcessor_NoSmooth::InfoType GradProcessor_NoSmooth::remapped( const RGBImage& image) const 
 {// {{{
     using namespace blitz;
 
-    pair<RGBImage, RGBImage> res = nosmoothgradientXY((*remapBefore)(image));
+    pair<RGBImage, RGBImage> res = nosmoothgradientXY(image);
 
     pair<Array2DType,Array2DType> best = (*to1d)(res.first,res.second);
 
@@ -126,13 +415,101 @@ GradProcessor_NoSmooth::InfoType GradProcessor_NoSmooth::operator()(const GrayIm
     return InfoType((*remapAfter)(best.first),ori);
 }// }}}
 
+GradProcessor_NoSmooth::InfoType GradProcessor_NoSmooth::fixedpoint(const RGB8Image& image, const int bins) const 
+{// {{{
+    if (bins < 1 || bins > 255)
+        throw Exception("GradProcessor_NoSmooth::fixedpoint()",
+                "Fixed-point orientation takes 1 to 255 bins");
+    if (remapBefore->toMethod() > ImageLogRemap::Method || 
+            remapAfter->toMethod() != ImageNoRemap::Method)
+        throw Exception("GradProcessor_NoSmooth::fixedpoint()",
+                "Fixed-point gradients need an 8-bit table image remap");
+
+    // remapBefore as a table of 8-bit values, scaled by an integer so that
+    // the largest is at most RemapMax
+    GrayImage levels(256, 1);
+    for (int v= 0; v< 256; ++v)
+        levels(v, 0) = v;
+    levels.reference((*remapBefore)(levels));
+    const RealType top = blitz::max(levels);
+    if (!(top > 0))
+        throw Exception("GradProcessor_NoSmooth::fixedpoint()",
+                "Image remap maps all 8-bit values to 0");
+    const int scale = std::max(static_cast<int>(RemapMax/top), 1);
+    short remap[256];
+    for (int v= 0; v< 256; ++v)
+        remap[v] = static_cast<short>(levels(v, 0)*scale + 0.5);
+
+    // remapped channels and their derivatives as x-major planes
+    const int w = image.extent(0), h = image.extent(1), n = w*h;
+    if (w < 3 || h < 3)
+        throw Exception("GradProcessor_NoSmooth::fixedpoint()",
+                "Image is smaller than 3x3 pixels");
+    std::vector<short> plane(3*n), dervX(3*n), dervY(3*n);
+    for (int x= 0; x< w; ++x) {
+        const RGB8Type* s = &image(image.lbound(0) + x, image.lbound(1));
+        const int step = image.stride(1);
+        for (int y= 0; y< h; ++y, s+=step)
+            for (int c= 0; c< 3; ++c)
+                plane[c*n + x*h + y] = remap[(*s)[c]];
+    }
+    for (int c= 0; c< 3; ++c) {
+        derivative(&plane[c*n], &dervX[c*n], h, w, h);
+        derivative(&plane[c*n], &dervY[c*n], w, h, 1);
+    }
+
+    // orientations are truncated to whole degrees like the int degrees of
+    // the float path, so that blocks match those models were trained on
+    const int range = semicirc ? 180 : 360;
+    const std::vector<unsigned short> position = positions(bins, range);
+
+    const FixedTables& table = fixedtables();
+    InfoType::FixedAType mag(image.lbound(), image.extent());
+    InfoType::FixedAType ori(image.lbound(), image.extent());
+    unsigned short* m = mag.data();
+    unsigned short* o = ori.data();
+    for (int i= 0; i< n; ++i) {
+        // channel of largest magnitude, the first one on ties
+        int dx = dervX[i], dy = dervY[i];
+        int energy = dx*dx + dy*dy;
+        for (int c= 1; c< 3; ++c) {
+            const int cx = dervX[c*n + i], cy = dervY[c*n + i];
+            if (cx*cx + cy*cy > energy) {
+                dx = cx; dy = cy; energy = cx*cx + cy*cy;
+            }
+        }
+        const int ax = std::abs(dx), ay = std::abs(dy);
+        const int big = std::max(ax, ay), small = std::min(ax, ay);
+        const int r = big ? ((small << RatioBits) + big/2)/big : 0;
+        m[i] = static_cast<unsigned short>(
+                (big*table.norm[r] + (1 << (NormBits - 1))) >> NormBits);
+
+        // angle of (dx,dy) plus half a turn, in units of 2^-16 turn, as
+        // atan2()*180/PI + 180 of the float path
+        int t = table.atan[r];
+        if (ay > ax) t = 16384 - t;
+        if (dx < 0) t = 32768 - t;
+        if (dy < 0) t = -t;
+        unsigned code = (t + 32768) & 0xffff;
+        if (semicirc) 
+            code = (code << 1) & 0xffff;
+        o[i] = position[(code*range) >> 16];
+    }
+    return InfoType(mag, ori, scale, bins);
+}// }}}
+
+GradProcessor::InfoType GradProcessor::fixedpoint(const RGB8Image& image, const int bins) const 
+{
+    throw Exception("GradProcessor::fixedpoint()",
+            "Fixed-point gradients are not smoothed, use a scale of 0");
+}
 
-GradProcessor::InfoType GradProcessor::operator()( const RGBImage& image) const 
+GradProcessor::InfoType GradProcessor::remapped( const RGBImage& image) const 
 {// {{{
     using namespace blitz;
 
     pair<RGBImage, RGBImage> res=
-        gradientXY< ConvolveExact<CPolicy_Chop> >((*remapBefore)(image),kernel);
+        gradientXY< ConvolveSeparable<CPolicy_Chop> >(image,kernel);
 
     pair<Array2DType,Array2DType> best = (*to1d)(res.first,res.second);
 
@@ -1,6 +1,7 @@
 
 #include <iostream>
 
+#include <cmath>
 #include <algorithm>
 #include <lear/blitz/tvmio.h>
 #include <lear/io/biostream.h>
@@ -10,6 +11,7 @@
 #include <lear/io/fileheader.h>
 
 #include <lear/cvision/rhogdense.h>
+#include <lear/cvision/halffloat.h>
 
 std::ostream& operator<<(std::ostream& o, const lear::RHOGDense& d)
 { d.print(o); return o; }
@@ -30,29 +32,41 @@ RHOGDense::RHOGDense(
         const RealType wtscale_,
         const bool semicirc_,
         const IProcessor* p,
-        const DescNormalizer<RealType>* n
+        const DescNormalizer<RealType>* n,
+        const RealType* weight,
+        const bool jointcirc_
         ):
     cellsize_(cellsize_), 
     numcell_(numcell_), 
     stride_(stride_),
     orientbin_(orientbin_), 
     wtscale_(wtscale_),
-    semicirc_(semicirc_), 
+    semicirc_(semicirc_ && !jointcirc_), 
+    jointcirc_(jointcirc_), 
     processor(p),
     normalizer(n),
 
-    descsize_(blitz::product(numcell_)*orientbin_),
+    descsize_(blitz::product(numcell_)*orientbin_*(jointcirc_ ? 3 : 1)),
     extent_(cellsize_*numcell_),
     ubound_(extent_ - 1),
     weight_(extent_), 
-    h_extent( extent_[0], extent_[1], (semicirc_ ? 180.0: 360.0)),
-    h_bandwidth( cellsize_[0], cellsize_[1], (semicirc_? 180.0: 360.0)/orientbin_),
+    // arguments, not members: jointcirc_ overrides semicirc_
+    h_extent( extent_[0], extent_[1], 
+            (semicirc_ && !jointcirc_ ? 180.0: 360.0)),
+    h_bandwidth( cellsize_[0], cellsize_[1], 
+            (semicirc_ && !jointcirc_ ? 180.0: 360.0)
+            /(jointcirc_ ? 2*orientbin_ : orientbin_)),
 
     tmag_(extent_),
     hist_(0.0,h_extent,h_bandwidth,
             blitz::TinyVector<bool,3>(false,false,true))
 {
-    if (wtscale_ > 1e-3) {
+    if (jointcirc_)
+        joint_.resize(numcell_[0], numcell_[1], 3*orientbin_);
+
+    if (weight) {
+        std::copy(weight, weight + weight_.numElements(), weight_.data());
+    } else if (wtscale_ > 1e-3) {
         using namespace blitz;
         TinyVector<RealType,N> var2=cellsize_*numcell_/(2*wtscale_);
         var2 *= var2*2;
@@ -69,11 +83,100 @@ RHOGDense::RHOGDense(
     } else {
         weight_ = 1;
     }
+    initfixed();
+}// }}}
+
+void RHOGDense::initfixed() 
+{// {{{
+    using namespace blitz;
+    const int bins = fixedbins();
+    const int pixels = product(extent_);
+    fcell_.assign(4*pixels, 0);
+    fweight_.assign(4*pixels, 0);
+    hweight_.assign(4*pixels, 0);
+    facc_.resize(product(numcell_)*bins);
+    hacc_.resize(product(numcell_)*bins);
+    hrow_.resize(extent_[1]);
+
+    const RealType top = max(weight_);
+    fnorm_ = top > 0 ? 65535/top : 1;
+
+    // magnitudes are below 2^15 (see IProcessor::fixedpoint), so a vote is
+    // below 2^(31-fshift_), and 256 times that after orientation
+    // interpolation. A cell sums the votes of (2*cellsize_)^2 pixels at
+    // most: shift so that the sum fits in 32 bits.
+    const int support = 4*product(cellsize_);
+    for (fshift_ = 16; support << 7 > 1 << fshift_; ++fshift_)
+        ;
+
+    for (int i= 0; i< extent_[0]; ++i) 
+    for (int j= 0; j< extent_[1]; ++j) {
+        // same interpolation as hist_: cell centers at (k+0.5)*cellsize_
+        const double pos[N] = {(i+0.5)/cellsize_[0] - 0.5, 
+            (j+0.5)/cellsize_[1] - 0.5};
+        int lo[N]; double d[N];
+        for (int k= 0; k< N; ++k) {
+            lo[k] = static_cast<int>(std::floor(pos[k]));
+            d[k] = pos[k] - lo[k];
+        }
+        const int p = 4*(i*extent_[1] + j);
+        for (int c= 0; c< 4; ++c) {
+            const int cx = lo[0] + (c >> 1), cy = lo[1] + (c & 1);
+            if (cx < 0 || cx >= numcell_[0] || cy < 0 || cy >= numcell_[1])
+                continue;
+            const double w = weight_(i,j)
+                *((c >> 1) ? d[0] : 1 - d[0])*((c & 1) ? d[1] : 1 - d[1]);
+            fcell_[p + c] = (cx*numcell_[1] + cy)*bins;
+            fweight_[p + c] = static_cast<unsigned short>(
+                    std::min(w*fnorm_ + 0.5, 65535.0));
+            hweight_[p + c] = w;
+        }
+    }
 }// }}}
 
 RHOGDense::FeatType& RHOGDense::operator() (const IndexType point, const Preprocessor& p)  const
+{// {{{
+    vote(point,p);
+    FeatType& h = votes();
+    (*normalizer)(h);
+    return h;
+}// }}}
+
+void RHOGDense::histogram(const IndexType point, const Preprocessor& p, ElemType* dest)  const
+{// {{{
+    vote(point,p);
+    const ElemType* h = votes().data();
+    std::copy(h, h+descsize_, dest);
+}// }}}
+
+RHOGDense::FeatType& RHOGDense::votes()  const
+{// {{{
+    if (!jointcirc_)
+        return hist_.data();
+
+    const FeatType& h = hist_.data();
+    for (int i= 0; i< numcell_[0]; ++i) 
+    for (int j= 0; j< numcell_[1]; ++j) 
+    for (int k= 0; k< orientbin_; ++k) {
+        const ElemType a = h(i,j,k), b = h(i,j,k+orientbin_);
+        joint_(i,j,k) = a;
+        joint_(i,j,k+orientbin_) = b;
+        joint_(i,j,k+2*orientbin_) = a + b;
+    }
+    return joint_;
+}// }}}
+
+void RHOGDense::vote(const IndexType point, const Preprocessor& p)  const
 {// {{{
     using namespace blitz;
+    if (p.half()) {
+        halfvote(point, p);
+        return;
+    }
+    if (p.fixed()) {
+        fixedvote(point, p);
+        return;
+    }
     RectDomain<N> span(point,point+ubound_);
     tmag_ = weight_*p.mag(span);
     Preprocessor::OriAType tori = p.ori(span);
@@ -86,13 +189,198 @@ RHOGDense::FeatType& RHOGDense::operator() (const IndexType point, const Preproc
         TinyVector<RealType,3> at ( i+0.5, j+0.5, tori(i,j) );
         hist_(at, tmag_(i,j));
     }
-    (*normalizer)(hist_.data());
-    return hist_.data();
+}// }}}
+
+void RHOGDense::fixedvote(const IndexType point, const Preprocessor& p)  const
+{// {{{
+    const unsigned bins = fixedbins();
+    if (p.fbins != static_cast<int>(bins))
+        throw lear::Exception("RHOGDense::vote()",
+                "Fixed-point orientation bins do not match the descriptor");
+    std::fill(facc_.begin(), facc_.end(), 0u);
+
+    const int* cell = &fcell_[0];
+    const unsigned short* weight = &fweight_[0];
+    const unsigned half = 1u << (fshift_ - 1);
+    for (int i= 0; i< extent_[0]; ++i) {
+        const unsigned short* mag = &p.fmag(point[0]+i, point[1]);
+        const unsigned short* ori = &p.fori(point[0]+i, point[1]);
+        for (int j= 0; j< extent_[1]; ++j, cell+=4, weight+=4) {
+            const unsigned m = mag[j];
+            if (!m)
+                continue;
+            const unsigned b = ori[j] >> 8, f = ori[j] & 255;
+            const unsigned b1 = b+1 == bins ? 0 : b+1;
+            for (int c= 0; c< 4; ++c) {
+                const unsigned v = (m*weight[c] + half) >> fshift_;
+                unsigned* h = &facc_[cell[c]];
+                h[b] += v*(256 - f);
+                h[b1] += v*f;
+            }
+        }
+    }
+
+    // back to float, in the magnitude unit of the float path
+    const RealType unit = std::ldexp(1.0, fshift_)/(p.fscale*fnorm_*256);
+    FeatType& h = hist_.data();
+    const unsigned* a = &facc_[0];
+    for (int i= 0; i< numcell_[0]; ++i) 
+    for (int j= 0; j< numcell_[1]; ++j) 
+    for (unsigned k= 0; k< bins; ++k) 
+        h(i,j,k) = *a++ * unit;
+}// }}}
+
+void RHOGDense::halfvote(const IndexType point, const Preprocessor& p)  const
+{// {{{
+    const int bins = fixedbins();
+    if (p.fbins != bins)
+        throw lear::Exception("RHOGDense::vote()",
+                "Half-precision orientation bins do not match the descriptor");
+    std::fill(hacc_.begin(), hacc_.end(), RealType(0));
+
+    const int* cell = &fcell_[0];
+    const RealType* weight = &hweight_[0];
+    RealType* mag = &hrow_[0];
+    const RealType unit = 1.0/256;
+    for (int i= 0; i< extent_[0]; ++i) {
+        half2float(&p.fmag(point[0]+i, point[1]), mag, extent_[1]);
+        const unsigned short* ori = &p.fori(point[0]+i, point[1]);
+        for (int j= 0; j< extent_[1]; ++j, cell+=4, weight+=4) {
+            const RealType m = mag[j];
+            if (m == 0)
+                continue;
+            const int b = ori[j] >> 8;
+            const int b1 = b+1 == bins ? 0 : b+1;
+            const RealType f = (ori[j] & 255)*unit;
+            for (int c= 0; c< 4; ++c) {
+                const RealType v = m*weight[c];
+                RealType* h = &hacc_[cell[c]];
+                h[b] += v - v*f;
+                h[b1] += v*f;
+            }
+        }
+    }
+
+    FeatType& h = hist_.data();
+    const RealType* a = &hacc_[0];
+    for (int i= 0; i< numcell_[0]; ++i) 
+    for (int j= 0; j< numcell_[1]; ++j) 
+    for (int k= 0; k< bins; ++k) 
+        h(i,j,k) = *a++;
+}// }}}
+
+void RHOGDense::cells(const IndexType origin, const IndexType count, 
+        const Preprocessor& p, ElemType* dest)  const
+{// {{{
+    const int bins = fixedbins();
+    if ((p.fixed() || p.half()) && p.fbins != bins)
+        throw lear::Exception("RHOGDense::cells()",
+                "Packed orientation bins do not match the descriptor");
+    std::fill(dest, dest + blitz::product(count)*bins, ElemType(0));
+
+    // pixels within half a cell outside the grid vote into its border
+    // cells too, so a cell does not depend on the grid it is part of;
+    // pixels outside the image do not vote
+    const IndexType size (count*cellsize_), margin (cellsize_/2 + 1);
+    IndexType lo, hi;
+    for (int k= 0; k< 2; ++k) {
+        lo[k] = std::max(-margin[k], -origin[k]);
+        hi[k] = std::min(size[k] + margin[k], p.extent[k] - origin[k]);
+        if (hi[k] <= lo[k])
+            return;
+    }
+    const int rows = hi[1] - lo[1];
+
+    // lower cell and weight of the upper one along y, the same for all
+    // columns; cell centers at (k+0.5)*cellsize_ like in hist_
+    std::vector<int> ylo(rows);
+    std::vector<RealType> yw(rows);
+    for (int y= 0; y< rows; ++y) {
+        const double pos = (lo[1]+y+0.5)/cellsize_[1] - 0.5;
+        ylo[y] = static_cast<int>(std::floor(pos));
+        yw[y] = pos - ylo[y];
+    }
+
+    // magnitude, orientation bin and weight of the next bin of a column
+    std::vector<RealType> mag(rows), frac(rows);
+    std::vector<int> bin(rows);
+    const RealType binwidth = (semicirc_ ? 180.0 : 360.0)/bins;
+    const int py = origin[1] + lo[1];
+    for (int x= lo[0]; x< hi[0]; ++x) {
+        const int px = origin[0] + x;
+        if (p.fixed() || p.half()) {
+            if (p.half())
+                half2float(&p.fmag(px, py), &mag[0], rows);
+            else {
+                const unsigned short* m = &p.fmag(px, py);
+                for (int y= 0; y< rows; ++y) 
+                    mag[y] = m[y]/p.fscale;
+            }
+            const unsigned short* o = &p.fori(px, py);
+            for (int y= 0; y< rows; ++y) {
+                bin[y] = o[y] >> 8;
+                frac[y] = (o[y] & 255)/256.0;
+            }
+        } else {
+            const RealType* m = &p.mag(px, py);
+            const int* o = &p.ori(px, py);
+            for (int y= 0; y< rows; ++y) {
+                const double pos = o[y]/binwidth - 0.5;
+                const int b = static_cast<int>(std::floor(pos));
+                mag[y] = m[y];
+                frac[y] = pos - b;
+                bin[y] = ((b % bins) + bins) % bins;
+            }
+        }
+
+        const double pos = (x+0.5)/cellsize_[0] - 0.5;
+        const int xlo = static_cast<int>(std::floor(pos));
+        const RealType xw[2] = {1 - (pos - xlo), pos - xlo};
+        for (int y= 0; y< rows; ++y) {
+            if (mag[y] == 0)
+                continue;
+            const int b = bin[y], b1 = b+1 == bins ? 0 : b+1;
+            const RealType yweight[2] = {1 - yw[y], yw[y]};
+            for (int c= 0; c< 4; ++c) {
+                const int cx = xlo + (c >> 1), cy = ylo[y] + (c & 1);
+                if (cx < 0 || cx >= count[0] || cy < 0 || cy >= count[1])
+                    continue;
+                const RealType v = mag[y]*xw[c >> 1]*yweight[c & 1];
+                ElemType* h = dest + (cx*count[1] + cy)*bins;
+                h[b] += v - v*frac[y];
+                h[b1] += v*frac[y];
+            }
+        }
+    }
+}// }}}
+
+void RHOGDense::block(const ElemType* cells, const IndexType count, 
+        const IndexType cell, ElemType* dest)  const
+{// {{{
+    const int bins = fixedbins();
+    for (int i= 0; i< numcell_[0]; ++i) 
+    for (int j= 0; j< numcell_[1]; ++j) {
+        const ElemType* h = cells + ((cell[0]+i)*count[1] + cell[1]+j)*bins;
+        dest = std::copy(h, h + bins, dest);
+        // jointcirc_: 0-180 folding after the 0-360 bins, as in votes()
+        if (jointcirc_)
+            for (int k= 0; k< orientbin_; ++k) 
+                *dest++ = h[k] + h[k+orientbin_];
+    }
+}// }}}
+
+void RHOGDense::cellblock(const IndexType point, const Preprocessor& p, 
+        ElemType* dest)  const
+{// {{{
+    std::vector<ElemType> c (blitz::product(numcell_)*fixedbins());
+    cells(point, numcell_, p, &c[0]);
+    block(&c[0], numcell_, IndexType(0), dest);
 }// }}}
 
 void RHOGDense::print(lear::BiOStream& o) const {// {{{
     using namespace std;
-    lear::FileHeader descheader("RHOGDense",96);
+    // version 97 adds jointcirc_
+    lear::FileHeader descheader("RHOGDense",97);
     o << descheader;
 
     int size=96;
@@ -100,7 +388,7 @@ void RHOGDense::print(lear::BiOStream& o) const {// {{{
     lear::BiOStream::pos_type pos = o.tellp();
 
     o << descsize_ << extent_ << cellsize_ << numcell_ << 
-        stride_ << orientbin_<< semicirc_ << wtscale_ ;
+        stride_ << orientbin_<< semicirc_ << wtscale_ << jointcirc_;
     o << *processor << *normalizer;
 
     lear::BiOStream::pos_type cur = o.tellp();
@@ -132,7 +420,7 @@ void RHOGDense::print(std::ostream& o) const {// {{{
                     "x" << setw(3) << left << stride_[1] << right << 
         "    WeightScale " << setw(7) << setprecision(2) << wtscale_<<" |\n"
         "  | Orient bin  " << setw(7) << orientbin_ << "     over range " 
-                << (semicirc_ ? "(0-180)" : "(0-360)") <<" |\n"
+                << (jointcirc_ ? "(joint)" : semicirc_ ? "(0-180)" : "(0-360)") <<" |\n"
         "  |--------------------------------------------|\n"
         "  | " << setw(42) << left << pstr.str() << right << " |\n"
         "  | " << setw(42) << left << nstr.str() << right << " |\n"
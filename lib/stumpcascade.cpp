@@ -0,0 +1,106 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  stumpcascade.cpp
+ *
+ *    Description:  Provides implementation to stumpcascade.h
+ *
+ * =====================================================================================
+ */
+
+#include <iomanip>
+
+#include <lear/exception.h>
+#include <lear/io/biistream.h>
+#include <lear/io/biostream.h>
+#include <lear/io/fileheader.h>
+
+#include <lear/cvision/stumpcascade.h>
+
+using namespace lear;
+
+namespace {
+const FileHeader header("StumpCas", 100);
+}
+
+StumpCascade::StumpCascade(const IndexType window, const int orientbin,
+        const bool luv, const RealType gscale) 
+    :
+    window_(window), orientbin_(orientbin), luv_(luv), gscale_(gscale)
+{}
+
+StumpCascade::StumpCascade(const std::string& filename) 
+{// {{{
+    BiIStream from(filename.c_str());
+    if (!from)
+        throw Exception("StumpCascade::StumpCascade",
+                "Unable to open model file " + filename);
+
+    FileHeader fheader;
+    from >> fheader;
+    if (!fheader.identify(header.tag()))
+        throw Exception("StumpCascade::StumpCascade",
+                "File " + filename + " does not look like a stump cascade");
+    if (fheader.version() != header.version())
+        throw Exception("StumpCascade::StumpCascade",
+                "File " + filename + " has unsupported version number");
+
+    int count = 0;
+    from >> window_[0] >> window_[1] >> orientbin_ >> luv_ >> gscale_ >> count;
+    const int numch = 1 + orientbin_ + (luv_ ? 3 : 0);
+    stumps_.resize(std::max(count, 0));
+    for (int i= 0; i< count; ++i) {
+        Stump& s = stumps_[i];
+        from >> s.channel >> s.tl[0] >> s.tl[1] >> s.extent[0] >> s.extent[1]
+             >> s.threshold >> s.left >> s.right >> s.reject;
+        if (s.channel < 0 || s.channel >= numch 
+                || s.tl[0] < 0 || s.tl[1] < 0 
+                || s.extent[0] < 1 || s.extent[1] < 1
+                || s.tl[0] + s.extent[0] > window_[0] 
+                || s.tl[1] + s.extent[1] > window_[1])
+            throw Exception("StumpCascade::StumpCascade",
+                    "Stump outside of the window in " + filename);
+    }
+    if (!from)
+        throw Exception("StumpCascade::StumpCascade",
+                "Unable to read model file " + filename);
+}// }}}
+
+void StumpCascade::save(const std::string& filename) const 
+{// {{{
+    BiOStream to(filename.c_str());
+    if (!to)
+        throw Exception("StumpCascade::save",
+                "Unable to open model file " + filename);
+
+    to << header;
+    to << window_[0] << window_[1] << orientbin_ << luv_ << gscale_ 
+       << static_cast<int>(stumps_.size());
+    for (std::vector<Stump>::const_iterator s = stumps_.begin();
+            s != stumps_.end(); ++s)
+        to << s->channel << s->tl[0] << s->tl[1] << s->extent[0] << s->extent[1]
+           << s->threshold << s->left << s->right << s->reject;
+    if (!to)
+        throw Exception("StumpCascade::save",
+                "Unable to write model file " + filename);
+}// }}}
+
+bool StumpCascade::check(const std::string& filename) 
+{
+    return header.verify(filename);
+}
+
+void StumpCascade::print(std::ostream& o) const 
+{
+    using namespace std;
+    o << "StumpCascade ::\n"
+        "  | Window  " << setw(4) << right << window_[0] << "x" << setw(4) << left << window_[1] << "  Stumps " << setw(6) << stumps_.size() << right << "           |\n"
+        "  | Orient  " << setw(4) << left << orientbin_ << "  LUV " << setw(2) << luv_ << "  GScale " << setw(6) << gscale_ << right << "        |\n"
+        "  |----------------------------------------------|\n";
+}
+
+std::ostream& lear::operator<<(std::ostream& o, const StumpCascade& c) 
+{
+    c.print(o);
+    return o;
+}
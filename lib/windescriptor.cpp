@@ -9,6 +9,7 @@
  */
 
 #include <sstream>
+#include <cstring>
 #include <algorithm>
 #include <functional>
 
@@ -25,6 +26,71 @@ using namespace lear;
 typedef WinDescriptor::DescCont::const_iterator   DescIter;
 typedef WinDescriptor::GridCont::const_iterator   GridIter;
 
+static inline int gcd(int a, int b) {
+    while (b) { int t = a%b; a = b; b = t; }
+    return a;
+}
+
+// {{{ PreprocessCache
+template<class PixelType>
+static bool samepixels(const blitz::Array<PixelType,2>& a, 
+        const blitz::Array<PixelType,2>& b)
+{
+    for (int d= 0; d< 2; ++d)
+        if (a.lbound(d) != b.lbound(d) || a.extent(d) != b.extent(d))
+            return false;
+    for (int i= a.lbound(0); i<= a.ubound(0); ++i)
+    for (int j= a.lbound(1); j<= a.ubound(1); ++j)
+        if (std::memcmp(&a(i,j), &b(i,j), sizeof(PixelType)))
+            return false;
+    return true;
+}
+
+template<class PixelType>
+const PreprocessCache::InfoType* PreprocessCache::find(
+        const std::string& key, const blitz::Array<PixelType,2>& image)
+{// {{{
+    for (std::list<Entry>::iterator e = entries_.begin(); 
+            e != entries_.end(); ++e) 
+    {
+        if (e->key != key)
+            continue;
+        const TypedImage<PixelType>* t = 
+            dynamic_cast<const TypedImage<PixelType>*>(e->image);
+        if (!t || !samepixels(t->pixels, image))
+            continue;
+        entries_.splice(entries_.begin(), entries_, e);
+        ++hits_;
+        return &entries_.front().info;
+    }
+    ++misses_;
+    return NULL;
+}// }}}
+
+template<class PixelType>
+void PreprocessCache::insert(const std::string& key, 
+        const blitz::Array<PixelType,2>& image, const InfoType& info)
+{// {{{
+    if (capacity_ < 1)
+        return;
+    while (static_cast<int>(entries_.size()) >= capacity_) {
+        delete entries_.back().image;
+        entries_.pop_back();
+    }
+    TypedImage<PixelType>* t = new TypedImage<PixelType>;
+    t->pixels.reference(image.copy());
+    entries_.push_front(Entry(key, t, info));
+}// }}}
+
+void PreprocessCache::clear()
+{
+    for (std::list<Entry>::iterator e = entries_.begin(); 
+            e != entries_.end(); ++e) 
+        delete e->image;
+    entries_.clear();
+}
+// }}}
+
 WinDescriptor::WinDescriptor(
         const IndexType t_extent_, 
         const DescCont& t_desc_,
@@ -38,7 +104,13 @@ WinDescriptor::WinDescriptor(
     initlength_(0),
     length_(0),
     numItem_(desc_.size()),
-    indexrange_(numItem_)
+    indexrange_(numItem_),
+    fixed_(false),
+    half_(false),
+    cellgrid_(false),
+    shared_(NULL),
+    qscale_(0),
+    shift_(0)
 {
     if (static_cast<int>(grid_.size()) != numItem_) 
     {
@@ -64,6 +136,23 @@ WinDescriptor::WinDescriptor(
 
         // fill cache also
         cache_.push_back(CacheType((*d)->size(), cachesize));
+        blocks_.push_back(BlockMap());
+
+        key_.push_back((*d)->imageprocessor().key());
+        first_.push_back(std::find(key_.begin(), key_.end(), key_.back()) 
+                - key_.begin());
+
+        ostringstream fixedkey;
+        fixedkey << key_.back() << ", fixed-point " << (*d)->fixedbins();
+        fixedkey_.push_back(fixedkey.str());
+        fixedfirst_.push_back(std::find(fixedkey_.begin(), fixedkey_.end(), 
+                    fixedkey_.back()) - fixedkey_.begin());
+
+        ostringstream halfkey;
+        halfkey << key_.back() << ", half " << (*d)->fixedbins();
+        halfkey_.push_back(halfkey.str());
+        halffirst_.push_back(std::find(halfkey_.begin(), halfkey_.end(), 
+                    halfkey_.back()) - halfkey_.begin());
     }
     initlength_ = length_;
 
@@ -76,6 +165,10 @@ WinDescriptor::Preprocessor& WinDescriptor::preprocess( const IProcessor::RGBIma
 {
     return template_preprocess(image);
 }
+WinDescriptor::Preprocessor& WinDescriptor::preprocess( const IProcessor::RGB8Image& image) 
+{
+    return template_preprocess(image);
+}
 template <class PixelType>
 WinDescriptor::Preprocessor& WinDescriptor::template_preprocess( const blitz::Array<PixelType,2>& image) 
 {// {{{
@@ -96,46 +189,275 @@ WinDescriptor::Preprocessor& WinDescriptor::template_preprocess( const blitz::Ar
 
         blitz::Array<PixelType,2> nimage = extendBorder(
                 image, extent_/2-1, extent_/2, image_extent/2);
-        for (DescIter i = desc_.begin(); i != desc_.end(); ++i) {
-            preprocessor.push_back((*i)->preprocess(nimage));
-        }
+        shared_preprocess(nimage);
         image_extent = nimage.extent();
     } else {
-        for (DescIter i = desc_.begin(); i != desc_.end(); ++i) {
-            preprocessor.push_back((*i)->preprocess(image));
-        }
+        shared_preprocess(image);
     }
     //for_each(cache_.begin(), cache_.end(),
     //        bind2nd(mem_fun_ref(&CacheType::clear),image_extent));
     for(WinDescriptor::CacheCont::iterator iter = cache_.begin(); iter!= cache_.end(); iter++){
         iter->clear(image_extent);
     }
+    for(WinDescriptor::BlockCont::iterator iter = blocks_.begin(); iter!= blocks_.end(); iter++){
+        iter->clear();
+    }
+    shift_ = 0;
     return preprocessor;
 }// }}}
 
+template <class PixelType>
+void WinDescriptor::shared_preprocess( const blitz::Array<PixelType,2>& image) 
+{// {{{
+    const std::vector<std::string>& key = 
+        fixed_ ? fixedkey_ : (half_ ? halfkey_ : key_);
+    const std::vector<int>& first = 
+        fixed_ ? fixedfirst_ : (half_ ? halffirst_ : first_);
+
+    std::vector<const DescType::Preprocessor*> done (numItem_);
+    int j = 0;
+    for (DescIter i = desc_.begin(); i != desc_.end(); ++i, ++j) {
+        const DescType::Preprocessor* p = NULL;
+        if (first[j] != j)
+            p = done[first[j]];
+        else if (shared_)
+            p = shared_->find(key[j], image);
+
+        if (p) {
+            // InfoType copies share their arrays
+            preprocessor.push_back(*p);
+        } else {
+            preprocessor.push_back(fixed_ ? (*i)->preprocessfixed(image) 
+                    : (half_ ? (*i)->preprocesshalf(image) 
+                        : (*i)->preprocess(image)));
+            if (shared_)
+                shared_->insert(key[j], image, preprocessor.back());
+        }
+        done[j] = &preprocessor.back();
+    }
+}// }}}
+
+void WinDescriptor::precompute( const IndexType winorigin, const IndexType winstride) 
+{// {{{
+    shift_ = 0;
+    setlattice(winorigin, winstride, false);
+}// }}}
+
+void WinDescriptor::prepare( const IndexType winorigin, const IndexType winstride) 
+{// {{{
+    shift_ = 0;
+    setlattice(winorigin, winstride, true);
+}// }}}
+
+void WinDescriptor::prepare( const IndexType winorigin, const IndexType winstride,
+        const IndexType area, const IndexType offset) 
+{// {{{
+    shift_ = offset;
+    setlattice(winorigin, winstride, true, &area);
+}// }}}
+
+void WinDescriptor::swapblocks( BlockCont& blocks) 
+{// {{{
+    blocks_.swap(blocks);
+    if (static_cast<int>(blocks_.size()) != numItem_)
+        blocks_.assign(numItem_, BlockMap());
+    for (BlockCont::iterator b = blocks_.begin(); b != blocks_.end(); ++b) {
+        b->halfprecision(half_);
+        b->cellgrid(cellgrid_);
+        if (b->quantization() != qscale_)
+            b->quantize(qscale_);
+    }
+}// }}}
+
+void WinDescriptor::setlattice( const IndexType winorigin, const IndexType winstride,
+        const bool lazy, const IndexType* area) 
+{// {{{
+    DescIter d=desc_.begin(); 
+    GridIter g=grid_.begin(); 
+    BlockCont::iterator b = blocks_.begin();
+    Preprocessor::const_iterator p = preprocessor.begin();
+    for (; d!=desc_.end(); ++d, ++p, ++b, ++g)
+    {
+        // block positions of all windows lie on a lattice with spacing
+        // gcd(window stride, descriptor stride)
+        IndexType stride, origin (winorigin + (*g)(g->lbound()));
+        for (int k= 0; k< 2; ++k) {
+            stride[k] = gcd(winstride[k], (*d)->stride()[k]);
+            origin[k] %= stride[k];
+            if (origin[k] < 0) 
+                origin[k] += stride[k];
+        }
+        if (area)
+            b->prepare(**d, origin, stride, *area, shift_);
+        else if (lazy)
+            b->prepare(**d, *p, origin, stride);
+        else
+            b->compute(**d, *p, origin, stride);
+    }
+}// }}}
+
+void WinDescriptor::fill( const IndexType* gridTopLeft, const int count) 
+{// {{{
+    if (count <= 0)
+        return;
+    DescIter d=desc_.begin(); 
+    GridIter g=grid_.begin(); 
+    BlockCont::iterator b = blocks_.begin();
+    Preprocessor::const_iterator p = preprocessor.begin();
+    for (; d!=desc_.end(); ++d, ++p, ++b, ++g)
+    {
+        loc_.clear();
+        for (int k= 0; k< count; ++k) 
+            for (GridType::const_iterator i=g->begin(); i != g->end(); ++i) 
+                loc_.push_back(*i + gridTopLeft[k]);
+        b->fill(**d, *p, &loc_[0], loc_.size());
+    }
+}// }}}
+
 WinDescriptor::FeatType WinDescriptor::compute( const IndexType gridTopLeft) const {// {{{
+    FeatType vec(initlength_);
+    compute(gridTopLeft, vec.data());
+    return vec;
+}// }}}
+
+void WinDescriptor::compute( const IndexType gridTopLeft, ElemType* dest) const {// {{{
     typedef WinDescriptor::CacheCont::iterator        CacheIter;
 
-    FeatType vec(initlength_);
-    FeatType::iterator dest = vec.begin();
-        
     DescIter d=desc_.begin(); 
     GridIter g=grid_.begin(); 
     CacheIter c =  cache_.begin();
+    BlockCont::const_iterator b = blocks_.begin();
     Preprocessor::const_iterator p = preprocessor.begin();
-    for (; d!=desc_.end(); ++d, ++p, ++c, ++g)
+    for (; d!=desc_.end(); ++d, ++p, ++c, ++g, ++b)
     {
+        if (b->contains((*g)(g->lbound()) + gridTopLeft) && 
+            b->contains((*g)(g->ubound()) + gridTopLeft)) 
+        {
+            for (GridType::const_iterator i=g->begin(); 
+                    i != g->end(); ++i) 
+                dest = b->read(*i+gridTopLeft, dest);
+            continue;
+        }
+        // blocks are in level positions, the preprocessed image is not
+        const IndexType at (gridTopLeft - shift_);
+        if (cellgrid_) {
+            cellwindow(**d, *p, *g, at, dest);
+            dest += g->numElements()*(*d)->size();
+            continue;
+        }
         DescOp op(*d,*p);
         for (GridType::const_iterator i=g->begin(); 
                 i != g->end(); ++i) 
         {
-            FeatType f = (*c)(*i+gridTopLeft,op);
+            FeatType f = (*c)(*i+at,op);
             dest = std::copy(f.begin(),f.end(),dest);
         }
     }
-    return vec;
 }// }}}
 
+void WinDescriptor::compute( const IndexType gridTopLeft, unsigned char* dest) const {// {{{
+    typedef WinDescriptor::CacheCont::iterator        CacheIter;
+
+    if (!(qscale_ > 0))
+        throw lear::Exception("WinDescriptor::compute()",
+                "Quantized descriptor requested without quantization scale");
+
+    DescIter d=desc_.begin(); 
+    GridIter g=grid_.begin(); 
+    CacheIter c =  cache_.begin();
+    BlockCont::const_iterator b = blocks_.begin();
+    Preprocessor::const_iterator p = preprocessor.begin();
+    for (; d!=desc_.end(); ++d, ++p, ++c, ++g, ++b)
+    {
+        const int size = (*d)->size();
+        if (b->quantization() == qscale_ &&
+            b->contains((*g)(g->lbound()) + gridTopLeft) && 
+            b->contains((*g)(g->ubound()) + gridTopLeft)) 
+        {
+            for (GridType::const_iterator i=g->begin(); 
+                    i != g->end(); ++i) 
+            {
+                const unsigned char* f = b->quantized(*i+gridTopLeft);
+                dest = std::copy(f, f+size, dest);
+            }
+            continue;
+        }
+        const IndexType at (gridTopLeft - shift_);
+        if (cellgrid_) {
+            const int count = g->numElements()*size;
+            if (static_cast<int>(blockbuf_.size()) < count)
+                blockbuf_.resize(count);
+            cellwindow(**d, *p, *g, at, &blockbuf_[0]);
+            for (int k= 0; k< count; ++k) 
+                *dest++ = quantize8(blockbuf_[k], qscale_);
+            continue;
+        }
+        DescOp op(*d,*p);
+        for (GridType::const_iterator i=g->begin(); 
+                i != g->end(); ++i) 
+        {
+            FeatType f = (*c)(*i+at,op);
+            for (FeatType::const_iterator v = f.begin(); v != f.end(); ++v) 
+                *dest++ = quantize8(*v, qscale_);
+        }
+    }
+}// }}}
+
+void WinDescriptor::cellwindow( const DescType& d, 
+        const DescType::Preprocessor& p, const GridType& g, 
+        const IndexType gridTopLeft, ElemType* dest) const 
+{// {{{
+    const IndexType cellsize (d.cellsize());
+    IndexType lo (g(g.lbound())), hi (lo);
+    bool oncells = true;
+    for (GridType::const_iterator i=g.begin(); i != g.end(); ++i) 
+        for (int k= 0; k< 2; ++k) {
+            lo[k] = std::min(lo[k], (*i)[k]);
+            hi[k] = std::max(hi[k], (*i)[k]);
+        }
+    for (GridType::const_iterator i=g.begin(); i != g.end(); ++i) 
+        for (int k= 0; k< 2; ++k) 
+            if (((*i)[k] - lo[k]) % cellsize[k])
+                oncells = false;
+
+    const int size = d.size();
+    ElemType* first = dest;
+    if (oncells) {
+        const IndexType count ((hi - lo)/cellsize + d.numcell());
+        const int cellcount = blitz::product(count)*d.fixedbins();
+        if (static_cast<int>(cellbuf_.size()) < cellcount)
+            cellbuf_.resize(cellcount);
+        d.cells(gridTopLeft + lo, count, p, &cellbuf_[0]);
+        for (GridType::const_iterator i=g.begin(); i != g.end(); ++i, dest+=size) 
+            d.block(&cellbuf_[0], count, IndexType((*i - lo)/cellsize), dest);
+    } else {
+        for (GridType::const_iterator i=g.begin(); i != g.end(); ++i, dest+=size) 
+            d.cellblock(*i + gridTopLeft, p, dest);
+    }
+    d.blocknormalizer()(first, g.numElements(), size);
+}// }}}
+
+void WinDescriptor::halfprecision( const bool on) 
+{
+    half_ = on;
+    for (BlockCont::iterator b = blocks_.begin(); b != blocks_.end(); ++b) 
+        b->halfprecision(on);
+}
+
+void WinDescriptor::cellgrid( const bool on) 
+{
+    cellgrid_ = on;
+    for (BlockCont::iterator b = blocks_.begin(); b != blocks_.end(); ++b) 
+        b->cellgrid(on);
+}
+
+void WinDescriptor::quantize( const RealType scale) 
+{
+    qscale_ = scale;
+    for (BlockCont::iterator b = blocks_.begin(); b != blocks_.end(); ++b) 
+        b->quantize(scale);
+}
+
 void WinDescriptor::print(std::ostream& o) const {// {{{
     using namespace std;
     o << setw(14) << title() << 
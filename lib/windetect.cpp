@@ -11,10 +11,18 @@
 
 
 #include <list>
+#include <cmath>
+#include <vector>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <boost/random.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <blitz/array.h>
 #include <blitz/tinyvec.h>
 
@@ -36,10 +44,15 @@
 #include <lear/cvision/imageslider.h>
 #include <lear/cvision/scalepyramid.h>
 #include <lear/cvision/windescriptor.h>
+#include <lear/cvision/halffloat.h>
+#include <lear/cvision/channelfeatures.h>
+#include <lear/cvision/stumpcascade.h>
+#include <lear/util/lookup.h>
 
 #include <lear/image/imageio.h>
 
 #include <lear/interface/windetect.h>
+#include <lear/interface/detectorbundle.h>
 
 typedef RHOGDenseParam::RealType        RealType;
 typedef blitz::Array<RealType,1>        Array1DType;
@@ -69,18 +82,31 @@ struct WinDetectDescHolder {
     GridContainer                gridarray;
 
     WinDescType*                 windesc;
+    /// see WinDetect::sharedlevels
+    PreprocessCache*             shared;
 
     WinDetectDescHolder() :
-        initialized(false), windesc(NULL)
+        initialized(false), windesc(NULL), shared(NULL)
     {}
 
     ~WinDetectDescHolder() 
+    { clear(); }
+
+    /// frees all descriptors, back to the uninitialized state
+    void clear() 
     {
         delete windesc;
+        delete shared;
         for (DescContainer::iterator i=descarray.begin(); i != descarray.end(); ++i)
             delete *i; 
+        descarray.clear();
+        gridarray.clear();
+        windesc = NULL;
+        shared = NULL;
+        initialized = false;
     }
-    static RHOGDense* init(const RHOGDenseParam& param, int verobse=0);
+    static RHOGDense* init(const RHOGDenseParam& param, int verobse=0,
+            const RealType* weight=NULL);
 };
 static WinDetectDescHolder          descholder;
 
@@ -108,12 +134,57 @@ void WinDetect::init(const std::vector<const RHOGDenseParam*>& param)
 
     descholder.windesc = new WinDescType(
             size, descholder.descarray, descholder.gridarray, cachesize);
+    if (sharedlevels > 0) {
+        descholder.shared = new PreprocessCache(sharedlevels);
+        descholder.windesc->share(descholder.shared);
+    }
+    descholder.windesc->cellgrid(cellgrid);
+    descholder.initialized = true;
+    if (verbose > 1) 
+    { cout << *descholder.windesc << endl; }
+} // }}}
+
+void WinDetect::init(const DetectorBundle& bundle) 
+{// {{{ init
+    if (descholder.initialized) {
+        throw Exception("WinDetect::init", 
+            "Init is supposed to be called only once. This is a repeat initialization.");
+    }
+    bundle.fill(*this);
+    IndexType size(size_x, size_y);
+
+    const std::vector<const RHOGDenseParam*>& param = bundle.param();
+    for (unsigned i= 0; i< param.size(); ++i) {
+        WinDescType::DescType* desc =  WinDetectDescHolder::init(
+                *param[i], verbose, bundle.gaussweight(i));
+        descholder.descarray.push_back(desc);
+        descholder.gridarray.push_back( DenseGrid<2>::get( size, desc->extent(), desc->stride()) );
+        if (static_cast<int>(descholder.gridarray.back().size()) != bundle.numblock(i)) {
+            descholder.clear();
+            throw Exception("WinDetect::init", 
+                "Bundle block count does not match the window geometry");
+        }
+    }
+
+    descholder.windesc = new WinDescType(
+            size, descholder.descarray, descholder.gridarray, cachesize);
+    if (sharedlevels > 0) {
+        descholder.shared = new PreprocessCache(sharedlevels);
+        descholder.windesc->share(descholder.shared);
+    }
+    if (descholder.windesc->length() != bundle.length()) {
+        descholder.clear();
+        throw Exception("WinDetect::init", 
+            "Bundle classifier length does not match the feature length");
+    }
+    descholder.windesc->cellgrid(cellgrid);
     descholder.initialized = true;
     if (verbose > 1) 
     { cout << *descholder.windesc << endl; }
 } // }}}
 
-RHOGDense* WinDetectDescHolder::init(const RHOGDenseParam& param, int verbose) 
+RHOGDense* WinDetectDescHolder::init(const RHOGDenseParam& param, int verbose,
+        const RealType* weight) 
 { //{{{
     ImageNoRemap* mapperBefore = NULL;// remap image before computing gradient
     ImageNoRemap* mapperAfter = NULL;// remap gradient magnitude 
@@ -128,24 +199,26 @@ RHOGDense* WinDetectDescHolder::init(const RHOGDenseParam& param, int verbose)
             break;
 
         case RHOGDenseParam::Lab_Sqrt_Grad:
-            mapperBefore = new ImageLabSqrtRemap();
+            mapperBefore = new ImageLabSqrtRemap(param.labnodes);
             break;
 
         case RHOGDenseParam::Lab_Grad:
-            mapperBefore = new ImageLabRemap();
+            mapperBefore = new ImageLabRemap(param.labnodes);
             break;
 
         case RHOGDenseParam::RGB_Grad:
         default:
             break;
     };
+    // joint orientation bins fold the 0-360 ones
+    const bool semicirc = param.semicirc && !param.jointcirc;
     IProcessor* preprocessor=NULL;
     if (param.gscale < 1e-3) {
         // It owns and deletes all pointers. So no worries.
-        preprocessor = new GradProcessor_NoSmooth(param.semicirc, NULL, mapperBefore, mapperAfter);
+        preprocessor = new GradProcessor_NoSmooth(semicirc, NULL, mapperBefore, mapperAfter);
     } else {
         // It owns and deletes all pointers. So no worries.
-        preprocessor = new GradProcessor(param.gscale, param.semicirc, NULL, mapperBefore, mapperAfter);
+        preprocessor = new GradProcessor(param.gscale, semicirc, NULL, mapperBefore, mapperAfter);
     }
     DescNormalizer<RealType>* normalizer=NULL;
     switch (param.norm2use) {
@@ -176,34 +249,199 @@ RHOGDense* WinDetectDescHolder::init(const RHOGDenseParam& param, int verbose)
 
     WinDescType::DescType* desc = new RHOGDense(
                 cellsize, numcell, stride, 
-                param.orientbin, param.wtscale, param.semicirc, 
-                preprocessor, normalizer);// owns preprocessor & normalizer and frees them when they not required
+                param.orientbin, param.wtscale, semicirc, 
+                preprocessor, normalizer, weight, param.jointcirc);// owns preprocessor & normalizer and frees them when they not required
 
     if (verbose > 1) 
         std::cout << *desc << std::endl;
     return desc;
 }//}}}
 
-// Convert image to blitz array format
-static WinDescType::ImageType getImage(
-        const unsigned char* image, int width, int height, int step) 
-{
-    WinDescType::ImageType bimage(width, height) ;
-    if (step==0)
-        step = 3*width;
+// {{{ frame buffer ingestion
+static inline void setpixel(ImageNoRemap::RGB8Type& d, 
+        const unsigned char* p, const int* off) 
+{ d = p[off[0]], p[off[1]], p[off[2]]; }
 
-    for (int j= 0; j< height; ++j) 
-    for (int i= 0; i< width; ++i) {
-        const unsigned char* pixel = image+j*step + 3*i;
-        bimage(i,j) = IProcessor::RGBType(pixel[0], pixel[1], pixel[2]);
+static inline void setpixel(IProcessor::RGBType& d, 
+        const unsigned char* p, const int* off) 
+{ d = p[off[0]], p[off[1]], p[off[2]]; }
+
+static inline void setpixel(IProcessor::GrayType& d, 
+        const unsigned char* p, const int* off) 
+{ d = p[off[0]]; }
+
+/**
+ * Copies an 8-bit frame buffer in the given format into a blitz image. The
+ * buffer is row-major, whereas x is the major index of the image, so the
+ * copy transposes. It works on Tile x Tile blocks, so that the source rows
+ * and destination columns of a block both stay in cache. PixelType is
+ * RGB8Type, RGBType or GrayType; the latter requires a Gray format. See
+ * viewframe for the layouts that need no copy.
+ */
+template<class PixelType>
+static blitz::Array<PixelType,2> readframe(
+        const unsigned char* image, const int width, const int height, 
+        const PixelFormat& format) 
+{// {{{
+    enum {Tile = 32};
+    if (!image || width <= 0 || height <= 0)
+        throw Exception("readframe", "Empty image buffer");
+
+    const int pixelbytes = format.pixelbytes();
+    const int rowbytes = format.rowbytes(width);
+    int off[3];
+    for (int c= 0; c< 3; ++c)
+        off[c] = format.planar() ? 
+            format.index(c)*format.planestep : format.index(c);
+
+    blitz::Array<PixelType,2> bimage(width, height);
+    PixelType* dest = bimage.data();
+
+    for (int j0= 0; j0< height; j0+=Tile)
+    for (int i0= 0; i0< width; i0+=Tile) {
+        const int j1 = std::min(j0+Tile, height);
+        const int i1 = std::min(i0+Tile, width);
+        for (int j= j0; j< j1; ++j) {
+            const unsigned char* row = image + j*rowbytes;
+            for (int i= i0; i< i1; ++i)
+                setpixel(dest[i*height + j], row + i*pixelbytes, off);
+        }
     }
-    //ImageIO::write("image.png", bimage);
     return bimage;
-} 
+}// }}}
+
+/**
+ * Sets view to the frame buffer itself, without a copy, if its pixels are
+ * 3 bytes in RGB order and its rows a whole number of pixels apart: x then
+ * steps one pixel and y one row of the buffer, which image remaps read
+ * through the strides. Returns false for other formats. view must not
+ * outlive the buffer.
+ */
+static bool viewframe(
+        const unsigned char* image, const int width, const int height, 
+        const PixelFormat& format, ImageNoRemap::RGB8Image& view) 
+{// {{{
+    typedef ImageNoRemap::RGB8Type          RGB8Type;
+    const int rowbytes = format.rowbytes(width);
+    if (format.order != PixelFormat::RGB || format.planar() || 
+            format.pixelbytes() != 3 || rowbytes % 3 || 
+            sizeof(RGB8Type) != 3)
+        return false;
+    RGB8Type* data = reinterpret_cast<RGB8Type*>(const_cast<unsigned char*>(image));
+    view.reference(ImageNoRemap::RGB8Image(data, blitz::shape(width, height),
+                blitz::shape(1, rowbytes/3), blitz::neverDeleteData));
+    return true;
+}// }}}
+
+/**
+ * Preprocesses the frame buffer. Gray buffers take the gray image route,
+ * color buffers are handed over as 8-bit images, which the image remap
+ * converts to float: RGB buffers are read in place (see viewframe), other
+ * layouts are copied first.
+ */
+static void preprocessframe(WinDescType* windesc,
+        const unsigned char* image, const int width, const int height, 
+        const PixelFormat& format) 
+{
+    ImageNoRemap::RGB8Image view;
+    if (format.gray())
+        windesc->preprocess(
+                readframe<IProcessor::GrayType>(image,width,height,format));
+    else if (viewframe(image, width, height, format, view))
+        windesc->preprocess(view);
+    else
+        windesc->preprocess(
+                readframe<ImageNoRemap::RGB8Type>(image,width,height,format));
+}
+// }}}
+
+/**
+ * Rejects windows of low gradient energy before their descriptor is
+ * computed, see WinDetectClassify::energythreshold. Holds the integral
+ * image of the gradient magnitude of the preprocessed level.
+ */
+struct EnergyFilter {// {{{
+    EnergyFilter(const RealType threshold, const IndexType winsize) : 
+        threshold(threshold), winsize(winsize), lb(0), rejected(0) {}
+
+    /// integral image of the magnitude of the first descriptor
+    void build(const WinDescType::Preprocessor& p) {
+        const IProcessor::InfoType& info = p.front();
+        if (info.half()) {
+            IProcessor::Array2DType mag(info.fmag.lbound(), info.fmag.extent());
+            half2float(info.fmag.data(), mag.data(), mag.numElements());
+            build(mag, 1);
+        } else if (info.fixed())
+            build(info.fmag, 1/info.fscale);
+        else
+            build(info.mag, 1);
+    }
+    /// integral image of mag times unit
+    template<class T>
+    void build(const blitz::Array<T,2>& mag, const double unit) {
+        const IndexType ext (mag.extent());
+        lb = mag.lbound();
+        integral.resize(ext[0]+1, ext[1]+1);
+        integral = 0;
+        for (int i= 0; i< ext[0]; ++i) {
+            double column = 0;
+            for (int j= 0; j< ext[1]; ++j) {
+                column += mag(lb[0]+i, lb[1]+j)*unit;
+                integral(i+1,j+1) = integral(i,j+1) + column;
+            }
+        }
+    }
+
+    /// mean magnitude of window at tl of the preprocessed image
+    RealType energy(const IndexType tl) const {
+        IndexType a, b;
+        for (int d= 0; d< 2; ++d) {
+            const int max = integral.extent(d)-1;
+            a[d] = std::min(std::max(tl[d] - lb[d], 0), max);
+            b[d] = std::min(std::max(tl[d] - lb[d] + winsize[d], 0), max);
+        }
+        const int area = (b[0]-a[0])*(b[1]-a[1]);
+        if (area <= 0)
+            return 0;
+        return (integral(b[0],b[1]) - integral(a[0],b[1]) 
+                - integral(b[0],a[1]) + integral(a[0],a[1]))/area;
+    }
+
+    bool accept(const IndexType tl) const {
+        if (energy(tl) >= threshold)
+            return true;
+        ++rejected;
+        return false;
+    }
+
+    const RealType threshold;
+    const IndexType winsize;
+    blitz::Array<double,2> integral;
+    IndexType lb;
+    /// windows rejected since construction
+    mutable int rejected;
+};// }}}
 
 bool WinDetect::computefeature(
     float* result, int xloc, int yloc, 
     const unsigned char* image, int width, int height, int step) const
+{
+    return computefeature(result, xloc, yloc, image, width, height, 
+            PixelFormat(PixelFormat::RGB, step));
+}
+
+std::vector<bool> WinDetect::computefeature(
+    std::vector<float*>& result, const std::vector<int>& xlocs, const std::vector<int>& ylocs, 
+    const unsigned char* image, int width, int height, int step) const
+{
+    return computefeature(result, xlocs, ylocs, image, width, height, 
+            PixelFormat(PixelFormat::RGB, step));
+}
+
+bool WinDetect::computefeature(
+    float* result, int xloc, int yloc, 
+    const unsigned char* image, int width, int height, 
+    const PixelFormat& format) const
 {// {{{
     if (!descholder.initialized) {
         throw Exception("WinDetect::computefeature", 
@@ -217,9 +455,7 @@ bool WinDetect::computefeature(
         xloc+descextent[0] <=width && 
         yloc+descextent[1] <=height)
     {
-        WinDescType::ImageType pyimage = getImage(image,width,height, step); 
-
-        windesc->preprocess(pyimage);
+        preprocessframe(windesc, image, width, height, format);
         Array1DType desc = windesc->compute(IndexType(xloc,yloc)); 
         std::copy(desc.begin(), desc.end(), result);
         return true;
@@ -229,7 +465,8 @@ bool WinDetect::computefeature(
 
 std::vector<bool> WinDetect::computefeature(
     std::vector<float*>& result, const std::vector<int>& xlocs, const std::vector<int>& ylocs, 
-    const unsigned char* image, int width, int height, int step) const
+    const unsigned char* image, int width, int height, 
+    const PixelFormat& format) const
 {// {{{
     std::vector<bool> status(xlocs.size());
     if (!descholder.initialized) {
@@ -241,8 +478,7 @@ std::vector<bool> WinDetect::computefeature(
 
     IndexType descextent = windesc->extent();
 
-    WinDescType::ImageType pyimage = getImage(image,width,height, step); 
-    windesc->preprocess(pyimage);
+    preprocessframe(windesc, image, width, height, format);
 
     for (unsigned i= 0; i< xlocs.size(); ++i) {
         IndexType topleft (xlocs[i], ylocs[i]);
@@ -259,6 +495,131 @@ std::vector<bool> WinDetect::computefeature(
     return status;
 }// }}}
 
+WinDetect::RealType WinDetect::windowenergy(
+    const int xloc, const int yloc, 
+    const unsigned char* image, int width, int height, 
+    const PixelFormat& format) const
+{// {{{
+    if (!descholder.initialized) {
+        throw Exception("WinDetect::windowenergy", 
+            "Init is supposed to be called before calling windowenergy");
+    }
+    WinDescType* windesc = descholder.windesc;
+    const IndexType descextent = windesc->extent();
+
+    if (xloc < 0 || yloc < 0 || 
+        xloc+descextent[0] > width || yloc+descextent[1] > height)
+        return -1;
+
+    preprocessframe(windesc, image, width, height, format);
+    EnergyFilter filter(0, descextent);
+    filter.build(windesc->preprocessed());
+    return filter.energy(IndexType(xloc,yloc));
+}// }}}
+
+LinearClassify WinDetect::posevariant(const LinearClassify& classifier,
+    const bool mirror, const RealType angle) const
+{// {{{
+    typedef blitz::TinyVector<double,2> Real2DType;
+    if (!descholder.initialized) {
+        throw Exception("WinDetect::posevariant", 
+            "Init is supposed to be called before calling posevariant");
+    }
+    const WinDescType* windesc = descholder.windesc;
+    if (classifier.length() != windesc->length())
+        throw Exception("WinDetect::posevariant", 
+            "Classifier length does not match the feature length");
+
+    const double rad = angle*MathConst<double>::PI_Value/180;
+    const double c = std::cos(rad), s = std::sin(rad);
+    const Real2DType center (Real2DType(windesc->extent())/2.0);
+    // model position of window position p: rotate back, then mirror
+    struct Pose {
+        double c, s; bool mirror;
+        Real2DType operator()(const Real2DType v) const {
+            Real2DType r (c*v[0] + s*v[1], -s*v[0] + c*v[1]);
+            if (mirror) r[0] = -r[0];
+            return r;
+        }
+    } pose = {c, s, mirror};
+
+    std::vector<double> weight(classifier.length(), 0);
+    int offset = 0;
+    DescContainer::const_iterator d = windesc->descriptors().begin();
+    GridContainer::const_iterator g = windesc->grids().begin();
+    for (; d != windesc->descriptors().end(); ++d, ++g) 
+    {// {{{
+        const RHOGDense& desc = **d;
+        const GridType& grid = *g;
+        const IndexType nblock (grid.extent()), ncell (desc.numcell());
+        const Real2DType cellsize (desc.cellsize());
+        const Real2DType half (Real2DType(desc.extent())/2.0);
+        const Real2DType origin (grid(0,0));
+        const Real2DType stride (desc.stride());
+
+        // orientation bins of a cell: first, number, range in degrees
+        const int ob = desc.orientbin();
+        int segments = 1, first[2] = {0, 2*ob}, bins[2] = {ob, ob};
+        double range[2] = {desc.semicirc() ? 180.0 : 360.0, 180};
+        if (desc.jointcirc()) {
+            segments = 2; bins[0] = 2*ob; range[0] = 360;
+        }
+        const int cellbins = desc.jointcirc() ? 3*ob : ob;
+        const int blocklen = desc.size();
+
+        for (int bi= 0; bi< nblock[0]; ++bi) 
+        for (int bj= 0; bj< nblock[1]; ++bj) {
+            // lattice coordinates of the model block
+            const Real2DType pb (Real2DType(grid(bi,bj)) + half);
+            const Real2DType u ((pose(Real2DType(pb - center)) + center - half - origin)/stride);
+            const int u0 = static_cast<int>(std::floor(u[0]));
+            const int u1 = static_cast<int>(std::floor(u[1]));
+
+            for (int ci= 0; ci< ncell[0]; ++ci) 
+            for (int cj= 0; cj< ncell[1]; ++cj) {
+                const Real2DType o ((Real2DType(ci,cj) + 0.5)*cellsize - half);
+                const Real2DType v (pose(o)/cellsize + Real2DType(ncell)/2.0 - 0.5);
+                IndexType sc;
+                for (int k= 0; k< 2; ++k)
+                    sc[k] = std::min(std::max(
+                            static_cast<int>(std::floor(v[k] + 0.5)), 0), ncell[k]-1);
+                const int target = offset + (bi*nblock[1] + bj)*blocklen 
+                    + (ci*ncell[1] + cj)*cellbins;
+                const int cell = (sc[0]*ncell[1] + sc[1])*cellbins;
+
+                for (int n= 0; n< segments; ++n)
+                for (int k= 0; k< bins[n]; ++k) {
+                    const double bw = range[n]/bins[n];
+                    double ori = (k + 0.5)*bw - angle;
+                    if (mirror) 
+                        ori = 180 - ori;
+                    const double f = ori/bw - 0.5;
+                    const double k0 = std::floor(f), a = f - k0;
+                    int b0 = static_cast<int>(k0) % bins[n];
+                    if (b0 < 0) 
+                        b0 += bins[n];
+                    const int b1 = (b0 + 1) % bins[n];
+
+                    double w = 0;
+                    for (int i= u0; i<= u0+1; ++i)
+                    for (int j= u1; j<= u1+1; ++j) {
+                        const double wb = (1 - std::abs(u[0] - i))*(1 - std::abs(u[1] - j));
+                        if (i < 0 || j < 0 || i >= nblock[0] || j >= nblock[1] || wb <= 0)
+                            continue;
+                        const int src = offset + (i*nblock[1] + j)*blocklen 
+                            + cell + first[n];
+                        w += wb*((1-a)*classifier.weight(src + b0) 
+                                + a*classifier.weight(src + b1));
+                    }
+                    weight[target + first[n] + k] = w;
+                }
+            }
+        }
+        offset += nblock[0]*nblock[1]*blocklen;
+    }// }}}
+    return LinearClassify(weight, classifier.bias());
+}// }}}
+
     
 int WinDetect::featurelength() const
 {
@@ -623,6 +984,7 @@ void WinDetectDump::writeWinDesc(
                 SliderType slider(pyimg.extent(),size,winstride);
 
                 windesc->preprocess(pyimg);
+                windesc->precompute(slider.lbound(), winstride);
 
                 for (SliderType::iterator siter = slider.begin(); 
                         siter != slider.end(); ++siter) 
@@ -703,6 +1065,8 @@ void WinDetectDump::writeWinDesc(
 #include <lear/classifier/resultholder.h>
 #include <lear/classifier/th_processresult.h>
 #include <lear/classifier/ms_processresult.h>
+#include <lear/classifier/ss_processresult.h>
+#include <lear/classifier/greedy_processresult.h>
 
 /**
  * A static object. It hides the complexity of determining the best object
@@ -710,7 +1074,7 @@ void WinDetectDump::writeWinDesc(
  */
 struct WinDetectClassifyHolder {
     bool initialized;
-    MS_ProcessResult *             holder;
+    ProcessResult *                holder;
 
     WinDetectClassifyHolder() :
         initialized(false), holder(NULL)
@@ -741,6 +1105,665 @@ static inline lear::DetectInfo bound(
             blitz::ceil(c - s/2), blitz::floor(s), lbound);
 }
 
+/// Scores and top-left corners of the windows scored on one pyramid level
+struct LevelScores {// {{{
+    std::vector<float> score;
+    std::vector<int> x, y;
+    /// lattice points already scored, coarse-to-fine scan only
+    std::vector<char> done;
+
+    void clear() { score.clear(); x.clear(); y.clear(); }
+    int size() const { return score.size(); }
+    void push_back(const RealType s, const IndexType tl) {
+        score.push_back(s); x.push_back(tl[0]); y.push_back(tl[1]);
+    }
+    ScoreBatch batch(const RealType scale, const IndexType extent, 
+            const IndexType shift) const 
+    {
+        return ScoreBatch(&score[0], &x[0], &y[0], size(), scale, extent, shift);
+    }
+};// }}}
+
+/// windows scored with one call of the classifier
+static const int BatchWindows = 32;
+
+/**
+ * Scores window at top-left tl with the current level of windesc, or a
+ * batch of windows: their descriptors are computed into the rows of a
+ * matrix, scored with one call of the classifier. If lazy, the blocks of
+ * the windows are computed first (see WinDescriptor::prepare).
+ */
+struct ScoreWindow {// {{{
+    ScoreWindow(WinDescType* windesc, const WindowClassifier& classifier,
+            RealType* desc) :
+        windesc(windesc), classifier(classifier), desc(desc), offset(0),
+        lazy(false), filter(NULL), quantized(NULL), qdesc(NULL),
+        matrix(BatchWindows*windesc->length()) {}
+
+    RealType operator()(const IndexType tl) const {
+        if (lazy) {
+            const IndexType at (tl - offset);
+            windesc->fill(&at, 1);
+        }
+        if (quantized) {
+            windesc->compute(tl - offset, qdesc);
+            return (*quantized)(qdesc);
+        }
+        windesc->compute(tl - offset, desc);
+        return classifier(desc);
+    }
+    /// scores of the count <= BatchWindows windows at tl to score
+    void operator()(const IndexType* tl, const int count, RealType* score) const {
+        IndexType at[BatchWindows];
+        for (int k= 0; k< count; ++k) 
+            at[k] = tl[k] - offset;
+        if (lazy)
+            windesc->fill(at, count);
+        if (quantized) {
+            for (int k= 0; k< count; ++k) {
+                windesc->compute(at[k], qdesc);
+                score[k] = (*quantized)(qdesc);
+            }
+            return;
+        }
+        const int length = windesc->length();
+        for (int k= 0; k< count; ++k) 
+            windesc->compute(at[k], &matrix[k*length]);
+        classifier(&matrix[0], count, score);
+    }
+    /// false if filter rejects the window, it is then not scored
+    bool accept(const IndexType tl) const {
+        return !filter || filter->accept(tl - offset);
+    }
+    WinDescType* windesc;
+    const WindowClassifier& classifier;
+    RealType* desc;
+    /// level position of the preprocessed image, see preparelevel
+    IndexType offset;
+    /// blocks are computed per batch, see preparelevel
+    bool lazy;
+    /// energy prefilter of the current level, if any
+    const EnergyFilter* filter;
+    /// integer scoring of 8-bit descriptors in qdesc, if set
+    const QuantizedClassify* quantized;
+    unsigned char* qdesc;
+    /// descriptors of a batch, one per row
+    mutable std::vector<RealType> matrix;
+};// }}}
+
+/**
+ * Sets score up for integer scoring if o.descscale is positive: windesc
+ * then keeps its blocks quantized, and quantized and qdesc hold the model
+ * and descriptor. Otherwise windesc stops quantizing. Integer scoring
+ * requires classifier to be a LinearClassify.
+ */
+static void setquantized(const WinDetectClassify& o, WinDescType* windesc,
+        const WindowClassifier& classifier, ScoreWindow& score, 
+        QuantizedClassify& quantized, std::vector<unsigned char>& qdesc)
+{// {{{
+    windesc->quantize(o.descscale);
+    if (!(o.descscale > 0))
+        return;
+    const LinearClassify* linear = 
+        dynamic_cast<const LinearClassify*>(&classifier);
+    if (!linear)
+        throw Exception("WinDetectClassify::test()", 
+            "Integer scoring (descscale) requires a LinearClassify");
+    // weights are quantized on each call, which costs one pass over the
+    // model, so that changes to the classifier are always picked up
+    quantized = QuantizedClassify(*linear, o.descscale);
+    qdesc.resize(windesc->length());
+    score.quantized = &quantized;
+    score.qdesc = &qdesc[0];
+}// }}}
+
+/**
+ * Lattice rows [first,last] of a level at scale whose windows agree with
+ * the ground plane prior of o (see WinDetectClassify::groundtolerance).
+ * Windows have top rows origin + k*stride, k < count, and are moved by
+ * -shift in the image. Returns false if no row agrees.
+ */
+static bool groundband(
+        const WinDetectClassify& o, const RealType scale, 
+        const int origin, const int stride, const int count, const int shift,
+        int& first, int& last)
+{// {{{
+    first = 0; last = count-1;
+    if (!(o.groundtolerance > 0))
+        return count > 0;
+
+    // window height h and bottom row r(k) in the image, expected height
+    // a*r(k)+b must lie in [h/(1+tol), h*(1+tol)], i.e. p*k+q in [lo,hi]
+    const RealType h = o.size_y*scale;
+    const RealType lo = h/(1+o.groundtolerance), hi = h*(1+o.groundtolerance);
+    const RealType p = o.groundplane_a*scale*stride;
+    const RealType q = o.groundplane_a*(scale*(origin + o.size_y) - shift) 
+        + o.groundplane_b;
+    if (p == 0) 
+        return q >= lo && q <= hi && count > 0;
+
+    RealType k0 = (lo - q)/p, k1 = (hi - q)/p;
+    if (p < 0) 
+        std::swap(k0,k1);
+    // clamp before converting, k0 and k1 may be far out of int range
+    k0 = std::max(k0, RealType(first)); k1 = std::min(k1, RealType(last));
+    first = static_cast<int>(std::ceil(k0));
+    last = static_cast<int>(std::floor(k1));
+    return first <= last;
+}// }}}
+
+/**
+ * Lattice points of a level at scale, with windows of size winsize on
+ * origin + k*stride, 0 <= k < extent, moved by -shift in the image, whose
+ * window center and scale lie in one of regions. origin and extent are
+ * reduced to the bounding box of these points, and mask (x outer, over the
+ * new extent) marks the points to score. Returns false if no point is left.
+ */
+static bool regionmask(
+        const std::vector<SearchRegion>& regions, const RealType scale,
+        const IndexType winsize, const IndexType shift, const IndexType stride,
+        IndexType& origin, IndexType& extent, std::vector<char>& mask)
+{// {{{
+    std::vector<IndexType> lo, hi;
+    IndexType blo (extent), bhi (-1);
+    for (unsigned r= 0; r< regions.size(); ++r) {
+        const SearchRegion& g = regions[r];
+        if (scale < g.minscale || scale > g.maxscale)
+            continue;
+        const RealType c0[2] = {g.x0, g.y0}, c1[2] = {g.x1, g.y1};
+        IndexType l, h;
+        for (int d= 0; d< 2; ++d) {
+            // clamp before converting, far away regions are out of int range
+            // lattice index k of the window centered on image coordinate c,
+            // inverse of c = scale*(origin + k*stride + winsize/2) - shift
+            RealType k0 = ((c0[d] + shift[d])/scale - winsize[d]/2 - origin[d])
+                /stride[d];
+            RealType k1 = ((c1[d] + shift[d])/scale - winsize[d]/2 - origin[d])
+                /stride[d];
+            k0 = std::max(k0, RealType(0)); k1 = std::min(k1, RealType(extent[d]-1));
+            l[d] = static_cast<int>(std::ceil(k0));
+            h[d] = static_cast<int>(std::floor(k1));
+        }
+        if (l[0] > h[0] || l[1] > h[1])
+            continue;
+        lo.push_back(l); hi.push_back(h);
+        blo = blitz::min(blo, l); bhi = blitz::max(bhi, h);
+    }
+    if (lo.empty())
+        return false;
+
+    origin += blo*stride;
+    extent = bhi - blo + 1;
+    mask.assign(extent[0]*extent[1], 0);
+    for (unsigned r= 0; r< lo.size(); ++r)
+        for (int i= lo[r][0]; i<= hi[r][0]; ++i)
+        for (int j= lo[r][1]; j<= hi[r][1]; ++j)
+            mask[(i-blo[0])*extent[1] + j-blo[1]] = 1;
+    return true;
+}// }}}
+
+/// level pixels around the windows of a band, see levelband
+static const int BandMargin = 8;
+
+/**
+ * Level pixels [lo,hi) the windows on origin + k*stride, 0 <= k < extent,
+ * of a level of extent levelextent use, with a margin so gradients at the
+ * border of the band are the same as in the whole level.
+ */
+static void levelband(
+        const IndexType origin, const IndexType extent, 
+        const IndexType stride, const IndexType winsize, 
+        const IndexType levelextent, IndexType& lo, IndexType& hi)
+{// {{{
+    for (int d= 0; d< 2; ++d) {
+        lo[d] = std::max(origin[d] - BandMargin, 0);
+        hi[d] = std::min(origin[d] + (extent[d]-1)*stride[d] + winsize[d] 
+                + BandMargin, levelextent[d]);
+    }
+}// }}}
+
+/**
+ * Preprocesses level image pyimg and precomputes the blocks of windows
+ * origin + k*stride, 0 <= k < extent. If lazy the block lattice is only
+ * prepared, and blocks are computed for the windows that are scored (see
+ * ScoreWindow::lazy). If crop is set only the part of the level these
+ * windows use is preprocessed, with a margin so gradients at its border
+ * are the same as in the whole level. Returns the level position of the
+ * preprocessed image, which compute() is relative to.
+ */
+template<class ImageType>
+static IndexType preparelevel(
+        WinDescType* windesc, const ImageType& pyimg, 
+        const IndexType origin, const IndexType extent, 
+        const IndexType stride, const IndexType winsize, const bool crop,
+        const bool lazy = false)
+{// {{{
+    IndexType lo, hi;
+    levelband(origin, extent, stride, winsize, pyimg.extent(), lo, hi);
+    const bool part = lo[0] > 0 || lo[1] > 0 
+        || hi[0] < pyimg.extent(0) || hi[1] < pyimg.extent(1);
+
+    IndexType offset(0);
+    if (crop && part) {
+        offset = lo;
+        ImageType band (pyimg(blitz::Range(lo[0], hi[0]-1), 
+                    blitz::Range(lo[1], hi[1]-1)).copy());
+        windesc->preprocess(band);
+    } else {
+        windesc->preprocess(pyimg);
+    }
+    if (lazy)
+        windesc->prepare(origin - offset, stride);
+    else
+        windesc->precompute(origin - offset, stride);
+    return offset;
+}// }}}
+
+/**
+ * Collects the windows score accepts and scores them BatchWindows at a
+ * time into s. Call flush() before reading s.
+ */
+template<class Score>
+class BatchScan {// {{{
+    public:
+        BatchScan(const Score& score, LevelScores& s) : score_(score), s_(s)
+        { tl_.reserve(BatchWindows); }
+
+        void operator()(const IndexType tl) {
+            if (!score_.accept(tl))
+                return;
+            tl_.push_back(tl);
+            if (tl_.size() == static_cast<unsigned>(BatchWindows))
+                flush();
+        }
+
+        void flush() {
+            if (tl_.empty())
+                return;
+            RealType out[BatchWindows];
+            score_(&tl_[0], tl_.size(), out);
+            for (unsigned k= 0; k< tl_.size(); ++k) 
+                s_.push_back(out[k], tl_[k]);
+            tl_.clear();
+        }
+
+    private:
+        const Score& score_;
+        LevelScores& s_;
+        std::vector<IndexType> tl_;
+};// }}}
+
+/**
+ * Scores the windows of one level with top-left corners on origin +
+ * k*stride, 0 <= k < extent, in s. With coarse > 1 every coarse'th lattice
+ * point is scored first, then the unscored lattice points within coarse-1
+ * of a coarse window scoring above refine, so with lazy blocks (see
+ * preparelevel) only the blocks of the coarse lattice and of the refined
+ * neighbourhoods are computed. Otherwise all windows are scored in the
+ * order of ImageSlider. If mask is given (x outer, over
+ * extent) only lattice points with a non-zero mask are scored, which
+ * requires coarse <= 1. Windows score.accept() rejects are not scored,
+ * the others are scored in batches (see BatchScan).
+ */
+template<class Score>
+static void scanlevel(
+        const IndexType origin, const IndexType extent, const IndexType stride,
+        const int coarse, const RealType refine,
+        const Score& score, LevelScores& s, const char* mask = NULL)
+{// {{{
+    s.clear();
+    BatchScan<Score> scan(score, s);
+    if (coarse <= 1) {
+        for (int i= 0; i< extent[0]; ++i)
+        for (int j= 0; j< extent[1]; ++j) {
+            if (mask && !mask[i*extent[1] + j])
+                continue;
+            scan(origin + IndexType(i,j)*stride);
+        }
+        scan.flush();
+        return;
+    }
+
+    s.done.assign(extent[0]*extent[1], 0);
+    for (int i= 0; i< extent[0]; i+= coarse)
+    for (int j= 0; j< extent[1]; j+= coarse) {
+        s.done[i*extent[1] + j] = 1;
+        scan(origin + IndexType(i,j)*stride);
+    }
+    scan.flush();
+
+    const int numcoarse = s.size(), r = coarse - 1;
+    for (int c= 0; c< numcoarse; ++c) {
+        if (!(s.score[c] > refine))
+            continue;
+        const int ci = (s.x[c] - origin[0])/stride[0];
+        const int cj = (s.y[c] - origin[1])/stride[1];
+        for (int i= std::max(ci-r,0); i<= std::min(ci+r,extent[0]-1); ++i)
+        for (int j= std::max(cj-r,0); j<= std::min(cj+r,extent[1]-1); ++j) {
+            char& done = s.done[i*extent[1] + j];
+            if (done)
+                continue;
+            done = 1;
+            scan(origin + IndexType(i,j)*stride);
+        }
+    }
+    scan.flush();
+}// }}}
+
+/**
+ * State of a WinDetectSession: the previous frame, its changed tiles and
+ * the window scores and blocks of each pyramid level.
+ */
+struct WinDetectSessionCache {// {{{
+    /// scores of the lattice of one level, x outer, see ImageSlider, and
+    /// the blocks computed for them (see WinDescriptor::swapblocks)
+    struct Level {
+        std::vector<float> score;
+        std::vector<char> valid;
+        WinDescType::BlockCont blocks;
+    };
+
+    WinDetectSessionCache() : 
+        width(0), height(0), channels(0), tilesize(1), tx(0), ty(0),
+        sincerefresh(0) 
+    {}
+
+    void invalidate() { level.clear(); }
+
+    /// scores of level l with extent lattice points
+    Level& get(const unsigned l, const IndexType extent) {
+        if (l >= level.size())
+            level.resize(l+1);
+        Level& v = level[l];
+        const unsigned n = extent[0]*extent[1];
+        if (v.score.size() != n) {
+            v.score.assign(n, 0);
+            v.valid.assign(n, 0);
+            v.blocks.clear();
+        }
+        return v;
+    }
+
+    /// forgets scores and blocks of level l, which is not scanned this frame
+    /// and so would miss its changes
+    void forget(const unsigned l, const IndexType extent) {
+        Level& v = get(l, extent);
+        std::fill(v.valid.begin(), v.valid.end(), 0);
+        v.blocks.clear();
+    }
+
+    /**
+     * Compares frame with the previous one and fills in the changed tiles.
+     * Returns false if the frames are not comparable.
+     */
+    bool compare(const unsigned char* imagedata, const int w, const int h,
+            const PixelFormat& format, const int difference, const int tile) 
+    {// {{{
+        const int ch = format.gray() ? 1 : 3;
+        const bool comparable = w == width && h == height && ch == channels 
+            && tile == tilesize;
+        width = w; height = h; channels = ch; tilesize = tile;
+        tx = (w + tile - 1)/tile; ty = (h + tile - 1)/tile;
+
+        std::vector<char> changed(tx*ty, 0);
+        frame.resize(w*h*ch);
+
+        const int pixelbytes = format.pixelbytes();
+        const int rowbytes = format.rowbytes(w);
+        const int planestep = format.planar() ? format.planestep : 1;
+        unsigned char* f = frame.empty() ? NULL : &frame[0];
+        for (int j= 0; j< h; ++j) {
+            const unsigned char* row = imagedata + j*rowbytes;
+            for (int i= 0; i< w; ++i) {
+                const unsigned char* pixel = row + i*pixelbytes;
+                bool diff = false;
+                for (int c= 0; c< ch; ++c, ++f) {
+                    const unsigned char v = pixel[format.index(c)*planestep];
+                    diff |= std::abs(int(v) - int(*f)) > difference;
+                    *f = v;
+                }
+                if (diff)
+                    changed[(i/tile)*ty + j/tile] = 1;
+            }
+        }
+
+        // summed area table, sat[(x+1)*(ty+1) + y+1] counts tiles < (x,y)
+        sat.assign((tx+1)*(ty+1), 0);
+        for (int x= 0; x< tx; ++x)
+        for (int y= 0; y< ty; ++y)
+            sat[(x+1)*(ty+1) + y+1] = changed[x*ty + y] 
+                + sat[x*(ty+1) + y+1] + sat[(x+1)*(ty+1) + y] - sat[x*(ty+1) + y];
+        return comparable;
+    }// }}}
+
+    /// true if a tile in [x0,x1]x[y0,y1] changed, tile coordinates
+    bool changed(const int x0, const int y0, const int x1, const int y1) const {
+        return sat[(x1+1)*(ty+1) + y1+1] - sat[x0*(ty+1) + y1+1] 
+            - sat[(x1+1)*(ty+1) + y0] + sat[x0*(ty+1) + y0] > 0;
+    }
+
+    /// tile range of image pixels [a,b], clamped to the frame as extendBorder
+    void tiles(const int d, int a, int b, int& t0, int& t1) const {
+        const int n = d ? height : width;
+        a = std::min(std::max(a, 0), n-1);
+        b = std::min(std::max(b, 0), n-1);
+        t0 = a/tilesize; t1 = b/tilesize;
+    }
+
+    std::vector<Level> level;
+    std::vector<unsigned char> frame;
+    int width, height, channels, tilesize;
+    std::vector<int> sat;
+    int tx, ty;
+    int sincerefresh;
+};// }}}
+
+/**
+ * Ranges [t0[k],t1[k]] of tiles of cache along axis d under the footprints
+ * of size level pixels at first + k*step, 0 <= k < count. A level pixel
+ * depends on frame pixels within one scale of it (bilinear rescale), and a
+ * footprint on level pixels one outside of it (gradients). scale and shift
+ * map the level to the frame as in bound().
+ */
+static void footprinttiles(const WinDetectSessionCache& cache, const int d,
+        const int first, const int step, const int count, const int size,
+        const RealType scale, const int shift, 
+        std::vector<int>& t0, std::vector<int>& t1)
+{// {{{
+    t0.resize(count); t1.resize(count);
+    for (int k= 0; k< count; ++k) {
+        const int lo = first + k*step;
+        const int a = static_cast<int>(std::floor((lo-3)*scale)) - 1 - shift;
+        const int b = static_cast<int>(std::ceil((lo+size+3)*scale)) + 1 - shift;
+        cache.tiles(d, a, b, t0[k], t1[k]);
+    }
+}// }}}
+
+/**
+ * Forgets what the changed tiles of cache touch in level v: the stored
+ * scores of the windows on lorigin + k*stride, 0 <= k < lextent, and the
+ * blocks of v.blocks, whatever part of the level is scanned this frame.
+ */
+static void forgetchanged(
+        const WinDetectSessionCache& cache, WinDetectSessionCache::Level& v,
+        const WinDescType& windesc, const IndexType lorigin, 
+        const IndexType lextent, const RealType scale, const IndexType winsize, 
+        const IndexType shift, const IndexType stride)
+{// {{{
+    std::vector<int> t[2][2];
+    for (int d= 0; d< 2; ++d) 
+        footprinttiles(cache, d, lorigin[d], stride[d], lextent[d], winsize[d],
+                scale, shift[d], t[d][0], t[d][1]);
+    for (int i= 0; i< lextent[0]; ++i)
+    for (int j= 0; j< lextent[1]; ++j) {
+        char& valid = v.valid[i*lextent[1] + j];
+        if (valid && cache.changed(t[0][0][i], t[1][0][j], t[0][1][i], t[1][1][j]))
+            valid = 0;
+    }
+
+    WinDescType::DescCont::const_iterator d = windesc.descriptors().begin();
+    for (WinDescType::BlockCont::iterator b = v.blocks.begin(); 
+            b != v.blocks.end(); ++b, ++d) 
+    {
+        if (b->empty())
+            continue;
+        const IndexType extent (b->extent()), size ((*d)->extent());
+        for (int a= 0; a< 2; ++a) 
+            footprinttiles(cache, a, b->origin()[a], b->stride()[a], extent[a],
+                    size[a], scale, shift[a], t[a][0], t[a][1]);
+        for (int i= 0; i< extent[0]; ++i)
+        for (int j= 0; j< extent[1]; ++j)
+            if (cache.changed(t[0][0][i], t[1][0][j], t[0][1][i], t[1][1][j]))
+                b->drop(IndexType(i,j));
+    }
+}// }}}
+
+/**
+ * Marks in mask (x outer, over the new extent) the windows on origin +
+ * k*stride, 0 <= k < extent, whose score is not stored in v, lorigin and
+ * lextent being the lattice of the level. origin and extent are reduced to
+ * the bounding box of the marked windows. Returns false if none is marked.
+ */
+static bool stalemask(const WinDetectSessionCache::Level& v,
+        const IndexType lorigin, const IndexType lextent, const IndexType stride,
+        IndexType& origin, IndexType& extent, std::vector<char>& mask)
+{// {{{
+    const IndexType first ((origin - lorigin)/stride);
+    IndexType blo (extent), bhi (-1);
+    std::vector<char> need(extent[0]*extent[1], 0);
+    for (int i= 0; i< extent[0]; ++i)
+    for (int j= 0; j< extent[1]; ++j) {
+        if (v.valid[(first[0]+i)*lextent[1] + first[1]+j])
+            continue;
+        need[i*extent[1] + j] = 1;
+        blo = blitz::min(blo, IndexType(i,j));
+        bhi = blitz::max(bhi, IndexType(i,j));
+    }
+    if (bhi[0] < 0)
+        return false;
+
+    const IndexType oldextent (extent);
+    origin += blo*stride;
+    extent = bhi - blo + 1;
+    mask.resize(extent[0]*extent[1]);
+    for (int i= 0; i< extent[0]; ++i)
+    for (int j= 0; j< extent[1]; ++j)
+        mask[i*extent[1] + j] = need[(blo[0]+i)*oldextent[1] + blo[1]+j];
+    return true;
+}// }}}
+
+/**
+ * Splits the windows marked in mask (x outer, over extent) into groups at
+ * least about reach lattice points apart, so that the band of each group
+ * (see levelband) is preprocessed on its own rather than the bounding box
+ * of all. group is set to the group of each marked window, from 0, and to
+ * -1 elsewhere. Returns the number of groups.
+ */
+static int splitmask(const IndexType extent, const std::vector<char>& mask,
+        const IndexType reach, std::vector<int>& group)
+{// {{{
+    // marked windows grown by half the reach along each axis, the
+    // connected parts of the grown mask are the groups
+    const int n = extent[0]*extent[1];
+    const IndexType r ((reach + 1)/2);
+    std::vector<char> rows(n, 0), grown(n, 0);
+    std::vector<int> count;
+    for (int i= 0; i< extent[0]; ++i) {
+        count.assign(extent[1]+1, 0);
+        for (int j= 0; j< extent[1]; ++j) 
+            count[j+1] = count[j] + (mask[i*extent[1] + j] != 0);
+        for (int j= 0; j< extent[1]; ++j) 
+            rows[i*extent[1] + j] = count[std::min(j+r[1]+1, extent[1])] 
+                > count[std::max(j-r[1], 0)];
+    }
+    for (int j= 0; j< extent[1]; ++j) {
+        count.assign(extent[0]+1, 0);
+        for (int i= 0; i< extent[0]; ++i) 
+            count[i+1] = count[i] + rows[i*extent[1] + j];
+        for (int i= 0; i< extent[0]; ++i) 
+            grown[i*extent[1] + j] = count[std::min(i+r[0]+1, extent[0])] 
+                > count[std::max(i-r[0], 0)];
+    }
+
+    std::vector<int> label(n, -1), stack;
+    int groups = 0;
+    for (int k= 0; k< n; ++k) {
+        if (!grown[k] || label[k] >= 0)
+            continue;
+        label[k] = groups;
+        stack.push_back(k);
+        while (!stack.empty()) {
+            const int c = stack.back(), i = c/extent[1], j = c%extent[1];
+            stack.pop_back();
+            const int next[4][2] = {{i-1,j}, {i+1,j}, {i,j-1}, {i,j+1}};
+            for (int m= 0; m< 4; ++m) {
+                const int a = next[m][0], b = next[m][1];
+                if (a < 0 || a >= extent[0] || b < 0 || b >= extent[1])
+                    continue;
+                const int l = a*extent[1] + b;
+                if (!grown[l] || label[l] >= 0)
+                    continue;
+                label[l] = groups;
+                stack.push_back(l);
+            }
+        }
+        ++groups;
+    }
+
+    group.resize(n);
+    for (int k= 0; k< n; ++k) 
+        group[k] = mask[k] ? label[k] : -1;
+    return groups;
+}// }}}
+
+/// Non-maximum suppression selected by o.nonmaxmethod, for windows on winstride
+static ProcessResult* newnonmax(const WinDetectClassify& o, const IndexType winstride) 
+{// {{{
+    typedef blitz::TinyVector<RealType,2>                SigmaType;
+    SigmaType score2prob(o.score2prob_a, o.score2prob_b);
+
+    typedef blitz::TinyVector<RealType,3>                NonmaxType;
+    NonmaxType nonmaxSigma(o.nonmaxsigma_x,o.nonmaxsigma_y, o.nonmaxsigma_scale); 
+
+    IndexType size(o.size_x, o.size_y);
+
+    switch (o.nonmaxmethod) {
+        case WinDetectClassify::ScaleSpace:
+            return new SS_ProcessResult(size, o.lightthreshold, o.threshold, 
+                    score2prob, nonmaxSigma, o.softmax, winstride);
+        case WinDetectClassify::Greedy:
+            return new Greedy_ProcessResult(o.lightthreshold, o.threshold, 
+                    o.nonmaxoverlap);
+        case WinDetectClassify::MeanShift:
+        default:
+            return new MS_ProcessResult(size, o.lightthreshold, o.threshold, 
+                    score2prob, nonmaxSigma, o.softmax);
+    }
+}// }}}
+
+void WinDetectClassify::init(const DetectorBundle& bundle) 
+{
+    bundle.fill(*this);
+    WinDetect::init(bundle);
+    initclassifier();
+}
+
+void WinDetectClassify::addposes(LinearClassify& classifier) const
+{// {{{
+    // variants are derived from the model alone, not from other variants
+    const LinearClassify model (classifier);
+    for (int k= -posesteps; k<= posesteps; ++k) 
+    for (int m= 0; m<= static_cast<int>(posemirror); ++m) {
+        if (k == 0 && m == 0)
+            continue;
+        if (k && poseangle == 0)
+            continue;
+        classifier.addvariant(posevariant(model, m, k*poseangle));
+    }
+    if (verbose > 1)
+        std::cout << "Pose variants " << classifier.variants() << std::endl; 
+}// }}}
+
 void WinDetectClassify::initclassifier() 
 { // {{{ 
     using namespace lear;
@@ -751,17 +1774,7 @@ void WinDetectClassify::initclassifier()
             "Init is supposed to be called only once. This is a repeat initialization.");
     }
 
-    typedef blitz::TinyVector<RealType,2>                SigmaType;
-    SigmaType score2prob(score2prob_a, score2prob_b);
-
-    typedef blitz::TinyVector<RealType,3>                NonmaxType;
-    NonmaxType nonmaxSigma(nonmaxsigma_x,nonmaxsigma_y, nonmaxsigma_scale); 
-
-    IndexType size(size_x, size_y);
-
-    MS_ProcessResult* holder = new MS_ProcessResult(
-            size, lightthreshold, threshold, 
-            score2prob, nonmaxSigma, softmax);
+    ProcessResult* holder = newnonmax(*this, IndexType(winstride_x, winstride_y));
 
     if (verbose > 1)
         std::cout << "Processor " << holder->toString() << std::endl; 
@@ -770,47 +1783,161 @@ void WinDetectClassify::initclassifier()
     classifierholder.initialized = true;
 }//}}}
 
-void WinDetectClassify::test(
-    const LinearClassify& classifier,
-    std::list<DetectedRegion>& detections,
-    const unsigned char* imagedata, int width, int height, int step 
-    ) const
-{//{{{
-    if (!descholder.initialized) {
-        throw Exception("WinDetectClassify::test", 
-            "Init is supposed to be called before we can use test");
+/**
+ * WinDetectSession part of detectimage for level levelindex of extent
+ * levelextent: scores the windows of the band origin + k*stride, 0 <= k <
+ * extent, that have no stored score or are touched by a change, and stores
+ * them in session. The windows to score are split into groups far enough
+ * apart (see splitmask), and only the band of each group is rescaled and
+ * preprocessed. Blocks are kept in session between frames, so only those
+ * the windows to score use and a change touched are computed again.
+ * stored is set to the scores of the whole band. Returns the number of
+ * windows scored.
+ */
+template<class ImageType, class SliderType>
+static int sessionlevel(
+        const WinDetectClassify& o, WinDetectSessionCache& session,
+        const unsigned levelindex, const ImageType& image, 
+        const IndexType levelextent, const RealType scale, 
+        const SliderType& slider, const IndexType toadd,
+        const IndexType borigin, const IndexType bextent,
+        ScoreWindow& score, LevelScores& levelscores, LevelScores& stored, 
+        std::vector<char>& mask)
+{// {{{
+    WinDescType* windesc = descholder.windesc;
+    const IndexType winsize(o.size_x, o.size_y);
+    const IndexType winstride(o.winstride_x, o.winstride_y);
+
+    const IndexType lorigin (slider.lbound()), lextent (slider.elem_extent());
+    WinDetectSessionCache::Level& v = session.get(levelindex, lextent);
+    forgetchanged(session, v, *windesc, lorigin, lextent, scale, winsize, 
+            toadd, winstride);
+
+    IndexType origin (borigin), extent (bextent);
+    int scored = 0;
+    if (stalemask(v, lorigin, lextent, winstride, origin, extent, mask)) {
+        // groups whose bands do not overlap
+        const IndexType reach ((winsize + 2*BandMargin)/winstride + 1);
+        std::vector<int> group;
+        const int groups = splitmask(extent, mask, reach, group);
+        std::vector<char> groupmask;
+        score.offset = 0;
+        score.lazy = true;
+        for (int g= 0; g< groups; ++g) {
+            IndexType glo (extent), ghi (-1);
+            for (int i= 0; i< extent[0]; ++i)
+            for (int j= 0; j< extent[1]; ++j) 
+                if (group[i*extent[1] + j] == g) {
+                    glo = blitz::min(glo, IndexType(i,j));
+                    ghi = blitz::max(ghi, IndexType(i,j));
+                }
+            const IndexType gorigin (origin + glo*winstride), 
+                  gextent (ghi - glo + 1);
+            groupmask.resize(gextent[0]*gextent[1]);
+            for (int i= 0; i< gextent[0]; ++i)
+            for (int j= 0; j< gextent[1]; ++j) 
+                groupmask[i*gextent[1] + j] = 
+                    group[(glo[0]+i)*extent[1] + glo[1]+j] == g;
+
+            IndexType lo, hi;
+            levelband(gorigin, gextent, winstride, winsize, levelextent, lo, hi);
+            windesc->preprocess(lear::rescalepart(image, levelextent, lo, hi));
+            // window positions are level positions, blocks of the level
+            // computed for other groups and earlier frames are reused
+            windesc->swapblocks(v.blocks);
+            windesc->prepare(lorigin, winstride, levelextent, lo);
+            scanlevel(gorigin, gextent, winstride, 1, 0, score, levelscores, 
+                    &groupmask[0]);
+            windesc->swapblocks(v.blocks);
+
+            for (int k= 0; k< levelscores.size(); ++k) {
+                const int l = (levelscores.x[k] - lorigin[0])/winstride[0]*lextent[1] 
+                    + (levelscores.y[k] - lorigin[1])/winstride[1];
+                v.score[l] = levelscores.score[k];
+                v.valid[l] = 1;
+            }
+            scored += levelscores.size();
+        }
     }
-    if (!classifierholder.initialized) {
-        throw Exception("WinDetectClassify::test", 
-            "Init is supposed to be called before we can use test");
+
+    // whole band, in the order of a dense scan
+    const IndexType first ((borigin - lorigin)/winstride);
+    stored.clear();
+    for (int i= 0; i< bextent[0]; ++i)
+    for (int j= 0; j< bextent[1]; ++j) {
+        const IndexType tl (borigin + IndexType(i,j)*winstride);
+        stored.push_back(v.score[(first[0]+i)*lextent[1] + first[1]+j], tl);
     }
+    return scored;
+}// }}}
 
-    WinDescType* windesc = descholder.windesc;
-    MS_ProcessResult& holder = *(classifierholder.holder);
-    if (verbose > 1) 
-    { std::cout << *this << std::endl; }
+typedef boost::posix_time::ptime            TimeType;
 
-    // create classifier
-    if (classifier.length() != windesc->length()) {
-        std::cerr << "Classifier length " << 
-                    classifier.length() << std::endl;
-        throw Exception("WinDetectClassify::test()", 
-            "Dimension mismatch between window feature vector "
-            "and SVM learned feature vectors");
-    }
+static inline TimeType now() {
+    return boost::posix_time::microsec_clock::universal_time();
+}
+/// milliseconds since start
+static inline RealType elapsed(const TimeType start) {
+    return (now() - start).total_microseconds()/1000.0;
+}
 
+/**
+ * Coarse stride for a level of pixels pixels and windows lattice points,
+ * given remaining ms in all and share ms for this level. Uses the
+ * smallest stride from mincoarse to maxcoarse whose estimated time fits
+ * share, or else maxcoarse if that fits remaining. Returns 0 if the level
+ * does not fit.
+ */
+static int budgetcoarse(const LevelCost& cost, 
+        const int pixels, const int windows, const int mincoarse,
+        const int maxcoarse, const RealType share, const RealType remaining)
+{// {{{
+    if (!(remaining > 0))
+        return 0;
+    // no estimate before the first level was measured
+    if (!cost.calibrated())
+        return mincoarse;
+    for (int c= mincoarse; c<= maxcoarse; ++c)
+        if (cost.level(pixels, windows, c) <= share)
+            return c;
+    const int c = std::max(mincoarse, maxcoarse);
+    return cost.level(pixels, windows, c) <= remaining ? c : 0;
+}// }}}
 
-    IndexType winsize(size_x, size_y);
-    IndexType winstride(winstride_x, winstride_y);
+/// A pyramid level, index is its position in the pyramid
+struct PyramidLevel {
+    unsigned index;
+    IndexType extent;
+    RealType scale;
+    RealType priority;
 
-    IndexType tmargin(margin_x, margin_y);
-    IndexType tavsize(avsize_x, avsize_y);
+    bool operator<(const PyramidLevel& o) const { return priority < o.priority; }
+};
+
+/// Window scores of a pyramid level, passed to non-maximum suppression
+struct LevelResult {
+    LevelResult() : done(false), scale(0) {}
+
+    bool done;
+    IndexType origin, extent;
+    RealType scale;
+    LevelScores scores;
+};
+
+/**
+ * Sets image to origimage with the border margin of o (margin_x/y pixels
+ * per avsize_x/y pixels of image size) added around it, or to origimage
+ * itself if there is none. Returns the margin added on each side.
+ */
+template<class ImageType>
+static IndexType extendmargin(const WinDetectClassify& o, 
+        const ImageType& origimage, ImageType& image)
+{// {{{
+    IndexType tmargin(o.margin_x, o.margin_y);
+    IndexType tavsize(o.avsize_x, o.avsize_y);
     bool addmargin ( blitz::sum((tmargin*tavsize) > 0));
 
-    WinDescType::ImageType image;
     IndexType toadd = 0;
-
-    WinDescType::ImageType origimage = getImage(imagedata,width,height, step);
     if (addmargin) {
         IndexType newext = origimage.extent();
         IndexType toaddX = 0, toaddY = 0;
@@ -827,6 +1954,49 @@ void WinDetectClassify::test(
     } else {
         image.reference(origimage);
     }
+    return toadd;
+}// }}}
+
+/// Runs non-maximum suppression of holder and copies the result to detections
+static void suppress(ProcessResult& holder, std::list<DetectedRegion>& detections)
+{// {{{
+    detections.clear();
+    holder.doit();
+
+    ProcessResult::const_iterator s = holder.begin();
+    ProcessResult::const_iterator e = holder.end();
+    for (; s!= e; ++s) {
+        detections.push_back(DetectedRegion( s->score, s->scale, 
+            s->lbound[0], s->lbound[1], s->extent[0], s->extent[1]));
+    }
+}// }}}
+
+/**
+ * Runs the classifier over the scale space of one image and fills in
+ * detections. PixelType is RGBType or GrayType. If regions is given only
+ * windows in one of them are scored. If session is given stored scores of
+ * windows not touched by a change are used, and new scores are stored.
+ */
+template<class PixelType>
+static void detectimage(
+    const WinDetectClassify& o,
+    const WindowClassifier& classifier,
+    std::list<DetectedRegion>& detections,
+    const blitz::Array<PixelType,2>& origimage,
+    const std::vector<SearchRegion>* regions,
+    WinDetectSessionCache* session,
+    DetectStats* stats)
+{//{{{
+    typedef blitz::Array<PixelType,2>           ImageType;
+
+    WinDescType* windesc = descholder.windesc;
+    ProcessResult& holder = *(classifierholder.holder);
+
+    IndexType winsize(o.size_x, o.size_y);
+    IndexType winstride(o.winstride_x, o.winstride_y);
+
+    ImageType image;
+    const IndexType toadd = extendmargin(o, origimage, image);
 
     int imagewindows = 0; 
     holder.clear();
@@ -835,9 +2005,9 @@ void WinDetectClassify::test(
     typedef lear::ScalePyramid<2>               PyramidType;
 
     const PyramidType pyramid(image.extent(),winsize,
-            scaleratio, endscale, startscale);
+            o.scaleratio, o.endscale, o.startscale);
 
-    if (verbose > 6) {// {{{
+    if (o.verbose > 6) {// {{{
         cout << "Scale levels" << setw(2) << pyramid.size() <<
             ", Start scale = " << 
             setw(6) << setprecision(2) << pyramid.startScale() <<
@@ -846,46 +2016,434 @@ void WinDetectClassify::test(
             endl;
     }// }}}
 
+    Array1DType desc(windesc->length());
+    ScoreWindow score(windesc, classifier, desc.data());
+    LevelScores levelscores;
+    std::vector<char> mask;
+    DetectStats imagestats;
+    // a session stores the score of every window, nothing is rejected
+    EnergyFilter filter(o.energythreshold, winsize);
+    if (o.energythreshold > 0 && !session)
+        score.filter = &filter;
+    QuantizedClassify quantized;
+    std::vector<unsigned char> qdesc;
+    setquantized(o, windesc, classifier, score, quantized, qdesc);
+    windesc->fixedpoint(o.fixedpoint);
+    windesc->halfprecision(o.halfprecision);
+
+    // levels in the order they are processed
+    std::vector<PyramidLevel> levels;
     for (PyramidType::iterator piter = pyramid.begin(); 
             piter != pyramid.end(); ++piter) 
+    {
+        PyramidLevel l;
+        l.index = levels.size();
+        l.extent = *piter;
+        l.scale = piter.scale();
+        l.priority = o.priorityscale > 0 ? 
+            std::abs(std::log(l.scale/o.priorityscale)) : l.index;
+        levels.push_back(l);
+    }
+    std::stable_sort(levels.begin(), levels.end());
+
+    // lattice points of the levels after the n'th, shares the time budget
+    std::vector<int> after(levels.size()+1, 0);
+    for (int n= levels.size()-1; n>= 0; --n)
+        after[n] = after[n+1] 
+            + SliderType(levels[n].extent,winsize,winstride).size();
+
+    LevelCost& cost = o.levelcost();
+    const TimeType start = now();
+    // non-maximum suppression has to fit in the budget too
+    const RealType budget = o.timebudget - cost.nonmaxms;
+    const int mincoarse = std::max(1, o.coarsestride);
+
+    std::vector<LevelResult> results(levels.size());
+    for (unsigned n= 0; n< levels.size(); ++n) 
     {// {{{
-        WinDescType::ImageType pyimg (lear::rescale(image, *piter));
-        SliderType slider(pyimg.extent(),winsize,winstride);
+        const PyramidLevel& level = levels[n];
+        const SliderType slider(level.extent,winsize,winstride);
+        imagestats.lattice += slider.size();
+
+        IndexType origin (slider.lbound()), extent (slider.elem_extent());
+        int first, last;
+        if (!groundband(o, level.scale, origin[1], winstride[1], extent[1],
+                    toadd[1], first, last)) 
+        {
+            if (session)
+                session->forget(level.index, slider.elem_extent());
+            continue;
+        }
+        origin[1] += first*winstride[1];
+        extent[1] = last - first + 1;
 
-        windesc->preprocess(pyimg);
+        if (regions && !regionmask(*regions, level.scale, winsize, toadd, 
+                    winstride, origin, extent, mask))
+            continue;
 
-        for (SliderType::iterator siter = slider.begin(); 
-                siter != slider.end(); ++siter) 
-        {
-            IndexType tl=*siter;
+        // regions are small, a coarse lattice could miss them entirely, and
+        // a session stores the score of every window: over budget such a
+        // level is skipped, not coarsened
+        const bool fine = regions || session;
+        int coarse = fine ? 1 : mincoarse;
+        const int pixels = level.extent[0]*level.extent[1];
+        const int windows = extent[0]*extent[1];
+        if (o.timebudget > 0) {
+            const RealType remaining = budget - elapsed(start);
+            const RealType share = remaining*windows/(windows + after[n+1]);
+            coarse = budgetcoarse(cost, pixels, windows, coarse, 
+                    fine ? 1 : LevelCost::MaxCoarse, share, remaining);
+            if (!coarse) {
+                imagestats.skipped.push_back(level.scale);
+                // changes of this frame are not seen by the next compare,
+                // so stored scores of the level cannot be trusted anymore
+                if (session)
+                    session->forget(level.index, slider.elem_extent());
+                continue;
+            }
+            if (coarse > mincoarse)
+                ++imagestats.coarsened;
+        }
 
-            Array1DType desc = windesc->compute(tl); 
+        LevelResult& r = results[level.index];
+        r.done = true;
+        r.origin = origin; r.extent = extent; r.scale = level.scale;
+
+        const TimeType levelstart = now();
+        RealType prepms = 0;
+        int scored;
+        if (session) {
+            scored = sessionlevel(o, *session, level.index, image, 
+                    level.extent, level.scale, slider, toadd, origin, extent, 
+                    score, levelscores, r.scores, mask);
+        } else {
+            // blocks of windows the energy filter rejects, or a coarse scan
+            // does not reach, are not computed. Under a time budget the
+            // block cost is always counted per window, so the coarse
+            // stride the budget picks decides how many blocks are computed
+            score.lazy = score.filter != NULL || coarse > 1 || o.timebudget > 0;
+            ImageType pyimg (lear::rescale(image, level.extent));
+            score.offset = preparelevel(windesc, pyimg, origin, extent, 
+                    winstride, winsize, o.groundtolerance > 0 || regions,
+                    score.lazy);
+            if (score.filter)
+                filter.build(windesc->preprocessed());
+            prepms = elapsed(levelstart);
+
+            scanlevel(origin, extent, winstride, coarse, o.refinethreshold, 
+                    score, r.scores, regions ? &mask[0] : NULL);
+            scored = r.scores.size();
+        }
+        imagewindows += scored;
+        ++imagestats.levels;
+
+        // session levels mix stored and new scores, not a level estimate
+        if (!session && scored) {
+            LevelCost::update(cost.pixelms, prepms/pixels);
+            LevelCost::update(cost.windowms[coarse], 
+                    (elapsed(levelstart) - prepms)/scored);
+            if (coarse > 1)
+                LevelCost::update(cost.refine, 
+                        scored*RealType(coarse*coarse)/windows);
+        }
+    }// }}}
 
-            DetectInfo r = bound(
-                    classifier(desc.data()),piter.scale(),
-                    tl, windesc->extent());
-            r.lbound -=toadd;
+    // pyramid order, ScaleSpace smooths over neighbouring levels
+    for (unsigned l= 0; l< results.size(); ++l) {
+        const LevelResult& r = results[l];
+        if (!r.done)
+            continue;
+        holder.newpyramid(r.origin, r.extent, r.scale, toadd);
+        if (r.scores.size())
+            holder(r.scores.batch(r.scale, windesc->extent(), toadd));
+    }
 
-            holder(r);
-            ++imagewindows;
+    imagestats.windows = imagewindows;
+    imagestats.rejected = filter.rejected;
+    if (stats)
+        *stats = imagestats;
+
+    if (o.verbose > 3) {// {{{
+        cout << "Processed " << setw(5) << imagewindows << " of " 
+             << imagestats.lattice << " windows" <<  endl;
+        if (score.filter)
+            cout << "Energy filter rejected " << imagestats.rejected 
+                << " windows" << endl;
+        if (!imagestats.skipped.empty()) {
+            cout << "Time budget skipped " << imagestats.skipped.size() 
+                << " scales:";
+            for (unsigned k= 0; k< imagestats.skipped.size(); ++k)
+                cout << " " << setprecision(3) << imagestats.skipped[k];
+            cout << endl;
         }
     }// }}}
+    const TimeType nonmaxstart = now();
+    suppress(holder, detections);
+    cost.nonmaxms = elapsed(nonmaxstart);
+}
+// }}}
+
+bool WinDetectClassify::fitGroundPlane(const std::list<DetectedRegion>& detections)
+{// {{{
+    double n = 0, sr = 0, sh = 0, srr = 0, srh = 0;
+    for (std::list<DetectedRegion>::const_iterator i = detections.begin();
+            i != detections.end(); ++i) 
+    {
+        const double r = i->y + i->height, h = i->height;
+        n += 1; sr += r; sh += h; srr += r*r; srh += r*h;
+    }
+    const double det = n*srr - sr*sr;
+    if (n < 2 || det <= 1e-9*n*srr)
+        return false;
+    groundplane_a = (n*srh - sr*sh)/det;
+    groundplane_b = (sh - groundplane_a*sr)/n;
+    return true;
+}// }}}
+
+void WinDetectClassify::test(
+    const WindowClassifier& classifier,
+    std::list<DetectedRegion>& detections,
+    const unsigned char* imagedata, int width, int height, int step 
+    ) const
+{
+    test(classifier, detections, imagedata, width, height, 
+            PixelFormat(PixelFormat::RGB, step));
+}
+
+/// Checks initialization of o and runs detectimage on a PixelFormat buffer
+static void detectframe(
+    const WinDetectClassify& o,
+    const WindowClassifier& classifier,
+    std::list<DetectedRegion>& detections,
+    const unsigned char* imagedata, int width, int height, 
+    const PixelFormat& format, const std::vector<SearchRegion>* regions,
+    WinDetectSessionCache* session, DetectStats* stats)
+{//{{{
+    if (!descholder.initialized) {
+        throw Exception("WinDetectClassify::test", 
+            "Init is supposed to be called before we can use test");
+    }
+    if (!classifierholder.initialized) {
+        throw Exception("WinDetectClassify::test", 
+            "Init is supposed to be called before we can use test");
+    }
+
+    const WinDescType* windesc = descholder.windesc;
+    if (o.verbose > 1) 
+    { std::cout << o << std::endl; }
+
+    // create classifier
+    if (classifier.length() != windesc->length()) {
+        std::cerr << "Classifier length " << 
+                    classifier.length() << std::endl;
+        throw Exception("WinDetectClassify::test()", 
+            "Dimension mismatch between window feature vector "
+            "and SVM learned feature vectors");
+    }
+
+    // pyramid levels are rescaled in float, so the frame is copied and
+    // converted whatever its layout
+    if (format.gray())
+        detectimage(o, classifier, detections, 
+            readframe<IProcessor::GrayType>(imagedata, width, height, format),
+            regions, session, stats);
+    else
+        detectimage(o, classifier, detections, 
+            readframe<IProcessor::RGBType>(imagedata, width, height, format),
+            regions, session, stats);
+}// }}}
 
-    if (verbose > 3) {// {{{
-        cout << "Processed " << setw(5) << imagewindows << " windows" <<  endl;
+void WinDetectClassify::test(
+    const WindowClassifier& classifier,
+    std::list<DetectedRegion>& detections,
+    const unsigned char* imagedata, int width, int height, 
+    const PixelFormat& format, DetectStats* stats) const
+{
+    detectframe(*this, classifier, detections, imagedata, width, height,
+            format, NULL, NULL, stats);
+}
+
+void WinDetectClassify::test(
+    const WindowClassifier& classifier,
+    std::list<DetectedRegion>& detections,
+    const unsigned char* imagedata, int width, int height, 
+    const PixelFormat& format, const std::vector<SearchRegion>& regions,
+    DetectStats* stats) const
+{
+    detectframe(*this, classifier, detections, imagedata, width, height,
+            format, &regions, NULL, stats);
+}
+
+/**
+ * Scores windows of the current level of features with a StumpCascade.
+ * accept() runs the cascade and keeps the score of accepted windows, which
+ * the batch operator() then hands out in the same order.
+ */
+struct ScoreCascade {// {{{
+    ScoreCascade(const StumpCascade& cascade, const ChannelFeatures& features) :
+        cascade(cascade), features(features), rejected(0) {}
+
+    bool accept(const IndexType tl) const {
+        RealType s;
+        if (cascade(features, tl, s)) {
+            pending.push_back(s);
+            return true;
+        }
+        ++rejected;
+        return false;
+    }
+    void operator()(const IndexType* , const int count, RealType* score) const {
+        std::copy(pending.begin(), pending.begin() + count, score);
+        pending.erase(pending.begin(), pending.begin() + count);
+    }
+    const StumpCascade& cascade;
+    const ChannelFeatures& features;
+    /// scores of the windows accepted and not handed out yet
+    mutable std::vector<RealType> pending;
+    mutable int rejected;
+};// }}}
+
+/**
+ * Detects objects in origimage with cascade over channel features, with
+ * the pyramid, lattice, ground plane prior and non-maximum suppression of
+ * detectimage.
+ */
+template<class PixelType>
+static void channeldetectimage(
+    const WinDetectClassify& o,
+    const StumpCascade& cascade,
+    std::list<DetectedRegion>& detections,
+    const blitz::Array<PixelType,2>& origimage,
+    DetectStats* stats)
+{//{{{
+    typedef blitz::Array<PixelType,2>           ImageType;
+    typedef lear::ImageSlider<2>                SliderType;
+    typedef lear::ScalePyramid<2>               PyramidType;
+
+    ProcessResult& holder = *(classifierholder.holder);
+
+    const IndexType winsize(o.size_x, o.size_y);
+    const IndexType winstride(o.winstride_x, o.winstride_y);
+
+    ImageType image;
+    const IndexType toadd = extendmargin(o, origimage, image);
+    holder.clear();
+
+    ChannelFeatures features(cascade.orientbin(), cascade.luv(), 
+            cascade.gscale());
+    ScoreCascade score(cascade, features);
+    LevelScores levelscores;
+    DetectStats imagestats;
+
+    const PyramidType pyramid(image.extent(),winsize,
+            o.scaleratio, o.endscale, o.startscale);
+    for (PyramidType::iterator piter = pyramid.begin(); 
+            piter != pyramid.end(); ++piter) 
+    {// {{{
+        const SliderType slider(*piter,winsize,winstride);
+        imagestats.lattice += slider.size();
+
+        IndexType origin (slider.lbound()), extent (slider.elem_extent());
+        int first, last;
+        if (!groundband(o, piter.scale(), origin[1], winstride[1], extent[1],
+                    toadd[1], first, last))
+            continue;
+        origin[1] += first*winstride[1];
+        extent[1] = last - first + 1;
+
+        ImageType pyimg (lear::rescale(image, *piter));
+        features.compute(pyimg);
+        holder.newpyramid(origin, extent, piter.scale(), toadd);
+
+        scanlevel(origin, extent, winstride, o.coarsestride, 
+                o.refinethreshold, score, levelscores);
+        if (levelscores.size())
+            holder(levelscores.batch(piter.scale(), winsize, toadd));
+        imagestats.windows += levelscores.size();
+        ++imagestats.levels;
     }// }}}
-    detections.clear();
-    holder.doit();
 
-    MS_ProcessResult::const_iterator s = holder.begin();
-    MS_ProcessResult::const_iterator e = holder.end();
-    for (; s!= e; ++s) {
-        detections.push_back(DetectedRegion( s->score, s->scale, 
-            s->lbound[0], s->lbound[1], s->extent[0], s->extent[1]));
+    imagestats.rejected = score.rejected;
+    if (stats)
+        *stats = imagestats;
+    if (o.verbose > 3)
+        cout << "Cascade accepted " << setw(5) << imagestats.windows 
+             << ", rejected " << imagestats.rejected << " of " 
+             << imagestats.lattice << " windows" <<  endl;
+
+    suppress(holder, detections);
+}// }}}
+
+void WinDetectClassify::init(const StumpCascade& cascade) 
+{
+    size_x = cascade.window()[0];
+    size_y = cascade.window()[1];
+    initclassifier();
+}
+
+void WinDetectClassify::test(
+    const StumpCascade& cascade,
+    std::list<DetectedRegion>& detections,
+    const unsigned char* imagedata, int width, int height, 
+    const PixelFormat& format, DetectStats* stats) const
+{//{{{
+    if (!classifierholder.initialized) {
+        throw Exception("WinDetectClassify::test", 
+            "Init is supposed to be called before we can use test");
     }
+    if (cascade.window()[0] != size_x || cascade.window()[1] != size_y)
+        throw Exception("WinDetectClassify::test()", 
+            "Cascade window differs from the detection window");
+    if (verbose > 1) 
+    { std::cout << *this << cascade << std::endl; }
+
+    if (format.gray())
+        channeldetectimage(*this, cascade, detections, 
+            readframe<IProcessor::GrayType>(imagedata, width, height, format),
+            stats);
+    else
+        channeldetectimage(*this, cascade, detections, 
+            readframe<IProcessor::RGBType>(imagedata, width, height, format),
+            stats);
+}// }}}
+
+WinDetectSession::WinDetectSession(const WinDetectClassify& detector,
+        const WindowClassifier& classifier)
+        :
+    refresh(30), difference(8), tilesize(16),
+    detector_(detector), classifier_(classifier),
+    cache_(new WinDetectSessionCache)
+{}
+
+WinDetectSession::~WinDetectSession()
+{
+    delete cache_;
 }
-// }}}
 
+void WinDetectSession::reset()
+{
+    delete cache_;
+    cache_ = new WinDetectSessionCache;
+}
+
+void WinDetectSession::test(
+    std::list<DetectedRegion>& detections,
+    const unsigned char* imagedata, int width, int height, 
+    const PixelFormat& format, DetectStats* stats)
+{//{{{
+    if (tilesize < 1)
+        throw Exception("WinDetectSession::test", "Tile size must be positive");
+
+    const bool comparable = cache_->compare(imagedata, width, height, format,
+            difference, tilesize);
+    // drift guard
+    if (!comparable || (refresh > 0 && ++cache_->sincerefresh >= refresh)) {
+        cache_->invalidate();
+        cache_->sincerefresh = 0;
+    }
+    detectframe(detector_, classifier_, detections, imagedata, width, height,
+            format, NULL, cache_, stats);
+}// }}}
 
 #ifdef BUILD_APP
 #include <lear/classifier/hist_processresult.h>
@@ -895,7 +2453,7 @@ void WinDetectClassify::test(
 #include <lear/classifier/aligninimage.h>
 
 void WinDetectClassify::runImageSlider(
-        const LinearClassify& classifier, const PathVector& inlist, 
+        const WindowClassifier& classifier, const PathVector& inlist, 
         const std::string& outfile, const std::string& outimage, 
         const std::string& outhist, const std::string& falsetxt,
         const std::string& testlocs
@@ -970,6 +2528,8 @@ void WinDetectClassify::runImageSlider(
 
     
     ResultHolder holder;
+    // scores of one pyramid level, reused across levels and images
+    LevelScores levelscores;
 
     if (outhist.empty() || (doImageOut && aligninimage)) {
         holder.push_back( new Th_ProcessResult(lightthreshold, label!='P'));
@@ -990,18 +2550,10 @@ void WinDetectClassify::runImageSlider(
                 " for writing false +/-. Disabling false out." << endl;
         }
     }
-    typedef blitz::TinyVector<RealType,2>                SigmaType;
-    SigmaType score2prob(score2prob_a, score2prob_b);
-
-    typedef blitz::TinyVector<RealType,3>                NonmaxType;
-    NonmaxType nonmaxSigma(nonmaxsigma_x,nonmaxsigma_y, nonmaxsigma_scale); 
-
     int list_marker=1;
     if (!no_nonmax) {
         list_marker=2;
-        holder.push_back(
-            new MS_ProcessResult(size, lightthreshold, threshold, 
-                score2prob, nonmaxSigma, softmax));
+        holder.push_back(newnonmax(*this, winstride));
     } 
     if (doImageOut && !aligninimage) {
         holder.push2last( new MarkImage(outimage, infileIsDir, !showscore));
@@ -1015,8 +2567,9 @@ void WinDetectClassify::runImageSlider(
     }
     if (verbose > 3)
         holder.print(cout);
+    holder.async(writers);
 
-    unsigned long totalwindows=0; 
+    unsigned long totalwindows=0, totallattice=0, totalrejected=0; 
 
     IndexType tmargin(margin_x, margin_y);
     IndexType tavsize(avsize_x, avsize_y);
@@ -1030,7 +2583,11 @@ void WinDetectClassify::runImageSlider(
         IndexType toadd = 0;
 
         WinDescType::ImageType origimage;
-        ImageIO::read(*f,origimage);
+        {
+            // background writers may be using Imlib2
+            ScopedLock lock(ImageIO::mutex());
+            ImageIO::read(*f,origimage);
+        }
         if (addmargin) {
             IndexType newext = origimage.extent();
             IndexType toaddX = 0, toaddY = 0;
@@ -1050,7 +2607,7 @@ void WinDetectClassify::runImageSlider(
 
         if (verbose > 5) cout << "Processing file " << *f << endl;
 
-        int imagewindows = 0; 
+        int imagewindows = 0, imagelattice = 0, imagerejected = 0; 
         holder.clear();
 
         if (nopyramid) {
@@ -1073,11 +2630,13 @@ void WinDetectClassify::runImageSlider(
                 tl = (image.extent() - size)/2;
 
             Array1DType desc = windesc->compute(tl); 
+            holder.newpyramid(tl, IndexType(1), 1, toadd);
 
             DetectInfo r = bound(classifier(desc.data()),1, tl, windesc->extent());
             r.lbound -=toadd;
 
             holder(r);
+            ++imagelattice;
             if (dotestlocs){
                 using std::setw; using std::setprecision;
                 testlocsstr << *f 
@@ -1104,53 +2663,86 @@ void WinDetectClassify::runImageSlider(
                     endl;
             }// }}}
 
+            Array1DType desc(windesc->length());
+            ScoreWindow score(windesc, classifier, desc.data());
+            EnergyFilter filter(energythreshold, winsize);
+            if (energythreshold > 0)
+                score.filter = &filter;
+            QuantizedClassify quantized;
+            std::vector<unsigned char> qdesc;
+            setquantized(*this, windesc, classifier, score, quantized, qdesc);
+            windesc->fixedpoint(fixedpoint);
+            windesc->halfprecision(halfprecision);
             for (PyramidType::iterator piter = pyramid.begin(); 
                     piter != pyramid.end(); ++piter) 
             {// {{{
-                WinDescType::ImageType pyimg (lear::rescale(image, *piter));
-                SliderType slider(pyimg.extent(),winsize,winstride);
-
-                windesc->preprocess(pyimg);
-
-                for (SliderType::iterator siter = slider.begin(); 
-                        siter != slider.end(); ++siter) 
-                {
-                    IndexType tl=*siter;
-                    if (hasTopLeft && hasFullSize) {
-                        tl += topleft;
-                    }
+                const SliderType slider(*piter,winsize,winstride);
+                imagelattice += slider.size();
 
-                    Array1DType desc = windesc->compute(tl); 
+                IndexType origin = slider.lbound(), extent = slider.elem_extent();
+                if (hasTopLeft && hasFullSize) 
+                    origin += topleft;
 
-                    DetectInfo r = bound(
-                            classifier(desc.data()),piter.scale(),
-                            tl, windesc->extent());
-                    r.lbound -=toadd;
+                int first, last;
+                if (!groundband(*this, piter.scale(), origin[1], winstride[1], 
+                            extent[1], toadd[1], first, last))
+                    continue;
+                origin[1] += first*winstride[1];
+                extent[1] = last - first + 1;
 
-                    holder(r);
-                    ++imagewindows;
-                    if (dotestlocs){
-                        using std::setw; using std::setprecision;
+                score.lazy = score.filter != NULL || coarsestride > 1;
+                WinDescType::ImageType pyimg (lear::rescale(image, *piter));
+                score.offset = preparelevel(windesc, pyimg, origin, extent, 
+                        winstride, winsize, groundtolerance > 0, score.lazy);
+                if (score.filter)
+                    filter.build(windesc->preprocessed());
+                holder.newpyramid(origin, extent, piter.scale(), toadd);
+
+                scanlevel(origin, extent, winstride,
+                        coarsestride, refinethreshold, score, levelscores);
+                if (levelscores.size())
+                    holder(levelscores.batch(
+                            piter.scale(), windesc->extent(), toadd));
+                imagewindows += levelscores.size();
+
+                if (dotestlocs){
+                    using std::setw; using std::setprecision;
+                    for (int k= 0; k< levelscores.size(); ++k)
                         testlocsstr << *f 
-<< ' ' << setprecision(4) << setw(10) << tl[0]*piter.scale() - toadd[0] 
-<< ' ' << setprecision(4) << setw(10) << tl[1]*piter.scale() - toadd[1]
+<< ' ' << setprecision(4) << setw(10) << levelscores.x[k]*piter.scale() - toadd[0] 
+<< ' ' << setprecision(4) << setw(10) << levelscores.y[k]*piter.scale() - toadd[1]
 << ' ' << setprecision(4) << setw(10) << size[0]*piter.scale() 
 << ' ' << setprecision(4) << setw(10) << size[1]*piter.scale() 
 << std::endl;
-                    }
                 }
             }// }}}
+            imagerejected = filter.rejected;
         }
         totalwindows+=imagewindows;
+        totalrejected+=imagerejected;
+        totallattice+=imagelattice;
 
         holder.write(*f); //just write to files
         if (verbose > 3) {// {{{
-            cout << "Processed " << setw(5) << imagewindows 
-                 << " windows in file " << *f <<  endl;
+            cout << "Processed " << setw(5) << imagewindows;
+            if (coarsestride > 1 || energythreshold > 0)
+                cout << " of " << imagelattice;
+            cout << " windows in file " << *f;
+            if (energythreshold > 0)
+                cout << ", " << imagerejected << " flat";
+            cout << endl;
         }// }}}
     }
+    holder.flush();
     if (verbose > 0)  {// {{{
-        cout << "Tested " << totalwindows << " windows" << endl;
+        cout << "Tested " << totalwindows << " windows";
+        if (coarsestride > 1)
+            cout << " of " << totallattice << " (coarse stride " 
+                 << coarsestride << ")";
+        if (energythreshold > 0 && totallattice)
+            cout << ", energy filter rejected " << totalrejected << " ("
+                 << setprecision(3) << 100.0*totalrejected/totallattice << "%)";
+        cout << endl;
     }// }}}
 }
 // }}}
@@ -1159,7 +2751,7 @@ void WinDetectClassify::runImageSlider(
 
 LinearClassify::LinearClassify(std::string& modelfile, const int verbose) 
     :
-    length_ (0), linearwt_(0),  linearbias_(0)
+    length_ (0), linearwt_(0),  linearbias_(0), floatwt_(0)
 {// {{{
     if (verbose > 2) 
         std::cout << "Reading model file: " << modelfile;
@@ -1231,11 +2823,25 @@ LinearClassify::LinearClassify(std::string& modelfile, const int verbose)
         std::cout << " Done" << std::endl;
 }// }}}
 
-LinearClassify::LinearClassify(const LinearClassify& o) :
-    length_(o.length_), linearbias_(o.linearbias_)
+LinearClassify::LinearClassify(const float* weight, const int length, const double bias) :
+    length_(length), linearwt_(0), linearbias_(bias), floatwt_(weight)
+{}
+
+LinearClassify::LinearClassify(const std::vector<double>& weight, const double bias) :
+    length_(weight.size()), linearwt_(0), linearbias_(bias), floatwt_(0)
 {
     linearwt_ = new double[length_];
-    std::copy(o.linearwt_, o.linearwt_+o.length_, linearwt_);
+    std::copy(weight.begin(), weight.end(), linearwt_);
+}
+
+LinearClassify::LinearClassify(const LinearClassify& o) :
+    length_(o.length_), linearwt_(0), linearbias_(o.linearbias_), floatwt_(o.floatwt_),
+    variant_(o.variant_)
+{
+    if (o.linearwt_) {
+        linearwt_ = new double[length_];
+        std::copy(o.linearwt_, o.linearwt_+o.length_, linearwt_);
+    }
 }
 
 LinearClassify& LinearClassify::operator=(const LinearClassify& o) 
@@ -1243,30 +2849,135 @@ LinearClassify& LinearClassify::operator=(const LinearClassify& o)
     if (&o != this) {
         if (linearwt_) 
             delete[] linearwt_;
+        linearwt_ = 0;
 
         length_=o.length_; 
         linearbias_=o.linearbias_;
+        floatwt_=o.floatwt_;
+        variant_=o.variant_;
 
-        linearwt_ = new double[length_];
-        std::copy(o.linearwt_, o.linearwt_+o.length_, linearwt_);
+        if (o.linearwt_) {
+            linearwt_ = new double[length_];
+            std::copy(o.linearwt_, o.linearwt_+o.length_, linearwt_);
+        }
     } 
     return *this;
 }
 
-double LinearClassify::operator()(const double* desc) const 
+template<class T>
+double LinearClassify::dot(const T* desc) const 
 {
     double sum = 0;
-    for (int i= 0; i< length_; ++i) 
-        sum += linearwt_[i]*desc[i]; 
-    return sum - linearbias_;
+    if (floatwt_) {
+        for (int i= 0; i< length_; ++i) 
+            sum += floatwt_[i]*desc[i]; 
+    } else {
+        for (int i= 0; i< length_; ++i) 
+            sum += linearwt_[i]*desc[i]; 
+    }
+    for (unsigned v= 0; v< variant_.size(); ++v) {
+        const double* w = &variant_[v][0];
+        double vsum = 0;
+        for (int i= 0; i< length_; ++i) 
+            vsum += w[i]*desc[i]; 
+        sum = std::max(sum, vsum);
+    }
+    return sum;
+}
+
+double LinearClassify::operator()(const double* desc) const 
+{
+    return dot(desc) - linearbias_;
 }
 
 float LinearClassify::operator()(const float* desc) const 
 {
-    double sum = 0;
+    return dot(desc) - linearbias_;
+}
+
+void LinearClassify::addvariant(const LinearClassify& variant) 
+{
+    if (variant.length() != length_)
+        throw Exception("LinearClassify::addvariant", 
+                "Variant length does not match the model length");
+    std::vector<double> w(length_);
     for (int i= 0; i< length_; ++i) 
-        sum += linearwt_[i]*desc[i]; 
-    return sum - linearbias_;
+        w[i] = variant.weight(i);
+    variant_.push_back(w);
+}
+
+/// sum of w[i]*x[i], i < n
+static int dot8(const signed char* w, const unsigned char* x, const int n)
+{// {{{
+    int i = 0, sum = 0;
+#ifdef __SSE2__
+    // x is widened with zeros, w sign extended by unpacking it with itself
+    // and shifting. Pairwise sums of products, at most 2*255*127, are
+    // added in 32 bits.
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i+16 <= n; i+= 16) {
+        const __m128i xv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x+i));
+        const __m128i wv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w+i));
+        const __m128i xlo = _mm_unpacklo_epi8(xv, zero);
+        const __m128i xhi = _mm_unpackhi_epi8(xv, zero);
+        const __m128i wlo = _mm_srai_epi16(_mm_unpacklo_epi8(wv, wv), 8);
+        const __m128i whi = _mm_srai_epi16(_mm_unpackhi_epi8(wv, wv), 8);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(xlo, wlo));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(xhi, whi));
+    }
+    int part[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(part), acc);
+    sum = part[0] + part[1] + part[2] + part[3];
+#endif
+    for (; i< n; ++i) 
+        sum += w[i]*x[i];
+    return sum;
+}// }}}
+
+QuantizedClassify::QuantizedClassify(
+        const LinearClassify& classifier, const double descscale) :
+    length_(classifier.length()), models_(1 + classifier.variants()),
+    descscale_(descscale), weightscale_(0), bias_(classifier.bias()),
+    weight_(length_*models_)
+{// {{{
+    if (!(descscale > 0))
+        throw Exception("QuantizedClassify::QuantizedClassify", 
+                "Descriptor scale must be positive");
+    // the 32 bit sum holds length_ products of at most 255*127
+    if (length_ > (1<<30)/(255*127))
+        throw Exception("QuantizedClassify::QuantizedClassify", 
+                "Model too long for 32 bit integer scoring");
+
+    double wmax = 0;
+    for (int i= 0; i< length_; ++i) 
+        wmax = std::max(wmax, std::abs(classifier.weight(i)));
+    for (int v= 0; v< classifier.variants(); ++v) 
+        for (int i= 0; i< length_; ++i) 
+            wmax = std::max(wmax, std::abs(classifier.variantweight(v,i)));
+    weightscale_ = wmax > 0 ? 127/wmax : 1;
+
+    for (int m= 0; m< models_; ++m) 
+        for (int i= 0; i< length_; ++i) {
+            const double w = m ? classifier.variantweight(m-1,i) 
+                : classifier.weight(i);
+            weight_[m*length_ + i] = static_cast<signed char>(
+                    std::floor(w*weightscale_ + 0.5));
+        }
+}// }}}
+
+void QuantizedClassify::quantize(const float* desc, unsigned char* dest) const 
+{
+    for (int i= 0; i< length_; ++i) 
+        dest[i] = lear::quantize8(desc[i], descscale_);
+}
+
+float QuantizedClassify::operator()(const unsigned char* desc) const 
+{
+    int sum = dot8(&weight_[0], desc, length_);
+    for (int m= 1; m< models_; ++m) 
+        sum = std::max(sum, dot8(&weight_[m*length_], desc, length_));
+    return sum/(descscale_*weightscale_) - bias_;
 }
 
 void DetectedRegion::print(std::ostream& o) const
@@ -1284,7 +2995,8 @@ std::ostream& operator<<(std::ostream& o, const DetectedRegion& region){
 
 extern const double         PERSON_WEIGHT_VEC[];
 extern const int            PERSON_WEIGHT_VEC_LENGTH;
-LinearClassify::LinearClassify() 
+LinearClassify::LinearClassify() :
+    floatwt_(0)
 {// {{{
     linearbias_ = 6.6657914910925990525925044494215;
     length_ = PERSON_WEIGHT_VEC_LENGTH;
@@ -1302,6 +3014,7 @@ void WinDetect::print(std::ostream& o) const
         "          FullSize" << setw(3) << right <<fullsize_x<< "x" << setw(3) << left <<fullsize_y<< right << "   |\n" <<
         "  | ScaleRatio " << setw(4) << left << scaleratio << " StartScale " << setw(3) << left << startscale << " EndScale " << setw(3) << left << endscale  << "|\n"
         "  | Label " << setw(4) << left << label  << "  CacheSize  " << setw(4) << left << cachesize  << "  Verbose  " << setw(4) << left << verbose << " |\n"
+        "  | SharedLevels " << setw(4) << left << sharedlevels << "  CellGrid " << setw(2) << left << cellgrid << "             |\n"
         "  |--------------------------------------------|\n";
 }
 #ifdef BUILD_APP
@@ -1322,7 +3035,15 @@ void WinDetectClassify::print(std::ostream& o) const
         "  | Pyramid " << !nopyramid << "   NonMax " << !no_nonmax << "   AlignImg " << aligninimage  << "   ShowSc " << showscore << " |\n"
         "  | Thres   " << setw(4) << left << threshold << "  LtThres   " << setw(4) << left << lightthreshold   << "  SoftMax   " << setw(4) << left << softmax << " |\n"
         "  | Sc2Prob   A:" << setw(4) << left << score2prob_a << "  B:" << setw(4) << left << score2prob_b<< "                     |\n"
+        "  | NonMaxMethod " << setw(10) << left << (nonmaxmethod == ScaleSpace ? "ScaleSpace" : (nonmaxmethod == Greedy ? "Greedy" : "MeanShift")) << "  Overlap " << setw(4) << left << nonmaxoverlap << "        |\n"
         "  | NonMaxSig X:" << setw(4) <<  nonmaxsigma_x<< "  Y:" << setw(4) << nonmaxsigma_y << "  Y: " << setw(4) << nonmaxsigma_scale  << "            |\n"
+        "  | CoarseStride " << setw(4) << left << coarsestride << "  RefineThres " << setw(6) << left << refinethreshold << "         |\n"
+        "  | Ground A:" << setw(7) << left << groundplane_a << " B:" << setw(7) << left << groundplane_b << " Tol:" << setw(6) << left << groundtolerance << "       |\n"
+        "  | Budget  " << setw(7) << left << timebudget << " ms  Priority " << setw(6) << left << priorityscale << "        |\n"
+        "  | EnergyThres " << setw(8) << left << energythreshold << "                       |\n"
+        "  | Pose Mirror " << setw(2) << left << posemirror << " Angle " << setw(6) << left << poseangle << " Steps " << setw(3) << left << posesteps << "      |\n"
+        "  | DescScale " << setw(8) << left << descscale << "  FixedPoint " << setw(2) << left << fixedpoint << "          |\n"
+        "  | HalfPrecision " << setw(2) << left << halfprecision << "                           |\n"
         "  | AvgSize " << setw(3) << right << avsize_x << "x" << setw(3) << left << avsize_y << right << 
         "          Margin  " << setw(3) << right << margin_x << "x" << setw(3) << left << margin_y << right << "     |\n" <<
         "  | AlMargin" << setw(3) << right << alignmargin_x<< "x" << setw(3) << left << alignmargin_y<< right << 
@@ -0,0 +1,433 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  windowclassify.cpp
+ *
+ *    Description:  Window classifiers of windetect.h other than
+ *    LinearClassify: batch scoring of the WindowClassifier interface, the
+ *    SSE linear model and the lookup table additive kernel model.
+ *
+ * =====================================================================================
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <lear/exception.h>
+#include <lear/io/biistream.h>
+#include <lear/io/biostream.h>
+#include <lear/io/fileheader.h>
+#include <lear/interface/windetect.h>
+
+using lear::Exception;
+
+void WindowClassifier::operator()(const float* desc, const int count, 
+        float* score) const 
+{
+    const int n = length();
+    for (int k= 0; k< count; ++k) 
+        score[k] = (*this)(desc + k*n);
+}
+
+// {{{ FloatClassify
+/// sum of w[i]*x[i], i < n
+static float dot1(const float* w, const float* x, const int n)
+{// {{{
+    int i = 0;
+    float sum = 0;
+#ifdef __SSE__
+    __m128 acc = _mm_setzero_ps();
+    for (; i+4 <= n; i+= 4) 
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(w+i), _mm_loadu_ps(x+i)));
+    float part[4];
+    _mm_storeu_ps(part, acc);
+    sum = part[0] + part[1] + part[2] + part[3];
+#endif
+    for (; i< n; ++i) 
+        sum += w[i]*x[i];
+    return sum;
+}// }}}
+
+/// dot products of w with the n values at x + k*stride, k < 4, to out
+static void dot4(const float* w, const float* x, const int stride, 
+        const int n, float* out)
+{// {{{
+    const float *x0 = x, *x1 = x + stride, *x2 = x + 2*stride, *x3 = x + 3*stride;
+    int i = 0;
+    out[0] = out[1] = out[2] = out[3] = 0;
+#ifdef __SSE__
+    // one weight load for four windows
+    __m128 a0 = _mm_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+    for (; i+4 <= n; i+= 4) {
+        const __m128 wv = _mm_loadu_ps(w+i);
+        a0 = _mm_add_ps(a0, _mm_mul_ps(wv, _mm_loadu_ps(x0+i)));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(wv, _mm_loadu_ps(x1+i)));
+        a2 = _mm_add_ps(a2, _mm_mul_ps(wv, _mm_loadu_ps(x2+i)));
+        a3 = _mm_add_ps(a3, _mm_mul_ps(wv, _mm_loadu_ps(x3+i)));
+    }
+    // lane k of the sum of the transposed accumulators is window k
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+    _mm_storeu_ps(out, _mm_add_ps(_mm_add_ps(a0, a1), _mm_add_ps(a2, a3)));
+#endif
+    for (; i< n; ++i) {
+        out[0] += w[i]*x0[i]; out[1] += w[i]*x1[i];
+        out[2] += w[i]*x2[i]; out[3] += w[i]*x3[i];
+    }
+}// }}}
+
+FloatClassify::FloatClassify(const LinearClassify& classifier) :
+    length_(classifier.length()), models_(1 + classifier.variants()),
+    bias_(classifier.bias()), weight_(length_*models_)
+{
+    for (int m= 0; m< models_; ++m) 
+        for (int i= 0; i< length_; ++i) 
+            weight_[m*length_ + i] = m ? classifier.variantweight(m-1,i) 
+                : classifier.weight(i);
+}
+
+float FloatClassify::operator()(const float* desc) const 
+{
+    float sum = dot1(&weight_[0], desc, length_);
+    for (int m= 1; m< models_; ++m) 
+        sum = std::max(sum, dot1(&weight_[m*length_], desc, length_));
+    return sum - bias_;
+}
+
+void FloatClassify::operator()(const float* desc, const int count, 
+        float* score) const 
+{
+    int k = 0;
+    for (; k+4 <= count; k+= 4) {
+        const float* x = desc + k*length_;
+        float best[4], v[4];
+        dot4(&weight_[0], x, length_, length_, best);
+        for (int m= 1; m< models_; ++m) {
+            dot4(&weight_[m*length_], x, length_, length_, v);
+            for (int j= 0; j< 4; ++j) 
+                best[j] = std::max(best[j], v[j]);
+        }
+        for (int j= 0; j< 4; ++j) 
+            score[k+j] = best[j] - bias_;
+    }
+    for (; k< count; ++k) 
+        score[k] = (*this)(desc + k*length_);
+}
+// }}}
+
+// {{{ AdditiveClassify
+namespace {
+const lear::FileHeader header("AddKern", 100);
+}
+
+AdditiveClassify::AdditiveClassify(const int length, 
+        const std::vector<float>& sv, const std::vector<double>& alpha, 
+        const double bias, const int bins, const Kernel kernel) :
+    kernel_(kernel), length_(length), bins_(bins), bias_(bias), 
+    scale_(length, 0), table_(2*length*bins, 0)
+{// {{{
+    if (length < 1 || bins < 2)
+        throw Exception("AdditiveClassify::AdditiveClassify", 
+                "Length must be positive and bins at least 2");
+    const int count = alpha.size();
+    if (sv.size() != static_cast<unsigned>(count*length))
+        throw Exception("AdditiveClassify::AdditiveClassify", 
+                "Support vectors do not match the coefficients and length");
+
+    // support values of one dimension in increasing order
+    std::vector< std::pair<float,double> > s(count);
+    for (int i= 0; i< length_; ++i) {
+        double total = 0;
+        for (int j= 0; j< count; ++j) {
+            s[j] = std::make_pair(std::max(sv[j*length_ + i], 0.0f), alpha[j]);
+            total += alpha[j];
+        }
+        std::sort(s.begin(), s.end());
+        const float smax = count ? s.back().first : 0;
+        if (!(smax > 0))
+            continue;
+        scale_[i] = (bins_-1)/smax;
+
+        float* t = &table_[2*i*bins_];
+        if (kernel_ == Intersection) {
+            // h(v) = sum_{s <= v} alpha*s + v * sum_{s > v} alpha
+            double below = 0, above = total;
+            int j = 0;
+            for (int k= 0; k< bins_; ++k) {
+                const double v = k == bins_-1 ? smax : k/scale_[i];
+                for (; j< count && s[j].first <= v; ++j) {
+                    below += s[j].second*s[j].first;
+                    above -= s[j].second;
+                }
+                t[2*k] = below + v*above;
+            }
+        } else {
+            for (int k= 1; k< bins_; ++k) {
+                const double v = k == bins_-1 ? smax : k/scale_[i];
+                double h = 0;
+                for (int j= 0; j< count; ++j) 
+                    h += s[j].second*2*v*s[j].first/(v + s[j].first);
+                t[2*k] = h;
+            }
+        }
+    }
+    setslopes();
+}// }}}
+
+AdditiveClassify::AdditiveClassify(const std::string& filename) 
+{// {{{
+    lear::BiIStream from(filename.c_str());
+    if (!from)
+        throw Exception("AdditiveClassify::AdditiveClassify",
+                "Unable to open table file " + filename);
+
+    lear::FileHeader fheader;
+    from >> fheader;
+    if (!fheader.identify(header.tag()))
+        throw Exception("AdditiveClassify::AdditiveClassify",
+                "File " + filename + " does not look like additive kernel tables");
+    if (fheader.version() != header.version())
+        throw Exception("AdditiveClassify::AdditiveClassify",
+                "File " + filename + " has unsupported version number");
+
+    int kernel = 0;
+    from >> kernel >> length_ >> bins_ >> bias_;
+    if (!from || (kernel != Intersection && kernel != ChiSquare) 
+            || length_ < 1 || bins_ < 2)
+        throw Exception("AdditiveClassify::AdditiveClassify",
+                "Invalid table file " + filename);
+    kernel_ = static_cast<Kernel>(kernel);
+
+    scale_.resize(length_);
+    table_.assign(2*length_*bins_, 0);
+    for (int i= 0; i< length_; ++i) 
+        from >> scale_[i];
+    for (int i= 0; i< length_*bins_; ++i) 
+        from >> table_[2*i];
+    if (!from)
+        throw Exception("AdditiveClassify::AdditiveClassify",
+                "Unable to read table file " + filename);
+    setslopes();
+}// }}}
+
+void AdditiveClassify::save(const std::string& filename) const 
+{// {{{
+    lear::BiOStream to(filename.c_str());
+    if (!to)
+        throw Exception("AdditiveClassify::save",
+                "Unable to open table file " + filename);
+
+    to << header;
+    to << static_cast<int>(kernel_) << length_ << bins_ << bias_;
+    for (int i= 0; i< length_; ++i) 
+        to << scale_[i];
+    for (int i= 0; i< length_*bins_; ++i) 
+        to << table_[2*i];
+    if (!to)
+        throw Exception("AdditiveClassify::save",
+                "Unable to write table file " + filename);
+}// }}}
+
+bool AdditiveClassify::check(const std::string& filename) 
+{
+    return header.verify(filename);
+}
+
+void AdditiveClassify::setslopes() 
+{
+    for (int i= 0; i< length_; ++i) {
+        if (!(scale_[i] >= 0))
+            throw Exception("AdditiveClassify::setslopes", 
+                    "Negative table scale");
+        float* t = &table_[2*i*bins_];
+        for (int k= 0; k< bins_-1; ++k) 
+            t[2*k+1] = t[2*k+2] - t[2*k];
+        t[2*bins_-1] = 0;
+    }
+}
+
+/// value in front of the first '#' of line
+template<class T>
+static T headervalue(std::istream& in, const std::string& filename)
+{// {{{
+    std::string line;
+    std::getline(in, line);
+    std::istringstream value(line.substr(0, line.find('#')));
+    T v = T();
+    if (!in || !(value >> v))
+        throw Exception("AdditiveClassify::readsvm", 
+                "Invalid model header in " + filename);
+    return v;
+}// }}}
+
+void AdditiveClassify::readsvm(const std::string& filename, int& length,
+        std::vector<float>& sv, std::vector<double>& alpha, double& bias,
+        std::string& kernel, const int verbose) 
+{// {{{
+    if (verbose > 2) 
+        std::cout << "Reading model file: " << filename;
+    std::ifstream in(filename.c_str());
+    if (!in)
+        throw Exception("AdditiveClassify::readsvm", 
+                "Unable to open the modelfile " + filename);
+
+    std::string line;
+    std::getline(in, line);
+    if (line.compare(0, 17, "SVM-light Version"))
+        throw Exception("AdditiveClassify::readsvm", 
+                filename + " is not an SVM-light text model");
+
+    const int type = headervalue<int>(in, filename);
+    if (type != 4)
+        throw Exception("AdditiveClassify::readsvm", 
+                "Only custom kernel (-t 4) models are supported");
+    // -d, -g, -s, -r
+    for (int k= 0; k< 4; ++k) 
+        std::getline(in, line);
+    std::getline(in, line);
+    kernel = line.substr(0, line.find('#'));
+
+    length = headervalue<int>(in, filename);
+    headervalue<long>(in, filename);        // training documents
+    const long count = headervalue<long>(in, filename) - 1;
+    bias = headervalue<double>(in, filename);
+    if (length < 1 || count < 0)
+        throw Exception("AdditiveClassify::readsvm", 
+                "Invalid model header in " + filename);
+
+    sv.assign(count*length, 0);
+    alpha.assign(count, 0);
+    for (long j= 0; j< count; ++j) {
+        std::getline(in, line);
+        std::istringstream words(line.substr(0, line.find('#')));
+        if (!in || !(words >> alpha[j]))
+            throw Exception("AdditiveClassify::readsvm", 
+                    "Unable to read support vectors from " + filename);
+        long index;
+        char colon;
+        double value;
+        // missing features are 0
+        while (words >> index >> colon >> value) {
+            if (colon != ':' || index < 1 || index > length)
+                throw Exception("AdditiveClassify::readsvm", 
+                        "Invalid feature in " + filename);
+            sv[j*length + index-1] = value;
+        }
+    }
+    if (verbose > 2) 
+        std::cout << " Done, " << count << " support vectors" << std::endl;
+}// }}}
+
+AdditiveClassify::Kernel AdditiveClassify::kernelname(const std::string& name) 
+{
+    std::istringstream in(name);
+    std::string word;
+    in >> word;
+    if (word == "intersection" || word == "min")
+        return Intersection;
+    if (word == "chi2")
+        return ChiSquare;
+    throw Exception("AdditiveClassify::kernelname", 
+            "Unknown additive kernel '" + name + "'");
+}
+
+float AdditiveClassify::lookup(const float* desc) const 
+{// {{{
+    const float* s = &scale_[0];
+    const float* t = &table_[0];
+    const int stride = 2*bins_;
+    const float last = bins_ - 1, beforelast = bins_ - 2;
+    int i = 0;
+    float sum = 0;
+    // u is clamped to [0,last] (NaN to 0), the sample below to beforelast,
+    // so that u = last interpolates to the last sample
+#ifdef __AVX2__
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 ulast = _mm256_set1_ps(last);
+        const __m256 kmax = _mm256_set1_ps(beforelast);
+        const __m256i step = _mm256_set1_epi32(8*stride);
+        __m256i base = _mm256_mullo_epi32(_mm256_setr_epi32(0,1,2,3,4,5,6,7), 
+                _mm256_set1_epi32(stride));
+        __m256 acc = zero;
+        for (; i+8 <= length_; i+= 8) {
+            __m256 u = _mm256_mul_ps(_mm256_loadu_ps(desc+i), _mm256_loadu_ps(s+i));
+            u = _mm256_min_ps(_mm256_max_ps(u, zero), ulast);
+            const __m256i k = _mm256_cvttps_epi32(_mm256_min_ps(u, kmax));
+            const __m256 f = _mm256_sub_ps(u, _mm256_cvtepi32_ps(k));
+            const __m256i o = _mm256_add_epi32(base, _mm256_slli_epi32(k, 1));
+            const __m256 v = _mm256_i32gather_ps(t, o, 4);
+            const __m256 d = _mm256_i32gather_ps(t+1, o, 4);
+            acc = _mm256_add_ps(acc, _mm256_add_ps(v, _mm256_mul_ps(f, d)));
+            base = _mm256_add_epi32(base, step);
+        }
+        float part[8];
+        _mm256_storeu_ps(part, acc);
+        for (int j= 0; j< 8; ++j) 
+            sum += part[j];
+    }
+#endif
+#ifdef __SSE2__
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 ulast = _mm_set1_ps(last);
+        const __m128 kmax = _mm_set1_ps(beforelast);
+        const __m128i step = _mm_set1_epi32(4*stride);
+        __m128i base = _mm_setr_epi32(i*stride, (i+1)*stride, 
+                (i+2)*stride, (i+3)*stride);
+        __m128 acc = zero;
+        for (; i+4 <= length_; i+= 4) {
+            __m128 u = _mm_mul_ps(_mm_loadu_ps(desc+i), _mm_loadu_ps(s+i));
+            u = _mm_min_ps(_mm_max_ps(u, zero), ulast);
+            const __m128i k = _mm_cvttps_epi32(_mm_min_ps(u, kmax));
+            const __m128 f = _mm_sub_ps(u, _mm_cvtepi32_ps(k));
+            int o[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o), 
+                    _mm_add_epi32(base, _mm_slli_epi32(k, 1)));
+            const __m128 v = _mm_setr_ps(t[o[0]], t[o[1]], t[o[2]], t[o[3]]);
+            const __m128 d = _mm_setr_ps(t[o[0]+1], t[o[1]+1], t[o[2]+1], t[o[3]+1]);
+            acc = _mm_add_ps(acc, _mm_add_ps(v, _mm_mul_ps(f, d)));
+            base = _mm_add_epi32(base, step);
+        }
+        float part[4];
+        _mm_storeu_ps(part, acc);
+        sum += part[0] + part[1] + part[2] + part[3];
+    }
+#endif
+    for (; i< length_; ++i) {
+        float u = desc[i]*s[i];
+        u = u > 0 ? std::min(u, last) : 0;
+        const int k = static_cast<int>(std::min(u, beforelast));
+        const float* ti = t + i*stride + 2*k;
+        sum += ti[0] + (u - k)*ti[1];
+    }
+    return sum;
+}// }}}
+
+float AdditiveClassify::operator()(const float* desc) const 
+{
+    return lookup(desc) - bias_;
+}
+
+void AdditiveClassify::operator()(const float* desc, const int count, 
+        float* score) const 
+{
+    for (int k= 0; k< count; ++k) 
+        score[k] = lookup(desc + k*length_) - bias_;
+}
+// }}}
@@ -0,0 +1,219 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  wintrack.cpp
+ *
+ *    Description:  Provides implementation to wintrack.h interface.
+ *
+ * =====================================================================================
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <algorithm>
+
+#include <lear/interface/wintrack.h>
+
+typedef WinDetectTrack::RealType        RealType;
+
+namespace {
+/// pixels between motion energy samples
+const int SampleStep = 8;
+
+/// overlap (intersection over union) of two windows
+RealType overlap(
+        const RealType ax, const RealType ay, const RealType aw, const RealType ah,
+        const DetectedRegion& b)
+{
+    const RealType x0 = std::max(ax - aw/2, RealType(b.x));
+    const RealType y0 = std::max(ay - ah/2, RealType(b.y));
+    const RealType x1 = std::min(ax + aw/2, RealType(b.x + b.width));
+    const RealType y1 = std::min(ay + ah/2, RealType(b.y + b.height));
+    if (x1 <= x0 || y1 <= y0)
+        return 0;
+    const RealType inter = (x1-x0)*(y1-y0);
+    return inter/(aw*ah + RealType(b.width)*b.height - inter);
+}
+
+/// candidate track/detection pair
+struct Match {
+    RealType overlap;
+    int track, detect;
+    bool operator<(const Match& o) const { return overlap > o.overlap; }
+};
+}
+
+WinDetectTrack::WinDetectTrack(const WinDetectClassify& detector,
+        const WindowClassifier& classifier)
+        :
+    fullscan(10), motionthreshold(0),
+    searchradius(0.25), searchscale(1.2),
+    maxmissed(2), matchoverlap(0.3),
+    detector_(detector), classifier_(classifier),
+    width_(0), height_(0), sincefull_(0), lastfull_(false), motion_(0)
+{}
+
+void WinDetectTrack::reset()
+{
+    tracks_.clear();
+    samples_.clear();
+    width_ = height_ = 0;
+    sincefull_ = 0;
+    lastfull_ = false;
+    motion_ = 0;
+}
+
+void WinDetectTrack::test(std::list<DetectedRegion>& detections,
+        const unsigned char* imagedata, int width, int height,
+        const PixelFormat& format, DetectStats* stats)
+{// {{{
+    const RealType energy = motionenergy(imagedata, width, height, format);
+    motion_ = std::max(energy, RealType(0));
+
+    ++sincefull_;
+    const bool full = energy < 0
+        || (fullscan > 0 && sincefull_ >= fullscan)
+        || (motionthreshold > 0 && energy > motionthreshold);
+
+    if (full) {
+        sincefull_ = 0;
+        detector_.test(classifier_, detections, imagedata, width, height,
+                format, stats);
+    } else {
+        std::vector<SearchRegion> regions;
+        predict(regions);
+        if (regions.empty()) {
+            detections.clear();
+            if (stats)
+                *stats = DetectStats();
+        } else {
+            detector_.test(classifier_, detections, imagedata, width, height,
+                    format, regions, stats);
+        }
+    }
+    lastfull_ = full;
+    update(detections);
+}// }}}
+
+RealType WinDetectTrack::motionenergy(const unsigned char* imagedata,
+        int width, int height, const PixelFormat& format)
+{// {{{
+    const int pixelbytes = format.pixelbytes();
+    const int rowbytes = format.rowbytes(width);
+    const unsigned char* green = imagedata + (format.planar()
+            ? format.index(1)*format.planestep : format.index(1));
+
+    const bool comparable = width == width_ && height == height_;
+    width_ = width; height_ = height;
+
+    const int nx = (width + SampleStep - 1)/SampleStep;
+    const int ny = (height + SampleStep - 1)/SampleStep;
+    samples_.resize(nx*ny);
+
+    long diff = 0;
+    unsigned char* s = samples_.empty() ? NULL : &samples_[0];
+    for (int j= 0; j< height; j+= SampleStep) {
+        const unsigned char* row = green + j*rowbytes;
+        for (int i= 0; i< width; i+= SampleStep, ++s) {
+            const unsigned char v = row[i*pixelbytes];
+            diff += std::abs(int(v) - int(*s));
+            *s = v;
+        }
+    }
+    if (!comparable || samples_.empty())
+        return -1;
+    return static_cast<RealType>(diff)/samples_.size();
+}// }}}
+
+void WinDetectTrack::predict(std::vector<SearchRegion>& regions) const
+{// {{{
+    regions.clear();
+    for (unsigned t= 0; t< tracks_.size(); ++t) {
+        const Track& k = tracks_[t];
+        // uncertainty grows with the frames since the last detection
+        const int n = k.missed + 1;
+        const RealType x = k.x + n*k.vx, y = k.y + n*k.vy;
+        const RealType rx = n*(searchradius*k.width + std::abs(k.vx));
+        const RealType ry = n*(searchradius*k.height + std::abs(k.vy));
+        regions.push_back(SearchRegion(x-rx, y-ry, x+rx, y+ry,
+                    k.scale/searchscale, k.scale*searchscale));
+    }
+}// }}}
+
+void WinDetectTrack::update(const std::list<DetectedRegion>& detections)
+{// {{{
+    const std::vector<DetectedRegion> det(detections.begin(), detections.end());
+
+    std::vector<Match> match;
+    for (unsigned t= 0; t< tracks_.size(); ++t) {
+        const Track& k = tracks_[t];
+        const int n = k.missed + 1;
+        for (unsigned d= 0; d< det.size(); ++d) {
+            Match m;
+            m.overlap = overlap(k.x + n*k.vx, k.y + n*k.vy,
+                    k.width, k.height, det[d]);
+            m.track = t; m.detect = d;
+            if (m.overlap >= matchoverlap)
+                match.push_back(m);
+        }
+    }
+    std::stable_sort(match.begin(), match.end());
+
+    std::vector<char> trackused(tracks_.size(), 0), detused(det.size(), 0);
+    for (unsigned i= 0; i< match.size(); ++i) {
+        const Match& m = match[i];
+        if (trackused[m.track] || detused[m.detect])
+            continue;
+        trackused[m.track] = detused[m.detect] = 1;
+
+        Track& k = tracks_[m.track];
+        const DetectedRegion& d = det[m.detect];
+        const RealType x = d.x + d.width/RealType(2);
+        const RealType y = d.y + d.height/RealType(2);
+        // displacement per frame since the last detection, smoothed
+        const RealType vx = (x - k.x)/(k.missed + 1);
+        const RealType vy = (y - k.y)/(k.missed + 1);
+        if (k.hits > 1) {
+            k.vx = (k.vx + vx)/2; k.vy = (k.vy + vy)/2;
+        } else {
+            k.vx = vx; k.vy = vy;
+        }
+        k.x = x; k.y = y;
+        k.width = d.width; k.height = d.height;
+        k.scale = d.scale; k.score = d.score;
+        k.missed = 0;
+        ++k.hits;
+    }
+
+    std::vector<Track> kept;
+    kept.reserve(tracks_.size() + det.size());
+    for (unsigned t= 0; t< tracks_.size(); ++t) {
+        Track k = tracks_[t];
+        if (!trackused[t] && ++k.missed > maxmissed)
+            continue;
+        kept.push_back(k);
+    }
+    for (unsigned d= 0; d< det.size(); ++d) {
+        if (detused[d])
+            continue;
+        Track k;
+        k.x = det[d].x + det[d].width/RealType(2);
+        k.y = det[d].y + det[d].height/RealType(2);
+        k.vx = k.vy = 0;
+        k.width = det[d].width; k.height = det[d].height;
+        k.scale = det[d].scale; k.score = det[d].score;
+        k.missed = 0; k.hits = 1;
+        kept.push_back(k);
+    }
+    tracks_.swap(kept);
+}// }}}
+
+void WinDetectTrack::print(std::ostream& o) const
+{
+    using std::setw; using std::left; using std::right;
+    o << "WinDetectTrack ::\n"
+        "  | FullScan " << setw(4) << left << fullscan << "  MotionThres " << setw(6) << left << motionthreshold << "           |\n"
+        "  | Search R:" << setw(5) << left << searchradius << " Sc:" << setw(5) << left << searchscale << " Miss:" << setw(3) << left << maxmissed << " Ovl:" << setw(5) << left << matchoverlap << right << "  |\n"
+        "  |----------------------------------------------|\n";
+}